@@ -0,0 +1,310 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/un.h>
+
+#include "contrib/addr_set.h"
+#include "contrib/macros.h"
+#include "contrib/sockaddr.h"
+#include "libknot/errcode.h"
+
+#define ROOT_IPV4	0
+#define ROOT_IPV6	1
+#define INIT_NODES	64
+
+typedef enum {
+	DISJOINT,
+	PARTIAL,
+	COVERED,
+} relation_t;
+
+addr_set_t *addr_set_new(void)
+{
+	addr_set_t *set = calloc(1, sizeof(*set));
+	if (set == NULL) {
+		return NULL;
+	}
+
+	set->nodes = calloc(INIT_NODES, sizeof(*set->nodes));
+	if (set->nodes == NULL) {
+		free(set);
+		return NULL;
+	}
+	set->count = 2; // Both roots.
+	set->capacity = INIT_NODES;
+
+	return set;
+}
+
+void addr_set_free(addr_set_t *set)
+{
+	if (set == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < set->path_count; i++) {
+		free(set->paths[i]);
+	}
+	free(set->paths);
+	free(set->nodes);
+	free(set);
+}
+
+static bool get_bit(const uint8_t *raw, unsigned bit)
+{
+	return raw[bit / 8] & (0x80 >> (bit % 8));
+}
+
+static void set_bits_from(uint8_t *raw, size_t len, unsigned bit, bool value)
+{
+	for (unsigned i = bit; i < len * 8; i++) {
+		if (i % 8 == 0) {
+			memset(raw + i / 8, value ? 0xff : 0x00, len - i / 8);
+			break;
+		}
+		if (value) {
+			raw[i / 8] |= (0x80 >> (i % 8));
+		} else {
+			raw[i / 8] &= ~(0x80 >> (i % 8));
+		}
+	}
+}
+
+/*!
+ * Relation of the [lo, hi] range to the subtree of the node at the given depth
+ * with the prefix (the bits from the depth on are zero).
+ */
+static relation_t relation(const uint8_t *prefix, unsigned depth,
+                           const uint8_t *lo, const uint8_t *hi, size_t len)
+{
+	uint8_t last[16];
+	memcpy(last, prefix, len);
+	set_bits_from(last, len, depth, true);
+
+	if (memcmp(last, lo, len) < 0 || memcmp(prefix, hi, len) > 0) {
+		return DISJOINT;
+	} else if (memcmp(lo, prefix, len) <= 0 && memcmp(last, hi, len) <= 0) {
+		return COVERED;
+	} else {
+		return PARTIAL;
+	}
+}
+
+static int node_child(addr_set_t *set, uint32_t node, bool bit, uint32_t *child)
+{
+	*child = set->nodes[node].child[bit];
+	if (*child != 0) {
+		return KNOT_EOK;
+	}
+
+	if (set->count == set->capacity) {
+		if (set->capacity > UINT32_MAX / 2) {
+			return KNOT_ESPACE;
+		}
+		addr_set_node_t *nodes = realloc(set->nodes,
+		                                 2 * set->capacity * sizeof(*nodes));
+		if (nodes == NULL) {
+			return KNOT_ENOMEM;
+		}
+		set->nodes = nodes;
+		set->capacity *= 2;
+	}
+
+	*child = set->count++;
+	memset(&set->nodes[*child], 0, sizeof(set->nodes[*child]));
+	set->nodes[node].child[bit] = *child;
+
+	return KNOT_EOK;
+}
+
+static void node_cover(addr_set_t *set, uint32_t node)
+{
+	// Nodes of the former subtree stay allocated but unreachable.
+	set->nodes[node].covered = true;
+	set->nodes[node].child[0] = 0;
+	set->nodes[node].child[1] = 0;
+}
+
+/*! Insert the range into the subtree of the node it partially covers. */
+static int insert(addr_set_t *set, uint32_t node, unsigned depth, uint8_t *prefix,
+                  const uint8_t *lo, const uint8_t *hi, size_t len)
+{
+	if (set->nodes[node].covered) {
+		return KNOT_EOK;
+	}
+
+	// A single address is either covered or disjoint.
+	assert(depth < len * 8);
+
+	for (int bit = 0; bit < 2; bit++) {
+		if (bit) {
+			prefix[depth / 8] |= (0x80 >> (depth % 8));
+		}
+
+		int ret = KNOT_EOK;
+		relation_t rel = relation(prefix, depth + 1, lo, hi, len);
+		if (rel != DISJOINT) {
+			uint32_t child;
+			ret = node_child(set, node, bit, &child);
+			if (ret == KNOT_EOK) {
+				if (rel == COVERED) {
+					node_cover(set, child);
+				} else {
+					ret = insert(set, child, depth + 1, prefix, lo, hi, len);
+				}
+			}
+		}
+
+		prefix[depth / 8] &= ~(0x80 >> (depth % 8));
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static int add_raw_range(addr_set_t *set, uint32_t root, const uint8_t *lo,
+                         const uint8_t *hi, size_t len)
+{
+	if (memcmp(lo, hi, len) > 0) {
+		return KNOT_EOK;
+	}
+
+	uint8_t prefix[16] = { 0 };
+	if (relation(prefix, 0, lo, hi, len) == COVERED) {
+		node_cover(set, root);
+		return KNOT_EOK;
+	}
+
+	return insert(set, root, 0, prefix, lo, hi, len);
+}
+
+static int add_path(addr_set_t *set, const struct sockaddr_storage *addr)
+{
+	const struct sockaddr_un *un = (const struct sockaddr_un *)addr;
+
+	char **paths = realloc(set->paths, (set->path_count + 1) * sizeof(*paths));
+	if (paths == NULL) {
+		return KNOT_ENOMEM;
+	}
+	set->paths = paths;
+
+	set->paths[set->path_count] = strdup(un->sun_path);
+	if (set->paths[set->path_count] == NULL) {
+		return KNOT_ENOMEM;
+	}
+	set->path_count++;
+
+	return KNOT_EOK;
+}
+
+static uint32_t family_root(int family)
+{
+	return (family == AF_INET) ? ROOT_IPV4 : ROOT_IPV6;
+}
+
+int addr_set_add_net(addr_set_t *set, const struct sockaddr_storage *addr,
+                     unsigned prefix)
+{
+	if (set == NULL || addr == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	switch (addr->ss_family) {
+	case AF_INET:
+	case AF_INET6:
+		break;
+	case AF_UNIX:
+		return add_path(set, addr);
+	default:
+		return KNOT_EINVAL;
+	}
+
+	size_t len = 0;
+	const uint8_t *raw = sockaddr_raw(addr, &len);
+	assert(len <= 16);
+	prefix = MIN(prefix, len * 8);
+
+	uint8_t lo[16], hi[16];
+	memcpy(lo, raw, len);
+	memcpy(hi, raw, len);
+	set_bits_from(lo, len, prefix, false);
+	set_bits_from(hi, len, prefix, true);
+
+	return add_raw_range(set, family_root(addr->ss_family), lo, hi, len);
+}
+
+int addr_set_add_range(addr_set_t *set, const struct sockaddr_storage *min,
+                       const struct sockaddr_storage *max)
+{
+	if (set == NULL || min == NULL || max == NULL ||
+	    min->ss_family != max->ss_family ||
+	    (min->ss_family != AF_INET && min->ss_family != AF_INET6)) {
+		return KNOT_EINVAL;
+	}
+
+	size_t len = 0;
+	const uint8_t *lo = sockaddr_raw(min, &len);
+	const uint8_t *hi = sockaddr_raw(max, &len);
+
+	return add_raw_range(set, family_root(min->ss_family), lo, hi, len);
+}
+
+bool addr_set_match(const addr_set_t *set, const struct sockaddr_storage *addr)
+{
+	if (set == NULL || addr == NULL) {
+		return false;
+	}
+
+	uint32_t node;
+	switch (addr->ss_family) {
+	case AF_INET:
+		node = ROOT_IPV4;
+		break;
+	case AF_INET6:
+		node = ROOT_IPV6;
+		break;
+	case AF_UNIX:
+		for (size_t i = 0; i < set->path_count; i++) {
+			const struct sockaddr_un *un = (const struct sockaddr_un *)addr;
+			if (strcmp(un->sun_path, set->paths[i]) == 0) {
+				return true;
+			}
+		}
+		return false;
+	default:
+		return false;
+	}
+
+	size_t len = 0;
+	const uint8_t *raw = sockaddr_raw(addr, &len);
+
+	for (unsigned depth = 0; !set->nodes[node].covered; depth++) {
+		if (depth == len * 8) {
+			return false;
+		}
+		node = set->nodes[node].child[get_bit(raw, depth)];
+		if (node == 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
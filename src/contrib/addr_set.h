@@ -0,0 +1,89 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * \brief Set of network address prefixes and ranges.
+ *
+ * The set is a binary prefix trie per address family. Ranges are stored
+ * as the minimal covering sets of prefixes, so a lookup takes at most one
+ * step per address bit regardless of the number of stored items.
+ *
+ * The set is built once and then only read, concurrent lookups are safe.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+typedef struct {
+	uint32_t child[2]; /*!< Child node indices, 0 if none. */
+	bool covered;      /*!< The whole subtree is in the set. */
+} addr_set_node_t;
+
+typedef struct {
+	addr_set_node_t *nodes; /*!< Trie nodes, 0 is IPv4 root, 1 is IPv6 root. */
+	uint32_t count;         /*!< Number of used nodes. */
+	uint32_t capacity;      /*!< Number of allocated nodes. */
+	char **paths;           /*!< UNIX socket paths (exact match). */
+	size_t path_count;      /*!< Number of UNIX socket paths. */
+} addr_set_t;
+
+/*!
+ * \brief Create an empty address set.
+ *
+ * \return New set or NULL if no memory.
+ */
+addr_set_t *addr_set_new(void);
+
+/*!
+ * \brief Free the address set.
+ */
+void addr_set_free(addr_set_t *set);
+
+/*!
+ * \brief Add a network prefix to the set.
+ *
+ * UNIX socket addresses are added as exact paths, prefix is ignored.
+ *
+ * \param set     Address set.
+ * \param addr    Network address.
+ * \param prefix  Prefix length in bits (longer is truncated to the address length).
+ *
+ * \return KNOT_E*
+ */
+int addr_set_add_net(addr_set_t *set, const struct sockaddr_storage *addr,
+                     unsigned prefix);
+
+/*!
+ * \brief Add an inclusive address range to the set.
+ *
+ * An empty range (min above max) is ignored.
+ *
+ * \param set  Address set.
+ * \param min  Lowest address in the range.
+ * \param max  Highest address in the range (same family).
+ *
+ * \return KNOT_E*
+ */
+int addr_set_add_range(addr_set_t *set, const struct sockaddr_storage *min,
+                       const struct sockaddr_storage *max);
+
+/*!
+ * \brief Check if the address is in the set.
+ */
+bool addr_set_match(const addr_set_t *set, const struct sockaddr_storage *addr);
@@ -30,6 +30,8 @@
  #define ATOMIC_ADD(dst, val)  (void)atomic_fetch_add_explicit(&(dst), (val), memory_order_relaxed)
  #define ATOMIC_SUB(dst, val)  (void)atomic_fetch_sub_explicit(&(dst), (val), memory_order_relaxed)
  #define ATOMIC_XCHG(dst, val) atomic_exchange_explicit(&(dst), (val), memory_order_relaxed)
+ #define ATOMIC_SET_RELEASE(dst, val) atomic_store_explicit(&(dst), (val), memory_order_release)
+ #define ATOMIC_GET_ACQUIRE(src)      atomic_load_explicit(&(src), memory_order_acquire)
 
  typedef atomic_uint_fast16_t knot_atomic_uint16_t;
  typedef atomic_uint_fast64_t knot_atomic_uint64_t;
@@ -47,6 +49,8 @@
  #define ATOMIC_ADD(dst, val)  __atomic_add_fetch(&(dst), (val), __ATOMIC_RELAXED)
  #define ATOMIC_SUB(dst, val)  __atomic_sub_fetch(&(dst), (val), __ATOMIC_RELAXED)
  #define ATOMIC_XCHG(dst, val) __atomic_exchange_n(&(dst), (val), __ATOMIC_RELAXED)
+ #define ATOMIC_SET_RELEASE(dst, val) __atomic_store_n(&(dst), (val), __ATOMIC_RELEASE)
+ #define ATOMIC_GET_ACQUIRE(src)      __atomic_load_n(&(src), __ATOMIC_ACQUIRE)
 
  typedef uint16_t knot_atomic_uint16_t;
  typedef uint64_t knot_atomic_uint64_t;
@@ -64,6 +68,8 @@
  #define ATOMIC_ADD(dst, val)  ((dst) += (val))
  #define ATOMIC_SUB(dst, val)  ((dst) -= (val))
  #define ATOMIC_XCHG(dst, val) ({ __typeof__ (dst) _z = (dst); (dst) = (val); _z; })
+ #define ATOMIC_SET_RELEASE(dst, val) ((dst) = (val))
+ #define ATOMIC_GET_ACQUIRE(src)      (src)
 
  typedef uint16_t knot_atomic_uint16_t;
  typedef uint64_t knot_atomic_uint64_t;
@@ -71,3 +77,11 @@
  typedef void* knot_atomic_ptr_t;
  typedef bool knot_atomic_bool;
 #endif
+
+/*
+ * Single-writer variants of ATOMIC_ADD and ATOMIC_SUB. The value must be
+ * modified by one thread only, other threads can read it using ATOMIC_GET.
+ * No locked read-modify-write instruction is needed.
+ */
+#define ATOMIC_ADD_OWNED(dst, val) ATOMIC_SET(dst, ATOMIC_GET(dst) + (val))
+#define ATOMIC_SUB_OWNED(dst, val) ATOMIC_SET(dst, ATOMIC_GET(dst) - (val))
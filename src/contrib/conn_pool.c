@@ -30,7 +30,77 @@ conn_pool_t *global_sessticket_pool = NULL;
 
 const conn_pool_fd_t CONN_POOL_FD_INVALID = -1;
 
-static conn_pool_fd_t pool_pop(conn_pool_t *pool, size_t i);
+/*! \brief Maximum number of dead connections closed per shard lock. */
+#define INVALID_BATCH	32
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+{
+	const uint8_t *byte = data;
+	for (size_t i = 0; i < len; i++) {
+		hash = (hash ^ byte[i]) * 16777619U;
+	}
+	return hash;
+}
+
+/*!
+ * \brief Hash the address pair consistently with conn_pool_get() matching.
+ *
+ * The source port is ignored, the destination port is significant.
+ */
+static uint32_t addr_hash(const struct sockaddr_storage *src,
+                          const struct sockaddr_storage *dst)
+{
+	uint32_t hash = 2166136261U;
+	size_t len = 0;
+
+	const void *raw = sockaddr_raw(src, &len);
+	hash = fnv1a(hash, &src->ss_family, sizeof(src->ss_family));
+	if (raw != NULL) {
+		hash = fnv1a(hash, raw, len);
+	}
+
+	raw = sockaddr_raw(dst, &len);
+	hash = fnv1a(hash, &dst->ss_family, sizeof(dst->ss_family));
+	if (raw != NULL) {
+		hash = fnv1a(hash, raw, len);
+	}
+	int port = sockaddr_port(dst);
+	hash = fnv1a(hash, &port, sizeof(port));
+
+	return hash;
+}
+
+static conn_pool_shard_t *get_shard(conn_pool_t *pool, uint32_t hash)
+{
+	return &pool->shards[hash % CONN_POOL_SHARDS];
+}
+
+static conn_pool_memb_t **get_bucket(conn_pool_shard_t *shard, uint32_t hash)
+{
+	return &shard->buckets[(hash / CONN_POOL_SHARDS) % CONN_POOL_BUCKETS];
+}
+
+/*!
+ * \brief Unlink the member from the shard and free it, return its fd.
+ */
+static conn_pool_fd_t pool_pop(conn_pool_t *pool, conn_pool_shard_t *shard,
+                               conn_pool_memb_t *conn)
+{
+	conn_pool_memb_t **pos = get_bucket(shard, conn->hash);
+	while (*pos != conn) {
+		assert(*pos != NULL);
+		pos = &(*pos)->next;
+	}
+	*pos = conn->next;
+	rem_node(&conn->n);
+
+	assert(ATOMIC_GET(pool->usage) > 0);
+	ATOMIC_SUB(pool->usage, 1);
+
+	conn_pool_fd_t fd = conn->fd;
+	free(conn);
+	return fd;
+}
 
 /*!
  * \brief Try to get an open connection older than specified timestamp.
@@ -51,26 +121,63 @@ static conn_pool_fd_t get_old(conn_pool_t *pool,
 
 	*next_oldest = 0;
 
-	conn_pool_fd_t fd = CONN_POOL_FD_INVALID;
-	pthread_mutex_lock(&pool->mutex);
-
-	for (size_t i = 0; i < pool->capacity; i++) {
-		knot_time_t la = pool->conns[i].last_active;
-		if (fd == CONN_POOL_FD_INVALID && knot_time_cmp(la, older_than) < 0) {
-			fd = pool_pop(pool, i);
-		} else if (knot_time_cmp(la, *next_oldest) < 0) {
-			*next_oldest = la;
+	for (size_t i = 0; i < CONN_POOL_SHARDS; i++) {
+		conn_pool_shard_t *shard = &pool->shards[i];
+		pthread_mutex_lock(&shard->mutex);
+		if (!EMPTY_LIST(shard->lru)) {
+			conn_pool_memb_t *conn = HEAD(shard->lru);
+			if (knot_time_cmp(conn->last_active, older_than) < 0) {
+				conn_pool_fd_t fd = pool_pop(pool, shard, conn);
+				pthread_mutex_unlock(&shard->mutex);
+				return fd;
+			} else if (knot_time_cmp(conn->last_active, *next_oldest) < 0) {
+				*next_oldest = conn->last_active;
+			}
 		}
+		pthread_mutex_unlock(&shard->mutex);
 	}
 
-	pthread_mutex_unlock(&pool->mutex);
-	return fd;
+	return CONN_POOL_FD_INVALID;
+}
+
+/*!
+ * \brief Close pooled connections which are no longer usable (e.g. closed by the peer).
+ */
+static void close_invalid(conn_pool_t *pool)
+{
+	for (size_t i = 0; i < CONN_POOL_SHARDS; i++) {
+		conn_pool_shard_t *shard = &pool->shards[i];
+		conn_pool_fd_t invalid[INVALID_BATCH];
+		size_t count;
+		do {
+			count = 0;
+			pthread_mutex_lock(&shard->mutex);
+			conn_pool_memb_t *conn, *nxt;
+			WALK_LIST_DELSAFE(conn, nxt, shard->lru) {
+				if (pool->invalid_cb(conn->fd)) {
+					invalid[count++] = pool_pop(pool, shard, conn);
+					if (count == INVALID_BATCH) {
+						break;
+					}
+				}
+			}
+			pthread_mutex_unlock(&shard->mutex);
+
+			for (size_t j = 0; j < count; j++) {
+				pool->close_cb(invalid[j]);
+			}
+		} while (count == INVALID_BATCH);
+	}
 }
 
 static void *closing_thread(void *_arg)
 {
 	conn_pool_t *pool = _arg;
 
+	/* Only allow cancellation while sleeping, never with a shard locked. */
+	int unused;
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &unused);
+
 	while (true) {
 		knot_time_t now = knot_time(), next = 0;
 		knot_timediff_t timeout = conn_pool_timeout(pool, 0);
@@ -85,11 +192,15 @@ static void *closing_thread(void *_arg)
 			}
 		}
 
+		close_invalid(pool);
+
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &unused);
 		if (next == 0) {
 			sleep(timeout);
 		} else {
 			sleep(next + timeout - now);
 		}
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &unused);
 	}
 
 	return NULL; // we never get here since the thread will be cancelled instead
@@ -103,21 +214,28 @@ conn_pool_t *conn_pool_init(size_t capacity, knot_timediff_t timeout,
 		return NULL;
 	}
 
-	conn_pool_t *pool = calloc(1, sizeof(*pool) + capacity * sizeof(pool->conns[0]));
+	conn_pool_t *pool = calloc(1, sizeof(*pool));
 	if (pool != NULL) {
 		pool->capacity = capacity;
 		pool->timeout = timeout;
+		pool->close_cb = close_cb;
+		pool->invalid_cb = invalid_cb;
 		if (pthread_mutex_init(&pool->mutex, 0) != 0) {
 			free(pool);
 			return NULL;
 		}
+		for (size_t i = 0; i < CONN_POOL_SHARDS; i++) {
+			pthread_mutex_init(&pool->shards[i].mutex, 0);
+			init_list(&pool->shards[i].lru);
+		}
 		if (pthread_create(&pool->closing_thread, NULL, closing_thread, pool) != 0) {
+			for (size_t i = 0; i < CONN_POOL_SHARDS; i++) {
+				pthread_mutex_destroy(&pool->shards[i].mutex);
+			}
 			pthread_mutex_destroy(&pool->mutex);
 			free(pool);
 			return NULL;
 		}
-		pool->close_cb = close_cb;
-		pool->invalid_cb = invalid_cb;
 	}
 	return pool;
 }
@@ -134,6 +252,9 @@ void conn_pool_deinit(conn_pool_t *pool)
 			pool->close_cb(fd);
 		}
 
+		for (size_t i = 0; i < CONN_POOL_SHARDS; i++) {
+			pthread_mutex_destroy(&pool->shards[i].mutex);
+		}
 		pthread_mutex_destroy(&pool->mutex);
 		free(pool);
 	}
@@ -157,17 +278,6 @@ knot_timediff_t conn_pool_timeout(conn_pool_t *pool,
 	return prev;
 }
 
-static conn_pool_fd_t pool_pop(conn_pool_t *pool, size_t i)
-{
-	conn_pool_memb_t *conn = &pool->conns[i];
-	assert(conn->last_active != 0);
-	assert(pool->usage > 0);
-	conn_pool_fd_t fd = conn->fd;
-	memset(conn, 0, sizeof(*conn));
-	pool->usage--;
-	return fd;
-}
-
 conn_pool_fd_t conn_pool_get(conn_pool_t *pool,
                              const struct sockaddr_storage *src,
                              const struct sockaddr_storage *dst)
@@ -176,41 +286,51 @@ conn_pool_fd_t conn_pool_get(conn_pool_t *pool,
 		return CONN_POOL_FD_INVALID;
 	}
 
-	conn_pool_fd_t fd = CONN_POOL_FD_INVALID;
-	pthread_mutex_lock(&pool->mutex);
+	uint32_t hash = addr_hash(src, dst);
+	conn_pool_shard_t *shard = get_shard(pool, hash);
 
-	for (size_t i = 0; i < pool->capacity; i++) {
-		if (pool->conns[i].last_active != 0 &&
-		    sockaddr_cmp(&pool->conns[i].dst, dst, false) == 0 &&
-		    sockaddr_cmp(&pool->conns[i].src, src, true) == 0) {
-			fd = pool_pop(pool, i);
-			break;
+	while (true) {
+		conn_pool_fd_t fd = CONN_POOL_FD_INVALID;
+		pthread_mutex_lock(&shard->mutex);
+
+		for (conn_pool_memb_t *conn = *get_bucket(shard, hash);
+		     conn != NULL; conn = conn->next) {
+			if (conn->hash == hash &&
+			    sockaddr_cmp(&conn->dst, dst, false) == 0 &&
+			    sockaddr_cmp(&conn->src, src, true) == 0) {
+				fd = pool_pop(pool, shard, conn);
+				break;
+			}
 		}
-	}
 
-	pthread_mutex_unlock(&pool->mutex);
+		pthread_mutex_unlock(&shard->mutex);
 
-	if (fd != CONN_POOL_FD_INVALID && pool->invalid_cb(fd)) {
+		if (fd == CONN_POOL_FD_INVALID || !pool->invalid_cb(fd)) {
+			return fd;
+		}
+
+		/* Dead connection, try another one to the same destination. */
 		pool->close_cb(fd);
-		fd = CONN_POOL_FD_INVALID;
 	}
-
-	return fd;
 }
 
-static void pool_push(conn_pool_t *pool, size_t i,
-                      const struct sockaddr_storage *src,
-                      const struct sockaddr_storage *dst,
-                      conn_pool_fd_t fd)
+/*!
+ * \brief Displace the oldest connection of some shard, the given one preferred.
+ */
+static conn_pool_fd_t pool_evict(conn_pool_t *pool, size_t first)
 {
-	conn_pool_memb_t *conn = &pool->conns[i];
-	assert(conn->last_active == 0);
-	assert(pool->usage < pool->capacity);
-	conn->last_active = knot_time();
-	conn->fd = fd;
-	memcpy(&conn->src, src, sizeof(conn->src));
-	memcpy(&conn->dst, dst, sizeof(conn->dst));
-	pool->usage++;
+	for (size_t i = 0; i < CONN_POOL_SHARDS; i++) {
+		conn_pool_shard_t *shard = &pool->shards[(first + i) % CONN_POOL_SHARDS];
+		pthread_mutex_lock(&shard->mutex);
+		if (!EMPTY_LIST(shard->lru)) {
+			conn_pool_fd_t fd = pool_pop(pool, shard, HEAD(shard->lru));
+			pthread_mutex_unlock(&shard->mutex);
+			return fd;
+		}
+		pthread_mutex_unlock(&shard->mutex);
+	}
+
+	return CONN_POOL_FD_INVALID;
 }
 
 conn_pool_fd_t conn_pool_put(conn_pool_t *pool,
@@ -222,27 +342,31 @@ conn_pool_fd_t conn_pool_put(conn_pool_t *pool,
 		return fd;
 	}
 
-	knot_time_t oldest_time = 0;
-	size_t oldest_i = pool->capacity;
-
-	pthread_mutex_lock(&pool->mutex);
+	conn_pool_memb_t *conn = malloc(sizeof(*conn));
+	if (conn == NULL) {
+		return fd;
+	}
+	conn->hash = addr_hash(src, dst);
+	conn->fd = fd;
+	conn->last_active = knot_time();
+	memcpy(&conn->src, src, sizeof(conn->src));
+	memcpy(&conn->dst, dst, sizeof(conn->dst));
 
-	for (size_t i = 0; i < pool->capacity; i++) {
-		knot_time_t la = pool->conns[i].last_active;
-		if (la == 0) {
-			pool_push(pool, i, src, dst, fd);
-			pthread_mutex_unlock(&pool->mutex);
-			return CONN_POOL_FD_INVALID;
-		} else if (knot_time_cmp(la, oldest_time) < 0) {
-			oldest_time = la;
-			oldest_i = i;
-		}
+	conn_pool_fd_t oldest_fd = CONN_POOL_FD_INVALID;
+	if (ATOMIC_GET(pool->usage) >= pool->capacity) {
+		oldest_fd = pool_evict(pool, conn->hash % CONN_POOL_SHARDS);
 	}
 
-	assert(oldest_i < pool->capacity);
-	conn_pool_fd_t oldest_fd = pool_pop(pool, oldest_i);
-	pool_push(pool, oldest_i, src, dst, fd);
-	pthread_mutex_unlock(&pool->mutex);
+	conn_pool_shard_t *shard = get_shard(pool, conn->hash);
+	conn_pool_memb_t **bucket = get_bucket(shard, conn->hash);
+
+	pthread_mutex_lock(&shard->mutex);
+	conn->next = *bucket;
+	*bucket = conn;
+	add_tail(&shard->lru, &conn->n);
+	ATOMIC_ADD(pool->usage, 1);
+	pthread_mutex_unlock(&shard->mutex);
+
 	return oldest_fd;
 }
 
@@ -20,7 +20,12 @@
 #include <stdbool.h>
 #include <sys/socket.h>
 
+#include "contrib/atomic.h"
 #include "contrib/time.h"
+#include "contrib/ucw/lists.h"
+
+#define CONN_POOL_SHARDS	16	/*!< Number of independently locked pool parts. */
+#define CONN_POOL_BUCKETS	64	/*!< Number of hash buckets per shard. */
 
 typedef intptr_t conn_pool_fd_t;
 extern const conn_pool_fd_t CONN_POOL_FD_INVALID;
@@ -28,22 +33,31 @@ extern const conn_pool_fd_t CONN_POOL_FD_INVALID;
 typedef void (*conn_pool_close_cb_t)(conn_pool_fd_t fd);
 typedef bool (*conn_pool_invalid_cb_t)(conn_pool_fd_t fd);
 
-typedef struct {
+typedef struct conn_pool_memb {
+	node_t n;			/*!< Shard LRU list node. */
+	struct conn_pool_memb *next;	/*!< Next member in the hash bucket. */
+	uint32_t hash;			/*!< Hash of the address pair. */
 	struct sockaddr_storage src;
 	struct sockaddr_storage dst;
 	conn_pool_fd_t fd;
 	knot_time_t last_active;
 } conn_pool_memb_t;
 
+typedef struct {
+	pthread_mutex_t mutex;
+	list_t lru;			/*!< Members, the least recently put first. */
+	conn_pool_memb_t *buckets[CONN_POOL_BUCKETS]; /*!< Members by address pair, newest first. */
+} conn_pool_shard_t;
+
 typedef struct {
 	size_t capacity;
-	size_t usage;
+	knot_atomic_size_t usage;
 	knot_timediff_t timeout;
-	pthread_mutex_t mutex;
+	pthread_mutex_t mutex;		/*!< Protects the timeout. */
 	pthread_t closing_thread;
 	conn_pool_close_cb_t close_cb;
 	conn_pool_invalid_cb_t invalid_cb;
-	conn_pool_memb_t conns[];
+	conn_pool_shard_t shards[CONN_POOL_SHARDS];
 } conn_pool_t;
 
 extern conn_pool_t *global_conn_pool;
@@ -84,6 +98,9 @@ knot_timediff_t conn_pool_timeout(conn_pool_t *pool,
 /*!
  * \brief Try to get an open connection if present, check if alive.
  *
+ * \note The most recently put connection for the address pair is preferred.
+ *       The returned connection is owned by the caller until it is put back.
+ *
  * \param pool   Pool to search in.
  * \param src    Connection source address.
  * \param dst    Connection destination address.
@@ -98,6 +115,9 @@ conn_pool_fd_t conn_pool_get(conn_pool_t *pool,
 /*!
  * \brief Put an open connection to the pool, possibly displacing the oldest one there.
  *
+ * \note Concurrent puts may exceed the capacity by the number of putting
+ *       threads for a moment, the excess is displaced by subsequent puts.
+ *
  * \param pool   Pool to insert into.
  * \param src    Connestion source address.
  * \param dst    Connection destination adress.
@@ -0,0 +1,53 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Same compiler requirements as for the KRU AVX2 implementation.
+#if defined(__x86_64__) && (__clang_major__ >= 5 || __GNUC__ >= 6)
+
+#if __clang__
+	#pragma clang attribute push (__attribute__((target("avx2"))), \
+							apply_to = function)
+#else
+	#pragma GCC push_options
+	#pragma GCC target("avx2")
+#endif
+
+#define USE_AVX2 1
+#define USE_SSE2 1
+
+#include "./lower.inc.c"
+const struct lower_api LOWER_AVX2 = LOWER_API_INITIALIZER;
+
+#ifdef __clang__
+	#pragma clang attribute pop
+#else
+	#pragma GCC pop_options
+#endif
+
+__attribute__((constructor))
+static void detect_CPU_avx2(void)
+{
+	if (__builtin_cpu_supports("avx2")) {
+		LOWER = LOWER_AVX2;
+	}
+}
+
+#else
+
+#include "./lower.h"
+const struct lower_api LOWER_AVX2 = {NULL};
+
+#endif
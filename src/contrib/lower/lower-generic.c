@@ -0,0 +1,27 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Vector instructions which are always available on the target architecture.
+#if defined(__SSE2__)
+	#define USE_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define USE_NEON 1
+#endif
+
+#include "./lower.inc.c"
+
+const struct lower_api LOWER_GENERIC = LOWER_API_INITIALIZER;
+struct lower_api LOWER = LOWER_API_INITIALIZER; // generic version is the default
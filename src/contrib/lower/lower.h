@@ -0,0 +1,47 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * \brief Vectorized ASCII lowercasing of byte strings.
+ *
+ * The implementation is selected at startup, the AVX2 one is used if
+ * the CPU supports it. Otherwise the baseline vector instructions (SSE2
+ * on x86-64, NEON on AArch64) or the scalar code are used.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Usage: LOWER.copy(...)
+struct lower_api {
+	/// Copy the bytes converting ASCII uppercase letters to lowercase.
+	/// The buffers must be either the same (in-place conversion) or disjoint.
+	void (*copy)(uint8_t *dst, const uint8_t *src, size_t len);
+
+	/// Check if the bytes are equal ignoring ASCII letter case.
+	bool (*equal)(const uint8_t *s1, const uint8_t *s2, size_t len);
+};
+
+// The functions are stateless, so the choice can be made at any time.
+extern struct lower_api LOWER;
+
+// Concrete implementations, for tests (NULL functions if not compiled in).
+extern const struct lower_api LOWER_SCALAR;
+extern const struct lower_api LOWER_GENERIC;
+extern const struct lower_api LOWER_AVX2;
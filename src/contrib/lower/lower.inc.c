@@ -0,0 +1,170 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The implementation is compiled several times with different USE_* macros:
+ *   USE_AVX2  - 32-byte vectors (also with USE_SSE2 for shorter strings),
+ *   USE_SSE2  - 16-byte vectors,
+ *   USE_NEON  - 16-byte vectors,
+ * and the scalar code for the strings shorter than a vector.
+ *
+ * Lowercasing is idempotent, so the last partial vector is processed as
+ * a full vector overlapping the previous one instead of a scalar tail.
+ */
+
+#include "./lower.h"
+#include "contrib/tolower.h"
+
+#if USE_AVX2
+#include <immintrin.h>
+
+static inline __m256i lower_avx2(__m256i v)
+{
+	// Shift 'A'..'Z' to the lowest signed values to use a single comparison.
+	__m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8(0x80 - 'A'));
+	__m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), shifted);
+	return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+static inline __m256i load_lower_avx2(const uint8_t *src)
+{
+	return lower_avx2(_mm256_loadu_si256((const __m256i *)src));
+}
+
+static inline bool equal_avx2(const uint8_t *s1, const uint8_t *s2)
+{
+	__m256i eq = _mm256_cmpeq_epi8(load_lower_avx2(s1), load_lower_avx2(s2));
+	return (uint32_t)_mm256_movemask_epi8(eq) == UINT32_MAX;
+}
+#endif
+
+#if USE_SSE2
+#include <emmintrin.h>
+
+static inline __m128i lower_sse2(__m128i v)
+{
+	__m128i shifted = _mm_add_epi8(v, _mm_set1_epi8(0x80 - 'A'));
+	__m128i upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 26));
+	return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+static inline __m128i load_lower_sse2(const uint8_t *src)
+{
+	return lower_sse2(_mm_loadu_si128((const __m128i *)src));
+}
+
+static inline bool equal_sse2(const uint8_t *s1, const uint8_t *s2)
+{
+	__m128i eq = _mm_cmpeq_epi8(load_lower_sse2(s1), load_lower_sse2(s2));
+	return _mm_movemask_epi8(eq) == 0xFFFF;
+}
+#endif
+
+#if USE_NEON
+#include <arm_neon.h>
+
+static inline uint8x16_t load_lower_neon(const uint8_t *src)
+{
+	uint8x16_t v = vld1q_u8(src);
+	uint8x16_t upper = vcltq_u8(vsubq_u8(v, vdupq_n_u8('A')), vdupq_n_u8(26));
+	return vorrq_u8(v, vandq_u8(upper, vdupq_n_u8(0x20)));
+}
+
+static inline bool equal_neon(const uint8_t *s1, const uint8_t *s2)
+{
+	uint8x16_t eq = vceqq_u8(load_lower_neon(s1), load_lower_neon(s2));
+	return vminvq_u8(eq) == 0xFF;
+}
+#endif
+
+static void lower_copy(uint8_t *dst, const uint8_t *src, size_t len)
+{
+#if USE_AVX2
+	if (len >= 32) {
+		for (size_t i = 0; i < len - 32; i += 32) {
+			_mm256_storeu_si256((__m256i *)(dst + i), load_lower_avx2(src + i));
+		}
+		_mm256_storeu_si256((__m256i *)(dst + len - 32), load_lower_avx2(src + len - 32));
+		return;
+	}
+#endif
+#if USE_SSE2
+	if (len >= 16) {
+		for (size_t i = 0; i < len - 16; i += 16) {
+			_mm_storeu_si128((__m128i *)(dst + i), load_lower_sse2(src + i));
+		}
+		_mm_storeu_si128((__m128i *)(dst + len - 16), load_lower_sse2(src + len - 16));
+		return;
+	}
+#endif
+#if USE_NEON
+	if (len >= 16) {
+		for (size_t i = 0; i < len - 16; i += 16) {
+			vst1q_u8(dst + i, load_lower_neon(src + i));
+		}
+		vst1q_u8(dst + len - 16, load_lower_neon(src + len - 16));
+		return;
+	}
+#endif
+	for (size_t i = 0; i < len; i++) {
+		dst[i] = knot_tolower(src[i]);
+	}
+}
+
+static bool lower_equal(const uint8_t *s1, const uint8_t *s2, size_t len)
+{
+#if USE_AVX2
+	if (len >= 32) {
+		for (size_t i = 0; i < len - 32; i += 32) {
+			if (!equal_avx2(s1 + i, s2 + i)) {
+				return false;
+			}
+		}
+		return equal_avx2(s1 + len - 32, s2 + len - 32);
+	}
+#endif
+#if USE_SSE2
+	if (len >= 16) {
+		for (size_t i = 0; i < len - 16; i += 16) {
+			if (!equal_sse2(s1 + i, s2 + i)) {
+				return false;
+			}
+		}
+		return equal_sse2(s1 + len - 16, s2 + len - 16);
+	}
+#endif
+#if USE_NEON
+	if (len >= 16) {
+		for (size_t i = 0; i < len - 16; i += 16) {
+			if (!equal_neon(s1 + i, s2 + i)) {
+				return false;
+			}
+		}
+		return equal_neon(s1 + len - 16, s2 + len - 16);
+	}
+#endif
+	for (size_t i = 0; i < len; i++) {
+		if (knot_tolower(s1[i]) != knot_tolower(s2[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#define LOWER_API_INITIALIZER { \
+	.copy = lower_copy, \
+	.equal = lower_equal, \
+}
@@ -15,6 +15,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "contrib/mempattern.h"
 #include "contrib/string.h"
@@ -107,6 +108,19 @@ void mm_free(knot_mm_t *mm, void *what)
 	}
 }
 
+void *mm_cache_line_alloc(size_t size)
+{
+	size = (size + MM_CACHE_LINE - 1) & ~(size_t)(MM_CACHE_LINE - 1);
+
+	void *mem;
+	if (posix_memalign(&mem, MM_CACHE_LINE, size) != 0) {
+		return NULL;
+	}
+	memset(mem, 0, size);
+
+	return mem;
+}
+
 void mm_ctx_init(knot_mm_t *mm)
 {
 	mm->ctx = NULL;
@@ -25,6 +25,9 @@
 /*! \brief Default memory block size. */
 #define MM_DEFAULT_BLKSIZE 4096
 
+/*! \brief Assumed CPU cache line size. */
+#define MM_CACHE_LINE 64
+
 /*! \brief Allocs using 'mm' if any, uses system malloc() otherwise. */
 void *mm_alloc(knot_mm_t *mm, size_t size);
 
@@ -40,6 +43,14 @@ char *mm_strdup(knot_mm_t *mm, const char *s);
 /*! \brief Free using 'mm' if any, uses system free() otherwise. */
 void mm_free(knot_mm_t *mm, void *what);
 
+/*!
+ * \brief Allocates a zeroed block aligned and padded to whole cache lines.
+ *
+ * Blocks used by different threads thus never share a cache line.
+ * The block is freed using system free().
+ */
+void *mm_cache_line_alloc(size_t size);
+
 /*! \brief Initialize default memory allocation context. */
 void mm_ctx_init(knot_mm_t *mm);
 
@@ -20,6 +20,7 @@
 #include <sys/types.h>   // OpenBSD
 #include <netinet/tcp.h> // TCP_FASTOPEN
 #include <netinet/in.h>
+#include <netinet/udp.h> // UDP_GRO
 #include <poll.h>
 #include <stdbool.h>
 #include <sys/socket.h>
@@ -340,6 +341,15 @@ int net_cmsg_ecn_enable(int sock, int family)
 	}
 }
 
+int net_udp_gro_enable(int sock)
+{
+#ifdef UDP_GRO
+	return sockopt_enable(sock, IPPROTO_UDP, UDP_GRO);
+#else
+	return KNOT_ENOTSUP;
+#endif
+}
+
 int *net_cmsg_ecn_ptr(struct cmsghdr *cmsg)
 {
 #if defined(__linux__)
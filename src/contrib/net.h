@@ -93,6 +93,17 @@ int net_bound_tfo(int sock, int backlog);
  */
 int net_cmsg_ecn_enable(int sock, int family);
 
+/*!
+ * \brief Let kernel coalesce received datagrams of the same flow (UDP GRO).
+ *
+ * \note The coalesced datagram comes with the segment size in UDP_GRO cmsg.
+ *
+ * \param sock  UDP socket.
+ *
+ * \return KNOT_E*
+ */
+int net_udp_gro_enable(int sock);
+
 /*!
  * \brief Return pointer to possible ECN value in cmsg.
  *
@@ -490,6 +490,52 @@ trie_val_t* trie_get_try_wildcard(trie_t *tbl, const trie_key_t *key, uint32_t l
 	return trie_get_try(tbl, wild_key, wild_len);
 }
 
+trie_val_t* trie_get_longest_prefix(trie_t *tbl, const trie_key_t *key, uint32_t len,
+                                    trie_prefix_cb *accept, void *d)
+{
+	assert(tbl);
+	if (!tbl->weight)
+		return NULL;
+	// Find leaf sharing the longest common prefix; see ns_find_branch() for explanation.
+	node_t *t = &tbl->root;
+	while (isbranch(t)) {
+		__builtin_prefetch(twigs(t));
+		bitmap_t b = twigbit(t, key, len);
+		uint i = hastwig(t, b) ? twigoff(t, b) : 0;
+		t = twig(t, i);
+	}
+	const tkey_t * const lcp_key = tkey(t);
+
+	uint32_t lcp = 0;
+	while (lcp < len && lcp < lcp_key->len && key[lcp] == lcp_key->chars[lcp])
+		++lcp;
+
+	// If the leaf is a prefix itself, it's the longest one.
+	if (lcp == lcp_key->len && (accept == NULL || accept(lcp, d)))
+		return tvalp(t);
+
+	/* Shorter keys end in NOBYTE twigs of the branches on the same path.
+	 * All keys below a branch share the nibbles up to the branch index,
+	 * so such a key is a prefix if it isn't longer than the common prefix. */
+	trie_val_t *best = NULL;
+	t = &tbl->root;
+	while (isbranch(t)) {
+		uint32_t plen = branch_index(t) >> 1;
+		if (plen > lcp)
+			break;
+		if (hastwig(t, BMP_NOBYTE) && (accept == NULL || accept(plen, d))) {
+			node_t *prefix = twig(t, 0);
+			assert(!isbranch(prefix) && tkey(prefix)->len == plen);
+			best = tvalp(prefix);
+		}
+		bitmap_t b = twigbit(t, key, len);
+		if (!hastwig(t, b))
+			break;
+		t = twig(t, twigoff(t, b));
+	}
+	return best;
+}
+
 /*! \brief Delete leaf t with parent p; b is the bit for t under p.
  * Optionally return the deleted value via val.  The function can't fail. */
 static void del_found(trie_t *tbl, node_t *t, node_t *p, bitmap_t b, trie_val_t *val)
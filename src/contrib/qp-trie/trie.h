@@ -85,6 +85,25 @@ trie_val_t* trie_get_try(trie_t *tbl, const trie_key_t *key, uint32_t len);
  */
 trie_val_t* trie_get_try_wildcard(trie_t *tbl, const trie_key_t *key, uint32_t len);
 
+/*! \brief Callback for accepting a prefix length in trie_get_longest_prefix(). */
+typedef bool trie_prefix_cb(uint32_t len, void *d);
+
+/*!
+ * \brief Search for the longest key which is a prefix of the given key.
+ *
+ * The trie is descended only once, regardless of the number of prefixes.
+ *
+ * \param tbl     Trie.
+ * \param key     Searched key.
+ * \param len     Key length.
+ * \param accept  (optional) Callback restricting acceptable prefix lengths.
+ * \param d       Additional callback data.
+ *
+ * \return Value of the longest accepted prefix (incl. exact match) or NULL.
+ */
+trie_val_t* trie_get_longest_prefix(trie_t *tbl, const trie_key_t *key, uint32_t len,
+                                    trie_prefix_cb *accept, void *d);
+
 /*! \brief Search the trie, inserting NULL trie_val_t on failure. */
 trie_val_t* trie_get_ins(trie_t *tbl, const trie_key_t *key, uint32_t len);
 
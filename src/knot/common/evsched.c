@@ -23,40 +23,157 @@
 #include "libknot/libknot.h"
 #include "knot/server/dthreads.h"
 #include "knot/common/evsched.h"
+#include "contrib/time.h"
+
+/*
+ * The events are kept in a hierarchical timer wheel. Wheel W has slots of
+ * 2^(W * EVSCHED_WHEEL_BITS) milliseconds. An event is put in the lowest
+ * wheel which can hold its remaining time. Slots of the upper wheels are
+ * processed one slot ahead, and their events are moved into lower wheels
+ * as the time advances. Inserting and removing an event is O(1). Advancing
+ * the time and finding the next wakeup only looks at the slot bitmaps.
+ */
+
+#define WHEEL_MASK	(EVSCHED_WHEEL_SLOTS - 1)
+#define TIME_NEVER	UINT64_MAX
+
+/*! \brief Monotonic time in milliseconds. */
+static uint64_t time_ms(void)
+{
+	struct timespec now = time_now();
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
 
-/*! \brief Some implementations of timercmp >= are broken, this is for compat.*/
-static inline int timercmp_ge(struct timeval *a, struct timeval *b) {
-	return !timercmp(a, b, <);
+static inline uint64_t rotl(uint64_t v, unsigned c)
+{
+	c &= 63;
+	return (c == 0) ? v : (v << c) | (v >> (64 - c));
 }
 
-static int compare_event_heap_nodes(void *e1, void *e2)
+static inline uint64_t rotr(uint64_t v, unsigned c)
 {
-	if (timercmp(&((event_t *)e1)->tv, &((event_t *)e2)->tv, <)) return -1;
-	if (timercmp(&((event_t *)e1)->tv, &((event_t *)e2)->tv, >)) return 1;
-	return 0;
+	c &= 63;
+	return (c == 0) ? v : (v >> c) | (v << (64 - c));
+}
+
+static void slot_insert(evsched_t *sched, event_t *ev)
+{
+	unsigned wheel = 0;
+	if (ev->expires > sched->curtime) {
+		uint64_t rem = ev->expires - sched->curtime;
+		wheel = (63 - __builtin_clzll(rem)) / EVSCHED_WHEEL_BITS;
+		if (wheel >= EVSCHED_WHEELS) {
+			wheel = EVSCHED_WHEELS - 1;
+		}
+	}
+
+	/* Expired events go to the current slot, which is processed next time. */
+	uint64_t when = (ev->expires > sched->curtime) ? ev->expires : sched->curtime;
+	unsigned slot = ((when >> (wheel * EVSCHED_WHEEL_BITS)) - (wheel > 0)) & WHEEL_MASK;
+
+	ev->slot = &sched->wheel[wheel][slot];
+	add_tail(ev->slot, &ev->n);
+	sched->pending[wheel] |= (uint64_t)1 << slot;
+}
+
+static void slot_remove(evsched_t *sched, event_t *ev)
+{
+	rem_node(&ev->n);
+	if (EMPTY_LIST(*ev->slot)) {
+		size_t idx = ev->slot - &sched->wheel[0][0];
+		sched->pending[idx / EVSCHED_WHEEL_SLOTS] &=
+			~((uint64_t)1 << (idx % EVSCHED_WHEEL_SLOTS));
+	}
+	ev->slot = NULL;
 }
 
 /*!
- * \brief Get time T (now) + dt milliseconds.
+ * \brief Advance the wheel to 'now', move expired events to 'due'.
  */
-static struct timeval timeval_in(uint32_t dt)
+static void wheel_advance(evsched_t *sched, uint64_t now, list_t *due)
 {
-	struct timeval tv = { 0 };
-	gettimeofday(&tv, NULL);
+	if (now < sched->curtime) {
+		now = sched->curtime;
+	}
+
+	list_t todo;
+	init_list(&todo);
+
+	uint64_t elapsed = now - sched->curtime;
+	for (unsigned wheel = 0; wheel < EVSCHED_WHEELS; wheel++) {
+		unsigned shift = wheel * EVSCHED_WHEEL_BITS;
+
+		/* Bitmap of the slots passed since the last advance. */
+		uint64_t passed;
+		if ((elapsed >> shift) > WHEEL_MASK) {
+			passed = UINT64_MAX;
+		} else {
+			unsigned steps = (elapsed >> shift) & WHEEL_MASK;
+			unsigned oslot = (sched->curtime >> shift) & WHEEL_MASK;
+			unsigned nslot = (now >> shift) & WHEEL_MASK;
+			uint64_t span = ((uint64_t)1 << steps) - 1;
+			passed = rotl(span, oslot) | rotr(rotl(span, nslot), steps) |
+			         ((uint64_t)1 << nslot);
+		}
+
+		uint64_t hit = passed & sched->pending[wheel];
+		while (hit != 0) {
+			list_t *slot = &sched->wheel[wheel][__builtin_ctzll(hit)];
+			event_t *ev, *nxt;
+			WALK_LIST_DELSAFE(ev, nxt, *slot) {
+				rem_node(&ev->n);
+				add_tail(&todo, &ev->n);
+			}
+			hit &= hit - 1;
+		}
+		sched->pending[wheel] &= ~passed;
+
+		/* Upper wheels only move if this one wrapped around. */
+		if (!(passed & 1)) {
+			break;
+		}
+		if (elapsed < ((uint64_t)EVSCHED_WHEEL_SLOTS << shift)) {
+			elapsed = (uint64_t)EVSCHED_WHEEL_SLOTS << shift;
+		}
+	}
 
-	/* Add number of seconds. */
-	tv.tv_sec += dt / 1000;
+	sched->curtime = now;
 
-	/* Add the number of microseconds. */
-	tv.tv_usec += (dt % 1000) * 1000;
+	event_t *ev, *nxt;
+	WALK_LIST_DELSAFE(ev, nxt, todo) {
+		rem_node(&ev->n);
+		if (ev->expires <= now) {
+			ev->slot = NULL;
+			add_tail(due, &ev->n);
+		} else {
+			slot_insert(sched, ev);
+		}
+	}
+}
 
-	/* Check for overflow. */
-	while (tv.tv_usec > 999999) {
-		tv.tv_sec += 1;
-		tv.tv_usec -= 1 * 1000 * 1000;
+/*!
+ * \brief Milliseconds from the wheel time till the first non-empty slot.
+ */
+static uint64_t wheel_timeout(const evsched_t *sched)
+{
+	uint64_t timeout = TIME_NEVER;
+	uint64_t relmask = 0;
+
+	for (unsigned wheel = 0; wheel < EVSCHED_WHEELS; wheel++) {
+		unsigned shift = wheel * EVSCHED_WHEEL_BITS;
+		if (sched->pending[wheel] != 0) {
+			unsigned slot = (sched->curtime >> shift) & WHEEL_MASK;
+			unsigned dist = __builtin_ctzll(rotr(sched->pending[wheel], slot));
+			uint64_t tmp = (uint64_t)(dist + (wheel > 0)) << shift;
+			tmp -= relmask & sched->curtime;
+			if (tmp < timeout) {
+				timeout = tmp;
+			}
+		}
+		relmask = (relmask << EVSCHED_WHEEL_BITS) | WHEEL_MASK;
 	}
 
-	return tv;
+	return timeout;
 }
 
 /*! \brief Event scheduler loop. */
@@ -68,33 +185,45 @@ static int evsched_run(dthread_t *thread)
 	}
 
 	/* Run event loop. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	while (!dt_is_cancelled(thread)) {
-		if (!!EMPTY_HEAP(&sched->heap) || sched->paused) {
-			pthread_cond_wait(&sched->notify, &sched->heap_lock);
+		if (sched->count == 0 || sched->paused) {
+			sched->wakeup = TIME_NEVER;
+			pthread_cond_wait(&sched->notify, &sched->lock);
 			continue;
 		}
 
-		/* Get current time. */
-		struct timeval dt;
-		gettimeofday(&dt, 0);
+		/* Execute expired events in one batch. */
+		list_t due;
+		init_list(&due);
+		wheel_advance(sched, time_ms(), &due);
 
-		/* Get next event. */
-		event_t *ev = *((event_t**)HHEAD(&sched->heap));
-		assert(ev != NULL);
-
-		if (timercmp_ge(&dt, &ev->tv)) {
-			heap_delmin(&sched->heap);
+		event_t *ev = NULL;
+		WALK_LIST_FIRST(ev, due) {
+			rem_node(&ev->n);
+			sched->count--;
 			ev->cb(ev);
-		} else {
-			/* Wait for next event or interrupt. Unlock calendar. */
-			struct timespec ts;
-			ts.tv_sec = ev->tv.tv_sec;
-			ts.tv_nsec = ev->tv.tv_usec * 1000L;
-			pthread_cond_timedwait(&sched->notify, &sched->heap_lock, &ts);
 		}
+
+		if (sched->count == 0) {
+			continue;
+		}
+
+		/* Wait for next event or interrupt. Unlock calendar. */
+		uint64_t timeout = wheel_timeout(sched);
+		sched->wakeup = sched->curtime + timeout;
+
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		uint64_t real_ms = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+		uint64_t left = (sched->wakeup > time_ms()) ? sched->wakeup - time_ms() : 0;
+		struct timespec ts = {
+			.tv_sec = (real_ms + left) / 1000,
+			.tv_nsec = ((real_ms + left) % 1000) * 1000000L
+		};
+		pthread_cond_timedwait(&sched->notify, &sched->lock, &ts);
 	}
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	return KNOT_EOK;
 }
@@ -105,9 +234,15 @@ int evsched_init(evsched_t *sched, void *ctx)
 	sched->ctx = ctx;
 
 	/* Initialize event calendar. */
-	pthread_mutex_init(&sched->heap_lock, 0);
+	pthread_mutex_init(&sched->lock, 0);
 	pthread_cond_init(&sched->notify, 0);
-	heap_init(&sched->heap, compare_event_heap_nodes, 0);
+	for (unsigned wheel = 0; wheel < EVSCHED_WHEELS; wheel++) {
+		for (unsigned slot = 0; slot < EVSCHED_WHEEL_SLOTS; slot++) {
+			init_list(&sched->wheel[wheel][slot]);
+		}
+	}
+	sched->curtime = time_ms();
+	sched->wakeup = TIME_NEVER;
 
 	sched->thread = dt_create(1, evsched_run, NULL, sched);
 
@@ -126,17 +261,18 @@ void evsched_deinit(evsched_t *sched)
 	}
 
 	/* Deinitialize event calendar. */
-	pthread_mutex_destroy(&sched->heap_lock);
+	pthread_mutex_destroy(&sched->lock);
 	pthread_cond_destroy(&sched->notify);
 
-	while (!EMPTY_HEAP(&sched->heap)) {
-		event_t *e = (event_t *)*HHEAD(&sched->heap);
-		heap_delmin(&sched->heap);
-		evsched_event_free(e);
+	for (unsigned wheel = 0; wheel < EVSCHED_WHEELS; wheel++) {
+		for (unsigned slot = 0; slot < EVSCHED_WHEEL_SLOTS; slot++) {
+			event_t *ev, *nxt;
+			WALK_LIST_DELSAFE(ev, nxt, sched->wheel[wheel][slot]) {
+				evsched_event_free(ev);
+			}
+		}
 	}
 
-	heap_deinit(&sched->heap);
-
 	if (sched->thread != NULL) {
 		dt_delete(&sched->thread);
 	}
@@ -163,7 +299,6 @@ event_t *evsched_event_create(evsched_t *sched, event_cb_t cb, void *data)
 	e->sched = sched;
 	e->cb = cb;
 	e->data = data;
-	e->hpos.pos = 0;
 
 	return e;
 }
@@ -183,27 +318,30 @@ int evsched_schedule(event_t *ev, uint32_t dt)
 		return KNOT_EINVAL;
 	}
 
-	struct timeval new_time = timeval_in(dt);
+	uint64_t expires = time_ms() + dt;
 
 	evsched_t *sched = ev->sched;
 
 	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
-
-	ev->tv = new_time;
+	pthread_mutex_lock(&sched->lock);
 
 	/* Make sure it's not already enqueued. */
-	int found = heap_find(&sched->heap, (heap_val_t *)ev);
-	if (found > 0) {
-		/* "Replacing" with itself -- just repositioning it. */
-		heap_replace(&sched->heap, found, (heap_val_t *)ev);
+	if (ev->slot != NULL) {
+		slot_remove(sched, ev);
 	} else {
-		heap_insert(&sched->heap, (heap_val_t *)ev);
+		sched->count++;
+	}
+
+	ev->expires = expires;
+	slot_insert(sched, ev);
+
+	/* Wake up the scheduler only if it would sleep past this event. */
+	if (expires < sched->wakeup) {
+		pthread_cond_signal(&sched->notify);
 	}
 
 	/* Unlock calendar. */
-	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	return KNOT_EOK;
 }
@@ -217,19 +355,18 @@ int evsched_cancel(event_t *ev)
 	evsched_t *sched = ev->sched;
 
 	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 
-	int found = heap_find(&sched->heap, (heap_val_t *)ev);
-	if (found > 0) {
-		heap_delete(&sched->heap, found);
-		pthread_cond_signal(&sched->notify);
+	if (ev->slot != NULL) {
+		slot_remove(sched, ev);
+		sched->count--;
 	}
 
-	/* Unlock calendar. */
-	pthread_mutex_unlock(&sched->heap_lock);
-
 	/* Reset event timer. */
-	memset(&ev->tv, 0, sizeof(struct timeval));
+	ev->expires = 0;
+
+	/* Unlock calendar. */
+	pthread_mutex_unlock(&sched->lock);
 
 	return KNOT_EOK;
 }
@@ -241,10 +378,10 @@ void evsched_start(evsched_t *sched)
 
 void evsched_stop(evsched_t *sched)
 {
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	dt_stop(sched->thread);
 	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 }
 
 void evsched_join(evsched_t *sched)
@@ -254,15 +391,15 @@ void evsched_join(evsched_t *sched)
 
 void evsched_pause(evsched_t *sched)
 {
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	sched->paused = true;
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 }
 
 void evsched_resume(evsched_t *sched)
 {
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	sched->paused = false;
 	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 }
@@ -26,7 +26,12 @@
 #include <sys/time.h>
 
 #include "knot/server/dthreads.h"
-#include "contrib/ucw/heap.h"
+#include "contrib/ucw/lists.h"
+
+/*! \brief Timer wheel geometry: EVSCHED_WHEELS levels of 2^EVSCHED_WHEEL_BITS slots. */
+#define EVSCHED_WHEEL_BITS	6
+#define EVSCHED_WHEEL_SLOTS	(1 << EVSCHED_WHEEL_BITS)
+#define EVSCHED_WHEELS		6
 
 /* Forward decls. */
 struct evsched;
@@ -51,8 +56,9 @@ typedef void (*event_cb_t)(struct event *);
  * \brief Event structure.
  */
 typedef struct event {
-	struct heap_val hpos;
-	struct timeval tv; /*!< Event scheduled time. */
+	node_t n;          /*!< Timer wheel slot membership. */
+	list_t *slot;      /*!< Timer wheel slot or NULL if not scheduled. */
+	uint64_t expires;  /*!< Event scheduled time (CLOCK_MONOTONIC milliseconds). */
 	void *data;        /*!< Usable data ptr. */
 	event_cb_t cb;     /*!< Event callback. */
 	struct evsched *sched; /*!< Scheduler for this event. */
@@ -63,9 +69,13 @@ typedef struct event {
  */
 typedef struct evsched {
 	volatile bool paused;      /*!< Temporarily stop processing events. */
-	pthread_mutex_t heap_lock; /*!< Event heap locking. */
-	pthread_cond_t notify;     /*!< Event heap notification. */
-	struct heap heap;          /*!< Event heap. */
+	pthread_mutex_t lock;      /*!< Timer wheel locking. */
+	pthread_cond_t notify;     /*!< Timer wheel notification. */
+	uint64_t curtime;          /*!< Time the wheel has been advanced to (ms). */
+	uint64_t wakeup;           /*!< Time the scheduler thread is sleeping until (ms). */
+	size_t count;              /*!< Number of scheduled events. */
+	uint64_t pending[EVSCHED_WHEELS];  /*!< Bitmaps of non-empty slots. */
+	list_t wheel[EVSCHED_WHEELS][EVSCHED_WHEEL_SLOTS]; /*!< Hierarchical timer wheel. */
 	void *ctx;                 /*!< Scheduler context. */
 	dt_unit_t *thread;
 } evsched_t;
@@ -24,6 +24,9 @@
 #include "knot/common/stats.h"
 #include "knot/common/log.h"
 #include "knot/nameserver/query_module.h"
+#ifdef ENABLE_QUIC
+#include "knot/server/quic-handler.h"
+#endif // ENABLE_QUIC
 #include "libknot/xdp.h"
 
 static uint64_t stats_get_counter(knot_atomic_uint64_t **stats_vals, uint32_t offset,
@@ -107,6 +110,22 @@ int stats_server(stats_dump_ctr_f fcn, stats_dump_ctx_t *ctx)
 
 	DUMP_VAL(params, "zone-count", knot_zonedb_size(ctx->server->zone_db));
 
+	knot_lmdb_batch_stats_t journal;
+	knot_lmdb_batch_stats(&ctx->server->journaldb, &journal);
+	DUMP_VAL(params, "journal-commits", journal.commits);
+	DUMP_VAL(params, "journal-commit-inserts", journal.operations);
+	DUMP_VAL(params, "journal-commit-max-batch", journal.max_batch);
+	DUMP_VAL(params, "journal-commit-time", journal.commit_time);
+
+#ifdef ENABLE_QUIC
+	quic_stats_t quic;
+	quic_stats_get(&quic);
+	DUMP_VAL(params, "quic-send-calls", quic.send_calls);
+	DUMP_VAL(params, "quic-send-segments", quic.send_segments);
+	DUMP_VAL(params, "quic-recv-calls", quic.recv_calls);
+	DUMP_VAL(params, "quic-recv-segments", quic.recv_segments);
+#endif // ENABLE_QUIC
+
 	return KNOT_EOK;
 }
 
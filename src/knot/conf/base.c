@@ -113,6 +113,56 @@ static int infinite_adjust(
 	return (timeout > 0) ? timeout : -1;
 }
 
+static int free_addr_set(
+	trie_val_t *val,
+	void *ctx)
+{
+	addr_set_free(*val);
+	return KNOT_EOK;
+}
+
+static void free_acl_addr_sets(
+	trie_t *sets)
+{
+	if (sets != NULL) {
+		trie_apply(sets, free_addr_set, NULL);
+		trie_free(sets);
+	}
+}
+
+static trie_t *init_acl_addr_sets(
+	conf_t *conf)
+{
+	trie_t *sets = trie_create(NULL);
+	if (sets == NULL) {
+		return NULL;
+	}
+
+	for (conf_iter_t iter = conf_iter(conf, C_ACL); iter.code == KNOT_EOK;
+	     conf_iter_next(conf, &iter)) {
+		conf_val_t id = conf_iter_id(conf, &iter);
+		conf_val_t addr = conf_id_get(conf, C_ACL, C_ADDR, &id);
+		if (addr.code != KNOT_EOK) {
+			continue; // Any address allowed.
+		}
+
+		addr_set_t *set = conf_addr_set(&addr);
+		trie_val_t *val = NULL;
+		if (set != NULL) {
+			val = trie_get_ins(sets, id.data, id.len);
+		}
+		if (val == NULL) {
+			addr_set_free(set);
+			conf_iter_finish(conf, &iter);
+			free_acl_addr_sets(sets);
+			return NULL;
+		}
+		*val = set;
+	}
+
+	return sets;
+}
+
 static void init_cache(
 	conf_t *conf,
 	bool reinit_cache)
@@ -126,6 +176,7 @@ static void init_cache(
 	static bool   first_init = true;
 	static bool   running_tcp_reuseport;
 	static bool   running_socket_affinity;
+	static bool   running_udp_io_uring;
 	static bool   running_xdp_udp;
 	static bool   running_xdp_tcp;
 	static uint16_t running_xdp_quic;
@@ -144,6 +195,7 @@ static void init_cache(
 	if (first_init || reinit_cache) {
 		running_tcp_reuseport = conf_get_bool(conf, C_SRV, C_TCP_REUSEPORT);
 		running_socket_affinity = conf_get_bool(conf, C_SRV, C_SOCKET_AFFINITY);
+		running_udp_io_uring = conf_get_bool(conf, C_SRV, C_UDP_IO_URING);
 		running_xdp_udp = conf_get_bool(conf, C_XDP, C_UDP);
 		running_xdp_tcp = conf_get_bool(conf, C_XDP, C_TCP);
 		running_xdp_quic = 0;
@@ -199,6 +251,8 @@ static void init_cache(
 
 	conf->cache.srv_socket_affinity = running_socket_affinity;
 
+	conf->cache.srv_udp_io_uring = running_udp_io_uring;
+
 	val = conf_get(conf, C_SRV, C_DBUS_EVENT);
 	while (val.code == KNOT_EOK) {
 		conf->cache.srv_dbus_event |= conf_opt(&val);
@@ -275,6 +329,11 @@ static void init_cache(
 
 	val = conf_get(conf, C_SRV, C_PROXY_ALLOWLIST);
 	conf->cache.srv_proxy_enabled = (conf_val_count(&val) > 0);
+	addr_set_free(conf->cache.srv_proxy_allowlist);
+	conf->cache.srv_proxy_allowlist = conf_addr_set(&val);
+
+	free_acl_addr_sets(conf->cache.acl_addr_sets);
+	conf->cache.acl_addr_sets = init_acl_addr_sets(conf);
 
 	val = conf_get(conf, C_SRV, C_IDENT);
 	if (val.code == KNOT_EOK) {
@@ -550,6 +609,8 @@ void conf_free(
 	if (conf->io.zones != NULL) {
 		trie_free(conf->io.zones);
 	}
+	addr_set_free(conf->cache.srv_proxy_allowlist);
+	free_acl_addr_sets(conf->cache.acl_addr_sets);
 
 	conf_mod_load_purge(conf, false);
 	conf_deactivate_modules(conf->query_modules, &conf->query_plan);
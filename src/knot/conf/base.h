@@ -18,6 +18,7 @@
 
 #include "libknot/libknot.h"
 #include "libknot/yparser/ypschema.h"
+#include "contrib/addr_set.h"
 #include "contrib/qp-trie/trie.h"
 #include "contrib/ucw/lists.h"
 #include "libknot/dynarray.h"
@@ -163,6 +164,8 @@ typedef struct {
 		size_t srv_nsid_len;
 		const char *srv_ident;
 		const char *srv_version;
+		addr_set_t *srv_proxy_allowlist;
+		trie_t *acl_addr_sets;
 		uint32_t srv_quic_idle_close;
 		uint16_t xdp_quic;
 		uint16_t xdp_ring_size;
@@ -175,6 +178,7 @@ typedef struct {
 		bool srv_tcp_reuseport;
 		bool srv_tcp_fastopen;
 		bool srv_socket_affinity;
+		bool srv_udp_io_uring;
 		bool srv_ecs;
 		bool srv_ans_rotate;
 		bool srv_auto_acl;
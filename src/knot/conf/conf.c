@@ -16,6 +16,7 @@
 
 #include <assert.h>
 #include <grp.h>
+#include <limits.h>
 #include <pwd.h>
 #include <stdio.h>
 #include <sys/resource.h>
@@ -868,6 +869,48 @@ bool conf_addr_range_match(
 	return false;
 }
 
+addr_set_t *conf_addr_set(
+	conf_val_t *val)
+{
+	assert(val != NULL && val->item != NULL);
+
+	addr_set_t *set = addr_set_new();
+	if (set == NULL) {
+		return NULL;
+	}
+
+	bool ranges = (val->item->type == YP_TNET ||
+	               (val->item->type == YP_TREF &&
+	                val->item->var.r.ref->var.g.id->type == YP_TNET));
+
+	while (val->code == KNOT_EOK) {
+		int ret;
+		if (ranges) {
+			int mask;
+			struct sockaddr_storage min, max;
+
+			min = conf_addr_range(val, &max, &mask);
+			if (max.ss_family == AF_UNSPEC) {
+				ret = addr_set_add_net(set, &min, mask);
+			} else {
+				ret = addr_set_add_range(set, &min, &max);
+			}
+		} else {
+			struct sockaddr_storage addr = conf_addr(val, NULL);
+			ret = addr_set_add_net(set, &addr, UINT_MAX);
+		}
+		// Items which cannot match any address are skipped.
+		if (ret != KNOT_EOK && ret != KNOT_EINVAL) {
+			addr_set_free(set);
+			return NULL;
+		}
+
+		conf_val_next(val);
+	}
+
+	return set;
+}
+
 char* conf_abs_path(
 	conf_val_t *val,
 	const char *base_dir)
@@ -1440,6 +1483,9 @@ conf_remote_t conf_remote_txn(
 	val = conf_id_get_txn(conf, txn, C_RMT, C_NO_EDNS, id);
 	out.no_edns = conf_bool(&val);
 
+	val = conf_id_get_txn(conf, txn, C_RMT, C_SOA_BATCH, id);
+	out.soa_batch = conf_int(&val);
+
 	return out;
 }
 
@@ -52,6 +52,8 @@ typedef struct {
 	bool block_notify_after_xfr;
 	/*! Disable EDNS on XFR queries. */
 	bool no_edns;
+	/*! Maximum number of other zones checked in one SOA batch. */
+	unsigned soa_batch;
 	/*! Possible remote certificate PIN. */
 	const uint8_t *pin;
 	/*! Length of the remote certificate PIN. Zero if PIN not specified. */
@@ -618,6 +620,19 @@ bool conf_addr_range_match(
 	const struct sockaddr_storage *addr
 );
 
+/*!
+ * Compiles the addresses or address ranges/network blocks into a prefix trie.
+ *
+ * \note The result must be explicitly deallocated.
+ *
+ * \param[in] val  Addresses or address ranges/network blocks.
+ *
+ * \return Address set or NULL if no memory.
+ */
+addr_set_t *conf_addr_set(
+	conf_val_t *val
+);
+
 /*!
  * Gets the absolute string value of the item.
  *
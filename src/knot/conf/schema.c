@@ -155,6 +155,14 @@ static const knot_lookup_t journal_content[] = {
 	{ 0, NULL }
 };
 
+static const knot_lookup_t journal_compression[] = {
+	{ JOURNAL_COMPRESSION_NONE, "none" },
+#ifdef ENABLE_ZSTD
+	{ JOURNAL_COMPRESSION_ZSTD, "zstd" },
+#endif
+	{ 0, NULL }
+};
+
 static const knot_lookup_t zonefile_load[] = {
 	{ ZONEFILE_LOAD_NONE,  "none" },
 	{ ZONEFILE_LOAD_DIFF,  "difference" },
@@ -228,6 +236,7 @@ static const yp_item_t desc_server[] = {
 	{ C_RMT_POOL_TIMEOUT,     YP_TINT,  YP_VINT = { 1, INT32_MAX, 5, YP_STIME } },
 	{ C_RMT_RETRY_DELAY,      YP_TINT,  YP_VINT = { 0, INT32_MAX, 0 } },
 	{ C_SOCKET_AFFINITY,      YP_TBOOL, YP_VNONE },
+	{ C_UDP_IO_URING,         YP_TBOOL, YP_VNONE },
 	{ C_UDP_MAX_PAYLOAD,      YP_TINT,  YP_VINT = { KNOT_EDNS_MIN_DNSSEC_PAYLOAD,
 	                                                KNOT_EDNS_MAX_UDP_PAYLOAD,
 	                                                1232, YP_SSIZE } },
@@ -305,6 +314,7 @@ static const yp_item_t desc_database[] = {
 	{ C_JOURNAL_DB_MODE,     YP_TOPT,  YP_VOPT = { journal_modes, JOURNAL_MODE_ROBUST } },
 	{ C_JOURNAL_DB_MAX_SIZE, YP_TINT,  YP_VINT = { MEGA(1), VIRT_MEM_LIMIT(TERA(100)),
 	                                               VIRT_MEM_LIMIT(GIGA(20)), YP_SSIZE } },
+	{ C_JOURNAL_DB_COMMIT_DELAY, YP_TINT, YP_VINT = { 0, 1000, 0 } },
 	{ C_KASP_DB,             YP_TSTR,  YP_VSTR = { "keys" } },
 	{ C_KASP_DB_MAX_SIZE,    YP_TINT,  YP_VINT = { MEGA(5), VIRT_MEM_LIMIT(GIGA(100)),
 	                                               MEGA(500), YP_SSIZE } },
@@ -346,6 +356,7 @@ static const yp_item_t desc_remote[] = {
 	{ C_CERT_KEY,         YP_TB64,  YP_VNONE, YP_FMULTI, { check_cert_pin } },
 	{ C_BLOCK_NOTIFY_XFR, YP_TBOOL, YP_VNONE },
 	{ C_NO_EDNS,          YP_TBOOL, YP_VNONE },
+	{ C_SOA_BATCH,        YP_TINT,  YP_VINT = { 0, 10000, 0 } },
 	{ C_AUTO_ACL,         YP_TBOOL, YP_VBOOL = { true } },
 	{ C_COMMENT,          YP_TSTR,  YP_VNONE },
 	{ NULL }
@@ -470,11 +481,13 @@ static const yp_item_t desc_policy[] = {
 	{ C_JOURNAL_CONTENT,     YP_TOPT,  YP_VOPT = { journal_content, JOURNAL_CONTENT_CHANGES }, FLAGS }, \
 	{ C_JOURNAL_MAX_USAGE,   YP_TINT,  YP_VINT = { KILO(40), SSIZE_MAX, MEGA(100), YP_SSIZE } }, \
 	{ C_JOURNAL_MAX_DEPTH,   YP_TINT,  YP_VINT = { 2, SSIZE_MAX, 20 } }, \
+	{ C_JOURNAL_COMPRESSION, YP_TOPT,  YP_VOPT = { journal_compression, JOURNAL_COMPRESSION_NONE } }, \
 	{ C_IXFR_BENEVOLENT,     YP_TBOOL, YP_VNONE }, \
 	{ C_IXFR_BY_ONE,         YP_TBOOL, YP_VNONE }, \
 	{ C_IXFR_FROM_AXFR,      YP_TBOOL, YP_VNONE }, \
 	{ C_ZONE_MAX_SIZE,       YP_TINT,  YP_VINT = { 0, SSIZE_MAX, SSIZE_MAX, YP_SSIZE }, FLAGS }, \
 	{ C_ADJUST_THR,          YP_TINT,  YP_VINT = { 1, UINT16_MAX, 1 } }, \
+	{ C_ANS_CACHE,           YP_TINT,  YP_VINT = { 0, UINT32_MAX, 0 }, FLAGS }, \
 	{ C_DNSSEC_SIGNING,      YP_TBOOL, YP_VNONE, FLAGS }, \
 	{ C_DNSSEC_VALIDATION,   YP_TBOOL, YP_VNONE, FLAGS }, \
 	{ C_DNSSEC_POLICY,       YP_TREF,  YP_VREF = { C_POLICY }, FLAGS, { check_ref_dflt } }, \
@@ -24,6 +24,7 @@
 #define C_ADDR			"\x07""address"
 #define C_ADJUST_THR		"\x0E""adjust-threads"
 #define C_ALG			"\x09""algorithm"
+#define C_ANS_CACHE		"\x0C""answer-cache"
 #define C_ANS_ROTATION		"\x0F""answer-rotation"
 #define C_ANY			"\x03""any"
 #define C_APPEND		"\x06""append"
@@ -75,8 +76,10 @@
 #define C_IXFR_BENEVOLENT	"\x0F""ixfr-benevolent"
 #define C_IXFR_BY_ONE		"\x0B""ixfr-by-one"
 #define C_IXFR_FROM_AXFR	"\x0E""ixfr-from-axfr"
+#define C_JOURNAL_COMPRESSION	"\x13""journal-compression"
 #define C_JOURNAL_CONTENT	"\x0F""journal-content"
 #define C_JOURNAL_DB		"\x0A""journal-db"
+#define C_JOURNAL_DB_COMMIT_DELAY "\x17""journal-db-commit-delay"
 #define C_JOURNAL_DB_MAX_SIZE	"\x13""journal-db-max-size"
 #define C_JOURNAL_DB_MODE	"\x0F""journal-db-mode"
 #define C_JOURNAL_MAX_DEPTH	"\x11""journal-max-depth"
@@ -147,6 +150,7 @@
 #define C_SERVER		"\x06""server"
 #define C_SIGNING_THREADS	"\x0F""signing-threads"
 #define C_SINGLE_TYPE_SIGNING	"\x13""single-type-signing"
+#define C_SOA_BATCH		"\x09""soa-batch"
 #define C_SOCKET_AFFINITY	"\x0F""socket-affinity"
 #define C_SRV			"\x06""server"
 #define C_STATS			"\x0A""statistics"
@@ -172,6 +176,7 @@
 #define C_TLS			"\x03""tls"
 #define C_TPL			"\x08""template"
 #define C_UDP			"\x03""udp"
+#define C_UDP_IO_URING		"\x0C""udp-io-uring"
 #define C_UDP_MAX_PAYLOAD	"\x0F""udp-max-payload"
 #define C_UDP_MAX_PAYLOAD_IPV4	"\x14""udp-max-payload-ipv4"
 #define C_UDP_MAX_PAYLOAD_IPV6	"\x14""udp-max-payload-ipv6"
@@ -247,6 +252,11 @@ enum {
 	JOURNAL_CONTENT_ALL     = 2,
 };
 
+enum {
+	JOURNAL_COMPRESSION_NONE = 0,
+	JOURNAL_COMPRESSION_ZSTD = 1,
+};
+
 enum {
 	JOURNAL_MODE_ROBUST = 0, // Robust journal DB disk synchronization.
 	JOURNAL_MODE_ASYNC  = 1, // Asynchronous journal DB disk synchronization.
@@ -14,6 +14,7 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
@@ -1895,6 +1896,20 @@ static int server_status(ctl_args_t *args)
 		               conf()->cache.srv_udp_threads, conf()->cache.srv_tcp_threads,
 		               conf()->cache.srv_xdp_threads, conf()->cache.srv_bg_threads,
 		               running_bkg_wrk, wrk_queue);
+	} else if (strcasecmp(type, "queue") == 0) {
+		worker_pool_stats_t st;
+		worker_pool_stats(args->server->workers, &st);
+		ret = snprintf(buff, sizeof(buff), "pending: urgent %zu, high %zu, "
+		               "normal %zu, low %zu, idle %zu (max %zu), "
+		               "waited: <1ms %"PRIu64", <10ms %"PRIu64", <100ms %"PRIu64", "
+		               "<1s %"PRIu64", <10s %"PRIu64", <100s %"PRIu64", "
+		               "more %"PRIu64,
+		               st.queued[WORKER_PRIO_URGENT], st.queued[WORKER_PRIO_HIGH],
+		               st.queued[WORKER_PRIO_NORMAL], st.queued[WORKER_PRIO_LOW],
+		               st.queued[WORKER_PRIO_IDLE], st.queued_max,
+		               st.wait_hist[0], st.wait_hist[1], st.wait_hist[2],
+		               st.wait_hist[3], st.wait_hist[4], st.wait_hist[5],
+		               st.wait_hist[6]);
 	} else if (strcasecmp(type, "configure") == 0) {
 		ret = snprintf(buff, sizeof(buff), "%s", configure_summary);
 	} else if (strcasecmp(type, "cert-key") == 0) {
@@ -15,6 +15,7 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 
 #include "libknot/dname.h"
 #include "knot/dnssec/nsec-chain.h"
@@ -24,8 +25,12 @@
 #include "knot/zone/adjust.h"
 #include "knot/zone/zone-diff.h"
 #include "contrib/base32hex.h"
+#include "contrib/macros.h"
 #include "contrib/wire_ctx.h"
 
+/*! \brief Minimal number of nodes per thread for NSEC3 nodes creation. */
+#define NSEC3_NODES_PER_THREAD	1024
+
 static bool nsec3_empty(const zone_node_t *node, const dnssec_nsec3_params_t *params)
 {
 	bool opt_out = (params->flags & KNOT_NSEC3_FLAG_OPT_OUT);
@@ -398,6 +403,83 @@ static int reconnect_nsec3_nodes2(zone_node_t *a, zone_node_t *b,
 	return ret;
 }
 
+typedef struct {
+	pthread_t thread;
+	zone_node_t **nodes;    //!< Nodes to create NSEC3 nodes for.
+	zone_node_t **nsec3;    //!< Output: created NSEC3 nodes.
+	size_t count;
+	zone_node_t *apex;
+	const dnssec_nsec3_params_t *params;
+	uint32_t ttl;
+	int ret;
+} nsec3_nodes_ctx_t;
+
+static void *create_nsec3_nodes_thread(void *arg)
+{
+	nsec3_nodes_ctx_t *ctx = arg;
+
+	for (size_t i = 0; i < ctx->count; i++) {
+		ctx->nsec3[i] = create_nsec3_node_for_node(ctx->nodes[i], ctx->apex,
+		                                           ctx->params, ctx->ttl);
+		if (ctx->nsec3[i] == NULL) {
+			ctx->ret = KNOT_ENOMEM;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/*!
+ * \brief Create NSEC3 nodes for the given nodes, hashing in parallel.
+ *
+ * The nodes are split into contiguous parts processed by the threads. Failed
+ * or not processed items of the output are NULL.
+ */
+static int create_nsec3_nodes_parallel(zone_node_t **nodes, zone_node_t **nsec3,
+                                       size_t count, zone_node_t *apex,
+                                       const dnssec_nsec3_params_t *params,
+                                       uint32_t ttl, size_t threads)
+{
+	threads = MIN(threads, count / NSEC3_NODES_PER_THREAD);
+	threads = MAX(threads, 1);
+
+	nsec3_nodes_ctx_t ctx[threads];
+	bool started[threads];
+	size_t begin = 0;
+	for (size_t i = 0; i < threads; i++) {
+		size_t end = count * (i + 1) / threads;
+		ctx[i] = (nsec3_nodes_ctx_t) {
+			.nodes = nodes + begin,
+			.nsec3 = nsec3 + begin,
+			.count = end - begin,
+			.apex = apex,
+			.params = params,
+			.ttl = ttl,
+			.ret = KNOT_EOK,
+		};
+		begin = end;
+
+		// The first part is processed by this thread.
+		started[i] = (i > 0 && pthread_create(&ctx[i].thread, NULL,
+		                                      create_nsec3_nodes_thread, &ctx[i]) == 0);
+	}
+
+	int ret = KNOT_EOK;
+	for (size_t i = 0; i < threads; i++) {
+		if (started[i]) {
+			pthread_join(ctx[i].thread, NULL);
+		} else {
+			create_nsec3_nodes_thread(&ctx[i]);
+		}
+		if (ret == KNOT_EOK) {
+			ret = ctx[i].ret;
+		}
+	}
+
+	return ret;
+}
+
 /*!
  * \brief Create NSEC3 node for each regular node in the zone.
  *
@@ -407,6 +489,7 @@ static int reconnect_nsec3_nodes2(zone_node_t *a, zone_node_t *b,
  * \param cds_in_apex  Hint to guess apex node type bitmap: false=just DNSKEY, true=DNSKEY,CDS,CDNSKEY.
  * \param nsec3_nodes  Tree whereto new NSEC3 nodes will be added.
  * \param update       Zone update for possible NSEC removals
+ * \param threads      Number of threads for NSEC3 hashing.
  *
  * \return Error code, KNOT_EOK if successful.
  */
@@ -414,7 +497,8 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
                               const dnssec_nsec3_params_t *params,
                               uint32_t ttl,
                               zone_tree_t *nsec3_nodes,
-                              zone_update_t *update)
+                              zone_update_t *update,
+                              size_t threads)
 {
 	assert(zone);
 	assert(nsec3_nodes);
@@ -422,6 +506,18 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
 
 	zone_tree_delsafe_it_t it = { 0 };
 	int result = zone_tree_delsafe_it_begin(zone->nodes, &it, false); // delsafe - removing nodes that contain only NSEC+RRSIG
+	if (result != KNOT_EOK) {
+		return result;
+	}
+
+	// Deleted nodes stay allocated until the iterator is freed.
+	zone_node_t **nodes = malloc(2 * MAX(it.total, 1) * sizeof(*nodes));
+	if (nodes == NULL) {
+		zone_tree_delsafe_it_free(&it);
+		return KNOT_ENOMEM;
+	}
+	zone_node_t **nsec3 = nodes + it.total;
+	size_t count = 0;
 
 	while (!zone_tree_delsafe_it_finished(&it)) {
 		zone_node_t *node = zone_tree_delsafe_it_val(&it);
@@ -434,27 +530,33 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
 		if (result != KNOT_EOK) {
 			break;
 		}
-		if (node->flags & NODE_FLAGS_NONAUTH || nsec3_empty(node, params) || node->flags & NODE_FLAGS_DELETED) {
-			zone_tree_delsafe_it_next(&it);
-			continue;
+		if (!(node->flags & NODE_FLAGS_NONAUTH || nsec3_empty(node, params) || node->flags & NODE_FLAGS_DELETED)) {
+			nodes[count++] = node;
 		}
 
-		zone_node_t *nsec3_node;
-		nsec3_node = create_nsec3_node_for_node(node, zone->apex,
-							params, ttl);
-		if (!nsec3_node) {
-			result = KNOT_ENOMEM;
-			break;
-		}
+		zone_tree_delsafe_it_next(&it);
+	}
 
-		result = zone_tree_insert(nsec3_nodes, &nsec3_node);
+	if (result == KNOT_EOK) {
+		memset(nsec3, 0, count * sizeof(*nsec3));
+		result = create_nsec3_nodes_parallel(nodes, nsec3, count, zone->apex,
+		                                     params, ttl, threads);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (nsec3[i] == NULL) {
+			continue;
+		}
+		if (result == KNOT_EOK) {
+			result = zone_tree_insert(nsec3_nodes, &nsec3[i]);
+		}
 		if (result != KNOT_EOK) {
-			break;
+			node_free_rrsets(nsec3[i], NULL);
+			node_free(nsec3[i], NULL);
 		}
-
-		zone_tree_delsafe_it_next(&it);
 	}
 
+	free(nodes);
 	zone_tree_delsafe_it_free(&it);
 
 	return result;
@@ -625,7 +727,8 @@ int delete_nsec3_chain(zone_update_t *up)
 int knot_nsec3_create_chain(const zone_contents_t *zone,
                             const dnssec_nsec3_params_t *params,
                             uint32_t ttl,
-                            zone_update_t *update)
+                            zone_update_t *update,
+                            size_t threads)
 {
 	assert(zone);
 	assert(params);
@@ -635,7 +738,7 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
 		return KNOT_ENOMEM;
 	}
 
-	int result = create_nsec3_nodes(zone, params, ttl, nsec3_nodes, update);
+	int result = create_nsec3_nodes(zone, params, ttl, nsec3_nodes, update, threads);
 	if (result != KNOT_EOK) {
 		free_nsec3_tree(nsec3_nodes);
 		return result;
@@ -657,7 +760,8 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
 
 int knot_nsec3_fix_chain(zone_update_t *update,
                          const dnssec_nsec3_params_t *params,
-                         uint32_t ttl)
+                         uint32_t ttl,
+                         size_t threads)
 {
 	assert(update);
 	assert(params);
@@ -668,7 +772,7 @@ int knot_nsec3_fix_chain(zone_update_t *update,
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
-		return knot_nsec3_create_chain(update->new_cont, params, ttl, update);
+		return knot_nsec3_create_chain(update->new_cont, params, ttl, update, threads);
 	}
 
 	int ret = fix_nsec3_nodes(update, params, ttl);
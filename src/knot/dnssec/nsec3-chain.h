@@ -34,13 +34,15 @@ int delete_nsec3_chain(zone_update_t *up);
  * \param params     NSEC3 parameters.
  * \param ttl        TTL for new records.
  * \param update     Zone update to stare immediate changes into.
+ * \param threads    Number of threads for hashing the owner names.
  *
  * \return KNOT_E*
  */
 int knot_nsec3_create_chain(const zone_contents_t *zone,
                             const dnssec_nsec3_params_t *params,
                             uint32_t ttl,
-                            zone_update_t *update);
+                            zone_update_t *update,
+                            size_t threads);
 
 /*!
  * \brief Updates zone's NSEC3 chain to follow the differences in zone update.
@@ -48,13 +50,15 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
  * \param update     Zone Update structure holding the zone and its update. Also modified!
  * \param params     NSEC3 parameters.
  * \param ttl        TTL for new records.
+ * \param threads    Number of threads if the whole chain is re-created.
  *
  * \retval KNOT_ENORECORD if the chain must be recreated from scratch.
  * \return KNOT_E*
  */
 int knot_nsec3_fix_chain(zone_update_t *update,
                          const dnssec_nsec3_params_t *params,
-                         uint32_t ttl);
+                         uint32_t ttl,
+                         size_t threads);
 
 /*!
  * \brief Validate NSEC3 chain in new_cont as whole.
@@ -533,50 +533,80 @@ static int sign_node_rrsets(const zone_node_t *node,
 	return result;
 }
 
+#define SIGN_CHUNK_NODES 32 /*!< Number of nodes claimed by a signing thread at once. */
+
 /*!
- * \brief Struct to carry data for 'sign_data' callback function.
+ * \brief Zone tree traversal shared by the signing threads.
+ *
+ * Threads claim chunks of consecutive nodes, so the tree is traversed only
+ * once and the threads which sign cheaper nodes simply claim more chunks.
  */
 typedef struct {
-	zone_tree_t *tree;
+	zone_tree_it_t it;
+	pthread_mutex_t lock;
+	bool failed;
+} tree_sign_queue_t;
+
+/*!
+ * \brief Struct to carry data for signing threads.
+ */
+typedef struct {
+	tree_sign_queue_t *queue;
 	zone_sign_ctx_t *sign_ctx;
 	changeset_t changeset;
 	dnssec_validation_hint_t *hint;
-	size_t num_threads;
-	size_t thread_index;
-	size_t rrset_index;
 	int errcode;
 	int thread_init_errcode;
 	pthread_t thread;
 } node_sign_args_t;
 
 /*!
- * \brief Sign node (callback function).
+ * \brief Claim next chunk of nodes to be signed.
+ *
+ * \param queue  Shared tree traversal.
+ * \param chunk  Output array for SIGN_CHUNK_NODES nodes.
  *
- * \param node  Node to be signed.
- * \param data  Callback data, node_sign_args_t.
+ * \return Number of claimed nodes, zero if finished.
  */
-static int sign_node(zone_node_t *node, void *data)
+static size_t tree_sign_claim(tree_sign_queue_t *queue, zone_node_t **chunk)
 {
-	assert(node);
-	assert(data);
-
-	node_sign_args_t *args = (node_sign_args_t *)data;
-
-	if (node->rrset_count == 0) {
-		return KNOT_EOK;
-	}
-
-	if (args->rrset_index++ % args->num_threads != args->thread_index) {
-		return KNOT_EOK;
+	size_t count = 0;
+
+	pthread_mutex_lock(&queue->lock);
+	while (count < SIGN_CHUNK_NODES && !queue->failed &&
+	       !zone_tree_it_finished(&queue->it)) {
+		zone_node_t *node = zone_tree_it_val(&queue->it);
+		if (node->rrset_count > 0) {
+			chunk[count++] = node;
+		}
+		zone_tree_it_next(&queue->it);
 	}
+	pthread_mutex_unlock(&queue->lock);
 
-	return sign_node_rrsets(node, args->sign_ctx, &args->changeset, args->hint);
+	return count;
 }
 
 static void *tree_sign_thread(void *_arg)
 {
 	node_sign_args_t *arg = _arg;
-	arg->errcode = zone_tree_apply(arg->tree, sign_node, _arg);
+	zone_node_t *chunk[SIGN_CHUNK_NODES];
+
+	size_t count;
+	while (arg->errcode == KNOT_EOK &&
+	       (count = tree_sign_claim(arg->queue, chunk)) > 0) {
+		for (size_t i = 0; i < count && arg->errcode == KNOT_EOK; i++) {
+			arg->errcode = sign_node_rrsets(chunk[i], arg->sign_ctx,
+			                                &arg->changeset, arg->hint);
+		}
+	}
+
+	// Stop the other threads early.
+	if (arg->errcode != KNOT_EOK) {
+		pthread_mutex_lock(&arg->queue->lock);
+		arg->queue->failed = true;
+		pthread_mutex_unlock(&arg->queue->lock);
+	}
+
 	return NULL;
 }
 
@@ -607,13 +637,23 @@ static int zone_tree_sign(zone_tree_t *tree,
 	assert(dnssec_ctx);
 	assert(update || dnssec_ctx->validation_mode);
 
-	int ret = KNOT_EOK;
+	if (zone_tree_is_empty(tree)) {
+		return KNOT_EOK;
+	}
+
+	tree_sign_queue_t queue = { 0 };
+	int ret = zone_tree_it_begin(tree, &queue.it);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	pthread_mutex_init(&queue.lock, NULL);
+
 	node_sign_args_t args[num_threads];
 	memset(args, 0, sizeof(args));
 
 	// init context structures
 	for (size_t i = 0; i < num_threads; i++) {
-		args[i].tree = tree;
+		args[i].queue = &queue;
 		args[i].sign_ctx = dnssec_ctx->validation_mode
 		                 ? zone_validation_ctx(dnssec_ctx)
 		                 : zone_sign_ctx(zone_keys, dnssec_ctx);
@@ -626,9 +666,6 @@ static int zone_tree_sign(zone_tree_t *tree,
 			break;
 		}
 		args[i].hint = &update->validation_hint;
-		args[i].num_threads = num_threads;
-		args[i].thread_index = i;
-		args[i].rrset_index = 0;
 		args[i].errcode = KNOT_EOK;
 		args[i].thread_init_errcode = -1;
 	}
@@ -637,6 +674,8 @@ static int zone_tree_sign(zone_tree_t *tree,
 			changeset_clear(&args[i].changeset);
 			zone_sign_ctx_free(args[i].sign_ctx);
 		}
+		zone_tree_it_free(&queue.it);
+		pthread_mutex_destroy(&queue.lock);
 		return ret;
 	}
 
@@ -674,6 +713,8 @@ static int zone_tree_sign(zone_tree_t *tree,
 		changeset_clear(&args[i].changeset);
 		zone_sign_ctx_free(args[i].sign_ctx);
 	}
+	zone_tree_it_free(&queue.it);
+	pthread_mutex_destroy(&queue.lock);
 
 	return ret;
 }
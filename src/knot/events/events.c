@@ -35,23 +35,24 @@ typedef struct event_info {
 	zone_event_type_t type;
 	const zone_event_cb callback;
 	const char *name;
+	worker_prio_t prio;
 } event_info_t;
 
 static const event_info_t EVENT_INFO[] = {
-	{ ZONE_EVENT_LOAD,         event_load,        "load" },
-	{ ZONE_EVENT_REFRESH,      event_refresh,     "refresh" },
-	{ ZONE_EVENT_UPDATE,       event_update,      "update" },
-	{ ZONE_EVENT_EXPIRE,       event_expire,      "expiration" },
-	{ ZONE_EVENT_FLUSH,        event_flush,       "flush" },
-	{ ZONE_EVENT_BACKUP,       event_backup,      "backup/restore" },
-	{ ZONE_EVENT_NOTIFY,       event_notify,      "notify" },
-	{ ZONE_EVENT_DNSSEC,       event_dnssec,      "re-sign" },
-	{ ZONE_EVENT_VALIDATE,     event_validate,    "DNSSEC-validate" },
-	{ ZONE_EVENT_UFREEZE,      event_ufreeze,     "update-freeze" },
-	{ ZONE_EVENT_UTHAW,        event_uthaw,       "update-thaw" },
-	{ ZONE_EVENT_DS_CHECK,     event_ds_check,    "DS-check" },
-	{ ZONE_EVENT_DS_PUSH,      event_ds_push,     "DS-push" },
-	{ ZONE_EVENT_DNSKEY_SYNC,  event_dnskey_sync, "DNSKEY-sync" },
+	{ ZONE_EVENT_LOAD,         event_load,        "load",            WORKER_PRIO_HIGH },
+	{ ZONE_EVENT_REFRESH,      event_refresh,     "refresh",         WORKER_PRIO_HIGH },
+	{ ZONE_EVENT_UPDATE,       event_update,      "update",          WORKER_PRIO_HIGH },
+	{ ZONE_EVENT_EXPIRE,       event_expire,      "expiration",      WORKER_PRIO_URGENT },
+	{ ZONE_EVENT_FLUSH,        event_flush,       "flush",           WORKER_PRIO_NORMAL },
+	{ ZONE_EVENT_BACKUP,       event_backup,      "backup/restore",  WORKER_PRIO_IDLE },
+	{ ZONE_EVENT_NOTIFY,       event_notify,      "notify",          WORKER_PRIO_HIGH },
+	{ ZONE_EVENT_DNSSEC,       event_dnssec,      "re-sign",         WORKER_PRIO_LOW },
+	{ ZONE_EVENT_VALIDATE,     event_validate,    "DNSSEC-validate", WORKER_PRIO_LOW },
+	{ ZONE_EVENT_UFREEZE,      event_ufreeze,     "update-freeze",   WORKER_PRIO_NORMAL },
+	{ ZONE_EVENT_UTHAW,        event_uthaw,       "update-thaw",     WORKER_PRIO_NORMAL },
+	{ ZONE_EVENT_DS_CHECK,     event_ds_check,    "DS-check",        WORKER_PRIO_LOW },
+	{ ZONE_EVENT_DS_PUSH,      event_ds_push,     "DS-push",         WORKER_PRIO_LOW },
+	{ ZONE_EVENT_DNSKEY_SYNC,  event_dnskey_sync, "DNSKEY-sync",     WORKER_PRIO_LOW },
 	{ 0 }
 };
 
@@ -272,7 +273,10 @@ static void event_dispatch(event_t *event)
 
 	pthread_mutex_lock(&events->mx);
 	if (!events->running && !events->frozen) {
+		zone_event_type_t type = get_next_event(events);
 		events->running = true;
+		events->task.prio = valid_event(type) ? get_event_info(type)->prio :
+		                                        WORKER_PRIO_NORMAL;
 		worker_pool_assign(events->pool, &events->task);
 	}
 	pthread_mutex_unlock(&events->mx);
@@ -440,6 +444,7 @@ void zone_events_enqueue(zone_t *zone, zone_event_type_t type)
 		events->running = true;
 		events->type = type;
 		event_set_time(events, type, ZONE_EVENT_IMMEDIATE);
+		events->task.prio = get_event_info(type)->prio;
 		worker_pool_assign(events->pool, &events->task);
 		pthread_mutex_unlock(&events->mx);
 		return;
@@ -1,4 +1,4 @@
-/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
 
     This program is free software: you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -101,6 +101,9 @@ int event_load(conf_t *conf, zone_t *zone)
 	unsigned digest_alg = conf_opt(&val);
 	bool update_zonemd = (digest_alg != ZONE_DIGEST_NONE);
 
+	val = conf_zone_get(conf, C_ADJUST_THR, zone->name);
+	unsigned digest_threads = conf_int(&val);
+
 	// If configured, attempt to load zonefile.
 	if (zf_from != ZONEFILE_LOAD_NONE && zone->cat_members == NULL) {
 		struct timespec mtime;
@@ -333,7 +336,7 @@ load_end:
 		/* Don't update ZONEMD if no change and ZONEMD is up-to-date.
 		 * If ZONEFILE_LOAD_DIFSE, the change is non-empty and ZONEMD
 		 * is directly updated without its verification. */
-		if (!zone_update_no_change(&up) || !zone_contents_digest_exists(up.new_cont, digest_alg, false)) {
+		if (!zone_update_no_change(&up) || !zone_contents_digest_exists(up.new_cont, digest_alg, false, digest_threads)) {
 			if (zone_update_to(&up) == NULL || middle_serial == zone->zonefile.serial) {
 				ret = zone_update_increment_soa(&up, conf);
 			}
@@ -361,7 +364,7 @@ load_end:
 		}
 
 		// If the original ZONEMD is outdated, use the reverted changeset again.
-		if (update_zonemd && !zone_contents_digest_exists(up.new_cont, digest_alg, false)) {
+		if (update_zonemd && !zone_contents_digest_exists(up.new_cont, digest_alg, false, digest_threads)) {
 			ret = zone_update_apply_changeset(&up, cpy);
 			changeset_free(cpy);
 			if (ret != KNOT_EOK) {
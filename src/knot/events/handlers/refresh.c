@@ -15,10 +15,13 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <urcu.h>
 
 #include "contrib/mempattern.h"
+#include "contrib/ucw/mempool.h"
+#include "contrib/sockaddr.h"
 #include "libdnssec/random.h"
 #include "knot/common/log.h"
 #include "knot/conf/conf.h"
@@ -29,6 +32,7 @@
 #include "knot/query/layer.h"
 #include "knot/query/query.h"
 #include "knot/query/requestor.h"
+#include "knot/query/soa-batch.h"
 #include "knot/server/server.h"
 #include "knot/updates/changesets.h"
 #include "knot/zone/adjust.h"
@@ -132,6 +136,8 @@ struct refresh_data {
 
 	struct {
 		zone_contents_t *zone;    //!< AXFR result, new zone.
+		struct axfr_builder *builder; //!< Background builder of the new zone.
+		bool soa_seen;            //!< The initial SOA has been received.
 	} axfr;
 
 	struct {
@@ -295,6 +301,173 @@ static void xfr_log_read_ms(const knot_dname_t *zone, int ret)
 	log_zone_error(zone, "failed reading master serial from KASP DB (%s)", knot_strerror(ret));
 }
 
+/*!
+ * \brief Maximum number of received packets waiting for the zone builder.
+ *
+ * Limits memory consumption if the builder is slower than the network.
+ */
+#define AXFR_BUILDER_QUEUE	32
+
+/*! \brief Copies of the records from one received AXFR packet. */
+struct axfr_batch {
+	struct axfr_batch *next;
+	knot_mm_t mm;             //!< Memory pool for the records.
+	knot_rrset_t **rrs;
+	uint16_t count;
+};
+
+/*!
+ * \brief AXFR zone builder.
+ *
+ * Inserting the records into the new zone runs in a separate thread, so that
+ * it overlaps with receiving and parsing of the following packets.
+ */
+struct axfr_builder {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct axfr_batch *head;  //!< Queue of batches to be inserted.
+	struct axfr_batch *tail;
+	unsigned queued;          //!< Number of batches in the queue.
+	bool closing;             //!< No more batches will come.
+	int ret;                  //!< First insertion error.
+	zone_contents_t *zone;    //!< New zone being built.
+};
+
+static struct axfr_batch *axfr_batch_new(uint16_t count)
+{
+	struct axfr_batch *batch = calloc(1, sizeof(*batch));
+	if (batch == NULL) {
+		return NULL;
+	}
+
+	mm_ctx_mempool(&batch->mm, 16 * MM_DEFAULT_BLKSIZE);
+	if (batch->mm.ctx != NULL) {
+		batch->rrs = mm_alloc(&batch->mm, count * sizeof(*batch->rrs));
+	}
+	if (batch->rrs == NULL) {
+		mp_delete(batch->mm.ctx);
+		free(batch);
+		return NULL;
+	}
+
+	return batch;
+}
+
+static void axfr_batch_free(struct axfr_batch *batch)
+{
+	mp_delete(batch->mm.ctx);
+	free(batch);
+}
+
+static void *axfr_builder_thread(void *arg)
+{
+	struct axfr_builder *builder = arg;
+
+	pthread_mutex_lock(&builder->lock);
+	while (true) {
+		while (builder->head == NULL && !builder->closing) {
+			pthread_cond_wait(&builder->cond, &builder->lock);
+		}
+		struct axfr_batch *batch = builder->head;
+		if (batch == NULL) {
+			break;
+		}
+		builder->head = batch->next;
+		if (builder->head == NULL) {
+			builder->tail = NULL;
+		}
+		builder->queued--;
+		pthread_cond_broadcast(&builder->cond);
+		int ret = builder->ret;
+		pthread_mutex_unlock(&builder->lock);
+
+		// After an error, the remaining batches are just dropped.
+		zcreator_t zc = {
+			.z = builder->zone,
+			.master = false,
+			.ret = KNOT_EOK
+		};
+		for (uint16_t i = 0; i < batch->count && ret == KNOT_EOK; i++) {
+			ret = zcreator_step(&zc, batch->rrs[i]);
+		}
+		axfr_batch_free(batch);
+
+		pthread_mutex_lock(&builder->lock);
+		if (builder->ret == KNOT_EOK) {
+			builder->ret = ret;
+		}
+	}
+	pthread_mutex_unlock(&builder->lock);
+
+	return NULL;
+}
+
+static struct axfr_builder *axfr_builder_start(zone_contents_t *zone)
+{
+	struct axfr_builder *builder = calloc(1, sizeof(*builder));
+	if (builder == NULL) {
+		return NULL;
+	}
+	builder->zone = zone;
+
+	pthread_mutex_init(&builder->lock, NULL);
+	pthread_cond_init(&builder->cond, NULL);
+	if (pthread_create(&builder->thread, NULL, axfr_builder_thread, builder) != 0) {
+		pthread_cond_destroy(&builder->cond);
+		pthread_mutex_destroy(&builder->lock);
+		free(builder);
+		return NULL;
+	}
+
+	return builder;
+}
+
+static int axfr_builder_push(struct axfr_builder *builder, struct axfr_batch *batch)
+{
+	pthread_mutex_lock(&builder->lock);
+	while (builder->queued >= AXFR_BUILDER_QUEUE && builder->ret == KNOT_EOK) {
+		pthread_cond_wait(&builder->cond, &builder->lock);
+	}
+	int ret = builder->ret;
+	if (ret == KNOT_EOK) {
+		if (builder->tail == NULL) {
+			builder->head = batch;
+		} else {
+			builder->tail->next = batch;
+		}
+		builder->tail = batch;
+		builder->queued++;
+		pthread_cond_broadcast(&builder->cond);
+	}
+	pthread_mutex_unlock(&builder->lock);
+
+	if (ret != KNOT_EOK) {
+		axfr_batch_free(batch);
+	}
+
+	return ret;
+}
+
+/*! \brief Wait until all the queued records are inserted and stop the builder. */
+static int axfr_builder_finish(struct axfr_builder *builder)
+{
+	pthread_mutex_lock(&builder->lock);
+	builder->closing = true;
+	pthread_cond_broadcast(&builder->cond);
+	pthread_mutex_unlock(&builder->lock);
+
+	pthread_join(builder->thread, NULL);
+	assert(builder->head == NULL);
+
+	int ret = builder->ret;
+	pthread_cond_destroy(&builder->cond);
+	pthread_mutex_destroy(&builder->lock);
+	free(builder);
+
+	return ret;
+}
+
 static int axfr_init(struct refresh_data *data)
 {
 	zone_contents_t *new_zone = zone_contents_new(data->zone->name, true);
@@ -303,11 +476,18 @@ static int axfr_init(struct refresh_data *data)
 	}
 
 	data->axfr.zone = new_zone;
+	data->axfr.soa_seen = false;
+	// If the builder can't be started, the records are inserted directly.
+	data->axfr.builder = axfr_builder_start(new_zone);
 	return KNOT_EOK;
 }
 
 static void axfr_cleanup(struct refresh_data *data)
 {
+	if (data->axfr.builder != NULL) {
+		(void)axfr_builder_finish(data->axfr.builder);
+		data->axfr.builder = NULL;
+	}
 	zone_contents_deep_free(data->axfr.zone);
 	data->axfr.zone = NULL;
 }
@@ -416,28 +596,43 @@ static int axfr_finalize(struct refresh_data *data)
 	return KNOT_EOK;
 }
 
-static int axfr_consume_rr(const knot_rrset_t *rr, struct refresh_data *data)
+static int axfr_consume_rr(const knot_rrset_t *rr, struct refresh_data *data,
+                           struct axfr_batch *batch)
 {
 	assert(rr);
 	assert(data);
 	assert(data->axfr.zone);
 
-	// zc is stateless structure which can be initialized for each rr
-	// the changes are stored only in data->axfr.zone (aka zc.z)
-	zcreator_t zc = {
-		.z = data->axfr.zone,
-		.master = false,
-		.ret = KNOT_EOK
-	};
-
-	if (rr->type == KNOT_RRTYPE_SOA &&
-	    node_rrtype_exists(zc.z->apex, KNOT_RRTYPE_SOA)) {
+	if (rr->type == KNOT_RRTYPE_SOA && data->axfr.soa_seen) {
 		return KNOT_STATE_DONE;
 	}
 
-	data->ret = zcreator_step(&zc, rr);
-	if (data->ret != KNOT_EOK) {
-		return KNOT_STATE_FAIL;
+	if (batch != NULL) {
+		// Inserted later by the builder, the packet will be reused.
+		knot_rrset_t *copy = knot_rrset_copy(rr, &batch->mm);
+		if (copy == NULL) {
+			data->ret = KNOT_ENOMEM;
+			return KNOT_STATE_FAIL;
+		}
+		batch->rrs[batch->count++] = copy;
+	} else {
+		// zc is stateless structure which can be initialized for each rr
+		// the changes are stored only in data->axfr.zone (aka zc.z)
+		zcreator_t zc = {
+			.z = data->axfr.zone,
+			.master = false,
+			.ret = KNOT_EOK
+		};
+
+		data->ret = zcreator_step(&zc, rr);
+		if (data->ret != KNOT_EOK) {
+			return KNOT_STATE_FAIL;
+		}
+	}
+
+	if (rr->type == KNOT_RRTYPE_SOA &&
+	    knot_dname_is_case_equal(rr->owner, data->zone->name)) {
+		data->axfr.soa_seen = true;
 	}
 
 	data->change_size += knot_rrset_size(rr);
@@ -451,16 +646,54 @@ static int axfr_consume_rr(const knot_rrset_t *rr, struct refresh_data *data)
 	return KNOT_STATE_CONSUME;
 }
 
-static int axfr_consume_packet(knot_pkt_t *pkt, struct refresh_data *data)
+static int axfr_consume_packet(knot_pkt_t *pkt, struct refresh_data *data,
+                               const knot_rrset_t *first)
 {
 	assert(pkt);
 	assert(data);
 
 	const knot_pktsection_t *answer = knot_pkt_section(pkt, KNOT_ANSWER);
+
+	struct axfr_batch *batch = NULL;
+	if (data->axfr.builder != NULL) {
+		batch = axfr_batch_new(answer->count + 1);
+		if (batch == NULL) {
+			data->ret = KNOT_ENOMEM;
+			return KNOT_STATE_FAIL;
+		}
+	}
+
 	int ret = KNOT_STATE_CONSUME;
+	if (first != NULL) {
+		ret = axfr_consume_rr(first, data, batch);
+	}
 	for (uint16_t i = 0; i < answer->count && ret == KNOT_STATE_CONSUME; ++i) {
-		ret = axfr_consume_rr(knot_pkt_rr(answer, i), data);
+		ret = axfr_consume_rr(knot_pkt_rr(answer, i), data, batch);
 	}
+
+	if (batch == NULL) {
+		return ret;
+	}
+
+	if (ret == KNOT_STATE_FAIL || batch->count == 0) {
+		axfr_batch_free(batch);
+	} else {
+		int push_ret = axfr_builder_push(data->axfr.builder, batch);
+		if (push_ret != KNOT_EOK) {
+			data->ret = push_ret;
+			return KNOT_STATE_FAIL;
+		}
+	}
+
+	// The new zone is complete once the builder finishes.
+	if (ret == KNOT_STATE_DONE) {
+		data->ret = axfr_builder_finish(data->axfr.builder);
+		data->axfr.builder = NULL;
+		if (data->ret != KNOT_EOK) {
+			return KNOT_STATE_FAIL;
+		}
+	}
+
 	return ret;
 }
 
@@ -494,22 +727,18 @@ static int axfr_consume(knot_pkt_t *pkt, struct refresh_data *data, bool reuse_s
 		data->change_size = 0;
 	}
 
-	int next;
 	// Process saved SOA if fallback from IXFR
+	const knot_rrset_t *first = reuse_soa ? data->initial_soa_copy : NULL;
+
+	// Process answer packet
+	xfr_stats_add(&data->stats, pkt->size + knot_rrset_size(pkt->tsig_rr));
+	int next = axfr_consume_packet(pkt, data, first);
+
 	if (data->initial_soa_copy != NULL) {
-		next = reuse_soa ? axfr_consume_rr(data->initial_soa_copy, data) :
-		                   KNOT_STATE_CONSUME;
 		knot_rrset_free(data->initial_soa_copy, data->mm);
 		data->initial_soa_copy = NULL;
-		if (next != KNOT_STATE_CONSUME) {
-			return next;
-		}
 	}
 
-	// Process answer packet
-	xfr_stats_add(&data->stats, pkt->size + knot_rrset_size(pkt->tsig_rr));
-	next = axfr_consume_packet(pkt, data);
-
 	// Finalize
 	if (next == KNOT_STATE_DONE) {
 		xfr_stats_end(&data->stats);
@@ -1265,7 +1494,10 @@ static int refresh_begin(knot_layer_t *layer, void *_data)
 	struct refresh_data *data = _data;
 	data->layer = layer;
 
-	if (data->soa) {
+	if (data->state == STATE_TRANSFER) {
+		// Transfer already decided by a batched SOA answer.
+		data->initial_soa_copy = NULL;
+	} else if (data->soa) {
 		data->state = STATE_SOA_QUERY;
 		data->xfr_type = XFR_TYPE_IXFR;
 		data->initial_soa_copy = NULL;
@@ -1339,6 +1571,113 @@ static size_t max_zone_size(conf_t *conf, const knot_dname_t *zone)
 	return conf_int(&val);
 }
 
+typedef struct {
+	knot_zonedb_t *db;
+	const knot_dname_t *leader;
+	time_t due;
+} batch_ctx_t;
+
+static bool batch_accept(const knot_dname_t *name, void *ctx)
+{
+	batch_ctx_t *batch = ctx;
+	if (knot_dname_is_equal(name, batch->leader)) {
+		return false;
+	}
+
+	zone_t *zone = knot_zonedb_find(batch->db, name);
+	if (zone == NULL || zone->contents == NULL) {
+		return false;
+	}
+
+	time_t refresh = zone_events_get_time(zone, ZONE_EVENT_REFRESH);
+	return refresh > 0 && refresh <= batch->due;
+}
+
+/*!
+ * \brief Check SOA serials of other zones due for refresh from the same master.
+ *
+ * Zones with a changed serial are refreshed immediately, the others
+ * pick up the cached answer when their refresh is due. Unanswered zones
+ * just query the master on their own.
+ */
+static void refresh_batch(conf_t *conf, server_t *server, const knot_dname_t *leader,
+                          const conf_remote_t *master)
+{
+	soa_batch_item_t *items = calloc(master->soa_batch, sizeof(soa_batch_item_t));
+	if (items == NULL) {
+		return;
+	}
+
+	rcu_read_lock();
+	batch_ctx_t ctx = {
+		.db = server->zone_db,
+		.leader = leader,
+		.due = time(NULL) + SOA_BATCH_WINDOW,
+	};
+	size_t count = soa_batch_candidates(conf, server->zone_db, master, items,
+	                                    master->soa_batch, batch_accept, &ctx);
+	rcu_read_unlock();
+
+	if (count > 0) {
+		query_edns_data_t edns = query_edns_data_init(conf, master, QUERY_EDNS_OPT_EXPIRE);
+		int timeout = conf->cache.srv_tcp_remote_io_timeout;
+		int ret = soa_batch_query(master, &edns, items, count, timeout);
+
+		size_t answered = 0, changed = 0;
+		rcu_read_lock();
+		for (size_t i = 0; i < count; i++) {
+			soa_batch_item_t *item = &items[i];
+			if (!item->answered) {
+				continue;
+			}
+			answered++;
+
+			uint32_t local_serial;
+			zone_t *other = knot_zonedb_find(server->zone_db, item->zone);
+			if (other != NULL && other->contents != NULL &&
+			    (slave_zone_serial(other, conf, &local_serial) != KNOT_EOK ||
+			     local_serial != item->serial)) {
+				zone_events_schedule_now(other, ZONE_EVENT_REFRESH);
+				changed++;
+			}
+		}
+		rcu_read_unlock();
+
+		char addr_str[SOCKADDR_STRLEN];
+		sockaddr_tostr(addr_str, sizeof(addr_str), &master->addr);
+		if (ret != KNOT_EOK) {
+			log_zone_warning(leader, "refresh, remote %s, batched SOA check "
+			                 "failed (%s)", addr_str, knot_strerror(ret));
+		}
+		log_zone_debug(leader, "refresh, remote %s, batched SOA check of %zu zones, "
+		               "answered %zu, changed %zu", addr_str, count, answered, changed);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		knot_dname_free(items[i].zone, NULL);
+	}
+	free(items);
+}
+
+static void refresh_batch_run(worker_task_t *task)
+{
+	soa_batch_task_t *batch = task->ctx;
+
+	conf_t *conf;
+	rcu_read_lock();
+	int ret = conf_clone(&conf);
+	rcu_read_unlock();
+	if (ret == KNOT_EOK) {
+		conf_remote_t master;
+		if (soa_batch_task_remote(conf, batch, &master)) {
+			refresh_batch(conf, batch->server, batch->leader, &master);
+		}
+		conf_free(conf);
+	}
+
+	soa_batch_task_free(batch);
+}
+
 typedef struct {
 	bool force_axfr;
 	bool send_notify;
@@ -1347,6 +1686,16 @@ typedef struct {
 	bool more_xfr;
 } try_refresh_ctx_t;
 
+static void refresh_done(try_refresh_ctx_t *trctx, const conf_remote_t *master,
+                         const struct refresh_data *data, int ret)
+{
+	if (ret == KNOT_EOK) {
+		trctx->send_notify = trctx->send_notify || (data->updated && !master->block_notify_after_xfr);
+		trctx->force_axfr = false;
+		trctx->more_xfr = trctx->more_xfr || (data->updated && data->ixfr_by_one && data->xfr_type == XFR_TYPE_IXFR);
+	}
+}
+
 static int try_refresh(conf_t *conf, zone_t *zone, const conf_remote_t *master,
                        void *ctx, zone_master_fallback_t *fallback)
 {
@@ -1384,6 +1733,21 @@ static int try_refresh(conf_t *conf, zone_t *zone, const conf_remote_t *master,
 		.ixfr_from_axfr = trctx->ixfr_from_axfr,
 	};
 
+	// Use the answer from a preceding batched SOA check if available.
+	knot_pkt_t *batched = (data.soa != NULL) ? soa_batch_take(master, zone->name) : NULL;
+	bool from_batch = (batched != NULL);
+	if (from_batch) {
+		knot_layer_t layer = { 0 };
+		(void)refresh_begin(&layer, &data);
+		int state = soa_query_consume(&layer, batched);
+		knot_pkt_free(batched);
+		if (state != KNOT_STATE_RESET) {
+			knot_rrset_free(soa, NULL);
+			refresh_done(trctx, master, &data, data.ret);
+			return data.ret;
+		}
+	}
+
 	knot_requestor_t requestor;
 	knot_requestor_init(&requestor, &REFRESH_API, &data, NULL);
 
@@ -1425,12 +1789,18 @@ static int try_refresh(conf_t *conf, zone_t *zone, const conf_remote_t *master,
 	knot_requestor_clear(&requestor);
 	knot_rrset_free(soa, NULL);
 
-	if (ret == KNOT_EOK) {
-		trctx->send_notify = trctx->send_notify || (data.updated && !master->block_notify_after_xfr);
-		trctx->force_axfr = false;
-		trctx->more_xfr = trctx->more_xfr || (data.updated && data.ixfr_by_one && data.xfr_type == XFR_TYPE_IXFR);
+	// Check the other zones from the master in the background.
+	if (ret == KNOT_EOK && !from_batch && data.soa != NULL &&
+	    soa_batch_usable(master) && soa_batch_claim(master)) {
+		soa_batch_task_t *batch = soa_batch_task_new(master, zone->name, zone->server,
+		                                             refresh_batch_run, WORKER_PRIO_LOW);
+		if (batch != NULL) {
+			worker_pool_assign(zone->server->workers, &batch->task);
+		}
 	}
 
+	refresh_done(trctx, master, &data, ret);
+
 	return ret;
 }
 
@@ -29,6 +29,7 @@
 #include <stdint.h>
 #include <syslog.h>
 #include <sys/socket.h>
+#include <time.h>
 
 #include <libknot/libknot.h>
 #include <libknot/yparser/ypschema.h>
@@ -101,6 +102,7 @@ typedef enum {
 	KNOTD_MOD_FLAG_SCOPE_ZONE   = 1 << 2, /*!< Can be specified as zone module. */
 	KNOTD_MOD_FLAG_SCOPE_ANY    = KNOTD_MOD_FLAG_SCOPE_GLOBAL |
 	                              KNOTD_MOD_FLAG_SCOPE_ZONE,
+	KNOTD_MOD_FLAG_NO_ANSWER_CACHE = 1 << 3, /*!< Answers mustn't be reused (dynamic content). */
 } knotd_mod_flag_t;
 
 /*! Module API. */
@@ -219,6 +221,8 @@ int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_cou
 /*!
  * Increments a statistics counter.
  *
+ * \note The counters of the worker thread must be modified by the thread only.
+ *
  * \param[in] mod     Module context.
  * \param[in] thr_id  Index of worker thread.
  * \param[in] ctr_id  Counter id (counted in the order the counters were registered).
@@ -231,6 +235,8 @@ void knotd_mod_stats_incr(knotd_mod_t *mod, unsigned thr_id, uint32_t ctr_id,
 /*!
  * Decrements a statistics counter.
  *
+ * \note The counters of the worker thread must be modified by the thread only.
+ *
  * \param[in] mod     Module context.
  * \param[in] thr_id  Index of worker thread.
  * \param[in] ctr_id  Counter id (counted in the order the counters were registered).
@@ -243,6 +249,8 @@ void knotd_mod_stats_decr(knotd_mod_t *mod, unsigned thr_id, uint32_t ctr_id,
 /*!
  * Sets a statistics counter value.
  *
+ * \note The counters of the worker thread must be modified by the thread only.
+ *
  * \param[in] mod     Module context.
  * \param[in] thr_id  Index of worker thread.
  * \param[in] ctr_id  Counter id (counted in the order the counters were registered).
@@ -364,6 +372,38 @@ knotd_conf_t knotd_conf_check_item(knotd_conf_check_args_t *args,
 bool knotd_conf_addr_range_match(const knotd_conf_t *range,
                                  const struct sockaddr_storage *addr);
 
+/*! Compiled address ranges for repeated matching. */
+typedef struct knotd_addr_set knotd_addr_set_t;
+
+/*!
+ * Compiles address ranges into a prefix trie.
+ *
+ * \note The lookup doesn't depend on the number of ranges.
+ *
+ * \param[in] range  Address ranges.
+ *
+ * \return Address set or NULL if no memory.
+ */
+knotd_addr_set_t *knotd_conf_addr_set(const knotd_conf_t *range);
+
+/*!
+ * Checks if address is in the compiled address ranges.
+ *
+ * \param[in] set   Address set.
+ * \param[in] addr  Address to check.
+ *
+ * \return true if addr is in at least one range, false otherwise.
+ */
+bool knotd_addr_set_match(const knotd_addr_set_t *set,
+                          const struct sockaddr_storage *addr);
+
+/*!
+ * Deallocates compiled address ranges.
+ *
+ * \param[in] set  Address set.
+ */
+void knotd_addr_set_free(knotd_addr_set_t *set);
+
 /*!
  * Deallocates multi-valued configuration values.
  *
@@ -416,6 +456,7 @@ typedef struct {
 	struct knot_tls_conn *tls_conn;        /*!< TLS connection context. */
 	int64_t quic_stream;                   /*!< QUIC stream ID inside quic_conn. */
 	uint32_t measured_rtt;                 /*!< Measured RTT in usecs: QUIC or TCP-XDP. */
+	struct timespec recv_time;             /*!< Query reception time (CLOCK_MONOTONIC). */
 } knotd_qdata_params_t;
 
 /*! Query processing data context. */
@@ -541,6 +582,7 @@ typedef enum {
 	KNOTD_STAGE_ADDITIONAL,       /*!< Additional section processing. */
 	KNOTD_STAGE_END,              /*!< After query processing. */
 	KNOTD_STAGE_PROTO_END,        /*!< End of transport protocol processing. */
+	KNOTD_STAGE_PROTO_BATCH,      /*!< Receive batch processing (before PROTO_BEGIN). */
 } knotd_stage_t;
 
 /*!
@@ -555,6 +597,22 @@ typedef enum {
 typedef knotd_proto_state_t (*knotd_mod_proto_hook_f)
 	(knotd_proto_state_t state, knotd_qdata_params_t *params, knotd_mod_t *mod);
 
+/*!
+ * Receive batch processing hook.
+ *
+ * Called for a batch of received UDP queries before their individual
+ * processing. The queries cannot be blocked here, the hook is intended for
+ * preparing the data needed by the per-query hooks (e.g. memory prefetching).
+ *
+ * \param[in] remotes    Remote addresses of the queries.
+ * \param[in] count      Number of the queries.
+ * \param[in] thread_id  Current thread id.
+ * \param[in] mod        Module context.
+ */
+typedef void (*knotd_mod_batch_hook_f)
+	(const struct sockaddr_storage *const *remotes, unsigned count,
+	 unsigned thread_id, knotd_mod_t *mod);
+
 /*!
  * General processing hook.
  *
@@ -592,6 +650,18 @@ typedef knotd_in_state_t (*knotd_mod_in_hook_f)
  */
 int knotd_mod_proto_hook(knotd_mod_t *mod, knotd_stage_t stage, knotd_mod_proto_hook_f hook);
 
+/*!
+ * Registers receive batch processing module hook.
+ *
+ * \note The hook is executed only if the module is global.
+ *
+ * \param[in] mod   Module context.
+ * \param[in] hook  Module hook.
+ *
+ * \return Error code, KNOT_EOK if success.
+ */
+int knotd_mod_batch_hook(knotd_mod_t *mod, knotd_mod_batch_hook_f hook);
+
 /*!
  * Registers general processing module hook.
  *
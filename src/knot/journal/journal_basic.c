@@ -14,10 +14,34 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "knot/journal/journal_basic.h"
 #include "knot/journal/journal_metadata.h"
+#include "contrib/macros.h"
 #include "libknot/error.h"
 
+#define JOURNAL_ZSTD_LEVEL 3
+#define JOURNAL_PAYLOAD_MAX (JOURNAL_CHUNK_MAX - JOURNAL_HEADER_SIZE)
+
+struct journal_compress {
+#ifdef ENABLE_ZSTD
+	ZSTD_CCtx *cctx;
+#endif
+	uint8_t raw[JOURNAL_CHUNK_MAX];
+	uint8_t compressed[JOURNAL_CHUNK_MAX];
+};
+
+struct journal_decompress {
+#ifdef ENABLE_ZSTD
+	ZSTD_DCtx *dctx;
+#endif
+	uint8_t payload[JOURNAL_PAYLOAD_MAX];
+};
+
 MDB_val journal_changeset_id_to_key(bool zone_in_journal, uint32_t serial, const knot_dname_t *zone)
 {
 	if (zone_in_journal) {
@@ -54,10 +78,10 @@ void journal_del_zone(knot_lmdb_txn_t *txn, const knot_dname_t *zone)
 	free(prefix.mv_data);
 }
 
-void journal_make_header(void *chunk, uint32_t ch_serial_to, uint64_t now)
+void journal_make_header(void *chunk, uint32_t ch_serial_to, uint32_t flags, uint64_t now)
 {
-	knot_lmdb_make_key_part(chunk, JOURNAL_HEADER_SIZE, "IILLL", ch_serial_to,
-	                        (uint32_t)0 /* we no longer care for # of chunks */,
+	// The former # of chunks is reused for the compression flags.
+	knot_lmdb_make_key_part(chunk, JOURNAL_HEADER_SIZE, "IILLL", ch_serial_to, flags,
 	                        (uint64_t)0, now, (uint64_t)0);
 }
 
@@ -71,6 +95,116 @@ uint64_t journal_ch_timestamp(const MDB_val *chunk)
 	return knot_wire_read_u64(chunk->mv_data + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t));
 }
 
+int journal_compress_init(journal_compress_t **ctx, int compression)
+{
+	if (compression != JOURNAL_COMPRESSION_ZSTD) {
+		return KNOT_ENOTSUP;
+	}
+#ifdef ENABLE_ZSTD
+	journal_compress_t *res = malloc(sizeof(*res));
+	if (res == NULL) {
+		return KNOT_ENOMEM;
+	}
+	res->cctx = ZSTD_createCCtx();
+	if (res->cctx == NULL) {
+		free(res);
+		return KNOT_ENOMEM;
+	}
+	*ctx = res;
+	return KNOT_EOK;
+#else
+	return KNOT_ENOTSUP;
+#endif
+}
+
+uint8_t *journal_compress_payload(journal_compress_t *ctx)
+{
+	return ctx->raw + JOURNAL_HEADER_SIZE;
+}
+
+MDB_val journal_compress_chunk(journal_compress_t *ctx, size_t payload_size,
+                               uint32_t ch_serial_to, uint64_t now)
+{
+	assert(payload_size <= JOURNAL_PAYLOAD_MAX);
+#ifdef ENABLE_ZSTD
+	// Fails if the result is not smaller than the payload.
+	size_t size = ZSTD_compressCCtx(ctx->cctx, ctx->compressed + JOURNAL_HEADER_SIZE,
+	                                payload_size - MIN(payload_size, 1),
+	                                ctx->raw + JOURNAL_HEADER_SIZE, payload_size,
+	                                JOURNAL_ZSTD_LEVEL);
+	if (!ZSTD_isError(size)) {
+		journal_make_header(ctx->compressed, ch_serial_to,
+		                    JOURNAL_CHUNK_ZSTD | payload_size, now);
+		return (MDB_val){ JOURNAL_HEADER_SIZE + size, ctx->compressed };
+	}
+#endif
+	journal_make_header(ctx->raw, ch_serial_to, 0, now);
+	return (MDB_val){ JOURNAL_HEADER_SIZE + payload_size, ctx->raw };
+}
+
+void journal_compress_free(journal_compress_t *ctx)
+{
+	if (ctx != NULL) {
+#ifdef ENABLE_ZSTD
+		ZSTD_freeCCtx(ctx->cctx);
+#endif
+		free(ctx);
+	}
+}
+
+int journal_chunk_payload(journal_decompress_t **ctx, const MDB_val *chunk, MDB_val *payload)
+{
+	if (chunk->mv_size < JOURNAL_HEADER_SIZE) {
+		return KNOT_EMALF;
+	}
+	uint32_t flags = knot_wire_read_u32(chunk->mv_data + sizeof(uint32_t));
+	if (!(flags & JOURNAL_CHUNK_ZSTD)) {
+		payload->mv_data = chunk->mv_data + JOURNAL_HEADER_SIZE;
+		payload->mv_size = chunk->mv_size - JOURNAL_HEADER_SIZE;
+		return KNOT_EOK;
+	}
+#ifdef ENABLE_ZSTD
+	size_t payload_size = flags & ~JOURNAL_CHUNK_ZSTD;
+	if (payload_size > JOURNAL_PAYLOAD_MAX) {
+		return KNOT_EMALF;
+	}
+	if (*ctx == NULL) {
+		journal_decompress_t *res = malloc(sizeof(*res));
+		if (res == NULL) {
+			return KNOT_ENOMEM;
+		}
+		res->dctx = ZSTD_createDCtx();
+		if (res->dctx == NULL) {
+			free(res);
+			return KNOT_ENOMEM;
+		}
+		*ctx = res;
+	}
+	size_t size = ZSTD_decompressDCtx((*ctx)->dctx, (*ctx)->payload, payload_size,
+	                                  chunk->mv_data + JOURNAL_HEADER_SIZE,
+	                                  chunk->mv_size - JOURNAL_HEADER_SIZE);
+	if (ZSTD_isError(size) || size != payload_size) {
+		return KNOT_EMALF;
+	}
+	payload->mv_data = (*ctx)->payload;
+	payload->mv_size = payload_size;
+	return KNOT_EOK;
+#else
+	(void)ctx;
+	return KNOT_ENOTSUP;
+#endif
+}
+
+void journal_decompress_free(journal_decompress_t *ctx)
+{
+	if (ctx != NULL) {
+#ifdef ENABLE_ZSTD
+		ZSTD_freeDCtx(ctx->dctx);
+#endif
+		free(ctx);
+	}
+}
+
 bool journal_serial_to(knot_lmdb_txn_t *txn, bool zij, uint32_t serial,
                        const knot_dname_t *zone, uint32_t *serial_to)
 {
@@ -100,3 +234,9 @@ size_t journal_conf_max_changesets(zone_journal_t j)
 	conf_val_t val = conf_zone_get(j.conf, C_JOURNAL_MAX_DEPTH, j.zone);
 	return conf_int(&val);
 }
+
+int journal_conf_compression(zone_journal_t j)
+{
+	conf_val_t val = conf_zone_get(j.conf, C_JOURNAL_COMPRESSION, j.zone);
+	return conf_opt(&val);
+}
@@ -31,6 +31,11 @@ typedef struct {
 #define JOURNAL_CHUNK_THRESH (15 * 1024)
 #define JOURNAL_HEADER_SIZE (32)
 
+#define JOURNAL_CHUNK_ZSTD (1U << 31) // chunk header flag of a zstd compressed payload
+
+typedef struct journal_compress journal_compress_t;
+typedef struct journal_decompress journal_decompress_t;
+
 /*! \brief Convert journal_mode to LMDB environment flags. */
 inline static unsigned journal_env_flags(int journal_mode, bool readonly)
 {
@@ -86,9 +91,10 @@ void journal_del_zone(knot_lmdb_txn_t *txn, const knot_dname_t *zone);
  *
  * \param chunk   Pointer to the changeset chunk. It must be at least JOURNAL_HEADER_SIZE, perhaps more.
  * \param ch      Serial-to of the changeset being serialized.
+ * \param flags   Compression flag and uncompressed payload size, or zero.
  * \param now     Current timestamp.
  */
-void journal_make_header(void *chunk, uint32_t ch_serial_to, uint64_t now);
+void journal_make_header(void *chunk, uint32_t ch_serial_to, uint32_t flags, uint64_t now);
 
 /*!
  * \brief Obtain serial-to of the serialized changeset.
@@ -108,6 +114,59 @@ uint32_t journal_next_serial(const MDB_val *chunk);
  */
 uint64_t journal_ch_timestamp(const MDB_val *chunk);
 
+/*!
+ * \brief Create a context for compressing changeset chunks.
+ *
+ * \param ctx           Output: compression context.
+ * \param compression   Compression algorithm (JOURNAL_COMPRESSION_*).
+ *
+ * \return KNOT_E*
+ */
+int journal_compress_init(journal_compress_t **ctx, int compression);
+
+/*!
+ * \brief Buffer to serialize the chunk payload into before compression.
+ *
+ * \note Its size is JOURNAL_CHUNK_MAX - JOURNAL_HEADER_SIZE.
+ */
+uint8_t *journal_compress_payload(journal_compress_t *ctx);
+
+/*!
+ * \brief Compress the serialized payload and make the whole chunk.
+ *
+ * \note The payload is stored uncompressed if the compression doesn't save space.
+ *
+ * \param ctx           Compression context.
+ * \param payload_size  Size of the payload serialized into journal_compress_payload().
+ * \param ch_serial_to  Serial-to of the changeset being serialized.
+ * \param now           Current timestamp.
+ *
+ * \return The chunk, valid until the next call.
+ */
+MDB_val journal_compress_chunk(journal_compress_t *ctx, size_t payload_size,
+                               uint32_t ch_serial_to, uint64_t now);
+
+/*!
+ * \brief Free the compression context.
+ */
+void journal_compress_free(journal_compress_t *ctx);
+
+/*!
+ * \brief Obtain the (decompressed if needed) payload of the chunk.
+ *
+ * \param ctx       In/out: decompression context, created on first use.
+ * \param chunk     Any chunk of a serialized changeset.
+ * \param payload   Output: the payload, valid until the next call or the end of the transaction.
+ *
+ * \return KNOT_E*
+ */
+int journal_chunk_payload(journal_decompress_t **ctx, const MDB_val *chunk, MDB_val *payload);
+
+/*!
+ * \brief Free the decompression context.
+ */
+void journal_decompress_free(journal_decompress_t *ctx);
+
 /*!
  * \brief Obtain serial-to of a changeset stored in journal.
  *
@@ -136,3 +195,6 @@ size_t journal_conf_max_usage(zone_journal_t j);
 
 /*! \brief Return configured maximal depth of journal. */
 size_t journal_conf_max_changesets(zone_journal_t j);
+
+/*! \brief Return the configured compression of the zone's journal. */
+int journal_conf_compression(zone_journal_t j);
@@ -19,6 +19,10 @@
 #include "libknot/endian.h"
 #include "libknot/error.h"
 
+#define JOURNAL_VERSION			"2.0"
+// Versions 3.x are opened by older servers, which can't read compressed chunks.
+#define JOURNAL_VERSION_COMPRESSED	"4.0"
+
 static void fix_endian(void *data, size_t data_size, bool in)
 {
 	union {
@@ -168,7 +172,7 @@ uint64_t journal_get_occupied(knot_lmdb_txn_t *txn, const knot_dname_t *zone)
 	return res;
 }
 
-static int first_digit(char * of)
+static int first_digit(const char *of)
 {
 	unsigned maj, min;
 	return sscanf(of, "%u.%u", &maj, &min) == 2 ? maj : -1;
@@ -186,6 +190,8 @@ void journal_load_metadata(knot_lmdb_txn_t *txn, const knot_dname_t *zone, journ
 			// still supported
 			// FALLTHROUGH
 		case 2:
+			// FALLTHROUGH
+		case 4:
 			// normal operation
 			break;
 		case 0:
@@ -227,7 +233,10 @@ void journal_store_metadata(knot_lmdb_txn_t *txn, const knot_dname_t *zone, cons
 	set_metadata(txn, zone, "merged_serial",   &md->merged_serial,   sizeof(md->merged_serial),   true);
 	set_metadata(txn, zone, "changeset_count", &md->changeset_count, sizeof(md->changeset_count), true);
 	set_metadata(txn, zone, "flags",           &md->flags,           sizeof(md->flags),           true);
-	set_metadata(txn, NULL, "version", "2.0", 4, false);
+	if (!get_metadata(txn, NULL, "version") ||
+	    first_digit(txn->cur_val.mv_data) != first_digit(JOURNAL_VERSION_COMPRESSED)) {
+		set_metadata(txn, NULL, "version", JOURNAL_VERSION, sizeof(JOURNAL_VERSION), false);
+	}
 	if (md->_new_zone) {
 		uint64_t journal_count = 0;
 		(void)get_metadata64or32(txn, NULL, "journal_count", &journal_count);
@@ -236,6 +245,12 @@ void journal_store_metadata(knot_lmdb_txn_t *txn, const knot_dname_t *zone, cons
 	}
 }
 
+void journal_metadata_compressed(knot_lmdb_txn_t *txn)
+{
+	set_metadata(txn, NULL, "version", JOURNAL_VERSION_COMPRESSED,
+	             sizeof(JOURNAL_VERSION_COMPRESSED), false);
+}
+
 void journal_metadata_after_delete(journal_metadata_t *md, uint32_t deleted_upto,
                                    size_t deleted_count)
 {
@@ -71,6 +71,15 @@ void journal_load_metadata(knot_lmdb_txn_t *txn, const knot_dname_t *zone, journ
  */
 void journal_store_metadata(knot_lmdb_txn_t *txn, const knot_dname_t *zone, const journal_metadata_t *md);
 
+/*!
+ * \brief Mark the journal DB as containing compressed chunks.
+ *
+ * \note Older versions refuse to open such a DB.
+ *
+ * \param txn    Journal DB transaction.
+ */
+void journal_metadata_compressed(knot_lmdb_txn_t *txn);
+
 /*!
  * \brief Update metadata according to what was deleted.
  *
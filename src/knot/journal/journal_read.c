@@ -31,6 +31,7 @@ struct journal_read {
 	MDB_val key_prefix;
 	const knot_dname_t *zone;
 	wire_ctx_t wire;
+	journal_decompress_t *decompress;
 	uint64_t timestamp;
 	uint32_t next;
 	uint32_t changesets_read;
@@ -42,10 +43,16 @@ int journal_read_get_error(const journal_read_t *ctx, int another_error)
 	return (ctx == NULL || ctx->txn.ret == KNOT_EOK ? another_error : ctx->txn.ret);
 }
 
-static void update_ctx_wire(journal_read_t *ctx)
+static bool update_ctx_wire(journal_read_t *ctx)
 {
-	ctx->wire = wire_ctx_init_const(ctx->txn.cur_val.mv_data, ctx->txn.cur_val.mv_size);
-	wire_ctx_skip(&ctx->wire, JOURNAL_HEADER_SIZE);
+	MDB_val payload;
+	int ret = journal_chunk_payload(&ctx->decompress, &ctx->txn.cur_val, &payload);
+	if (ret != KNOT_EOK) {
+		ctx->txn.ret = ret;
+		return false;
+	}
+	ctx->wire = wire_ctx_init_const(payload.mv_data, payload.mv_size);
+	return true;
 }
 
 static bool go_correct_prefix(journal_read_t *ctx)
@@ -78,8 +85,7 @@ static bool go_next_changeset(journal_read_t *ctx, bool go_zone, const knot_dnam
 	}
 	ctx->next = journal_next_serial(&ctx->txn.cur_val);
 	ctx->timestamp = journal_ch_timestamp(&ctx->txn.cur_val);
-	update_ctx_wire(ctx);
-	return true;
+	return update_ctx_wire(ctx);
 }
 
 int journal_read_begin(zone_journal_t j, bool read_zone, uint32_t serial_from, journal_read_t **ctx)
@@ -120,6 +126,7 @@ void journal_read_end(journal_read_t *ctx)
 	if (ctx != NULL) {
 		free(ctx->key_prefix.mv_data);
 		knot_lmdb_abort(&ctx->txn);
+		journal_decompress_free(ctx->decompress);
 		free(ctx);
 	}
 }
@@ -138,7 +145,7 @@ static bool make_data_available(journal_read_t *ctx)
 			ctx->txn.ret = KNOT_EMALF;
 			return false;
 		}
-		update_ctx_wire(ctx);
+		return update_ctx_wire(ctx);
 	}
 	return true;
 }
@@ -40,7 +40,7 @@ static void journal_write_serialize(knot_lmdb_txn_t *txn, serialize_ctx_t *ser,
 		chunk.mv_data = NULL;
 		MDB_val key = journal_make_chunk_key(apex, ch_from, zij, i);
 		if (knot_lmdb_insert(txn, &key, &chunk)) {
-			journal_make_header(chunk.mv_data, ch_to, now);
+			journal_make_header(chunk.mv_data, ch_to, 0, now);
 			serialize_chunk(ser, chunk.mv_data + JOURNAL_HEADER_SIZE, chunk.mv_size - JOURNAL_HEADER_SIZE);
 		}
 		free(key.mv_data);
@@ -52,6 +52,101 @@ static void journal_write_serialize(knot_lmdb_txn_t *txn, serialize_ctx_t *ser,
 	}
 }
 
+typedef struct {
+	MDB_val *chunks;
+	size_t count;
+	size_t size; // Total size of the chunks.
+	const knot_dname_t *apex;
+	bool zij;
+	uint32_t ch_from;
+} compressed_t;
+
+static void compressed_free(compressed_t *c)
+{
+	for (size_t i = 0; i < c->count; i++) {
+		free(c->chunks[i].mv_data);
+	}
+	free(c->chunks);
+	memset(c, 0, sizeof(*c));
+}
+
+/*!
+ * Serialize and compress the changeset in advance, so that its real size
+ * is known before making space for it.
+ */
+static int compress_serialize(compressed_t *c, serialize_ctx_t *ser, int compression,
+                              const knot_dname_t *apex, bool zij, uint32_t ch_from, uint32_t ch_to)
+{
+	memset(c, 0, sizeof(*c));
+	c->apex = apex;
+	c->zij = zij;
+	c->ch_from = ch_from;
+	if (ser == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	journal_compress_t *comp = NULL;
+	int ret = journal_compress_init(&comp, compression);
+	size_t capacity = 0;
+	uint64_t now = knot_time();
+	while (serialize_unfinished(ser) && ret == KNOT_EOK) {
+		size_t payload_size;
+		serialize_prepare(ser, JOURNAL_CHUNK_THRESH - JOURNAL_HEADER_SIZE,
+		                  JOURNAL_CHUNK_MAX - JOURNAL_HEADER_SIZE, &payload_size);
+		if (payload_size == 0) {
+			break; // beware! If this is omitted, it creates empty chunk => EMALF when reading.
+		}
+		serialize_chunk(ser, journal_compress_payload(comp), payload_size);
+		MDB_val chunk = journal_compress_chunk(comp, payload_size, ch_to, now);
+
+		if (c->count == capacity) {
+			capacity = MAX(2 * capacity, 16);
+			MDB_val *chunks = realloc(c->chunks, capacity * sizeof(*chunks));
+			if (chunks == NULL) {
+				ret = KNOT_ENOMEM;
+				break;
+			}
+			c->chunks = chunks;
+		}
+		void *data = malloc(chunk.mv_size);
+		if (data == NULL) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+		memcpy(data, chunk.mv_data, chunk.mv_size);
+		c->chunks[c->count++] = (MDB_val){ chunk.mv_size, data };
+		c->size += chunk.mv_size;
+	}
+	journal_compress_free(comp);
+
+	int ser_ret = serialize_deinit(ser);
+	if (ret == KNOT_EOK) {
+		ret = ser_ret;
+	}
+	if (ret != KNOT_EOK) {
+		compressed_free(c);
+	}
+	return ret;
+}
+
+static int compress_changeset(compressed_t *c, const changeset_t *ch, int compression)
+{
+	bool zij = (ch->remove == NULL);
+	return compress_serialize(c, serialize_init(ch), compression, ch->soa_to->owner,
+	                          zij, zij ? 0 : changeset_from(ch), changeset_to(ch));
+}
+
+static void write_compressed(knot_lmdb_txn_t *txn, const compressed_t *c)
+{
+	for (uint32_t i = 0; i < c->count && txn->ret == KNOT_EOK; i++) {
+		MDB_val key = journal_make_chunk_key(c->apex, c->ch_from, c->zij, i);
+		MDB_val val = c->chunks[i];
+		knot_lmdb_insert(txn, &key, &val);
+		free(key.mv_data);
+	}
+	journal_metadata_compressed(txn);
+}
+
 void journal_write_changeset(knot_lmdb_txn_t *txn, const changeset_t *ch)
 {
 	serialize_ctx_t *ser = serialize_init(ch);
@@ -136,7 +231,15 @@ void journal_merge(zone_journal_t j, knot_lmdb_txn_t *txn, bool merge_zij,
 		assert(del_next_serial == *original_serial_to);
 	}
 
-	journal_write_changeset(txn, &merge);
+	int compression = journal_conf_compression(j);
+	if (compression == JOURNAL_COMPRESSION_NONE) {
+		journal_write_changeset(txn, &merge);
+	} else if (txn->ret == KNOT_EOK) {
+		compressed_t c;
+		txn->ret = compress_changeset(&c, &merge, compression);
+		write_compressed(txn, &c);
+		compressed_free(&c);
+	}
 	journal_read_clear_changeset(&merge);
 }
 
@@ -235,113 +338,183 @@ void journal_fix_occupation(zone_journal_t j, knot_lmdb_txn_t *txn, journal_meta
 	}
 }
 
-int journal_insert_zone(zone_journal_t j, const zone_contents_t *z)
+typedef struct {
+	zone_journal_t j;
+	const changeset_t *ch;
+	const changeset_t *extra;
+	const zone_diff_t *zdiff;
+	const zone_contents_t *z;
+	compressed_t chunks;       // Compressed 'ch', 'zdiff', or 'z' (if enabled).
+	compressed_t extra_chunks; // Compressed 'extra' (if enabled).
+	size_t ch_size;
+	size_t max_usage;
+} insert_ctx_t;
+
+static void insert_zone_txn(knot_lmdb_txn_t *txn, void *_ctx)
 {
-	changeset_t fake_ch = { .add = (zone_contents_t *)z };
-	size_t ch_size = changeset_serialized_size(&fake_ch);
-	size_t max_usage = journal_conf_max_usage(j);
-	if (ch_size >= max_usage) {
-		return KNOT_ESPACE;
-	}
-	int ret = knot_lmdb_open(j.db);
-	if (ret != KNOT_EOK) {
-		return ret;
-	}
-	knot_lmdb_txn_t txn = { 0 };
-	knot_lmdb_begin(j.db, &txn, true);
+	insert_ctx_t *ctx = _ctx;
+	const zone_contents_t *z = ctx->z;
 
-	update_last_inserter(&txn, j.zone);
-	journal_del_zone_txn(&txn, j.zone);
+	update_last_inserter(txn, ctx->j.zone);
+	journal_del_zone_txn(txn, ctx->j.zone);
 
-	journal_write_zone(&txn, z);
+	if (ctx->chunks.count > 0) {
+		write_compressed(txn, &ctx->chunks);
+	} else {
+		journal_write_zone(txn, z);
+	}
 
 	journal_metadata_t md = { 0 };
 	md.flags = JOURNAL_SERIAL_TO_VALID;
 	md.serial_to = zone_contents_serial(z);
 	md.first_serial = md.serial_to;
-	journal_store_metadata(&txn, j.zone, &md);
-
-	knot_lmdb_commit(&txn);
-	return txn.ret;
+	journal_store_metadata(txn, ctx->j.zone, &md);
 }
 
-int journal_insert(zone_journal_t j, const changeset_t *ch, const changeset_t *extra,
-                   const zone_diff_t *zdiff)
+int journal_insert_zone(zone_journal_t j, const zone_contents_t *z)
 {
-	assert(zdiff == NULL || (ch == NULL && extra == NULL));
+	insert_ctx_t ctx = { .j = j, .z = z };
+
+	size_t ch_size;
+	int compression = journal_conf_compression(j);
+	if (compression != JOURNAL_COMPRESSION_NONE) {
+		int ret = compress_serialize(&ctx.chunks, serialize_zone_init(z), compression,
+		                             z->apex->owner, true, 0, zone_contents_serial(z));
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		ch_size = ctx.chunks.size;
+	} else {
+		changeset_t fake_ch = { .add = (zone_contents_t *)z };
+		ch_size = changeset_serialized_size(&fake_ch);
+	}
 
-	size_t ch_size = zdiff == NULL ? changeset_serialized_size(ch) :
-	                                 zone_diff_serialized_size(*zdiff);
 	size_t max_usage = journal_conf_max_usage(j);
-	if (ch_size >= max_usage) {
-		return KNOT_ESPACE;
+	int ret = (ch_size >= max_usage) ? KNOT_ESPACE : knot_lmdb_open(j.db);
+	if (ret == KNOT_EOK) {
+		ret = knot_lmdb_apply_batched(j.db, insert_zone_txn, &ctx);
 	}
+	compressed_free(&ctx.chunks);
+	return ret;
+}
 
-	uint32_t ch_from = zdiff == NULL ? changeset_from(ch) : zone_diff_from(zdiff);
-	uint32_t ch_to = zdiff == NULL ? changeset_to(ch) : zone_diff_to(zdiff);
+static void insert_txn(knot_lmdb_txn_t *txn, void *_ctx)
+{
+	insert_ctx_t *ctx = _ctx;
+	zone_journal_t j = ctx->j;
+	const changeset_t *extra = ctx->extra;
+	size_t ch_size = ctx->ch_size;
+
+	uint32_t ch_from = ctx->zdiff == NULL ? changeset_from(ctx->ch) : zone_diff_from(ctx->zdiff);
+	uint32_t ch_to = ctx->zdiff == NULL ? changeset_to(ctx->ch) : zone_diff_to(ctx->zdiff);
 	uint32_t extra_from = extra == NULL ? 0 : changeset_from(extra);
 	uint32_t extra_to = extra == NULL ? 0 : changeset_to(extra);
-	if (extra != NULL && (extra_to != ch_to || extra_from == ch_from)) {
-		return KNOT_EINVAL;
-	}
-	if (serial_compare(ch_from, ch_to) != SERIAL_LOWER ||
-	    (extra != NULL && serial_compare(extra_from, extra_to) != SERIAL_LOWER)) {
-		return KNOT_ESEMCHECK;
-	}
-	int ret = knot_lmdb_open(j.db);
-	if (ret != KNOT_EOK) {
-		return ret;
-	}
-	knot_lmdb_txn_t txn = { 0 };
+
 	journal_metadata_t md = { 0 };
-	knot_lmdb_begin(j.db, &txn, true);
-	journal_load_metadata(&txn, j.zone, &md);
+	journal_load_metadata(txn, j.zone, &md);
 
-	update_last_inserter(&txn, j.zone);
+	update_last_inserter(txn, j.zone);
 
 	if (extra != NULL) {
-		if (journal_contains(&txn, true, 0, j.zone)) {
-			txn.ret = KNOT_ESEMCHECK;
+		if (journal_contains(txn, true, 0, j.zone)) {
+			txn->ret = KNOT_ESEMCHECK;
 		}
 		uint64_t merged_freed = 0;
-		delete_merged(&txn, j.zone, &md, &merged_freed);
-		ch_size += changeset_serialized_size(extra);
+		delete_merged(txn, j.zone, &md, &merged_freed);
+		ch_size += (ctx->extra_chunks.count > 0) ? ctx->extra_chunks.size :
+		                                           changeset_serialized_size(extra);
 		ch_size -= merged_freed;
 		md.flushed_upto = md.serial_to; // set temporarily
 		md.flags |= JOURNAL_LAST_FLUSHED_VALID;
 	}
 
 	size_t chs_limit = journal_conf_max_changesets(j);
-	journal_fix_occupation(j, &txn, &md, max_usage - ch_size, chs_limit - 1);
+	journal_fix_occupation(j, txn, &md, ctx->max_usage - ch_size, chs_limit - 1);
 
 	// avoid discontinuity
 	if ((md.flags & JOURNAL_SERIAL_TO_VALID) && md.serial_to != ch_from) {
-		if (journal_contains(&txn, true, 0, j.zone)) {
-			txn.ret = KNOT_ESEMCHECK;
+		if (journal_contains(txn, true, 0, j.zone)) {
+			txn->ret = KNOT_ESEMCHECK;
 		} else {
-			journal_del_zone_txn(&txn, j.zone);
+			journal_del_zone_txn(txn, j.zone);
 			memset(&md, 0, sizeof(md));
 		}
 	}
 
 	// avoid cycle
-	if (journal_contains(&txn, false, ch_to, j.zone)) {
-		journal_fix_occupation(j, &txn, &md, INT64_MAX, 1);
+	if (journal_contains(txn, false, ch_to, j.zone)) {
+		journal_fix_occupation(j, txn, &md, INT64_MAX, 1);
 	}
 
-	if (zdiff == NULL) {
-		journal_write_changeset(&txn, ch);
+	if (ctx->chunks.count > 0) {
+		write_compressed(txn, &ctx->chunks);
+	} else if (ctx->zdiff == NULL) {
+		journal_write_changeset(txn, ctx->ch);
 	} else {
-		journal_write_zone_diff(&txn, zdiff);
+		journal_write_zone_diff(txn, ctx->zdiff);
 	}
 	journal_metadata_after_insert(&md, ch_from, ch_to);
 
 	if (extra != NULL) {
-		journal_write_changeset(&txn, extra);
+		if (ctx->extra_chunks.count > 0) {
+			write_compressed(txn, &ctx->extra_chunks);
+		} else {
+			journal_write_changeset(txn, extra);
+		}
 		journal_metadata_after_extra(&md, extra_from, extra_to);
 	}
 
-	journal_store_metadata(&txn, j.zone, &md);
-	knot_lmdb_commit(&txn);
-	return txn.ret;
+	journal_store_metadata(txn, j.zone, &md);
+}
+
+int journal_insert(zone_journal_t j, const changeset_t *ch, const changeset_t *extra,
+                   const zone_diff_t *zdiff)
+{
+	assert(zdiff == NULL || (ch == NULL && extra == NULL));
+
+	uint32_t ch_from = zdiff == NULL ? changeset_from(ch) : zone_diff_from(zdiff);
+	uint32_t ch_to = zdiff == NULL ? changeset_to(ch) : zone_diff_to(zdiff);
+	uint32_t extra_from = extra == NULL ? 0 : changeset_from(extra);
+	uint32_t extra_to = extra == NULL ? 0 : changeset_to(extra);
+	if (extra != NULL && (extra_to != ch_to || extra_from == ch_from)) {
+		return KNOT_EINVAL;
+	}
+	if (serial_compare(ch_from, ch_to) != SERIAL_LOWER ||
+	    (extra != NULL && serial_compare(extra_from, extra_to) != SERIAL_LOWER)) {
+		return KNOT_ESEMCHECK;
+	}
+
+	insert_ctx_t ctx = {
+		.j = j,
+		.ch = ch,
+		.extra = extra,
+		.zdiff = zdiff,
+		.max_usage = journal_conf_max_usage(j),
+	};
+
+	int compression = journal_conf_compression(j);
+	if (compression != JOURNAL_COMPRESSION_NONE) {
+		int ret = (zdiff == NULL) ? compress_changeset(&ctx.chunks, ch, compression) :
+		          compress_serialize(&ctx.chunks, serialize_zone_diff_init(zdiff), compression,
+		                             zdiff->apex->owner, false, ch_from, ch_to);
+		if (ret == KNOT_EOK && extra != NULL) {
+			ret = compress_changeset(&ctx.extra_chunks, extra, compression);
+		}
+		if (ret != KNOT_EOK) {
+			compressed_free(&ctx.chunks);
+			return ret;
+		}
+		ctx.ch_size = ctx.chunks.size;
+	} else {
+		ctx.ch_size = zdiff == NULL ? changeset_serialized_size(ch) :
+		                              zone_diff_serialized_size(*zdiff);
+	}
+
+	int ret = (ctx.ch_size >= ctx.max_usage) ? KNOT_ESPACE : knot_lmdb_open(j.db);
+	if (ret == KNOT_EOK) {
+		ret = knot_lmdb_apply_batched(j.db, insert_txn, &ctx);
+	}
+	compressed_free(&ctx.chunks);
+	compressed_free(&ctx.extra_chunks);
+	return ret;
 }
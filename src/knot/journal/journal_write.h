@@ -115,6 +115,9 @@ int journal_insert_zone(zone_journal_t j, const zone_contents_t *z);
  *       the same like merged changeset. Inserting it requires no zone-in-journal
  *       present and leads to deleting any previous merged changeset.
  *
+ * \note Concurrent insertions (also of other zones) are committed together
+ *       in one transaction, see knot_lmdb_apply_batched().
+ *
  * \return KNOT_E*
  */
 int journal_insert(zone_journal_t j, const changeset_t *ch, const changeset_t *extra,
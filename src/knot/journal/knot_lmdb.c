@@ -17,13 +17,16 @@
 #include <stdarg.h>
 #include <stdio.h> // snprintf
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "knot/journal/knot_lmdb.h"
 
 #include "knot/conf/conf.h"
 #include "contrib/files.h"
+#include "contrib/macros.h"
 #include "contrib/time.h"
 #include "contrib/wire_ctx.h"
 #include "libknot/dname.h"
@@ -81,7 +84,14 @@ void knot_lmdb_init(knot_lmdb_db_t *db, const char *path, size_t mapsize, unsign
 	pthread_mutex_init(&db->opening_mutex, NULL);
 	db->maxdbs = 2;
 	db->maxreaders = conf_lmdb_readers(conf());
+	db->batch_delay = 0;
 	db->last_readlock_clean = 0;
+	pthread_mutex_init(&db->batch_mutex, NULL);
+	pthread_cond_init(&db->batch_cond, NULL);
+	db->batch_head = NULL;
+	db->batch_tail = &db->batch_head;
+	db->batch_leader = false;
+	memset(&db->batch_stats, 0, sizeof(db->batch_stats));
 }
 
 static int lmdb_stat(const char *lmdb_path, struct stat *st)
@@ -275,6 +285,8 @@ void knot_lmdb_deinit(knot_lmdb_db_t *db)
 {
 	knot_lmdb_close(db);
 	pthread_mutex_destroy(&db->opening_mutex);
+	pthread_mutex_destroy(&db->batch_mutex);
+	pthread_cond_destroy(&db->batch_cond);
 	free(db->path);
 }
 
@@ -290,6 +302,7 @@ void knot_lmdb_begin(knot_lmdb_db_t *db, knot_lmdb_txn_t *txn, bool rw)
 	err_to_knot(&txn->ret);
 	if (txn->ret == KNOT_EOK) {
 		txn->opened = true;
+		txn->committed = false;
 		txn->db = db;
 		txn->is_rw = rw;
 	}
@@ -331,6 +344,133 @@ void knot_lmdb_commit(knot_lmdb_txn_t *txn)
 	txn->ret = mdb_txn_commit(txn->txn);
 	err_to_knot(&txn->ret);
 	txn->opened = false;
+	txn->committed = (txn->ret == KNOT_EOK);
+}
+
+typedef struct knot_lmdb_batch_op {
+	knot_lmdb_batch_cb cb;
+	void *ctx;
+	int ret;
+	bool done;
+	struct knot_lmdb_batch_op *next;
+} knot_lmdb_batch_op_t;
+
+/*!
+ * Apply at most 'max' operations in one transaction, return the first one
+ * not processed.
+ */
+static knot_lmdb_batch_op_t *batch_commit(knot_lmdb_db_t *db, knot_lmdb_batch_op_t *ops,
+                                          size_t max)
+{
+	struct timespec begin = time_now();
+
+	knot_lmdb_txn_t txn = { 0 };
+	knot_lmdb_begin(db, &txn, true);
+	knot_lmdb_batch_op_t *op = ops, *last = ops;
+	size_t count = 0;
+	while (op != NULL && count < max && txn.ret == KNOT_EOK) {
+		op->cb(&txn, op->ctx);
+		last = op;
+		op = op->next;
+		count++;
+	}
+	knot_lmdb_commit(&txn);
+
+	if (txn.ret != KNOT_EOK && !txn.committed) {
+		if (count <= 1) {
+			ops->ret = txn.ret;
+			return ops->next;
+		}
+		// Isolate the failed operation from the rest of the batch.
+		for (knot_lmdb_batch_op_t *it = ops; it != op; ) {
+			it = batch_commit(db, it, 1);
+		}
+		return op;
+	}
+
+	// Committed, possibly by the last operation itself keeping its partial work.
+	for (knot_lmdb_batch_op_t *it = ops; it != last; it = it->next) {
+		it->ret = KNOT_EOK;
+	}
+	last->ret = txn.ret;
+
+	struct timespec end = time_now();
+	struct timespec diff = time_diff(&begin, &end);
+
+	pthread_mutex_lock(&db->batch_mutex);
+	knot_lmdb_batch_stats_t *stats = &db->batch_stats;
+	stats->commits++;
+	stats->operations += count;
+	stats->max_batch = MAX(stats->max_batch, count);
+	stats->commit_time += diff.tv_sec * 1000000 + diff.tv_nsec / 1000;
+	pthread_mutex_unlock(&db->batch_mutex);
+
+	return op;
+}
+
+static void batch_run(knot_lmdb_db_t *db, knot_lmdb_batch_op_t *ops)
+{
+	while (ops != NULL) {
+		ops = batch_commit(db, ops, SIZE_MAX);
+	}
+}
+
+int knot_lmdb_apply_batched(knot_lmdb_db_t *db, knot_lmdb_batch_cb cb, void *ctx)
+{
+	if (db == NULL || cb == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	knot_lmdb_batch_op_t op = { .cb = cb, .ctx = ctx };
+
+	pthread_mutex_lock(&db->batch_mutex);
+	*db->batch_tail = &op;
+	db->batch_tail = &op.next;
+
+	while (!op.done && db->batch_leader) {
+		pthread_cond_wait(&db->batch_cond, &db->batch_mutex);
+	}
+	if (op.done) { // Committed by another leader.
+		pthread_mutex_unlock(&db->batch_mutex);
+		return op.ret;
+	}
+
+	// Become the leader, let other operations join the batch meanwhile.
+	db->batch_leader = true;
+	if (db->batch_delay > 0) {
+		pthread_mutex_unlock(&db->batch_mutex);
+		struct timespec delay = {
+			.tv_sec = db->batch_delay / 1000,
+			.tv_nsec = (db->batch_delay % 1000) * 1000000
+		};
+		nanosleep(&delay, NULL);
+		pthread_mutex_lock(&db->batch_mutex);
+	}
+	knot_lmdb_batch_op_t *ops = db->batch_head;
+	db->batch_head = NULL;
+	db->batch_tail = &db->batch_head;
+	pthread_mutex_unlock(&db->batch_mutex);
+
+	batch_run(db, ops);
+
+	pthread_mutex_lock(&db->batch_mutex);
+	while (ops != NULL) {
+		knot_lmdb_batch_op_t *next = ops->next; // The follower may return once done.
+		ops->done = true;
+		ops = next;
+	}
+	db->batch_leader = false;
+	pthread_cond_broadcast(&db->batch_cond);
+	pthread_mutex_unlock(&db->batch_mutex);
+
+	return op.ret;
+}
+
+void knot_lmdb_batch_stats(knot_lmdb_db_t *db, knot_lmdb_batch_stats_t *stats)
+{
+	pthread_mutex_lock(&db->batch_mutex);
+	*stats = db->batch_stats;
+	pthread_mutex_unlock(&db->batch_mutex);
 }
 
 // save the programmer's frequent checking for ENOMEM when creating search keys
@@ -23,6 +23,16 @@
 #include <stdlib.h>
 #include <pthread.h>
 
+struct knot_lmdb_batch_op;
+
+/*! \brief Statistics of the group commit, see knot_lmdb_apply_batched(). */
+typedef struct {
+	uint64_t commits;     // Number of committed transactions.
+	uint64_t operations;  // Number of operations in the committed transactions.
+	uint64_t max_batch;   // Maximum number of operations in one transaction.
+	uint64_t commit_time; // Total time of the committed transactions in microseconds.
+} knot_lmdb_batch_stats_t;
+
 typedef struct knot_lmdb_db {
 	MDB_dbi dbi;
 	MDB_env *env;
@@ -31,6 +41,7 @@ typedef struct knot_lmdb_db {
 	// those are static options. Set them after knot_lmdb_init().
 	unsigned maxdbs;
 	unsigned maxreaders;
+	unsigned batch_delay; // Time (in milliseconds) to wait for more operations to group commit.
 
 	// those are internal options. Please don't touch them directly.
 	size_t mapsize;
@@ -38,6 +49,14 @@ typedef struct knot_lmdb_db {
 	uint64_t last_readlock_clean;
 	const char *dbname;
 	char *path;
+
+	// group commit state, see knot_lmdb_apply_batched()
+	pthread_mutex_t batch_mutex;
+	pthread_cond_t batch_cond;
+	struct knot_lmdb_batch_op *batch_head;
+	struct knot_lmdb_batch_op **batch_tail;
+	bool batch_leader;
+	knot_lmdb_batch_stats_t batch_stats;
 } knot_lmdb_db_t;
 
 typedef struct {
@@ -47,6 +66,7 @@ typedef struct {
 	MDB_val cur_val;
 
 	bool opened;
+	bool committed;
 	bool is_rw;
 	int ret;
 	knot_lmdb_db_t *db;
@@ -75,6 +95,17 @@ typedef bool (*sweep_cb)(const uint8_t *zone, void *data);
  */
 typedef bool (*knot_lmdb_copy_cb)(MDB_val *cur_key, MDB_val *cur_val);
 
+/*!
+ * \brief Callback performing one write operation in a RW transaction.
+ *
+ * The callback may be called again in a separate transaction, so it must not
+ * modify the context in a way that would change its result. On failure, it
+ * sets txn->ret and possibly aborts the transaction. If it commits the
+ * transaction itself to keep a partial work, the operations batched before it
+ * are committed as well.
+ */
+typedef void (*knot_lmdb_batch_cb)(knot_lmdb_txn_t *txn, void *ctx);
+
 /*!
  * \brief Initialise the DB handling structure.
  *
@@ -150,6 +181,27 @@ int knot_lmdb_reinit(knot_lmdb_db_t *db, const char *path, size_t mapsize, unsig
  */
 int knot_lmdb_reconfigure(knot_lmdb_db_t *db, const char *path, size_t mapsize, unsigned env_flags);
 
+/*!
+ * \brief Perform a write operation, committed together with concurrent ones.
+ *
+ * The first caller becomes a leader, which waits db->batch_delay milliseconds,
+ * then applies all pending operations in one RW transaction and commits it at
+ * once. If the shared transaction fails, each operation is retried in its own
+ * transaction so that a failure of one doesn't affect the others.
+ *
+ * \param db    The DB, already opened.
+ * \param cb    Callback performing the operation.
+ * \param ctx   Callback context.
+ *
+ * \return KNOT_E* result of the operation.
+ */
+int knot_lmdb_apply_batched(knot_lmdb_db_t *db, knot_lmdb_batch_cb cb, void *ctx);
+
+/*!
+ * \brief Get a snapshot of the group commit statistics.
+ */
+void knot_lmdb_batch_stats(knot_lmdb_db_t *db, knot_lmdb_batch_stats_t *stats);
+
 /*!
  * \brief Close and de-initialise DB.
  *
@@ -53,7 +53,7 @@ int dnsproxy_conf_check(knotd_conf_check_args_t *args)
 typedef struct {
 	knotd_conf_t remote;
 	knotd_conf_t via;
-	knotd_conf_t addr;
+	knotd_addr_set_t *addr;
 	bool fallback;
 	bool tfo;
 	bool catch_nxdomain;
@@ -122,7 +122,7 @@ static int fwd(dnsproxy_t *proxy, knot_pkt_t *pkt, knotd_qdata_t *qdata, int add
 		return KNOT_ENOMEM;
 	}
 
-	/* Forward request. */
+	/* Forward request, the worker waits for the response. */
 	ret = knot_requestor_exec(&re, req, proxy->timeout);
 
 	if (pkt->tsig_rr != NULL) {
@@ -149,9 +149,9 @@ static knotd_state_t dnsproxy_fwd(knotd_state_t state, knot_pkt_t *pkt,
 	}
 
 	/* Forward from specified addresses only if configured. */
-	if (proxy->addr.count > 0) {
+	if (proxy->addr != NULL) {
 		const struct sockaddr_storage *addr = knotd_qdata_remote_addr(qdata);
-		if (!knotd_conf_addr_range_match(&proxy->addr, addr)) {
+		if (!knotd_addr_set_match(proxy->addr, addr)) {
 			return state;
 		}
 	}
@@ -190,9 +190,15 @@ int dnsproxy_load(knotd_mod_t *mod)
 
 	proxy->via = knotd_conf(mod, C_RMT, C_VIA, &remote_id);
 
-	proxy->addr = knotd_conf_mod(mod, MOD_ADDRESS);
+	knotd_conf_t conf = knotd_conf_mod(mod, MOD_ADDRESS);
+	bool addr_failed = false;
+	if (conf.count > 0) {
+		proxy->addr = knotd_conf_addr_set(&conf);
+		addr_failed = (proxy->addr == NULL);
+	}
+	knotd_conf_free(&conf);
 
-	knotd_conf_t conf = knotd_conf_mod(mod, MOD_TIMEOUT);
+	conf = knotd_conf_mod(mod, MOD_TIMEOUT);
 	proxy->timeout = conf.single.integer;
 
 	conf = knotd_conf_mod(mod, MOD_FALLBACK);
@@ -204,6 +210,13 @@ int dnsproxy_load(knotd_mod_t *mod)
 	conf = knotd_conf_mod(mod, MOD_CATCH_NXDOMAIN);
 	proxy->catch_nxdomain = conf.single.boolean;
 
+	if (addr_failed) {
+		knotd_conf_free(&proxy->remote);
+		knotd_conf_free(&proxy->via);
+		free(proxy);
+		return KNOT_ENOMEM;
+	}
+
 	knotd_mod_ctx_set(mod, proxy);
 
 	if (proxy->fallback) {
@@ -219,7 +232,7 @@ void dnsproxy_unload(knotd_mod_t *mod)
 	if (ctx != NULL) {
 		knotd_conf_free(&ctx->remote);
 		knotd_conf_free(&ctx->via);
-		knotd_conf_free(&ctx->addr);
+		knotd_addr_set_free(ctx->addr);
 	}
 	free(ctx);
 }
@@ -17,6 +17,7 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 
+#include "contrib/atomic.h"
 #include "contrib/dnstap/dnstap.h"
 #include "contrib/dnstap/dnstap.pb-c.h"
 #include "contrib/dnstap/message.h"
@@ -30,6 +31,16 @@
 #define MOD_QUERIES		"\x0B""log-queries"
 #define MOD_RESPONSES		"\x0D""log-responses"
 #define MOD_WITH_QUERIES	"\x16""responses-with-queries"
+#define MOD_SAMPLE_RATE		"\x0B""sample-rate"
+
+/*! Frames per thread arena, the default fstrm input queue size. */
+#define FRAME_SLOTS		512
+/*! Arena slot size, larger frames are allocated separately. */
+#define FRAME_SLOT_SIZE		1024
+
+enum {
+	CTR_DROPPED,
+};
 
 const yp_item_t dnstap_conf[] = {
 	{ MOD_SINK,         YP_TSTR,  YP_VNONE },
@@ -38,6 +49,7 @@ const yp_item_t dnstap_conf[] = {
 	{ MOD_QUERIES,      YP_TBOOL, YP_VBOOL = { true } },
 	{ MOD_RESPONSES,    YP_TBOOL, YP_VBOOL = { true } },
 	{ MOD_WITH_QUERIES, YP_TBOOL, YP_VBOOL = { false } },
+	{ MOD_SAMPLE_RATE,  YP_TINT,  YP_VINT = { 1, UINT16_MAX, 1 } },
 	{ NULL }
 };
 
@@ -52,15 +64,105 @@ int dnstap_conf_check(knotd_conf_check_args_t *args)
 	return KNOT_EOK;
 }
 
+/*!
+ * Pre-allocated frames of one worker thread. The slots are taken by the thread
+ * in a round-robin fashion and released by the fstrm I/O thread.
+ */
+typedef struct {
+	uint8_t *slots;                      //!< Allocated on the first use.
+	unsigned next;                       //!< Next slot to be tried.
+	knot_atomic_bool used[FRAME_SLOTS];  //!< Slot submitted and not yet written.
+} frame_arena_t;
+
 typedef struct {
 	struct fstrm_iothr *iothread;
-	char *identity;
-	size_t identity_len;
-	char *version;
-	size_t version_len;
+	uint8_t *header;        //!< Pre-encoded identity and version fields.
+	size_t header_len;
+	frame_arena_t *arenas;  //!< Frame arena per thread.
+	unsigned threads;
 	bool with_queries;
+	uint16_t sample_rate;
 } dnstap_ctx_t;
 
+/*! \brief Encode a length-delimited protobuf field with a small field number. */
+static size_t put_bytes_field(uint8_t *out, unsigned field, const char *data, size_t len)
+{
+	size_t pos = 0;
+	out[pos++] = (field << 3) | 2;
+	for (size_t val = len; ; val >>= 7) {
+		if (val < 0x80) {
+			out[pos++] = val;
+			break;
+		}
+		out[pos++] = (val & 0x7f) | 0x80;
+	}
+	memcpy(out + pos, data, len);
+
+	return pos + len;
+}
+
+/*!
+ * \brief Pre-encode the identity and version fields.
+ *
+ * These are the first two fields of the Dnstap message, so that the rest of
+ * the message can be packed right after them.
+ */
+static int make_header(dnstap_ctx_t *ctx, const char *identity, const char *version)
+{
+	size_t identity_len = (identity != NULL) ? strlen(identity) : 0;
+	size_t version_len = (version != NULL) ? strlen(version) : 0;
+
+	// Tag and at most 10 bytes of length for each field.
+	ctx->header = malloc(identity_len + version_len + 2 * 11);
+	if (ctx->header == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	if (identity_len > 0) {
+		ctx->header_len += put_bytes_field(ctx->header + ctx->header_len,
+		                                   1, identity, identity_len);
+	}
+	if (version_len > 0) {
+		ctx->header_len += put_bytes_field(ctx->header + ctx->header_len,
+		                                   2, version, version_len);
+	}
+
+	return KNOT_EOK;
+}
+
+static void frame_free(void *buf, void *free_data)
+{
+	knot_atomic_bool *used = free_data;
+	if (used != NULL) {
+		ATOMIC_SET_RELEASE(*used, false);
+	} else {
+		free(buf);
+	}
+}
+
+/*! \brief Get a frame buffer from the thread arena, or allocate it if not available. */
+static uint8_t *frame_alloc(dnstap_ctx_t *ctx, unsigned thread_id, size_t size,
+                            knot_atomic_bool **used)
+{
+	*used = NULL;
+
+	frame_arena_t *arena = (thread_id < ctx->threads) ? &ctx->arenas[thread_id] : NULL;
+	if (arena != NULL && size <= FRAME_SLOT_SIZE) {
+		if (arena->slots == NULL) {
+			arena->slots = malloc(FRAME_SLOTS * FRAME_SLOT_SIZE);
+		}
+		unsigned slot = arena->next;
+		if (arena->slots != NULL && !ATOMIC_GET_ACQUIRE(arena->used[slot])) {
+			arena->next = (slot + 1) % FRAME_SLOTS;
+			ATOMIC_SET(arena->used[slot], true);
+			*used = &arena->used[slot];
+			return arena->slots + slot * FRAME_SLOT_SIZE;
+		}
+	}
+
+	return malloc(size);
+}
+
 static knotd_state_t log_message(knotd_state_t state, const knot_pkt_t *pkt,
                                  knotd_qdata_t *qdata, knotd_mod_t *mod)
 {
@@ -73,6 +175,12 @@ static knotd_state_t log_message(knotd_state_t state, const knot_pkt_t *pkt,
 
 	dnstap_ctx_t *ctx = knotd_mod_ctx(mod);
 
+	/* Sample by the message ID so that a query and its response match. */
+	if (ctx->sample_rate > 1 && pkt->size >= KNOT_WIRE_HEADER_SIZE &&
+	    knot_wire_get_id(pkt->wire) % ctx->sample_rate != 0) {
+		return state;
+	}
+
 	struct fstrm_iothr_queue *ioq =
 		fstrm_iothr_get_input_queue_idx(ctx->iothread, qdata->params->thread_id);
 
@@ -97,22 +205,11 @@ static knotd_state_t log_message(knotd_state_t state, const knot_pkt_t *pkt,
 		return state;
 	}
 
+	/* Identity and version are pre-encoded in the frame header. */
 	Dnstap__Dnstap dnstap = DNSTAP__DNSTAP__INIT;
 	dnstap.type = DNSTAP__DNSTAP__TYPE__MESSAGE;
 	dnstap.message = &msg;
 
-	/* Set message version and identity. */
-	if (ctx->identity_len > 0) {
-		dnstap.identity.data = (uint8_t *)ctx->identity;
-		dnstap.identity.len = ctx->identity_len;
-		dnstap.has_identity = 1;
-	}
-	if (ctx->version_len > 0) {
-		dnstap.version.data = (uint8_t *)ctx->version;
-		dnstap.version.len = ctx->version_len;
-		dnstap.has_version = 1;
-	}
-
 	/* Also add query message if 'responses-with-queries' is enabled and this is a response. */
 	if (ctx->with_queries &&
 	    msgtype == DNSTAP__MESSAGE__TYPE__AUTH_RESPONSE &&
@@ -123,19 +220,23 @@ static knotd_state_t log_message(knotd_state_t state, const knot_pkt_t *pkt,
 		msg.has_query_message = 1;
 	}
 
-	/* Pack the message. */
-	uint8_t *frame = NULL;
-	size_t size = 0;
-	dt_pack(&dnstap, &frame, &size);
+	/* Pack the message after the header. */
+	size_t size = ctx->header_len + dnstap__dnstap__get_packed_size(&dnstap);
+	knot_atomic_bool *used = NULL;
+	uint8_t *frame = frame_alloc(ctx, qdata->params->thread_id, size, &used);
 	if (frame == NULL) {
+		knotd_mod_stats_incr(mod, qdata->params->thread_id, CTR_DROPPED, 0, 1);
 		return state;
 	}
+	memcpy(frame, ctx->header, ctx->header_len);
+	(void)dnstap__dnstap__pack(&dnstap, frame + ctx->header_len);
 
 	/* Submit a request. */
 	fstrm_res res = fstrm_iothr_submit(ctx->iothread, ioq, frame, size,
-	                                   fstrm_free_wrapper, NULL);
+	                                   frame_free, used);
 	if (res != fstrm_res_success) {
-		free(frame);
+		knotd_mod_stats_incr(mod, qdata->params->thread_id, CTR_DROPPED, 0, 1);
+		frame_free(frame, used);
 		return state;
 	}
 
@@ -288,30 +389,44 @@ int dnstap_load(knotd_mod_t *mod)
 
 	/* Set identity. */
 	knotd_conf_t conf = knotd_conf_mod(mod, MOD_IDENTITY);
-	if (conf.count == 1) {
-		ctx->identity = (conf.single.string != NULL) ?
-		                strdup(conf.single.string) : NULL;
-	} else {
+	const char *identity = conf.single.string;
+	if (conf.count == 0) {
 		knotd_conf_t host = knotd_conf_env(mod, KNOTD_CONF_ENV_HOSTNAME);
-		ctx->identity = strdup(host.single.string);
+		identity = host.single.string;
 	}
-	ctx->identity_len = (ctx->identity != NULL) ? strlen(ctx->identity) : 0;
 
 	/* Set version. */
 	conf = knotd_conf_mod(mod, MOD_VERSION);
-	if (conf.count == 1) {
-		ctx->version = (conf.single.string != NULL) ?
-		               strdup(conf.single.string) : NULL;
-	} else {
-		knotd_conf_t version = knotd_conf_env(mod, KNOTD_CONF_ENV_VERSION);
-		ctx->version = strdup(version.single.string);
+	const char *version = conf.single.string;
+	if (conf.count == 0) {
+		knotd_conf_t env = knotd_conf_env(mod, KNOTD_CONF_ENV_VERSION);
+		version = env.single.string;
+	}
+
+	/* Pre-encode them. */
+	int ret = make_header(ctx, identity, version);
+	if (ret != KNOT_EOK) {
+		free(ctx);
+		return ret;
+	}
+
+	/* Allocate frame arenas. */
+	ctx->threads = knotd_mod_threads(mod);
+	ctx->arenas = calloc(ctx->threads, sizeof(*ctx->arenas));
+	if (ctx->arenas == NULL) {
+		free(ctx->header);
+		free(ctx);
+		return KNOT_ENOMEM;
 	}
-	ctx->version_len = (ctx->version != NULL) ? strlen(ctx->version) : 0;
 
 	/* Set responses-with-queries. */
 	conf = knotd_conf_mod(mod, MOD_WITH_QUERIES);
 	ctx->with_queries = conf.single.boolean;
 
+	/* Set sample-rate. */
+	conf = knotd_conf_mod(mod, MOD_SAMPLE_RATE);
+	ctx->sample_rate = conf.single.integer;
+
 	/* Set sink. */
 	conf = knotd_conf_mod(mod, MOD_SINK);
 	const char *sink = conf.single.string;
@@ -347,6 +462,15 @@ int dnstap_load(knotd_mod_t *mod)
 		goto fail;
 	}
 
+	ret = knotd_mod_stats_add(mod, "dropped", 1, NULL);
+	if (ret != KNOT_EOK) {
+		fstrm_iothr_destroy(&ctx->iothread);
+		free(ctx->arenas);
+		free(ctx->header);
+		free(ctx);
+		return ret;
+	}
+
 	knotd_mod_ctx_set(mod, ctx);
 
 	/* Hook to the query plan. */
@@ -361,8 +485,8 @@ int dnstap_load(knotd_mod_t *mod)
 fail:
 	knotd_mod_log(mod, LOG_ERR, "failed to initialize sink '%s'", sink);
 
-	free(ctx->identity);
-	free(ctx->version);
+	free(ctx->arenas);
+	free(ctx->header);
 	free(ctx);
 
 	return KNOT_EINVAL;
@@ -372,9 +496,13 @@ void dnstap_unload(knotd_mod_t *mod)
 {
 	dnstap_ctx_t *ctx = knotd_mod_ctx(mod);
 
+	/* Pending frames are written and released by the I/O thread first. */
 	fstrm_iothr_destroy(&ctx->iothread);
-	free(ctx->identity);
-	free(ctx->version);
+	for (unsigned i = 0; i < ctx->threads; i++) {
+		free(ctx->arenas[i].slots);
+	}
+	free(ctx->arenas);
+	free(ctx->header);
 	free(ctx);
 }
 
@@ -1057,5 +1057,5 @@ void geoip_unload(knotd_mod_t *mod)
 	}
 }
 
-KNOTD_MOD_API(geoip, KNOTD_MOD_FLAG_SCOPE_ZONE,
+KNOTD_MOD_API(geoip, KNOTD_MOD_FLAG_SCOPE_ZONE | KNOTD_MOD_FLAG_NO_ANSWER_CACHE,
               geoip_load, geoip_unload, geoip_conf, geoip_conf_check);
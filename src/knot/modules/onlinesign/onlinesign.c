@@ -15,6 +15,7 @@
  */
 
 #include <assert.h>
+#include <limits.h>
 #include <stddef.h>
 #include <string.h>
 
@@ -22,6 +23,7 @@
 #include "libdnssec/error.h"
 #include "knot/include/module.h"
 #include "knot/modules/onlinesign/nsec_next.h"
+#include "knot/modules/onlinesign/rrsig_cache.h"
 // Next dependencies force static module!
 #include "knot/dnssec/ds_query.h"
 #include "knot/dnssec/key-events.h"
@@ -34,6 +36,12 @@
 
 #define MOD_POLICY	"\x06""policy"
 #define MOD_NSEC_BITMAP	"\x0B""nsec-bitmap"
+#define MOD_CACHE_SIZE	"\x0A""cache-size"
+
+enum {
+	CTR_CACHE_HIT,
+	CTR_CACHE_MISS,
+};
 
 int policy_check(knotd_conf_check_args_t *args)
 {
@@ -60,6 +68,7 @@ int bitmap_check(knotd_conf_check_args_t *args)
 const yp_item_t online_sign_conf[] = {
 	{ MOD_POLICY,      YP_TREF, YP_VREF = { C_POLICY }, YP_FNONE, { policy_check } },
 	{ MOD_NSEC_BITMAP, YP_TSTR, YP_VNONE, YP_FMULTI, { bitmap_check } },
+	{ MOD_CACHE_SIZE,  YP_TINT, YP_VINT = { 0, SSIZE_MAX, 10 * 1024 * 1024, YP_SSIZE } },
 	{ NULL }
 };
 
@@ -87,6 +96,9 @@ typedef struct {
 
 	uint16_t *nsec_force_types;
 
+	rrsig_cache_t *rrsig_cache;
+	uint32_t keyset_gen;
+
 	bool zone_doomed;
 } online_sign_ctx_t;
 
@@ -230,37 +242,81 @@ static knot_rrset_t *synth_nsec(knot_pkt_t *pkt, knotd_qdata_t *qdata, knotd_mod
 	return nsec;
 }
 
+static knot_time_t rrsigs_valid_until(const knot_rdataset_t *rrsigs,
+                                      const kdnssec_ctx_t *dnssec)
+{
+	knot_time_t expire = UINT64_MAX;
+	knot_rdata_t *rr = rrsigs->rdata;
+	for (int i = 0; i < rrsigs->count; i++) {
+		expire = MIN(expire, knot_rrsig_sig_expiration(rr));
+		rr = knot_rdataset_next(rr);
+	}
+
+	return expire - MIN(expire, dnssec->policy->rrsig_refresh_before);
+}
+
 static knot_rrset_t *sign_rrset(const knot_dname_t *owner,
                                 const knot_rrset_t *cover,
                                 knotd_mod_t *mod,
                                 zone_sign_ctx_t *sign_ctx,
+                                unsigned thread_id,
                                 knot_mm_t *mm)
 {
+	online_sign_ctx_t *ctx = knotd_mod_ctx(mod);
+
+	// resulting RRSIG
+
+	knot_rrset_t *rrsig = knot_rrset_new(owner, KNOT_RRTYPE_RRSIG, cover->rclass,
+	                                     cover->ttl, mm);
+	if (!rrsig) {
+		return NULL;
+	}
+
+	// try cached signatures first
+
+	knot_rrset_t covered;
+	knot_rrset_init(&covered, (knot_dname_t *)owner, cover->type, cover->rclass,
+	                cover->ttl);
+	covered.rrs = cover->rrs;
+
+	pthread_rwlock_rdlock(&ctx->signing_mutex);
+	const knot_rdataset_t *cached = rrsig_cache_get(ctx->rrsig_cache, thread_id,
+	                                                &covered, ctx->keyset_gen,
+	                                                knot_time());
+	if (cached != NULL) {
+		int ret = knot_rdataset_copy(&rrsig->rrs, cached, mm);
+		pthread_rwlock_unlock(&ctx->signing_mutex);
+		if (ret != KNOT_EOK) {
+			knot_rrset_free(rrsig, mm);
+			return NULL;
+		}
+		knotd_mod_stats_incr(mod, thread_id, CTR_CACHE_HIT, 0, 1);
+		return rrsig;
+	}
+	pthread_rwlock_unlock(&ctx->signing_mutex);
+
 	// copy of RR set with replaced owner name
 
 	knot_rrset_t *copy = knot_rrset_new(owner, cover->type, cover->rclass,
 	                                    cover->ttl, NULL);
 	if (!copy) {
+		knot_rrset_free(rrsig, mm);
 		return NULL;
 	}
 
 	if (knot_rdataset_copy(&copy->rrs, &cover->rrs, NULL) != KNOT_EOK) {
 		knot_rrset_free(copy, NULL);
+		knot_rrset_free(rrsig, mm);
 		return NULL;
 	}
 
-	// resulting RRSIG
-
-	knot_rrset_t *rrsig = knot_rrset_new(owner, KNOT_RRTYPE_RRSIG, copy->rclass,
-	                                     copy->ttl, mm);
-	if (!rrsig) {
-		knot_rrset_free(copy, NULL);
-		return NULL;
-	}
-
-	online_sign_ctx_t *ctx = knotd_mod_ctx(mod);
 	pthread_rwlock_rdlock(&ctx->signing_mutex);
 	int ret = knot_sign_rrset2(rrsig, copy, sign_ctx, mm);
+	if (ret == KNOT_EOK && ctx->rrsig_cache != NULL) {
+		rrsig_cache_put(ctx->rrsig_cache, thread_id, copy, ctx->keyset_gen,
+		                &rrsig->rrs, rrsigs_valid_until(&rrsig->rrs, mod->dnssec));
+		knotd_mod_stats_incr(mod, thread_id, CTR_CACHE_MISS, 0, 1);
+	}
 	pthread_rwlock_unlock(&ctx->signing_mutex);
 	if (ret != KNOT_EOK) {
 		knot_rrset_free(copy, NULL);
@@ -331,7 +387,8 @@ static knotd_in_state_t sign_section(knotd_in_state_t state, knot_pkt_t *pkt,
 		knot_dname_unpack(owner, pkt->wire + rr_pos, sizeof(owner), pkt->wire);
 		knot_dname_to_lower(owner);
 
-		knot_rrset_t *rrsig = sign_rrset(owner, rr, mod, sign_ctx, &pkt->mm);
+		knot_rrset_t *rrsig = sign_rrset(owner, rr, mod, sign_ctx,
+		                                 qdata->params->thread_id, &pkt->mm);
 		if (!rrsig) {
 			state = KNOTD_IN_STATE_ERROR;
 			break;
@@ -515,6 +572,7 @@ static knotd_in_state_t pre_routine(knotd_in_state_t state, knot_pkt_t *pkt,
 		pthread_rwlock_wrlock(&ctx->signing_mutex);
 		knotd_mod_dnssec_unload_keyset(mod);
 		ret = knotd_mod_dnssec_load_keyset(mod, true);
+		ctx->keyset_gen++; // Invalidates the cached signatures.
 		if (ret != KNOT_EOK) {
 			ctx->zone_doomed = true;
 			state = KNOTD_IN_STATE_ERROR;
@@ -605,6 +663,7 @@ static void online_sign_ctx_free(online_sign_ctx_t *ctx)
 	pthread_mutex_destroy(&ctx->event_mutex);
 	pthread_rwlock_destroy(&ctx->signing_mutex);
 
+	rrsig_cache_free(ctx->rrsig_cache);
 	free(ctx->nsec_force_types);
 	free(ctx);
 }
@@ -712,6 +771,27 @@ int online_sign_load(knotd_mod_t *mod)
 		return ret;
 	}
 
+	conf = knotd_conf_mod(mod, MOD_CACHE_SIZE);
+	if (conf.single.integer > 0) {
+		ctx->rrsig_cache = rrsig_cache_new(conf.single.integer,
+		                                   knotd_mod_threads(mod));
+		if (ctx->rrsig_cache == NULL) {
+			online_sign_ctx_free(ctx);
+			return KNOT_ENOMEM;
+		}
+
+		ret = knotd_mod_stats_add(mod, "cache-hit", 1, NULL);
+		if (ret != KNOT_EOK) {
+			online_sign_ctx_free(ctx);
+			return ret;
+		}
+		ret = knotd_mod_stats_add(mod, "cache-miss", 1, NULL);
+		if (ret != KNOT_EOK) {
+			online_sign_ctx_free(ctx);
+			return ret;
+		}
+	}
+
 	knotd_mod_ctx_set(mod, ctx);
 
 	knotd_mod_in_hook(mod, KNOTD_STAGE_ANSWER, pre_routine);
@@ -732,5 +812,6 @@ void online_sign_unload(knotd_mod_t *mod)
 	online_sign_ctx_free(knotd_mod_ctx(mod));
 }
 
-KNOTD_MOD_API(onlinesign, KNOTD_MOD_FLAG_SCOPE_ZONE | KNOTD_MOD_FLAG_OPT_CONF,
+KNOTD_MOD_API(onlinesign, KNOTD_MOD_FLAG_SCOPE_ZONE | KNOTD_MOD_FLAG_OPT_CONF |
+                          KNOTD_MOD_FLAG_NO_ANSWER_CACHE,
               online_sign_load, online_sign_unload, online_sign_conf, NULL);
@@ -0,0 +1,228 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "knot/modules/onlinesign/rrsig_cache.h"
+#include "libdnssec/random.h"
+#include "contrib/openbsd/siphash.h"
+
+#define ENTRY_SIZE_ESTIMATE 512 /*!< Average entry size to derive the table size from. */
+
+typedef struct {
+	uint64_t hash;
+	uint32_t generation;
+	knot_time_t valid_until;
+	size_t size;                /*!< Total allocated size. */
+	uint16_t type;
+	uint32_t ttl;
+	knot_rdataset_t covered;    /*!< Covered records, data in the 'data' array. */
+	knot_rdataset_t rrsigs;     /*!< RRSIG records, data in the 'data' array. */
+	knot_dname_t *owner;        /*!< Owner, in the 'data' array. */
+	uint8_t data[];             /*!< Covered rdata, RRSIG rdata, owner. */
+} cache_entry_t;
+
+typedef struct {
+	cache_entry_t **slots;
+	size_t mask;
+	size_t size;                /*!< Total size of the stored entries. */
+	size_t max_size;
+} cache_shard_t;
+
+struct rrsig_cache {
+	SIPHASH_KEY key;
+	unsigned count;
+	cache_shard_t *shards[];
+};
+
+static size_t pow2_floor(size_t x)
+{
+	size_t res = 1;
+	while (res <= x / 2) {
+		res *= 2;
+	}
+	return res;
+}
+
+rrsig_cache_t *rrsig_cache_new(size_t max_size, unsigned shards)
+{
+	if (max_size == 0 || shards == 0) {
+		return NULL;
+	}
+
+	rrsig_cache_t *cache = calloc(1, sizeof(*cache) + shards * sizeof(cache_shard_t *));
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->count = shards;
+	(void)dnssec_random_buffer((uint8_t *)&cache->key, sizeof(cache->key));
+
+	size_t shard_size = max_size / shards;
+	size_t slots = pow2_floor(shard_size / ENTRY_SIZE_ESTIMATE);
+
+	for (unsigned i = 0; i < shards; i++) {
+		// Shards are allocated separately to avoid false sharing.
+		cache_shard_t *shard = calloc(1, sizeof(*shard));
+		if (shard == NULL) {
+			rrsig_cache_free(cache);
+			return NULL;
+		}
+		cache->shards[i] = shard;
+
+		shard->slots = calloc(slots, sizeof(*shard->slots));
+		if (shard->slots == NULL) {
+			rrsig_cache_free(cache);
+			return NULL;
+		}
+		shard->mask = slots - 1;
+		shard->max_size = shard_size;
+	}
+
+	return cache;
+}
+
+static void shard_drop(cache_shard_t *shard, size_t idx)
+{
+	cache_entry_t *entry = shard->slots[idx];
+	if (entry != NULL) {
+		shard->size -= entry->size;
+		free(entry);
+		shard->slots[idx] = NULL;
+	}
+}
+
+void rrsig_cache_free(rrsig_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (unsigned i = 0; i < cache->count; i++) {
+		cache_shard_t *shard = cache->shards[i];
+		if (shard == NULL) {
+			continue;
+		}
+		for (size_t j = 0; shard->slots != NULL && j <= shard->mask; j++) {
+			shard_drop(shard, j);
+		}
+		free(shard->slots);
+		free(shard);
+	}
+
+	free(cache);
+}
+
+static uint64_t covered_hash(rrsig_cache_t *cache, const knot_rrset_t *covered)
+{
+	SIPHASH_CTX ctx;
+	SipHash24_Init(&ctx, &cache->key);
+	SipHash24_Update(&ctx, covered->owner, knot_dname_size(covered->owner));
+	SipHash24_Update(&ctx, &covered->type, sizeof(covered->type));
+	SipHash24_Update(&ctx, &covered->ttl, sizeof(covered->ttl));
+	SipHash24_Update(&ctx, covered->rrs.rdata, covered->rrs.size);
+	return SipHash24_End(&ctx);
+}
+
+static bool entry_match(const cache_entry_t *entry, uint64_t hash,
+                        const knot_rrset_t *covered)
+{
+	return entry->hash == hash &&
+	       entry->type == covered->type &&
+	       entry->ttl == covered->ttl &&
+	       knot_dname_is_equal(entry->owner, covered->owner) &&
+	       knot_rdataset_eq(&entry->covered, &covered->rrs);
+}
+
+static cache_shard_t *get_shard(rrsig_cache_t *cache, unsigned shard)
+{
+	return (cache != NULL && shard < cache->count) ? cache->shards[shard] : NULL;
+}
+
+const knot_rdataset_t *rrsig_cache_get(rrsig_cache_t *cache, unsigned shard,
+                                       const knot_rrset_t *covered,
+                                       uint32_t generation, knot_time_t now)
+{
+	cache_shard_t *s = get_shard(cache, shard);
+	if (s == NULL || covered == NULL) {
+		return NULL;
+	}
+
+	uint64_t hash = covered_hash(cache, covered);
+	size_t idx = hash & s->mask;
+	cache_entry_t *entry = s->slots[idx];
+	if (entry == NULL || !entry_match(entry, hash, covered)) {
+		return NULL;
+	}
+
+	if (entry->generation != generation || knot_time_geq(now, entry->valid_until)) {
+		shard_drop(s, idx);
+		return NULL;
+	}
+
+	return &entry->rrsigs;
+}
+
+void rrsig_cache_put(rrsig_cache_t *cache, unsigned shard,
+                     const knot_rrset_t *covered, uint32_t generation,
+                     const knot_rdataset_t *rrsigs, knot_time_t valid_until)
+{
+	cache_shard_t *s = get_shard(cache, shard);
+	if (s == NULL || covered == NULL || rrsigs == NULL || rrsigs->count == 0) {
+		return;
+	}
+
+	uint64_t hash = covered_hash(cache, covered);
+	size_t idx = hash & s->mask;
+	shard_drop(s, idx);
+
+	size_t owner_size = knot_dname_size(covered->owner);
+	size_t size = sizeof(cache_entry_t) + owner_size + covered->rrs.size + rrsigs->size;
+	if (s->size + size > s->max_size) {
+		return;
+	}
+
+	cache_entry_t *entry = malloc(size);
+	if (entry == NULL) {
+		return;
+	}
+
+	entry->hash = hash;
+	entry->generation = generation;
+	entry->valid_until = valid_until;
+	entry->size = size;
+	entry->type = covered->type;
+	entry->ttl = covered->ttl;
+
+	// Rdata first as it must be aligned.
+	uint8_t *pos = entry->data;
+	entry->covered = covered->rrs;
+	entry->covered.rdata = (knot_rdata_t *)pos;
+	memcpy(pos, covered->rrs.rdata, covered->rrs.size);
+	pos += covered->rrs.size;
+
+	entry->rrsigs = *rrsigs;
+	entry->rrsigs.rdata = (knot_rdata_t *)pos;
+	memcpy(pos, rrsigs->rdata, rrsigs->size);
+	pos += rrsigs->size;
+
+	entry->owner = pos;
+	memcpy(pos, covered->owner, owner_size);
+
+	s->slots[idx] = entry;
+	s->size += size;
+}
@@ -0,0 +1,73 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "contrib/time.h"
+#include "libknot/rrset.h"
+
+/*!
+ * \brief Cache of generated RRSIGs.
+ *
+ * The cache is split into per-thread shards, so no locking is needed
+ * as long as each shard is accessed only by its own thread. Each shard
+ * is a direct-mapped hash table, a colliding entry replaces the old one.
+ */
+typedef struct rrsig_cache rrsig_cache_t;
+
+/*!
+ * \brief Create a new RRSIG cache.
+ *
+ * \param max_size  Memory limit for all the cached entries.
+ * \param shards    Number of shards (threads).
+ *
+ * \return New cache, NULL if error or zero max_size.
+ */
+rrsig_cache_t *rrsig_cache_new(size_t max_size, unsigned shards);
+
+/*!
+ * \brief Free the cache.
+ */
+void rrsig_cache_free(rrsig_cache_t *cache);
+
+/*!
+ * \brief Find cached RRSIGs covering given RRSet.
+ *
+ * \param cache       Cache.
+ * \param shard       Shard (thread) index.
+ * \param covered     Covered RRSet with the canonical owner.
+ * \param generation  Current generation of the signing keys.
+ * \param now         Current time.
+ *
+ * \return Cached RRSIG records or NULL if not found or not valid anymore.
+ */
+const knot_rdataset_t *rrsig_cache_get(rrsig_cache_t *cache, unsigned shard,
+                                       const knot_rrset_t *covered,
+                                       uint32_t generation, knot_time_t now);
+
+/*!
+ * \brief Store RRSIGs covering given RRSet.
+ *
+ * \param cache        Cache.
+ * \param shard        Shard (thread) index.
+ * \param covered      Covered RRSet with the canonical owner.
+ * \param generation   Current generation of the signing keys.
+ * \param rrsigs       RRSIG records to be stored.
+ * \param valid_until  Time until the records can be served from the cache.
+ */
+void rrsig_cache_put(rrsig_cache_t *cache, unsigned shard,
+                     const knot_rrset_t *covered, uint32_t generation,
+                     const knot_rdataset_t *rrsigs, knot_time_t valid_until);
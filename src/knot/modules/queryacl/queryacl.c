@@ -27,8 +27,8 @@ const yp_item_t queryacl_conf[] = {
 };
 
 typedef struct {
-	knotd_conf_t allow_addr;
-	knotd_conf_t allow_iface;
+	knotd_addr_set_t *allow_addr;
+	knotd_addr_set_t *allow_iface;
 } queryacl_ctx_t;
 
 static knotd_state_t queryacl_process(knotd_state_t state, knot_pkt_t *pkt,
@@ -43,17 +43,17 @@ static knotd_state_t queryacl_process(knotd_state_t state, knot_pkt_t *pkt,
 		return state;
 	}
 
-	if (ctx->allow_addr.count > 0) {
+	if (ctx->allow_addr != NULL) {
 		const struct sockaddr_storage *addr = knotd_qdata_remote_addr(qdata);
-		if (!knotd_conf_addr_range_match(&ctx->allow_addr, addr)) {
+		if (!knotd_addr_set_match(ctx->allow_addr, addr)) {
 			qdata->rcode = KNOT_RCODE_NOTAUTH;
 			return KNOTD_STATE_FAIL;
 		}
 	}
 
-	if (ctx->allow_iface.count > 0) {
+	if (ctx->allow_iface != NULL) {
 		const struct sockaddr_storage *addr = knotd_qdata_local_addr(qdata);
-		if (!knotd_conf_addr_range_match(&ctx->allow_iface, addr)) {
+		if (!knotd_addr_set_match(ctx->allow_iface, addr)) {
 			qdata->rcode = KNOT_RCODE_NOTAUTH;
 			return KNOTD_STATE_FAIL;
 		}
@@ -62,6 +62,32 @@ static knotd_state_t queryacl_process(knotd_state_t state, knot_pkt_t *pkt,
 	return state;
 }
 
+static int addr_set_load(knotd_mod_t *mod, const yp_name_t *item_name,
+                         knotd_addr_set_t **set)
+{
+	int ret = KNOT_EOK;
+
+	knotd_conf_t conf = knotd_conf_mod(mod, item_name);
+	if (conf.count > 0) {
+		*set = knotd_conf_addr_set(&conf);
+		if (*set == NULL) {
+			ret = KNOT_ENOMEM;
+		}
+	}
+	knotd_conf_free(&conf);
+
+	return ret;
+}
+
+static void ctx_free(queryacl_ctx_t *ctx)
+{
+	if (ctx != NULL) {
+		knotd_addr_set_free(ctx->allow_addr);
+		knotd_addr_set_free(ctx->allow_iface);
+	}
+	free(ctx);
+}
+
 int queryacl_load(knotd_mod_t *mod)
 {
 	// Create module context.
@@ -70,8 +96,14 @@ int queryacl_load(knotd_mod_t *mod)
 		return KNOT_ENOMEM;
 	}
 
-	ctx->allow_addr = knotd_conf_mod(mod, MOD_ADDRESS);
-	ctx->allow_iface = knotd_conf_mod(mod, MOD_INTERFACE);
+	int ret = addr_set_load(mod, MOD_ADDRESS, &ctx->allow_addr);
+	if (ret == KNOT_EOK) {
+		ret = addr_set_load(mod, MOD_INTERFACE, &ctx->allow_iface);
+	}
+	if (ret != KNOT_EOK) {
+		ctx_free(ctx);
+		return ret;
+	}
 
 	knotd_mod_ctx_set(mod, ctx);
 
@@ -80,12 +112,7 @@ int queryacl_load(knotd_mod_t *mod)
 
 void queryacl_unload(knotd_mod_t *mod)
 {
-	queryacl_ctx_t *ctx = knotd_mod_ctx(mod);
-	if (ctx != NULL) {
-		knotd_conf_free(&ctx->allow_addr);
-		knotd_conf_free(&ctx->allow_iface);
-	}
-	free(ctx);
+	ctx_free(knotd_mod_ctx(mod));
 }
 
 KNOTD_MOD_API(queryacl, KNOTD_MOD_FLAG_SCOPE_ANY,
@@ -195,6 +195,32 @@ int rrl_query(rrl_table_t *rrl, const struct sockaddr_storage *remote, knotd_mod
 	return KNOT_ELIMIT;
 }
 
+void rrl_prefetch(rrl_table_t *rrl, const struct sockaddr_storage *const *remotes,
+                  size_t count)
+{
+	assert(rrl);
+	assert(remotes || count == 0);
+
+	for (size_t i = 0; i < count; i++) {
+		const struct sockaddr_storage *remote = remotes[i];
+
+		_Alignas(16) uint8_t key[16] = { 0 };
+		if (remote->ss_family == AF_INET6) {
+			struct sockaddr_in6 *ipv6 = (struct sockaddr_in6 *)remote;
+			memcpy(key, &ipv6->sin6_addr, 16);
+
+			KRU.prefetch_multi_prefix((struct kru *)rrl->kru, 1, key,
+			                          RRL_V6_PREFIXES, RRL_V6_PREFIXES_CNT);
+		} else {
+			struct sockaddr_in *ipv4 = (struct sockaddr_in *)remote;
+			memcpy(key, &ipv4->sin_addr, 4);
+
+			KRU.prefetch_multi_prefix((struct kru *)rrl->kru, 0, key,
+			                          RRL_V4_PREFIXES, RRL_V4_PREFIXES_CNT);
+		}
+	}
+}
+
 void rrl_update(rrl_table_t *rrl, const struct sockaddr_storage *remote, size_t value)
 {
 	assert(rrl);
@@ -51,6 +51,19 @@ rrl_table_t *rrl_create(size_t size, uint32_t instant_limit, uint32_t rate_limit
  */
 int rrl_query(rrl_table_t *rrl, const struct sockaddr_storage *remote, knotd_mod_t *mod);
 
+/*!
+ * \brief Prefetch the RRL table buckets of several sources.
+ *
+ * The table isn't modified, subsequent rrl_query() calls for the sources
+ * don't have to wait for the memory.
+ *
+ * \param rrl RRL table.
+ * \param remotes Source addresses.
+ * \param count Number of source addresses.
+ */
+void rrl_prefetch(rrl_table_t *rrl, const struct sockaddr_storage *const *remotes,
+                  size_t count);
+
 /*!
  * \brief Update the RRL table.
  *
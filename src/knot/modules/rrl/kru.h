@@ -82,6 +82,13 @@ struct kru_api {
 	/// The key of i-th query consists of prefixes[i] bits of key, prefixes[i], and namespace.
 	uint16_t (*load_multi_prefix_max)(struct kru *kru, uint32_t time_now,
 			uint8_t namespace, uint8_t key[static 16], uint8_t *prefixes, kru_price_t *prices, size_t queries_cnt, uint8_t *prefix_out);
+
+	/// Only prefetch the cache-lines of multiple queries based on different prefixes of a single key.
+	/// KRU isn't updated; a subsequent call of limited_multi_prefix_or or load_multi_prefix_max
+	/// with the same key, prefixes, and namespace then doesn't wait for the memory.
+	/// Prefetching keys of many sources in advance hides the memory latency of the whole batch.
+	void (*prefetch_multi_prefix)(struct kru *kru,
+			uint8_t namespace, uint8_t key[static 16], uint8_t *prefixes, size_t queries_cnt);
 };
 
 // The functions are stored this way to make it easier to switch
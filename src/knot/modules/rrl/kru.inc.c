@@ -598,6 +598,16 @@ static uint16_t kru_load_multi_prefix_max(struct kru *kru, uint32_t time_now, ui
 	return max_load;
 }
 
+static void kru_prefetch_multi_prefix(struct kru *kru, uint8_t namespace,
+                                      uint8_t key[static 16], uint8_t *prefixes, size_t queries_cnt)
+{
+	struct query_ctx ctx;
+
+	for (size_t i = 0; i < queries_cnt; i++) {
+		kru_limited_prefetch_prefix(kru, 0, namespace, key, prefixes[i], 0, &ctx);
+	}
+}
+
 /// Update limiting and return true iff it hit the limit instead.
 static bool kru_limited(struct kru *kru, uint32_t time_now, uint8_t key[static 16], kru_price_t price)
 {
@@ -612,4 +622,5 @@ static bool kru_limited(struct kru *kru, uint32_t time_now, uint8_t key[static 1
 	.limited_multi_or_nobreak = kru_limited_multi_or_nobreak, \
 	.limited_multi_prefix_or = kru_limited_multi_prefix_or, \
 	.load_multi_prefix_max = kru_load_multi_prefix_max, \
+	.prefetch_multi_prefix = kru_prefetch_multi_prefix, \
 }
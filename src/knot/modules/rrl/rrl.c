@@ -74,7 +74,7 @@ typedef struct {
 	thrd_ctx_t *thrd_ctx;
 	int slip;
 	bool dry_run;
-	knotd_conf_t whitelist;
+	knotd_addr_set_t *whitelist;
 } rrl_ctx_t;
 
 static uint32_t time_diff_us(const struct timespec *begin, const struct timespec *end)
@@ -93,7 +93,7 @@ static knotd_proto_state_t protolimit_start(knotd_proto_state_t state,
 
 	// Check if a whitelisted client.
 	thrd->whitelist_checked = true;
-	if (knotd_conf_addr_range_match(&ctx->whitelist, params->remote)) {
+	if (knotd_addr_set_match(ctx->whitelist, params->remote)) {
 		thrd->skip = true;
 		return state;
 	}
@@ -136,6 +136,15 @@ static knotd_proto_state_t protolimit_end(knotd_proto_state_t state,
 	return state;
 }
 
+static void ratelimit_prefetch(const struct sockaddr_storage *const *remotes,
+                               unsigned count, unsigned thread_id, knotd_mod_t *mod)
+{
+	rrl_ctx_t *ctx = knotd_mod_ctx(mod);
+
+	// Hide the table memory latency of the following per-query decisions.
+	rrl_prefetch(ctx->rate_table, remotes, count);
+}
+
 static knotd_state_t ratelimit_apply(knotd_state_t state, knot_pkt_t *pkt,
                                      knotd_qdata_t *qdata, knotd_mod_t *mod)
 {
@@ -161,7 +170,7 @@ static knotd_state_t ratelimit_apply(knotd_state_t state, knot_pkt_t *pkt,
 
 	// Check for whitelisted client IF PER-ZONE module (no proto callbacks).
 	if (!thrd->whitelist_checked &&
-	    knotd_conf_addr_range_match(&ctx->whitelist, qdata->params->remote)) {
+	    knotd_addr_set_match(ctx->whitelist, qdata->params->remote)) {
 		thrd->skip = true;
 		return state;
 	}
@@ -195,7 +204,7 @@ static void ctx_free(rrl_ctx_t *ctx)
 	free(ctx->thrd_ctx);
 	rrl_destroy(ctx->rate_table);
 	rrl_destroy(ctx->time_table);
-	knotd_conf_free(&ctx->whitelist);
+	knotd_addr_set_free(ctx->whitelist);
 	free(ctx);
 }
 
@@ -207,7 +216,13 @@ int rrl_load(knotd_mod_t *mod)
 	}
 
 	ctx->dry_run = knotd_conf_mod(mod, MOD_DRY_RUN).single.boolean;
-	ctx->whitelist = knotd_conf_mod(mod, MOD_WHITELIST);
+	knotd_conf_t whitelist = knotd_conf_mod(mod, MOD_WHITELIST);
+	ctx->whitelist = knotd_conf_addr_set(&whitelist);
+	knotd_conf_free(&whitelist);
+	if (ctx->whitelist == NULL) {
+		ctx_free(ctx);
+		return KNOT_ENOMEM;
+	}
 
 	ctx->thrd_ctx = calloc(knotd_mod_threads(mod), sizeof(*ctx->thrd_ctx));
 	if (ctx->thrd_ctx == NULL) {
@@ -267,6 +282,8 @@ int rrl_load(knotd_mod_t *mod)
 
 	if (rate_limit > 0) {
 		knotd_mod_hook(mod, KNOTD_STAGE_BEGIN, ratelimit_apply);
+		// Note that this callback isn't executed IF PER-ZONE module!
+		knotd_mod_batch_hook(mod, ratelimit_prefetch);
 	}
 
 	if (time_limit > 0) {
@@ -32,6 +32,7 @@
 #define MOD_QTYPE	"\x0A""query-type"
 #define MOD_QSIZE	"\x0A""query-size"
 #define MOD_RSIZE	"\x0A""reply-size"
+#define MOD_LATENCY	"\x0F""request-latency"
 
 #define OTHER		"other"
 
@@ -49,6 +50,7 @@ const yp_item_t stats_conf[] = {
 	{ MOD_QTYPE,      YP_TBOOL, YP_VNONE },
 	{ MOD_QSIZE,      YP_TBOOL, YP_VNONE },
 	{ MOD_RSIZE,      YP_TBOOL, YP_VNONE },
+	{ MOD_LATENCY,    YP_TBOOL, YP_VNONE },
 	{ NULL }
 };
 
@@ -66,6 +68,7 @@ enum {
 	CTR_QTYPE,
 	CTR_QSIZE,
 	CTR_RSIZE,
+	CTR_LATENCY,
 };
 
 typedef struct {
@@ -82,6 +85,7 @@ typedef struct {
 	bool qtype;
 	bool qsize;
 	bool rsize;
+	bool latency;
 } stats_t;
 
 typedef struct {
@@ -350,6 +354,80 @@ static char *rsize_to_str(uint32_t idx, uint32_t count)
 	return size_to_str(idx, count);
 }
 
+enum {
+	LATENCY_UDP = 0,
+	LATENCY_TCP,
+	LATENCY_QUIC,
+	LATENCY_TLS,
+	LATENCY_UDP_XDP,
+	LATENCY_TCP_XDP,
+	LATENCY_QUIC_XDP,
+	LATENCY__COUNT
+};
+
+/*
+ * Log-linear latency buckets in microseconds. Values below LATENCY_SUBS
+ * have their own buckets, each higher power of two is split linearly into
+ * LATENCY_SUBS buckets. Values from 2^(LATENCY_MAX_EXP + 1) are counted in
+ * the last bucket.
+ */
+#define LATENCY_SUB_BITS	2
+#define LATENCY_SUBS		(1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_EXP		20
+#define LATENCY_BUCKETS		(LATENCY_MAX_EXP * LATENCY_SUBS + 1)
+
+static uint32_t latency_bucket(uint64_t usecs)
+{
+	if (usecs < LATENCY_SUBS) {
+		return usecs;
+	}
+
+	unsigned exp = 63 - __builtin_clzll(usecs);
+	if (exp > LATENCY_MAX_EXP) {
+		return LATENCY_BUCKETS - 1;
+	}
+
+	unsigned shift = exp - LATENCY_SUB_BITS;
+	return (shift + 1) * LATENCY_SUBS + ((usecs >> shift) & (LATENCY_SUBS - 1));
+}
+
+static char *latency_to_str(uint32_t idx, uint32_t count)
+{
+	static const char *protocols[] = {
+		[LATENCY_UDP]      = "udp",
+		[LATENCY_TCP]      = "tcp",
+		[LATENCY_QUIC]     = "quic",
+		[LATENCY_TLS]      = "tls",
+		[LATENCY_UDP_XDP]  = "udp-xdp",
+		[LATENCY_TCP_XDP]  = "tcp-xdp",
+		[LATENCY_QUIC_XDP] = "quic-xdp",
+	};
+
+	const char *protocol = protocols[idx / LATENCY_BUCKETS];
+	uint32_t bucket = idx % LATENCY_BUCKETS;
+
+	char str[32];
+
+	int ret;
+	if (bucket < 2 * LATENCY_SUBS) { // Single-value buckets.
+		ret = snprintf(str, sizeof(str), "%s/%u", protocol, bucket);
+	} else if (bucket < LATENCY_BUCKETS - 1) {
+		unsigned shift = bucket / LATENCY_SUBS - 1;
+		uint32_t min = (LATENCY_SUBS + bucket % LATENCY_SUBS) << shift;
+		ret = snprintf(str, sizeof(str), "%s/%u-%u", protocol, min,
+		               min + (1 << shift) - 1);
+	} else {
+		ret = snprintf(str, sizeof(str), "%s/%u-", protocol,
+		               1 << (LATENCY_MAX_EXP + 1));
+	}
+
+	if (ret <= 0 || (size_t)ret >= sizeof(str)) {
+		return NULL;
+	} else {
+		return strdup(str);
+	}
+}
+
 static const ctr_desc_t ctr_descs[] = {
 	#define item(macro, name, count) \
 		[CTR_##macro] = { MOD_##macro, offsetof(stats_t, name), (count), name##_to_str }
@@ -366,6 +444,7 @@ static const ctr_desc_t ctr_descs[] = {
 	item(QTYPE,      qtype,      QTYPE__COUNT),
 	item(QSIZE,      qsize,      QSIZE_MAX_IDX + 1),
 	item(RSIZE,      rsize,      RSIZE_MAX_IDX + 1),
+	item(LATENCY,    latency,    LATENCY__COUNT * LATENCY_BUCKETS),
 	{ NULL }
 };
 
@@ -571,6 +650,36 @@ static knotd_state_t update_counters(knotd_state_t state, knot_pkt_t *pkt,
 		}
 	}
 
+	// Count the request latency.
+	if (stats->latency && (qdata->params->recv_time.tv_sec != 0 ||
+	                       qdata->params->recv_time.tv_nsec != 0)) {
+		bool xdp = qdata->params->xdp_msg != NULL;
+		unsigned protocol;
+		switch (qdata->params->proto) {
+		case KNOTD_QUERY_PROTO_UDP:
+			protocol = xdp ? LATENCY_UDP_XDP : LATENCY_UDP;
+			break;
+		case KNOTD_QUERY_PROTO_QUIC:
+			protocol = xdp ? LATENCY_QUIC_XDP : LATENCY_QUIC;
+			break;
+		case KNOTD_QUERY_PROTO_TLS:
+			protocol = LATENCY_TLS;
+			break;
+		default:
+			protocol = xdp ? LATENCY_TCP_XDP : LATENCY_TCP;
+			break;
+		}
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		int64_t usecs = (now.tv_sec - qdata->params->recv_time.tv_sec) * 1000000 +
+		                (now.tv_nsec - qdata->params->recv_time.tv_nsec) / 1000;
+		uint32_t bucket = latency_bucket(MAX(usecs, 0));
+
+		knotd_mod_stats_incr(mod, tid, CTR_LATENCY,
+		                     protocol * LATENCY_BUCKETS + bucket, 1);
+	}
+
 	// Count EDNS occurrences.
 	if (stats->edns) {
 		if (knot_pkt_has_edns(qdata->query)) {
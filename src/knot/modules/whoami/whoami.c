@@ -110,5 +110,6 @@ int whoami_load(knotd_mod_t *mod)
 	return KNOT_EOK;
 }
 
-KNOTD_MOD_API(whoami, KNOTD_MOD_FLAG_SCOPE_ZONE | KNOTD_MOD_FLAG_OPT_CONF,
+KNOTD_MOD_API(whoami, KNOTD_MOD_FLAG_SCOPE_ZONE | KNOTD_MOD_FLAG_OPT_CONF |
+                      KNOTD_MOD_FLAG_NO_ANSWER_CACHE,
               whoami_load, NULL, NULL, NULL);
@@ -0,0 +1,291 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "knot/nameserver/answer_cache.h"
+#include "libknot/libknot.h"
+
+#define WAYS	2
+
+enum {
+	KEY_DNSSEC = 1 << 0,
+	KEY_UDP    = 1 << 1,
+};
+
+typedef struct {
+	uint32_t hash;       /*!< Key hash. */
+	uint16_t qtype;
+	uint16_t qclass;
+	uint16_t space;      /*!< Space available for the response. */
+	uint8_t key_flags;
+	uint8_t flags1;      /*!< Response header flags. */
+	uint8_t flags2;
+	uint16_t ancount;
+	uint16_t nscount;
+	uint16_t arcount;
+	uint16_t rcode;
+	int rcode_ede;
+	uint64_t generation; /*!< Zone contents generation, 0 if empty entry. */
+	uint16_t qname_len;
+	uint16_t body_len;
+	uint8_t *data;       /*!< Lower-case QNAME followed by the response body. */
+} entry_t;
+
+typedef struct {
+	uint32_t hash;
+	uint16_t qtype;
+	uint16_t qclass;
+	uint16_t space;
+	uint8_t key_flags;
+	const knot_dname_t *qname;
+	uint16_t qname_len;
+} cache_key_t;
+
+struct answer_cache {
+	size_t sets;         /*!< Number of sets per thread (power of two). */
+	unsigned threads;
+	entry_t *tables[];   /*!< Per-thread tables, allocated on the first use. */
+};
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+{
+	const uint8_t *byte = data;
+	for (size_t i = 0; i < len; i++) {
+		hash = (hash ^ byte[i]) * 16777619U;
+	}
+	return hash;
+}
+
+static void make_key(cache_key_t *key, const knot_pkt_t *pkt, const knotd_qdata_t *qdata)
+{
+	key->qname = knot_pkt_qname(qdata->query);
+	key->qname_len = qdata->query->qname_size;
+	key->qtype = knot_pkt_qtype(qdata->query);
+	key->qclass = knot_pkt_qclass(qdata->query);
+	key->space = pkt->max_size - pkt->reserved;
+	key->key_flags = 0;
+	if (knot_pkt_has_dnssec(qdata->query)) {
+		key->key_flags |= KEY_DNSSEC;
+	}
+	if (qdata->params->proto == KNOTD_QUERY_PROTO_UDP) {
+		key->key_flags |= KEY_UDP;
+	}
+
+	uint32_t hash = 2166136261U;
+	hash = fnv1a(hash, key->qname, key->qname_len);
+	hash = fnv1a(hash, &key->qtype, sizeof(key->qtype));
+	hash = fnv1a(hash, &key->qclass, sizeof(key->qclass));
+	hash = fnv1a(hash, &key->space, sizeof(key->space));
+	hash = fnv1a(hash, &key->key_flags, sizeof(key->key_flags));
+	key->hash = hash;
+}
+
+static bool entry_match(const entry_t *entry, const cache_key_t *key, uint64_t generation)
+{
+	return entry->generation == generation &&
+	       entry->hash == key->hash &&
+	       entry->qtype == key->qtype &&
+	       entry->qclass == key->qclass &&
+	       entry->space == key->space &&
+	       entry->key_flags == key->key_flags &&
+	       entry->qname_len == key->qname_len &&
+	       memcmp(entry->data, key->qname, key->qname_len) == 0;
+}
+
+static entry_t *get_set(answer_cache_t *cache, unsigned thread, uint32_t hash,
+                        bool create)
+{
+	if (thread >= cache->threads) {
+		return NULL;
+	}
+
+	entry_t *table = cache->tables[thread];
+	if (table == NULL) {
+		if (!create) {
+			return NULL;
+		}
+		table = calloc(cache->sets * WAYS, sizeof(*table));
+		if (table == NULL) {
+			return NULL;
+		}
+		cache->tables[thread] = table;
+	}
+
+	return table + (hash & (cache->sets - 1)) * WAYS;
+}
+
+answer_cache_t *answer_cache_new(size_t size, unsigned threads)
+{
+	if (size == 0 || threads == 0) {
+		return NULL;
+	}
+
+	answer_cache_t *cache = calloc(1, sizeof(*cache) + threads * sizeof(cache->tables[0]));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	cache->sets = 1;
+	while (cache->sets * WAYS < size) {
+		cache->sets <<= 1;
+	}
+	cache->threads = threads;
+
+	return cache;
+}
+
+void answer_cache_free(answer_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (unsigned i = 0; i < cache->threads; i++) {
+		entry_t *table = cache->tables[i];
+		if (table == NULL) {
+			continue;
+		}
+		for (size_t j = 0; j < cache->sets * WAYS; j++) {
+			free(table[j].data);
+		}
+		free(table);
+	}
+	free(cache);
+}
+
+int answer_cache_get(answer_cache_t *cache, uint64_t generation, bool parse,
+                     knot_pkt_t *pkt, knotd_qdata_t *qdata)
+{
+	if (cache == NULL || pkt == NULL || qdata == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	cache_key_t key;
+	make_key(&key, pkt, qdata);
+
+	entry_t *set = get_set(cache, qdata->params->thread_id, key.hash, false);
+	if (set == NULL) {
+		return KNOT_ENOENT;
+	}
+
+	int way = 0;
+	while (way < WAYS && !entry_match(&set[way], &key, generation)) {
+		way++;
+	}
+	if (way == WAYS) {
+		return KNOT_ENOENT;
+	}
+
+	/* Keep the most recently used entry first. */
+	if (way > 0) {
+		entry_t tmp = set[0];
+		set[0] = set[way];
+		set[way] = tmp;
+	}
+	const entry_t *entry = &set[0];
+
+	size_t offset = KNOT_WIRE_HEADER_SIZE + knot_pkt_question_size(pkt);
+	if (pkt->size != offset || offset + entry->body_len > key.space) {
+		return KNOT_ENOENT;
+	}
+
+	memcpy(pkt->wire + offset, entry->data + entry->qname_len, entry->body_len);
+	pkt->size = offset + entry->body_len;
+
+	uint8_t flags1 = knot_wire_get_flags1(pkt->wire);
+	uint8_t flags2 = knot_wire_get_flags2(pkt->wire);
+	knot_wire_set_flags1(pkt->wire, (entry->flags1 & ~KNOT_WIRE_RD_MASK) |
+	                                (flags1 & KNOT_WIRE_RD_MASK));
+	knot_wire_set_flags2(pkt->wire, (entry->flags2 & ~KNOT_WIRE_CD_MASK) |
+	                                (flags2 & KNOT_WIRE_CD_MASK));
+	knot_wire_set_ancount(pkt->wire, entry->ancount);
+	knot_wire_set_nscount(pkt->wire, entry->nscount);
+	knot_wire_set_arcount(pkt->wire, entry->arcount);
+
+	qdata->rcode = entry->rcode;
+	qdata->rcode_ede = entry->rcode_ede;
+
+	/* Parse the sections only if someone needs them, just append otherwise. */
+	if (parse) {
+		return knot_pkt_parse(pkt, KNOT_PF_NOCANON);
+	} else {
+		return knot_pkt_begin(pkt, KNOT_ADDITIONAL);
+	}
+}
+
+void answer_cache_put(answer_cache_t *cache, uint64_t generation,
+                      const knot_pkt_t *pkt, const knotd_qdata_t *qdata)
+{
+	if (cache == NULL || pkt == NULL || qdata == NULL || generation == 0) {
+		return;
+	}
+
+	if (knot_wire_get_tc(pkt->wire) || pkt->size > ANSWER_CACHE_MAX_SIZE ||
+	    (qdata->rcode != KNOT_RCODE_NOERROR && qdata->rcode != KNOT_RCODE_NXDOMAIN)) {
+		return;
+	}
+
+	cache_key_t key;
+	make_key(&key, pkt, qdata);
+
+	entry_t *set = get_set(cache, qdata->params->thread_id, key.hash, true);
+	if (set == NULL) {
+		return;
+	}
+
+	size_t offset = KNOT_WIRE_HEADER_SIZE + knot_pkt_question_size(pkt);
+	assert(pkt->size >= offset);
+	size_t body_len = pkt->size - offset;
+
+	uint8_t *data = malloc(key.qname_len + body_len);
+	if (data == NULL) {
+		return;
+	}
+	memcpy(data, key.qname, key.qname_len);
+	memcpy(data + key.qname_len, pkt->wire + offset, body_len);
+
+	/* Evict an outdated entry or the least recently used one. */
+	int victim = 0;
+	while (victim < WAYS - 1 && set[victim].generation == generation) {
+		victim++;
+	}
+	free(set[victim].data);
+
+	/* Insert as the most recently used entry. */
+	memmove(&set[1], &set[0], victim * sizeof(*set));
+
+	set[0] = (entry_t) {
+		.hash = key.hash,
+		.qtype = key.qtype,
+		.qclass = key.qclass,
+		.space = key.space,
+		.key_flags = key.key_flags,
+		.flags1 = knot_wire_get_flags1(pkt->wire),
+		.flags2 = knot_wire_get_flags2(pkt->wire),
+		.ancount = knot_wire_get_ancount(pkt->wire),
+		.nscount = knot_wire_get_nscount(pkt->wire),
+		.arcount = knot_wire_get_arcount(pkt->wire),
+		.rcode = qdata->rcode,
+		.rcode_ede = qdata->rcode_ede,
+		.generation = generation,
+		.qname_len = key.qname_len,
+		.body_len = body_len,
+		.data = data,
+	};
+}
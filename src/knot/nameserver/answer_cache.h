@@ -0,0 +1,84 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * \brief Per-zone cache of rendered responses.
+ *
+ * Each worker thread has its own table, so no locking is needed. Entries
+ * are tagged with the generation of the zone contents they were rendered
+ * from, a new contents version invalidates all of them at once.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "knot/include/module.h"
+#include "libknot/packet/pkt.h"
+
+/*! \brief Maximum size of a cached response (without OPT and TSIG). */
+#define ANSWER_CACHE_MAX_SIZE	4096
+
+typedef struct answer_cache answer_cache_t;
+
+/*!
+ * \brief Create an answer cache.
+ *
+ * \param size     Number of entries per thread (rounded up to a power of two).
+ * \param threads  Number of worker threads.
+ *
+ * \return New cache or NULL if no memory.
+ */
+answer_cache_t *answer_cache_new(size_t size, unsigned threads);
+
+/*!
+ * \brief Free the answer cache including all entries.
+ */
+void answer_cache_free(answer_cache_t *cache);
+
+/*!
+ * \brief Fill the response from the cache.
+ *
+ * The response must contain only the question. The message ID, the question
+ * (including its letter case) and the query flags are kept.
+ *
+ * \param cache       Answer cache.
+ * \param generation  Generation of the current zone contents.
+ * \param parse       Parse the filled response sections (else just move to Additional).
+ * \param pkt         Response.
+ * \param qdata       Query data (RCODE is set on success).
+ *
+ * \retval KNOT_EOK     if the response was filled.
+ * \retval KNOT_ENOENT  if not found, the response is untouched.
+ * \retval KNOT_E*      if the filled response is unusable.
+ */
+int answer_cache_get(answer_cache_t *cache, uint64_t generation, bool parse,
+                     knot_pkt_t *pkt, knotd_qdata_t *qdata);
+
+/*!
+ * \brief Store the finished response in the cache.
+ *
+ * Truncated, oversized, and other than NOERROR or NXDOMAIN responses
+ * are skipped.
+ *
+ * \param cache       Answer cache.
+ * \param generation  Generation of the zone contents used for the response.
+ * \param pkt         Response without OPT and TSIG.
+ * \param qdata       Query data.
+ */
+void answer_cache_put(answer_cache_t *cache, uint64_t generation,
+                      const knot_pkt_t *pkt, const knotd_qdata_t *qdata);
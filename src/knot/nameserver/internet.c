@@ -17,6 +17,7 @@
 #include "libknot/libknot.h"
 #include "knot/dnssec/rrset-sign.h"
 #include "knot/dnssec/zone-nsec.h"
+#include "knot/nameserver/answer_cache.h"
 #include "knot/nameserver/internet.h"
 #include "knot/nameserver/nsec_proofs.h"
 #include "knot/nameserver/query_module.h"
@@ -638,6 +639,31 @@ static knotd_in_state_t solve_additional_dnssec(knotd_in_state_t state, knot_pkt
 	}
 }
 
+/*! \brief Check if the answer cache can be used for the query. */
+static bool answer_cache_usable(knotd_qdata_t *qdata)
+{
+	const zone_t *zone = qdata->extra->zone;
+	if (zone->answer_cache == NULL || knot_pkt_has_tsig(qdata->query) ||
+	    conf()->cache.srv_ans_rotate) {
+		return false;
+	}
+
+	/* Modules with dynamic answers. */
+	struct query_plan *plan = conf()->query_plan;
+	return (plan == NULL || !plan->no_answer_cache) &&
+	       (zone->query_plan == NULL || !zone->query_plan->no_answer_cache);
+}
+
+/*! \brief Check if the response sections are used after the query processing. */
+static bool answer_parse_needed(knotd_qdata_t *qdata)
+{
+	struct query_plan *plan = conf()->query_plan;
+	struct query_plan *zone_plan = qdata->extra->zone->query_plan;
+
+	return (plan != NULL && !EMPTY_LIST(plan->stage[KNOTD_STAGE_END])) ||
+	       (zone_plan != NULL && !EMPTY_LIST(zone_plan->stage[KNOTD_STAGE_END]));
+}
+
 /*! \brief Helper for internet_query repetitive code. */
 #define SOLVE_STEP(solver, state, context) \
 	state = (solver)(state, pkt, qdata, context); \
@@ -734,5 +760,24 @@ knot_layer_state_t internet_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 	/* Get answer to QNAME. */
 	qdata->name = knot_pkt_qname(qdata->query);
 
-	return answer_query(pkt, qdata);
+	if (!answer_cache_usable(qdata)) {
+		return answer_query(pkt, qdata);
+	}
+
+	/* Reuse a rendered answer if possible. */
+	answer_cache_t *cache = qdata->extra->zone->answer_cache;
+	uint64_t generation = qdata->extra->contents->generation;
+	int ret = answer_cache_get(cache, generation, answer_parse_needed(qdata), pkt, qdata);
+	if (ret == KNOT_EOK) {
+		return KNOT_STATE_DONE;
+	} else if (ret != KNOT_ENOENT) {
+		return KNOT_STATE_FAIL;
+	}
+
+	knot_layer_state_t state = answer_query(pkt, qdata);
+	if (state == KNOT_STATE_DONE) {
+		answer_cache_put(cache, generation, pkt, qdata);
+	}
+
+	return state;
 }
@@ -1031,6 +1031,29 @@ knotd_proto_state_t process_query_proto(knotd_qdata_params_t *params,
 	return state;
 }
 
+void process_query_batch(const struct sockaddr_storage *const *remotes,
+                         unsigned count, unsigned thread_id)
+{
+	assert(remotes || count == 0);
+
+	if (count == 0) {
+		return;
+	}
+
+	rcu_read_lock();
+
+	struct query_plan *plan = conf()->query_plan;
+	if (plan != NULL) {
+		struct query_step *step;
+		WALK_LIST(step, plan->stage[KNOTD_STAGE_PROTO_BATCH]) {
+			assert(step->type == QUERY_HOOK_TYPE_BATCH);
+			step->batch_hook(remotes, count, thread_id, step->ctx);
+		}
+	}
+
+	rcu_read_unlock();
+}
+
 /*! \brief Module implementation. */
 const knot_layer_api_t *process_query_layer(void)
 {
@@ -117,3 +117,13 @@ int process_query_put_rr(knot_pkt_t *pkt, knotd_qdata_t *qdata,
  */
 knotd_proto_state_t process_query_proto(knotd_qdata_params_t *params,
                                         const knotd_stage_t stage);
+
+/*!
+ * \brief Processes all global module batch callbacks for received UDP queries.
+ *
+ * \param remotes    Remote addresses of the queries.
+ * \param count      Number of the queries.
+ * \param thread_id  Current thread id.
+ */
+void process_query_batch(const struct sockaddr_storage *const *remotes,
+                         unsigned count, unsigned thread_id);
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "contrib/addr_set.h"
 #include "contrib/sockaddr.h"
 #include "libknot/attribute.h"
 #include "libknot/probe/data.h"
@@ -48,6 +49,7 @@ struct query_plan *query_plan_create(void)
 	for (unsigned i = 0; i < KNOTD_STAGES; ++i) {
 		init_list(&plan->stage[i]);
 	}
+	plan->no_answer_cache = false;
 
 	return plan;
 }
@@ -95,6 +97,23 @@ int knotd_mod_proto_hook(knotd_mod_t *mod, knotd_stage_t stage, knotd_mod_proto_
 	return query_plan_step(mod->plan, stage, QUERY_HOOK_TYPE_PROTO, hook,  mod);
 }
 
+_public_
+int knotd_mod_batch_hook(knotd_mod_t *mod, knotd_mod_batch_hook_f hook)
+{
+	return query_plan_step(mod->plan, KNOTD_STAGE_PROTO_BATCH, QUERY_HOOK_TYPE_BATCH,
+	                       hook, mod);
+}
+
+static int mod_plan_step(knotd_mod_t *mod, knotd_stage_t stage,
+                         query_hook_type_t type, void *hook)
+{
+	if (mod->api->flags & KNOTD_MOD_FLAG_NO_ANSWER_CACHE) {
+		mod->plan->no_answer_cache = true;
+	}
+
+	return query_plan_step(mod->plan, stage, type, hook, mod);
+}
+
 _public_
 int knotd_mod_hook(knotd_mod_t *mod, knotd_stage_t stage, knotd_mod_hook_f hook)
 {
@@ -102,7 +121,7 @@ int knotd_mod_hook(knotd_mod_t *mod, knotd_stage_t stage, knotd_mod_hook_f hook)
 		return KNOT_EINVAL;
 	}
 
-	return query_plan_step(mod->plan, stage, QUERY_HOOK_TYPE_GENERAL, hook, mod);
+	return mod_plan_step(mod, stage, QUERY_HOOK_TYPE_GENERAL, hook);
 }
 
 _public_
@@ -113,7 +132,7 @@ int knotd_mod_in_hook(knotd_mod_t *mod, knotd_stage_t stage, knotd_mod_in_hook_f
 		return KNOT_EINVAL;
 	}
 
-	return query_plan_step(mod->plan, stage, QUERY_HOOK_TYPE_IN, hook, mod);
+	return mod_plan_step(mod, stage, QUERY_HOOK_TYPE_IN, hook);
 }
 
 knotd_mod_t *query_module_open(conf_t *conf, server_t *server, conf_mod_id_t *mod_id,
@@ -251,6 +270,27 @@ void knotd_mod_vlog(knotd_mod_t *mod, int priority, const char *fmt, va_list arg
 	#undef LOG_ARGS
 }
 
+/*!
+ * \brief Allocates a block of thread-owned counters with additional zeroed ones.
+ *
+ * The block is aligned and padded to whole cache lines, so that counters
+ * of different threads never share a cache line.
+ */
+static knot_atomic_uint64_t *stats_vals_alloc(knot_atomic_uint64_t *old_vals,
+                                              uint32_t old_count, uint32_t add_count)
+{
+	knot_atomic_uint64_t *vals =
+		mm_cache_line_alloc((old_count + add_count) * sizeof(*old_vals));
+	if (vals == NULL) {
+		return NULL;
+	}
+	if (old_count > 0) {
+		memcpy(vals, old_vals, old_count * sizeof(*old_vals));
+	}
+
+	return vals;
+}
+
 _public_
 int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_count,
                         knotd_mod_idx_to_str_f idx_to_str)
@@ -279,7 +319,7 @@ int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_cou
 		}
 
 		for (unsigned i = 0; i < threads; i++) {
-			mod->stats_vals[i] = calloc(idx_count, sizeof(**mod->stats_vals));
+			mod->stats_vals[i] = stats_vals_alloc(NULL, 0, idx_count);
 			if (mod->stats_vals[i] == NULL) {
 				knotd_mod_stats_free(mod);
 				return KNOT_ENOMEM;
@@ -304,17 +344,14 @@ int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_cou
 		stats += mod->stats_count;
 
 		for (unsigned i = 0; i < threads; i++) {
-			knot_atomic_uint64_t *new_vals = realloc(mod->stats_vals[i],
-			                                 (offset + idx_count) * sizeof(*new_vals));
+			knot_atomic_uint64_t *new_vals = stats_vals_alloc(mod->stats_vals[i],
+			                                                  offset, idx_count);
 			if (new_vals == NULL) {
 				knotd_mod_stats_free(mod);
 				return KNOT_ENOMEM;
 			}
+			free(mod->stats_vals[i]);
 			mod->stats_vals[i] = new_vals;
-			new_vals += offset;
-			for (uint32_t j = 0; j < idx_count; j++) {
-				*new_vals++ = 0;
-			}
 		}
 	}
 
@@ -354,18 +391,20 @@ void knotd_mod_stats_free(knotd_mod_t *mod)
 	OPERATION(mod->stats_vals[thr_id][ctr->offset + idx], val); \
 }
 
+/* The counters of each thread are modified by the owning thread only. */
+
 _public_
 void knotd_mod_stats_incr(knotd_mod_t *mod, unsigned thr_id, uint32_t ctr_id,
                           uint32_t idx, uint64_t val)
 {
-	STATS_BODY(ATOMIC_ADD)
+	STATS_BODY(ATOMIC_ADD_OWNED)
 }
 
 _public_
 void knotd_mod_stats_decr(knotd_mod_t *mod, unsigned thr_id, uint32_t ctr_id,
                           uint32_t idx, uint64_t val)
 {
-	STATS_BODY(ATOMIC_SUB)
+	STATS_BODY(ATOMIC_SUB_OWNED)
 }
 
 _public_
@@ -595,6 +634,49 @@ bool knotd_conf_addr_range_match(const knotd_conf_t *range,
 	return false;
 }
 
+_public_
+knotd_addr_set_t *knotd_conf_addr_set(const knotd_conf_t *range)
+{
+	if (range == NULL) {
+		return NULL;
+	}
+
+	addr_set_t *set = addr_set_new();
+	if (set == NULL) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < range->count; i++) {
+		knotd_conf_val_t *val = &range->multi[i];
+		int ret;
+		if (val->addr_max.ss_family == AF_UNSPEC) {
+			ret = addr_set_add_net(set, &val->addr, val->addr_mask);
+		} else {
+			ret = addr_set_add_range(set, &val->addr, &val->addr_max);
+		}
+		// Items which cannot match any address are skipped.
+		if (ret != KNOT_EOK && ret != KNOT_EINVAL) {
+			addr_set_free(set);
+			return NULL;
+		}
+	}
+
+	return (knotd_addr_set_t *)set;
+}
+
+_public_
+bool knotd_addr_set_match(const knotd_addr_set_t *set,
+                          const struct sockaddr_storage *addr)
+{
+	return addr_set_match((const addr_set_t *)set, addr);
+}
+
+_public_
+void knotd_addr_set_free(knotd_addr_set_t *set)
+{
+	addr_set_free((addr_set_t *)set);
+}
+
 _public_
 void knotd_conf_free(knotd_conf_t *conf)
 {
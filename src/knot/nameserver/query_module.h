@@ -25,12 +25,13 @@
 #include "contrib/atomic.h"
 #include "contrib/ucw/lists.h"
 
-#define KNOTD_STAGES (KNOTD_STAGE_PROTO_END + 1)
+#define KNOTD_STAGES (KNOTD_STAGE_PROTO_BATCH + 1)
 
 typedef enum {
 	QUERY_HOOK_TYPE_PROTO,
 	QUERY_HOOK_TYPE_GENERAL,
 	QUERY_HOOK_TYPE_IN,
+	QUERY_HOOK_TYPE_BATCH,
 } query_hook_type_t;
 
 /*! \brief Single processing step in query/module processing. */
@@ -41,6 +42,7 @@ struct query_step {
 		knotd_mod_proto_hook_f proto_hook;
 		knotd_mod_hook_f general_hook;
 		knotd_mod_in_hook_f in_hook;
+		knotd_mod_batch_hook_f batch_hook;
 	};
 	void *ctx;
 };
@@ -51,6 +53,7 @@ struct query_step {
  */
 struct query_plan {
 	list_t stage[KNOTD_STAGES];
+	bool no_answer_cache; /*!< Some module requires fresh answers. */
 };
 
 /*! \brief Create an empty query plan. */
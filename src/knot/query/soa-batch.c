@@ -0,0 +1,712 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "knot/query/soa-batch.h"
+#include "knot/nameserver/tsig_ctx.h"
+#include "libknot/errcode.h"
+#include "libknot/rrtype/soa.h"
+#include "contrib/conn_pool.h"
+#include "contrib/macros.h"
+#include "contrib/net.h"
+#include "contrib/qp-trie/trie.h"
+#include "contrib/sockaddr.h"
+
+/*! Cache key: remote address, port, TSIG key name, zone name. */
+#define KEY_MAXLEN (1 + 16 + 2 + 2 * KNOT_DNAME_MAXLEN)
+
+typedef struct {
+	time_t received;
+	size_t size;
+	uint8_t wire[];
+} cached_answer_t;
+
+/*!
+ * Answers are kept in two generations rotated every SOA_BATCH_WINDOW,
+ * which bounds the lifetime of answers that are never taken.
+ */
+static struct {
+	pthread_mutex_t mx;
+	trie_t *answers[2]; //!< Current and previous generation.
+	time_t rotated;     //!< Time of the last rotation.
+	trie_t *claims;     //!< Last batch time per remote address.
+} cache = { .mx = PTHREAD_MUTEX_INITIALIZER };
+
+/*! Zones sharing a primary usable for batching. */
+typedef struct {
+	size_t count;
+	size_t max;
+	knot_dname_t **zones;
+} primary_zones_t;
+
+/*!
+ * Index of zones by their batching primaries (address and TSIG key), built
+ * from the zone database so that batches needn't search all the zones.
+ */
+static struct {
+	pthread_mutex_t mx;
+	const knot_zonedb_t *db; //!< Zone database the index was built from.
+	time_t built;            //!< Time of the build.
+	trie_t *primaries;       //!< Zone lists by primary key.
+} zindex = { .mx = PTHREAD_MUTEX_INITIALIZER };
+
+/*! Batch tasks created but not yet freed. */
+static struct {
+	pthread_mutex_t mx;
+	list_t list;
+	bool init;
+} tasks = { .mx = PTHREAD_MUTEX_INITIALIZER };
+
+typedef struct {
+	uint16_t id;
+	size_t item;
+	tsig_ctx_t tsig;
+} inflight_t;
+
+static size_t remote_key(uint8_t *key, const conf_remote_t *remote)
+{
+	size_t addr_len = 0;
+	const void *addr = sockaddr_raw(&remote->addr, &addr_len);
+	uint16_t port = sockaddr_port(&remote->addr);
+
+	uint8_t *pos = key;
+	*pos++ = remote->addr.ss_family;
+	memcpy(pos, addr, addr_len);
+	pos += addr_len;
+	memcpy(pos, &port, sizeof(port));
+	pos += sizeof(port);
+
+	return pos - key;
+}
+
+static size_t primary_key(uint8_t *key, const conf_remote_t *remote)
+{
+	size_t len = remote_key(key, remote);
+
+	// The name is self-delimiting, missing TSIG key is the root name.
+	if (remote->key.name != NULL) {
+		len += knot_dname_to_wire(key + len, remote->key.name, KNOT_DNAME_MAXLEN);
+	} else {
+		key[len++] = '\0';
+	}
+
+	return len;
+}
+
+static size_t answer_key(uint8_t *key, const conf_remote_t *remote,
+                         const knot_dname_t *zone)
+{
+	size_t len = primary_key(key, remote);
+	len += knot_dname_to_wire(key + len, zone, KNOT_DNAME_MAXLEN);
+
+	return len;
+}
+
+static int free_answer(trie_val_t *val, void *ctx)
+{
+	free(*val);
+	return KNOT_EOK;
+}
+
+static void free_answers(trie_t *answers)
+{
+	if (answers != NULL) {
+		(void)trie_apply(answers, free_answer, NULL);
+		trie_free(answers);
+	}
+}
+
+/*! \brief Rotate answer generations, needs the cache lock. */
+static int rotate(time_t now)
+{
+	if (cache.answers[0] == NULL) {
+		cache.answers[0] = trie_create(NULL);
+		cache.rotated = now;
+	} else if (now - cache.rotated >= SOA_BATCH_WINDOW) {
+		trie_t *fresh = trie_create(NULL);
+		if (fresh == NULL) {
+			return KNOT_ENOMEM;
+		}
+		free_answers(cache.answers[1]);
+		cache.answers[1] = cache.answers[0];
+		cache.answers[0] = fresh;
+		cache.rotated = now;
+	}
+
+	return cache.answers[0] != NULL ? KNOT_EOK : KNOT_ENOMEM;
+}
+
+static void store_answer(const conf_remote_t *remote, const knot_dname_t *zone,
+                         const knot_pkt_t *pkt)
+{
+	cached_answer_t *answer = malloc(sizeof(*answer) + pkt->size);
+	if (answer == NULL) {
+		return;
+	}
+	answer->received = time(NULL);
+	answer->size = pkt->size;
+	memcpy(answer->wire, pkt->wire, pkt->size);
+
+	uint8_t key[KEY_MAXLEN];
+	size_t key_len = answer_key(key, remote, zone);
+
+	pthread_mutex_lock(&cache.mx);
+	trie_val_t *val = NULL;
+	if (rotate(answer->received) == KNOT_EOK) {
+		val = trie_get_ins(cache.answers[0], key, key_len);
+	}
+	if (val != NULL) {
+		free(*val);
+		*val = answer;
+	} else {
+		free(answer);
+	}
+	pthread_mutex_unlock(&cache.mx);
+}
+
+bool soa_batch_usable(const conf_remote_t *remote)
+{
+	return remote->soa_batch > 0 && !remote->quic && !remote->tls &&
+	       (remote->addr.ss_family == AF_INET || remote->addr.ss_family == AF_INET6);
+}
+
+bool soa_batch_claim(const conf_remote_t *remote)
+{
+	uint8_t key[KEY_MAXLEN];
+	size_t key_len = remote_key(key, remote);
+	time_t now = time(NULL);
+	bool claimed = false;
+
+	pthread_mutex_lock(&cache.mx);
+	if (cache.claims == NULL) {
+		cache.claims = trie_create(NULL);
+	}
+	trie_val_t *val = cache.claims != NULL ?
+	                  trie_get_ins(cache.claims, key, key_len) : NULL;
+	if (val != NULL && (*val == NULL || now - (time_t)(intptr_t)*val >= SOA_BATCH_WINDOW)) {
+		*val = (void *)(intptr_t)now;
+		claimed = true;
+	}
+	pthread_mutex_unlock(&cache.mx);
+
+	return claimed;
+}
+
+static int send_query(int fd, knot_pkt_t *pkt, inflight_t *slot,
+                      const conf_remote_t *remote, const query_edns_data_t *edns,
+                      const knot_dname_t *zone, int timeout_ms)
+{
+	const knot_tsig_key_t *key = remote->key.name != NULL ? &remote->key : NULL;
+	tsig_init(&slot->tsig, key);
+
+	query_init_pkt(pkt);
+	slot->id = knot_wire_get_id(pkt->wire);
+
+	int ret = knot_pkt_put_question(pkt, zone, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = knot_pkt_reserve(pkt, knot_tsig_wire_size(key));
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	if (!edns->no_edns) {
+		ret = query_put_edns(pkt, edns, false);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	ret = tsig_sign_packet(&slot->tsig, pkt);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = net_dns_tcp_send(fd, pkt->wire, pkt->size, timeout_ms, NULL);
+	if (ret < 0) {
+		return ret;
+	} else if (ret != pkt->size) {
+		return KNOT_ECONN;
+	}
+
+	return KNOT_EOK;
+}
+
+static int free_primary(trie_val_t *val, void *ctx)
+{
+	primary_zones_t *primary = *val;
+	for (size_t i = 0; i < primary->count; i++) {
+		knot_dname_free(primary->zones[i], NULL);
+	}
+	free(primary->zones);
+	free(primary);
+	return KNOT_EOK;
+}
+
+static void free_primaries(trie_t *primaries)
+{
+	if (primaries != NULL) {
+		(void)trie_apply(primaries, free_primary, NULL);
+		trie_free(primaries);
+	}
+}
+
+typedef struct {
+	conf_t *conf;
+	trie_t *primaries;
+	int ret;
+} index_ctx_t;
+
+static int index_add(trie_t *primaries, const conf_remote_t *remote,
+                     const knot_dname_t *zone)
+{
+	uint8_t key[KEY_MAXLEN];
+	size_t key_len = primary_key(key, remote);
+
+	trie_val_t *val = trie_get_ins(primaries, key, key_len);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+	if (*val == NULL) {
+		*val = calloc(1, sizeof(primary_zones_t));
+		if (*val == NULL) {
+			return KNOT_ENOMEM;
+		}
+	}
+
+	primary_zones_t *primary = *val;
+	if (primary->count > 0 &&
+	    knot_dname_is_equal(primary->zones[primary->count - 1], zone)) {
+		return KNOT_EOK; // Another address of the same remote.
+	}
+	if (primary->count == primary->max) {
+		size_t max = MAX(2 * primary->max, 16);
+		knot_dname_t **zones = realloc(primary->zones, max * sizeof(*zones));
+		if (zones == NULL) {
+			return KNOT_ENOMEM;
+		}
+		primary->zones = zones;
+		primary->max = max;
+	}
+	primary->zones[primary->count] = knot_dname_copy(zone, NULL);
+	if (primary->zones[primary->count] == NULL) {
+		return KNOT_ENOMEM;
+	}
+	primary->count++;
+
+	return KNOT_EOK;
+}
+
+static void index_zone(zone_t *zone, index_ctx_t *ctx)
+{
+	conf_val_t masters = conf_zone_get(ctx->conf, C_MASTER, zone->name);
+	conf_mix_iter_t iter;
+	conf_mix_iter_init(ctx->conf, &masters, &iter);
+	while (ctx->ret == KNOT_EOK && iter.id->code == KNOT_EOK) {
+		conf_val_t addr = conf_id_get(ctx->conf, C_RMT, C_ADDR, iter.id);
+		size_t addr_count = conf_val_count(&addr);
+
+		for (size_t i = 0; ctx->ret == KNOT_EOK && i < addr_count; i++) {
+			conf_remote_t remote = conf_remote(ctx->conf, iter.id, i);
+			if (soa_batch_usable(&remote)) {
+				ctx->ret = index_add(ctx->primaries, &remote, zone->name);
+			}
+		}
+		conf_mix_iter_next(&iter);
+	}
+}
+
+/*! \brief Rebuild the zone index if outdated, needs the index lock. */
+static int index_update(conf_t *conf, knot_zonedb_t *db, time_t now)
+{
+	if (zindex.primaries != NULL && zindex.db == db &&
+	    now - zindex.built < SOA_BATCH_WINDOW) {
+		return KNOT_EOK;
+	}
+
+	index_ctx_t ctx = {
+		.conf = conf,
+		.primaries = trie_create(NULL),
+	};
+	if (ctx.primaries == NULL) {
+		return KNOT_ENOMEM;
+	}
+	knot_zonedb_foreach(db, index_zone, &ctx);
+	if (ctx.ret != KNOT_EOK) {
+		free_primaries(ctx.primaries);
+		return ctx.ret;
+	}
+
+	free_primaries(zindex.primaries);
+	zindex.primaries = ctx.primaries;
+	zindex.db = db;
+	zindex.built = now;
+
+	return KNOT_EOK;
+}
+
+size_t soa_batch_candidates(conf_t *conf, knot_zonedb_t *db, const conf_remote_t *remote,
+                            soa_batch_item_t *items, size_t max,
+                            soa_batch_accept_cb accept, void *ctx)
+{
+	if (conf == NULL || db == NULL || remote == NULL || items == NULL ||
+	    accept == NULL || !soa_batch_usable(remote)) {
+		return 0;
+	}
+
+	uint8_t key[KEY_MAXLEN];
+	size_t key_len = primary_key(key, remote);
+	size_t count = 0;
+
+	pthread_mutex_lock(&zindex.mx);
+	if (index_update(conf, db, time(NULL)) == KNOT_EOK) {
+		trie_val_t *val = trie_get_try(zindex.primaries, key, key_len);
+		primary_zones_t *primary = (val != NULL) ? *val : NULL;
+		for (size_t i = 0; primary != NULL && i < primary->count && count < max; i++) {
+			if (!accept(primary->zones[i], ctx)) {
+				continue;
+			}
+			knot_dname_t *zone = knot_dname_copy(primary->zones[i], NULL);
+			if (zone != NULL) {
+				items[count++] = (soa_batch_item_t){ .zone = zone };
+			}
+		}
+	}
+	pthread_mutex_unlock(&zindex.mx);
+
+	return count;
+}
+
+static bool valid_answer(knot_pkt_t *pkt, inflight_t *slot, uint32_t *serial)
+{
+	if (knot_wire_get_tc(pkt->wire) ||
+	    tsig_verify_packet(&slot->tsig, pkt) != KNOT_EOK ||
+	    knot_pkt_ext_rcode(pkt) != KNOT_RCODE_NOERROR) {
+		return false;
+	}
+
+	const knot_pktsection_t *answer = knot_pkt_section(pkt, KNOT_ANSWER);
+	const knot_rrset_t *rr = answer->count == 1 ? knot_pkt_rr(answer, 0) : NULL;
+	if (rr == NULL || rr->type != KNOT_RRTYPE_SOA || rr->rrs.count != 1) {
+		return false;
+	}
+
+	*serial = knot_soa_serial(rr->rrs.rdata);
+	return true;
+}
+
+static inflight_t *match_answer(knot_pkt_t *resp, inflight_t *inflight, size_t active,
+                                soa_batch_item_t *items)
+{
+	for (size_t i = 0; i < active; i++) {
+		if (inflight[i].id == knot_wire_get_id(resp->wire) &&
+		    knot_pkt_qtype(resp) == KNOT_RRTYPE_SOA &&
+		    knot_dname_is_equal(knot_pkt_qname(resp), items[inflight[i].item].zone)) {
+			return &inflight[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*!
+ * \brief Pipeline SOA queries of the not answered items over the connection.
+ *
+ * Unexpected or malformed messages are ignored, the affected items stay
+ * unanswered.
+ */
+static int exchange(int fd, knot_pkt_t *query, knot_pkt_t *resp,
+                    const conf_remote_t *remote, const query_edns_data_t *edns,
+                    soa_batch_item_t *items, size_t count, int timeout_ms,
+                    size_t *received)
+{
+	inflight_t inflight[SOA_BATCH_INFLIGHT];
+	size_t active = 0, next = 0;
+	int ret = KNOT_EOK;
+
+	while (ret == KNOT_EOK && (next < count || active > 0)) {
+		// Keep the pipeline full.
+		while (ret == KNOT_EOK && next < count && active < SOA_BATCH_INFLIGHT) {
+			if (items[next].answered) {
+				next++;
+				continue;
+			}
+			inflight_t *slot = &inflight[active];
+			slot->item = next++;
+			ret = send_query(fd, query, slot, remote, edns,
+			                 items[slot->item].zone, timeout_ms);
+			if (ret == KNOT_EOK) {
+				active++;
+			} else {
+				tsig_cleanup(&slot->tsig);
+			}
+		}
+		if (ret != KNOT_EOK || active == 0) {
+			break;
+		}
+
+		knot_pkt_clear(resp);
+		ret = net_dns_tcp_recv(fd, resp->wire, resp->max_size, timeout_ms);
+		if (ret <= 0) {
+			ret = (ret == 0) ? KNOT_ECONN : ret;
+			break;
+		}
+		(*received)++;
+		resp->size = ret;
+		ret = KNOT_EOK;
+
+		// Match the answer by the message ID and the question.
+		inflight_t *slot = NULL;
+		if (knot_pkt_parse(resp, 0) == KNOT_EOK) {
+			slot = match_answer(resp, inflight, active, items);
+		}
+		if (slot == NULL) {
+			continue;
+		}
+
+		soa_batch_item_t *item = &items[slot->item];
+		item->answered = valid_answer(resp, slot, &item->serial);
+		if (item->answered) {
+			store_answer(remote, item->zone, resp);
+		}
+
+		tsig_cleanup(&slot->tsig);
+		*slot = inflight[--active];
+	}
+
+	for (size_t i = 0; i < active; i++) {
+		tsig_cleanup(&inflight[i].tsig);
+	}
+
+	return ret;
+}
+
+int soa_batch_query(const conf_remote_t *remote, const query_edns_data_t *edns,
+                    soa_batch_item_t *items, size_t count, int timeout_ms)
+{
+	if (remote == NULL || edns == NULL || items == NULL || !soa_batch_usable(remote)) {
+		return KNOT_EINVAL;
+	}
+
+	knot_pkt_t *query = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	knot_pkt_t *resp = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	if (query == NULL || resp == NULL) {
+		knot_pkt_free(query);
+		knot_pkt_free(resp);
+		return KNOT_ENOMEM;
+	}
+
+	bool pooled = true;
+	int fd = (int)conn_pool_get(global_conn_pool, &remote->via, &remote->addr);
+	if (fd < 0) {
+		pooled = false;
+		fd = net_connected_socket(SOCK_STREAM, &remote->addr, &remote->via, false);
+	}
+
+	int ret = fd;
+	size_t received = 0;
+	if (fd >= 0) {
+		ret = exchange(fd, query, resp, remote, edns, items, count,
+		               timeout_ms, &received);
+	}
+
+	// The pooled connection may have been closed by the remote meanwhile.
+	if (ret != KNOT_EOK && pooled && received == 0) {
+		close(fd);
+		fd = net_connected_socket(SOCK_STREAM, &remote->addr, &remote->via, false);
+		ret = fd;
+		if (fd >= 0) {
+			ret = exchange(fd, query, resp, remote, edns, items, count,
+			               timeout_ms, &received);
+		}
+	}
+
+	if (ret == KNOT_EOK) {
+		fd = (int)conn_pool_put(global_conn_pool, &remote->via, &remote->addr,
+		                        (conn_pool_fd_t)fd);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+
+	knot_pkt_free(query);
+	knot_pkt_free(resp);
+
+	return ret;
+}
+
+soa_batch_task_t *soa_batch_task_new(const conf_remote_t *remote,
+                                     const knot_dname_t *leader, void *server,
+                                     task_cb run, worker_prio_t prio)
+{
+	if (remote == NULL || leader == NULL || run == NULL) {
+		return NULL;
+	}
+
+	soa_batch_task_t *task = calloc(1, sizeof(*task));
+	if (task == NULL) {
+		return NULL;
+	}
+	task->task = (worker_task_t){ .ctx = task, .run = run, .prio = prio };
+	task->server = server;
+	task->addr = remote->addr;
+	task->leader = knot_dname_copy(leader, NULL);
+	if (remote->key.name != NULL) {
+		task->key_name = knot_dname_copy(remote->key.name, NULL);
+	}
+	if (task->leader == NULL || (remote->key.name != NULL && task->key_name == NULL)) {
+		knot_dname_free(task->leader, NULL);
+		knot_dname_free(task->key_name, NULL);
+		free(task);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&tasks.mx);
+	if (!tasks.init) {
+		init_list(&tasks.list);
+		tasks.init = true;
+	}
+	add_tail(&tasks.list, &task->n);
+	pthread_mutex_unlock(&tasks.mx);
+
+	return task;
+}
+
+bool soa_batch_task_remote(conf_t *conf, const soa_batch_task_t *task,
+                           conf_remote_t *remote)
+{
+	if (conf == NULL || task == NULL || remote == NULL) {
+		return false;
+	}
+
+	conf_val_t masters = conf_zone_get(conf, C_MASTER, task->leader);
+	conf_mix_iter_t iter;
+	conf_mix_iter_init(conf, &masters, &iter);
+	while (iter.id->code == KNOT_EOK) {
+		conf_val_t addr = conf_id_get(conf, C_RMT, C_ADDR, iter.id);
+		size_t addr_count = conf_val_count(&addr);
+
+		for (size_t i = 0; i < addr_count; i++) {
+			*remote = conf_remote(conf, iter.id, i);
+			if (soa_batch_usable(remote) &&
+			    sockaddr_cmp(&remote->addr, &task->addr, false) == 0 &&
+			    (remote->key.name == task->key_name ||
+			     knot_dname_is_equal(remote->key.name, task->key_name))) {
+				return true;
+			}
+		}
+		conf_mix_iter_next(&iter);
+	}
+
+	return false;
+}
+
+static void task_free(soa_batch_task_t *task)
+{
+	knot_dname_free(task->leader, NULL);
+	knot_dname_free(task->key_name, NULL);
+	free(task);
+}
+
+void soa_batch_task_free(soa_batch_task_t *task)
+{
+	if (task == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&tasks.mx);
+	rem_node(&task->n);
+	pthread_mutex_unlock(&tasks.mx);
+
+	task_free(task);
+}
+
+knot_pkt_t *soa_batch_take(const conf_remote_t *remote, const knot_dname_t *zone)
+{
+	if (remote == NULL || zone == NULL || !soa_batch_usable(remote)) {
+		return NULL;
+	}
+
+	uint8_t key[KEY_MAXLEN];
+	size_t key_len = answer_key(key, remote, zone);
+
+	cached_answer_t *answer = NULL;
+	pthread_mutex_lock(&cache.mx);
+	for (int i = 0; i < 2 && answer == NULL; i++) {
+		if (cache.answers[i] != NULL) {
+			(void)trie_del(cache.answers[i], key, key_len, (trie_val_t *)&answer);
+		}
+	}
+	pthread_mutex_unlock(&cache.mx);
+
+	if (answer == NULL) {
+		return NULL;
+	} else if (time(NULL) - answer->received >= SOA_BATCH_WINDOW) {
+		free(answer);
+		return NULL;
+	}
+
+	knot_pkt_t *pkt = knot_pkt_new(NULL, answer->size, NULL);
+	if (pkt != NULL) {
+		memcpy(pkt->wire, answer->wire, answer->size);
+		pkt->size = answer->size;
+		if (knot_pkt_parse(pkt, 0) != KNOT_EOK) {
+			knot_pkt_free(pkt);
+			pkt = NULL;
+		}
+	}
+	free(answer);
+
+	return pkt;
+}
+
+void soa_batch_deinit(void)
+{
+	pthread_mutex_lock(&cache.mx);
+	free_answers(cache.answers[0]);
+	free_answers(cache.answers[1]);
+	cache.answers[0] = NULL;
+	cache.answers[1] = NULL;
+	if (cache.claims != NULL) {
+		trie_free(cache.claims);
+		cache.claims = NULL;
+	}
+	pthread_mutex_unlock(&cache.mx);
+
+	pthread_mutex_lock(&zindex.mx);
+	free_primaries(zindex.primaries);
+	zindex.primaries = NULL;
+	zindex.db = NULL;
+	pthread_mutex_unlock(&zindex.mx);
+
+	// Tasks dropped from the worker queue without being run.
+	pthread_mutex_lock(&tasks.mx);
+	if (tasks.init) {
+		soa_batch_task_t *task, *next;
+		WALK_LIST_DELSAFE(task, next, tasks.list) {
+			rem_node(&task->n);
+			task_free(task);
+		}
+	}
+	pthread_mutex_unlock(&tasks.mx);
+}
@@ -0,0 +1,160 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "knot/conf/conf.h"
+#include "knot/query/query.h"
+#include "knot/worker/queue.h"
+#include "knot/zone/zonedb.h"
+#include "contrib/ucw/lists.h"
+#include "libknot/packet/pkt.h"
+
+/*! Validity of a batched SOA answer (and the batch rate limit) in seconds. */
+#define SOA_BATCH_WINDOW	60
+
+/*! Maximum number of pipelined SOA queries awaiting an answer. */
+#define SOA_BATCH_INFLIGHT	32
+
+/*!
+ * \brief SOA check of one zone within a batch.
+ */
+typedef struct {
+	knot_dname_t *zone;  /*!< Zone name (input). */
+	bool answered;       /*!< Valid answer received and cached (output). */
+	uint32_t serial;     /*!< Remote SOA serial if answered (output). */
+} soa_batch_item_t;
+
+/*!
+ * \brief Batch of SOA checks to be run by a worker.
+ *
+ * Only copies of the remote parameters are kept as the configuration
+ * can be reloaded before the task is run.
+ */
+typedef struct {
+	node_t n;                     /*!< Node of the list of pending tasks. */
+	worker_task_t task;           /*!< Worker task, its ctx points to this structure. */
+	void *server;                 /*!< Server the task belongs to. */
+	knot_dname_t *leader;         /*!< Zone which triggered the batch. */
+	struct sockaddr_storage addr; /*!< Remote address. */
+	knot_dname_t *key_name;       /*!< Remote TSIG key name or NULL. */
+} soa_batch_task_t;
+
+/*!
+ * \brief Callback deciding if a zone is to be included in a batch.
+ */
+typedef bool (*soa_batch_accept_cb)(const knot_dname_t *zone, void *ctx);
+
+/*!
+ * \brief Check if SOA batching can be used with the remote.
+ *
+ * Batching is enabled by the remote configuration and only plain TCP
+ * to an IP address is supported.
+ */
+bool soa_batch_usable(const conf_remote_t *remote);
+
+/*!
+ * \brief Claim the right to send a batch to the remote.
+ *
+ * \return True at most once per SOA_BATCH_WINDOW for the same remote address.
+ */
+bool soa_batch_claim(const conf_remote_t *remote);
+
+/*!
+ * \brief Select zones for a batch sent to the remote.
+ *
+ * The zones are looked up in an index by primaries, which is rebuilt when
+ * the zone database changes or after SOA_BATCH_WINDOW.
+ *
+ * \note The caller must hold the RCU read lock protecting the database.
+ *
+ * \param conf    Configuration.
+ * \param db      Zone database.
+ * \param remote  Remote the batch is sent to.
+ * \param items   Output items (zone names to be freed by the caller).
+ * \param max     Maximum number of the items.
+ * \param accept  Callback selecting the zones.
+ * \param ctx     Callback context.
+ *
+ * \return Number of the items.
+ */
+size_t soa_batch_candidates(conf_t *conf, knot_zonedb_t *db, const conf_remote_t *remote,
+                            soa_batch_item_t *items, size_t max,
+                            soa_batch_accept_cb accept, void *ctx);
+
+/*!
+ * \brief Check SOA serials of the zones, pipelined over one TCP connection.
+ *
+ * Valid answers are cached for soa_batch_take().
+ *
+ * \param remote      Remote to be queried.
+ * \param edns        EDNS parameters of the queries.
+ * \param items       Zones to be checked.
+ * \param count       Number of the zones.
+ * \param timeout_ms  I/O timeout.
+ *
+ * \return KNOT_E* (the items answered before an error are valid)
+ */
+int soa_batch_query(const conf_remote_t *remote, const query_edns_data_t *edns,
+                    soa_batch_item_t *items, size_t count, int timeout_ms);
+
+/*!
+ * \brief Create a batch task for the remote.
+ *
+ * The task is tracked until freed so that tasks never run are released
+ * by soa_batch_deinit().
+ *
+ * \param remote  Remote to be queried.
+ * \param leader  Zone which triggered the batch.
+ * \param server  Server the task belongs to.
+ * \param run     Task callback.
+ * \param prio    Task priority.
+ *
+ * \return Task or NULL if out of memory.
+ */
+soa_batch_task_t *soa_batch_task_new(const conf_remote_t *remote,
+                                     const knot_dname_t *leader, void *server,
+                                     task_cb run, worker_prio_t prio);
+
+/*!
+ * \brief Find the remote of the leader zone matching the batch task.
+ *
+ * \return True if still configured.
+ */
+bool soa_batch_task_remote(conf_t *conf, const soa_batch_task_t *task,
+                           conf_remote_t *remote);
+
+/*!
+ * \brief Free the batch task.
+ */
+void soa_batch_task_free(soa_batch_task_t *task);
+
+/*!
+ * \brief Take the cached SOA answer for the zone from the remote.
+ *
+ * The answer is removed from the cache.
+ *
+ * \return Parsed answer (to be freed by the caller) or NULL if not available.
+ */
+knot_pkt_t *soa_batch_take(const conf_remote_t *remote, const knot_dname_t *zone);
+
+/*!
+ * \brief Free the cached answers, the zone index and the pending tasks.
+ */
+void soa_batch_deinit(void);
@@ -40,9 +40,16 @@ int proxyv2_header_strip(knot_pkt_t **query,
 	 * Check if the query was sent from an IP address authorized to send
 	 * proxied DNS traffic.
 	 */
-	conf_val_t whitelist_val = conf_get(pconf, C_SRV, C_PROXY_ALLOWLIST);
-	if (!conf_addr_range_match(&whitelist_val, remote)) {
-		return KNOT_EDENIED;
+	const addr_set_t *allowlist = pconf->cache.srv_proxy_allowlist;
+	if (allowlist != NULL) {
+		if (!addr_set_match(allowlist, remote)) {
+			return KNOT_EDENIED;
+		}
+	} else {
+		conf_val_t whitelist_val = conf_get(pconf, C_SRV, C_PROXY_ALLOWLIST);
+		if (!conf_addr_range_match(&whitelist_val, remote)) {
+			return KNOT_EDENIED;
+		}
 	}
 
 	/*
@@ -18,10 +18,16 @@
 #define __APPLE_USE_RFC_3542 // IPV6_PKTINFO
 #endif
 
+#include <errno.h>
 #include <netinet/in.h>
+#include <netinet/udp.h> // UDP_SEGMENT
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "contrib/atomic.h"
 #include "contrib/macros.h"
+#include "contrib/mempattern.h"
 #include "contrib/net.h"
 #include "knot/common/log.h"
 #include "knot/nameserver/process_query.h"
@@ -33,77 +39,236 @@
 
 #define SWEEP_BUF_SIZE 4096
 
+#define GSO_MAX_SEGMENTS	64 // UDP_MAX_SEGMENTS in Linux.
+#define GSO_MIN_SPACE		KNOT_EDNS_MAX_UDP_PAYLOAD
+
 typedef union {
 	struct cmsghdr cmsg;
 	uint8_t buf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
 } cmsg_pktinfo_t;
 
-static void quic_log_cb(const char *line)
+/*! \brief Received control messages with appended UDP GSO segment size. */
+typedef union {
+	struct cmsghdr cmsg;
+	uint8_t buf[CMSG_SPACE(sizeof(struct in6_pktinfo)) + CMSG_SPACE(sizeof(int)) +
+	            CMSG_SPACE(sizeof(uint16_t))];
+} cmsg_gso_t;
+
+/*! \brief QUIC reply coalescing consecutive packets into one UDP GSO send. */
+typedef struct {
+	knot_quic_reply_t rpl;
+	uint8_t *buf;       /*!< Output buffer. */
+	size_t len;         /*!< Length of pending packets. */
+	size_t seg_size;    /*!< Size of the first pending packet. */
+	unsigned segs;      /*!< Number of pending packets. */
+	uint8_t ecn;        /*!< ECN of pending packets. */
+} uq_reply_t;
+
+/*!
+ * \brief QUIC counters owned by one thread.
+ *
+ * Only the owning thread modifies the counters, the block is aligned to whole
+ * cache lines so that blocks of different threads never share a line. Blocks
+ * are kept after their thread exits so that the sums never decrease.
+ */
+typedef struct quic_stats_local {
+	knot_atomic_uint64_t send_calls;
+	knot_atomic_uint64_t send_segments;
+	knot_atomic_uint64_t recv_calls;
+	knot_atomic_uint64_t recv_segments;
+	struct quic_stats_local *next;
+} quic_stats_local_t;
+
+static struct {
+	pthread_mutex_t mx;
+	quic_stats_local_t *blocks; //!< Blocks of all threads.
+} quic_stats = { .mx = PTHREAD_MUTEX_INITIALIZER };
+
+#ifdef UDP_SEGMENT
+static knot_atomic_bool gso_disabled;
+#endif
+
+static bool gso_enabled(void)
 {
-	log_fmt(LOG_DEBUG, LOG_SOURCE_QUIC, "QUIC, %s", line);
+#ifdef UDP_SEGMENT
+	return !ATOMIC_GET(gso_disabled);
+#else
+	return false;
+#endif
 }
 
-static int uq_alloc_reply(knot_quic_reply_t *r)
+static quic_stats_local_t *stats_local(void)
 {
-	r->out_payload->iov_len = KNOT_WIRE_MAX_PKTSIZE;
+	static _Thread_local quic_stats_local_t *local = NULL;
+	if (local != NULL) {
+		return local;
+	}
 
-	return KNOT_EOK;
+	local = mm_cache_line_alloc(sizeof(*local));
+	if (local == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&quic_stats.mx);
+	local->next = quic_stats.blocks;
+	quic_stats.blocks = local;
+	pthread_mutex_unlock(&quic_stats.mx);
+
+	return local;
 }
 
-static int uq_send_reply(knot_quic_reply_t *r)
+static void quic_log_cb(const char *line)
+{
+	log_fmt(LOG_DEBUG, LOG_SOURCE_QUIC, "QUIC, %s", line);
+}
+
+static int uq_sendmsg(uq_reply_t *ur, uint8_t *data, size_t len, uint8_t ecn,
+                      size_t seg_size, unsigned segs)
 {
+	knot_quic_reply_t *r = &ur->rpl;
 	int fd = *(int *)r->sock;
 
 	if (r->in_ctx != NULL) {
-		*(int *)r->in_ctx = r->ecn; // set ECN for outgoing CMSG
+		*(int *)r->in_ctx = ecn; // set ECN for outgoing CMSG
+	}
+
+	struct iovec iov = { .iov_base = data, .iov_len = len };
+	struct msghdr msg = *(struct msghdr *)r->out_ctx;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+#ifdef UDP_SEGMENT
+	cmsg_gso_t cmsg;
+	if (segs > 1) {
+		size_t ctl_len = CMSG_ALIGN(msg.msg_controllen);
+		assert(ctl_len + CMSG_SPACE(sizeof(uint16_t)) <= sizeof(cmsg));
+		memset(&cmsg, 0, sizeof(cmsg));
+		if (msg.msg_controllen > 0) {
+			memcpy(cmsg.buf, msg.msg_control, msg.msg_controllen);
+		}
+		struct cmsghdr *gso = (struct cmsghdr *)(cmsg.buf + ctl_len);
+		gso->cmsg_level = SOL_UDP;
+		gso->cmsg_type = UDP_SEGMENT;
+		gso->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		*(uint16_t *)CMSG_DATA(gso) = seg_size;
+		msg.msg_control = cmsg.buf;
+		msg.msg_controllen = ctl_len + CMSG_SPACE(sizeof(uint16_t));
+	}
+#endif
+
+	int ret = sendmsg(fd, &msg, 0);
+#ifdef UDP_SEGMENT
+	if (ret < 0 && segs > 1 && (errno == EIO || errno == EINVAL)) {
+		// GSO not supported by the device or the kernel, send one by one.
+		ATOMIC_SET(gso_disabled, true);
+		for (size_t off = 0; off < len; off += seg_size) {
+			ret = uq_sendmsg(ur, data + off, MIN(seg_size, len - off),
+			                 ecn, seg_size, 1);
+		}
+		return ret;
+	}
+#endif
+
+	quic_stats_local_t *stats = stats_local();
+	if (stats != NULL) {
+		ATOMIC_ADD_OWNED(stats->send_calls, 1);
+		ATOMIC_ADD_OWNED(stats->send_segments, segs);
 	}
-	int ret = sendmsg(fd, r->out_ctx, 0);
+
 	if (ret < 0) {
 		return knot_map_errno();
-	} else if (ret == r->out_payload->iov_len) {
+	} else if (ret == len) {
 		return KNOT_EOK;
 	} else {
 		return KNOT_EAGAIN;
 	}
 }
 
+static int uq_flush_reply(uq_reply_t *ur)
+{
+	if (ur->segs == 0) {
+		return KNOT_EOK;
+	}
+
+	int ret = uq_sendmsg(ur, ur->buf, ur->len, ur->ecn, ur->seg_size, ur->segs);
+	ur->len = 0;
+	ur->segs = 0;
+
+	return ret;
+}
+
+static int uq_alloc_reply(knot_quic_reply_t *r)
+{
+	uq_reply_t *ur = (uq_reply_t *)r;
+
+	int ret = KNOT_EOK;
+	if (KNOT_WIRE_MAX_PKTSIZE - ur->len < GSO_MIN_SPACE) {
+		ret = uq_flush_reply(ur);
+	}
+
+	// Next packet is written after the pending ones.
+	r->out_payload->iov_base = ur->buf + ur->len;
+	r->out_payload->iov_len = KNOT_WIRE_MAX_PKTSIZE - ur->len;
+
+	return ret;
+}
+
+static int uq_send_reply(knot_quic_reply_t *r)
+{
+	uq_reply_t *ur = (uq_reply_t *)r;
+	uint8_t *pkt = r->out_payload->iov_base;
+	size_t pkt_len = r->out_payload->iov_len;
+
+	if (!gso_enabled()) {
+		return uq_sendmsg(ur, pkt, pkt_len, r->ecn, pkt_len, 1);
+	}
+
+	/* All but the last segment must be of the same size and ECN. */
+	int ret = KNOT_EOK;
+	bool last_smaller = (ur->segs > 0 && ur->len % ur->seg_size != 0);
+	if (ur->segs > 0 && (last_smaller || pkt_len > ur->seg_size || r->ecn != ur->ecn)) {
+		ret = uq_flush_reply(ur);
+		memmove(ur->buf, pkt, pkt_len);
+	}
+
+	if (ur->segs == 0) {
+		ur->seg_size = pkt_len;
+		ur->ecn = r->ecn;
+	}
+	ur->len += pkt_len;
+	ur->segs++;
+
+	if (ur->segs == GSO_MAX_SEGMENTS) {
+		int flush_ret = uq_flush_reply(ur);
+		if (ret == KNOT_EOK) {
+			ret = flush_ret;
+		}
+	}
+
+	return ret;
+}
+
 static void uq_free_reply(knot_quic_reply_t *r)
 {
 	// This prevents udp send handler from sending.
 	r->out_payload->iov_len = 0;
 }
 
-void quic_handler(knotd_qdata_params_t *params, knot_layer_t *layer,
-                  uint64_t idle_close, knot_quic_table_t *table,
-                  struct iovec *rx, struct msghdr *mh_out, int *p_ecn)
-{
-	knot_quic_reply_t rpl = {
-		.ip_rem = params->remote,
-		.ip_loc = params->local,
-		.in_payload = rx,
-		.out_payload = mh_out->msg_iov,
-		.sock = &params->socket,
-		.in_ctx = p_ecn,
-		.out_ctx = mh_out,
-		.ecn = (p_ecn == NULL ? 0 : (*p_ecn & 0x3)),
-		.alloc_reply = uq_alloc_reply,
-		.send_reply = uq_send_reply,
-		.free_reply = uq_free_reply
-	};
-
-	rpl.out_payload->iov_len = 0; // prevent send attempt if uq_alloc_reply is not called at all
-
+static void quic_handle_packet(knotd_qdata_params_t *params, knot_layer_t *layer,
+                               uint64_t idle_close, knot_quic_table_t *table,
+                               knot_quic_reply_t *rpl)
+{
 	if (process_query_proto(params, KNOTD_STAGE_PROTO_BEGIN) == KNOTD_PROTO_STATE_BLOCK) {
 		return;
 	}
 
 	knot_quic_conn_t *conn = NULL;
-	(void)knot_quic_handle(table, &rpl, idle_close, &conn);
+	(void)knot_quic_handle(table, rpl, idle_close, &conn);
 
 	if (conn != NULL) {
 		handle_quic_streams(conn, params, layer);
 
-		(void)knot_quic_send(table, conn, &rpl, QUIC_MAX_SEND_PER_RECV, 0);
+		(void)knot_quic_send(table, conn, rpl, QUIC_MAX_SEND_PER_RECV, 0);
 
 		knot_quic_cleanup(&conn, 1);
 	}
@@ -111,6 +276,72 @@ void quic_handler(knotd_qdata_params_t *params, knot_layer_t *layer,
 	(void)process_query_proto(params, KNOTD_STAGE_PROTO_END);
 }
 
+void quic_handler(knotd_qdata_params_t *params, knot_layer_t *layer,
+                  uint64_t idle_close, knot_quic_table_t *table,
+                  struct iovec *rx, struct msghdr *mh_out, int *p_ecn,
+                  size_t gro_size)
+{
+	struct iovec segment;
+	uq_reply_t ur = {
+		.rpl = {
+			.ip_rem = params->remote,
+			.ip_loc = params->local,
+			.in_payload = &segment,
+			.out_payload = mh_out->msg_iov,
+			.sock = &params->socket,
+			.in_ctx = p_ecn,
+			.out_ctx = mh_out,
+			.ecn = (p_ecn == NULL ? 0 : (*p_ecn & 0x3)),
+			.alloc_reply = uq_alloc_reply,
+			.send_reply = uq_send_reply,
+			.free_reply = uq_free_reply
+		},
+		.buf = mh_out->msg_iov->iov_base,
+	};
+	quic_stats_local_t *stats = stats_local();
+
+	// Split datagrams coalesced by UDP GRO.
+	if (gro_size == 0 || gro_size > rx->iov_len) {
+		gro_size = rx->iov_len;
+	}
+	size_t off = 0;
+	do {
+		segment.iov_base = (uint8_t *)rx->iov_base + off;
+		segment.iov_len = MIN(gro_size, rx->iov_len - off);
+		ur.rpl.handle_ret = 0;
+
+		quic_handle_packet(params, layer, idle_close, table, &ur.rpl);
+
+		if (stats != NULL) {
+			ATOMIC_ADD_OWNED(stats->recv_segments, 1);
+		}
+		off += gro_size;
+	} while (off < rx->iov_len);
+	if (stats != NULL) {
+		ATOMIC_ADD_OWNED(stats->recv_calls, 1);
+	}
+
+	(void)uq_flush_reply(&ur);
+
+	// Restore the output buffer and prevent the UDP handler from sending.
+	mh_out->msg_iov->iov_base = ur.buf;
+	mh_out->msg_iov->iov_len = 0;
+}
+
+void quic_stats_get(quic_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	pthread_mutex_lock(&quic_stats.mx);
+	for (quic_stats_local_t *it = quic_stats.blocks; it != NULL; it = it->next) {
+		stats->send_calls += ATOMIC_GET(it->send_calls);
+		stats->send_segments += ATOMIC_GET(it->send_segments);
+		stats->recv_calls += ATOMIC_GET(it->recv_calls);
+		stats->recv_segments += ATOMIC_GET(it->recv_segments);
+	}
+	pthread_mutex_unlock(&quic_stats.mx);
+}
+
 knot_quic_table_t *quic_make_table(struct server *server)
 {
 	conf_t *pconf = conf();
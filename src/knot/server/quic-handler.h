@@ -23,6 +23,14 @@
 
 struct server;
 
+/*! \brief Counters of QUIC packets and system calls. */
+typedef struct {
+	uint64_t send_calls;    /*!< Send system calls. */
+	uint64_t send_segments; /*!< Packets sent (more per call with UDP GSO). */
+	uint64_t recv_calls;    /*!< Received datagrams (possibly coalesced by UDP GRO). */
+	uint64_t recv_segments; /*!< Packets received. */
+} quic_stats_t;
+
 /*!
  * \brief Handle a received QUIC packet.
  *
@@ -35,10 +43,19 @@ struct server;
  * \param rx            Incoming packet payload.
  * \param mh_out        Msghdr for outgoing packets.
  * \param p_ecn         Pointer on in/out ECN in cmsg header.
+ * \param gro_size      Segment size of coalesced packets (UDP GRO), or zero.
  */
 void quic_handler(knotd_qdata_params_t *params, knot_layer_t *layer,
                   uint64_t idle_close, knot_quic_table_t *table,
-                  struct iovec *rx, struct msghdr *mh_out, int *p_ecn);
+                  struct iovec *rx, struct msghdr *mh_out, int *p_ecn,
+                  size_t gro_size);
+
+/*!
+ * \brief Get the QUIC packet and system call counters.
+ *
+ * \param stats  Output counters.
+ */
+void quic_stats_get(quic_stats_t *stats);
 
 /*!
  * \brief Allocate QUIC connection table.
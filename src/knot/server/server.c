@@ -40,6 +40,7 @@
 #include "knot/conf/module.h"
 #include "knot/dnssec/kasp/kasp_db.h"
 #include "knot/journal/journal_basic.h"
+#include "knot/query/soa-batch.h"
 #include "knot/server/server.h"
 #include "knot/server/udp-handler.h"
 #include "knot/server/tcp-handler.h"
@@ -364,7 +365,8 @@ static iface_t *server_init_xdp_iface(struct sockaddr_storage *addr, bool route_
  */
 static iface_t *server_init_iface(struct sockaddr_storage *addr, bool tls,
                                   int udp_thread_count, int tcp_thread_count,
-                                  bool tcp_reuseport, bool socket_affinity)
+                                  bool tcp_reuseport, bool socket_affinity,
+                                  bool udp_gro)
 {
 	iface_t *new_if = calloc(1, sizeof(*new_if));
 	if (new_if == NULL) {
@@ -407,6 +409,7 @@ static iface_t *server_init_iface(struct sockaddr_storage *addr, bool tls,
 	bool warn_bufsize = true;
 	bool warn_pktinfo = true;
 	bool warn_ecn = true;
+	bool warn_gro = true;
 	bool warn_flag_misc = true;
 
 	/* Create bound UDP sockets. */
@@ -466,6 +469,14 @@ static iface_t *server_init_iface(struct sockaddr_storage *addr, bool tls,
 			}
 		}
 
+		if (tls && udp_gro) {
+			ret = net_udp_gro_enable(sock);
+			if (ret != KNOT_EOK && ret != KNOT_ENOTSUP && warn_gro) {
+				log_warning("failed to enable UDP GRO for QUIC");
+				warn_gro = false;
+			}
+		}
+
 		new_if->fd_udp[new_if->fd_udp_count] = sock;
 		new_if->fd_udp_count += 1;
 	}
@@ -698,6 +709,8 @@ static int configure_sockets(conf_t *conf, server_t *s)
 	unsigned size_tcp = s->handlers[IO_TCP].handler.unit->size;
 	bool tcp_reuseport = conf->cache.srv_tcp_reuseport;
 	bool socket_affinity = conf->cache.srv_socket_affinity;
+	// Provided io_uring buffers are too small for coalesced datagrams.
+	bool udp_gro = !conf->cache.srv_udp_io_uring;
 	char *rundir = conf_abs_path(&rundir_val, NULL);
 	while (listen_val.code == KNOT_EOK) {
 		struct sockaddr_storage addr = conf_addr(&listen_val, rundir);
@@ -706,7 +719,7 @@ static int configure_sockets(conf_t *conf, server_t *s)
 		log_info("binding to interface %s", addr_str);
 
 		iface_t *new_if = server_init_iface(&addr, false, size_udp, size_tcp,
-		                                    tcp_reuseport, socket_affinity);
+		                                    tcp_reuseport, socket_affinity, false);
 		if (new_if == NULL) {
 			server_deinit_iface_list(newlist, nifs);
 			free(rundir);
@@ -724,7 +737,7 @@ static int configure_sockets(conf_t *conf, server_t *s)
 		log_info("binding to QUIC interface %s", addr_str);
 
 		iface_t *new_if = server_init_iface(&addr, true, size_udp, 0,
-		                                    false, socket_affinity);
+		                                    false, socket_affinity, udp_gro);
 		if (new_if == NULL) {
 			server_deinit_iface_list(newlist, nifs);
 			free(rundir);
@@ -743,7 +756,7 @@ static int configure_sockets(conf_t *conf, server_t *s)
 		log_info("binding to TLS interface %s", addr_str);
 
 		iface_t *new_if = server_init_iface(&addr, true, 0, size_tcp,
-		                                    tcp_reuseport, socket_affinity);
+		                                    tcp_reuseport, socket_affinity, false);
 		if (new_if == NULL) {
 			server_deinit_iface_list(newlist, nifs);
 			free(rundir);
@@ -856,6 +869,8 @@ int server_init(server_t *server, int bg_workers)
 	conf_val_t journal_mode = conf_db_param(conf(), C_JOURNAL_DB_MODE);
 	knot_lmdb_init(&server->journaldb, journal_dir, conf_int(&journal_size), journal_env_flags(conf_opt(&journal_mode), false), NULL);
 	free(journal_dir);
+	conf_val_t journal_delay = conf_db_param(conf(), C_JOURNAL_DB_COMMIT_DELAY);
+	server->journaldb.batch_delay = conf_int(&journal_delay);
 
 	kasp_db_ensure_init(&server->kaspdb, conf());
 
@@ -916,6 +931,7 @@ void server_deinit(server_t *server)
 	global_conn_pool = NULL;
 	conn_pool_deinit(global_sessticket_pool);
 	global_sessticket_pool = NULL;
+	soa_batch_deinit();
 	knot_unreachables_deinit(&global_unreachables);
 
 	knot_creds_free(server->quic_creds);
@@ -1184,6 +1200,7 @@ static void warn_server_reconfigure(conf_t *conf, server_t *server)
 
 	static bool warn_tcp_reuseport = true;
 	static bool warn_socket_affinity = true;
+	static bool warn_udp_io_uring = true;
 	static bool warn_udp = true;
 	static bool warn_tcp = true;
 	static bool warn_bg = true;
@@ -1207,6 +1224,11 @@ static void warn_server_reconfigure(conf_t *conf, server_t *server)
 		warn_socket_affinity = false;
 	}
 
+	if (warn_udp_io_uring && conf->cache.srv_udp_io_uring != conf_get_bool(conf, C_SRV, C_UDP_IO_URING)) {
+		log_warning(msg, &C_UDP_IO_URING[1]);
+		warn_udp_io_uring = false;
+	}
+
 	if (warn_udp && server->handlers[IO_UDP].size != conf_udp_threads(conf)) {
 		log_warning(msg, &C_UDP_WORKERS[1]);
 		warn_udp = false;
@@ -1414,6 +1436,9 @@ static int reconfigure_journal_db(conf_t *conf, server_t *server)
 	}
 	free(journal_dir);
 
+	conf_val_t journal_delay = conf_db_param(conf, C_JOURNAL_DB_COMMIT_DELAY);
+	server->journaldb.batch_delay = conf_int(&journal_delay);
+
 	return KNOT_EOK; // not "ret"
 }
 
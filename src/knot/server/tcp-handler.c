@@ -37,6 +37,7 @@
 #include "knot/nameserver/process_query.h"
 #include "knot/query/layer.h"
 #include "libknot/quic/tls.h"
+#include "libknot/wire.h"
 #include "contrib/macros.h"
 #include "contrib/mempattern.h"
 #include "contrib/net.h"
@@ -61,6 +62,18 @@ typedef struct tcp_context {
 	struct knot_tls_ctx *tls_ctx;    /*!< DoT answering context. */
 } tcp_context_t;
 
+/*! \brief Per-connection state of a TCP client. */
+typedef struct {
+	knot_tls_conn_t *tls_conn;       /*!< DoT session (if DoT). */
+	uint8_t *inbuf;                  /*!< Received but not processed data. */
+	size_t inbuf_len;                /*!< Length of the received data. */
+	uint8_t *outbuf;                 /*!< Unsent remainder of the last reply. */
+	size_t outbuf_len;               /*!< Length of the unsent remainder. */
+	size_t outbuf_pos;               /*!< Already sent part of the remainder. */
+} tcp_conn_t;
+
+#define TCP_RX_BUFSIZE (sizeof(uint16_t) + KNOT_WIRE_MAX_PKTSIZE)
+
 #define TCP_SWEEP_INTERVAL 2 /*!< [secs] granularity of connection sweeping. */
 
 static void update_sweep_timer(struct timespec *timer)
@@ -84,10 +97,18 @@ static void update_tcp_conf(tcp_context_t *tcp)
 	}
 }
 
-static void free_tls_ctx(fdset_t *set, int idx)
+static void free_conn_ctx(fdset_t *set, int idx)
 {
-	void *tls_conn = *fdset_ctx2(set, idx);
-	knot_tls_conn_del(tls_conn);
+	tcp_conn_t *conn = *fdset_ctx2(set, idx);
+	if (conn == NULL) {
+		return;
+	}
+
+	knot_tls_conn_del(conn->tls_conn);
+	free(conn->inbuf);
+	free(conn->outbuf);
+	free(conn);
+	*fdset_ctx2(set, idx) = NULL;
 }
 
 /*! \brief Sweep TCP connection. */
@@ -105,7 +126,7 @@ static fdset_sweep_state_t tcp_sweep(fdset_t *set, int idx, _unused_ void *data)
 		log_notice("TCP, terminated inactive client, address %s", addr_str);
 	}
 
-	free_tls_ctx(set, idx);
+	free_conn_ctx(set, idx);
 
 	return FDSET_SWEEP;
 }
@@ -155,27 +176,29 @@ static unsigned tcp_set_ifaces(const iface_t *ifaces, size_t n_ifaces,
 	return fdset_get_length(fds);
 }
 
-static int tcp_handle(tcp_context_t *tcp, knotd_qdata_params_t *params,
-                      struct iovec *rx, struct iovec *tx)
+/*!
+ * \brief Receive and answer one DoT query.
+ *
+ * \note Unlike plain TCP, this blocks the worker up to the IO timeout when
+ *       the query is incomplete or the reply doesn't fit into the socket.
+ */
+static int tcp_handle_tls(tcp_context_t *tcp, knotd_qdata_params_t *params,
+                          struct iovec *rx, struct iovec *tx)
 {
 	rx->iov_len = KNOT_WIRE_MAX_PKTSIZE;
 	tx->iov_len = KNOT_WIRE_MAX_PKTSIZE;
 
 	/* Receive data. */
 	int recv;
-	if (params->tls_conn != NULL) {
-		int ret = knot_tls_handshake(params->tls_conn, true);
-		switch (ret) {
-		case KNOT_EAGAIN: // Unfinished handshake, continue later.
-			return KNOT_EOK;
-		case KNOT_EOK: // Finished handshake, continue with receiving message.
-			recv = knot_tls_recv_dns(params->tls_conn, rx->iov_base, rx->iov_len);
-			break;
-		default: // E.g. handshake timeout.
-			return ret;
-		}
-	} else {
-		recv = net_dns_tcp_recv(params->socket, rx->iov_base, rx->iov_len, tcp->io_timeout);
+	int ret = knot_tls_handshake(params->tls_conn, true);
+	switch (ret) {
+	case KNOT_EAGAIN: // Unfinished handshake, continue later.
+		return KNOT_EOK;
+	case KNOT_EOK: // Finished handshake, continue with receiving message.
+		recv = knot_tls_recv_dns(params->tls_conn, rx->iov_base, rx->iov_len);
+		break;
+	default: // E.g. handshake timeout.
+		return ret;
 	}
 	if (recv > 0) {
 		rx->iov_len = recv;
@@ -183,6 +206,7 @@ static int tcp_handle(tcp_context_t *tcp, knotd_qdata_params_t *params,
 		tcp_log_error(params->remote, "receive", recv);
 		return KNOT_EOF;
 	}
+	clock_gettime(CLOCK_MONOTONIC, &params->recv_time);
 
 	handle_query(params, &tcp->layer, rx, NULL);
 
@@ -192,13 +216,7 @@ static int tcp_handle(tcp_context_t *tcp, knotd_qdata_params_t *params,
 		knot_layer_produce(&tcp->layer, ans);
 		/* Send, if response generation passed and wasn't ignored. */
 		if (ans->size > 0 && send_state(tcp->layer.state)) {
-			int sent;
-			if (params->tls_conn != NULL) {
-				sent = knot_tls_send_dns(params->tls_conn, ans->wire, ans->size);
-			} else {
-				sent = net_dns_tcp_send(params->socket, ans->wire, ans->size,
-				                        tcp->io_timeout, NULL);
-			}
+			int sent = knot_tls_send_dns(params->tls_conn, ans->wire, ans->size);
 			if (sent != ans->size) {
 				tcp_log_error(params->remote, "send", sent);
 				handle_finish(&tcp->layer);
@@ -212,6 +230,233 @@ static int tcp_handle(tcp_context_t *tcp, knotd_qdata_params_t *params,
 	return KNOT_EOK;
 }
 
+static bool io_would_block(void)
+{
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+/*!
+ * \brief Send out as much of the unsent reply remainder as possible.
+ *
+ * \param timeout_ms  Negative for non-blocking flush, otherwise wait for
+ *                    the whole remainder to be sent (0 for infinity).
+ */
+static int tcp_flush(int fd, tcp_conn_t *conn, int timeout_ms)
+{
+	if (conn->outbuf_len == 0) {
+		return KNOT_EOK;
+	}
+
+	const uint8_t *data = conn->outbuf + conn->outbuf_pos;
+	size_t len = conn->outbuf_len - conn->outbuf_pos;
+
+	if (timeout_ms >= 0) {
+		ssize_t ret = net_stream_send(fd, data, len, timeout_ms);
+		if (ret < 0) {
+			return ret;
+		}
+		conn->outbuf_pos = conn->outbuf_len;
+	} else {
+		ssize_t ret = send(fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (ret < 0) {
+			return io_would_block() ? KNOT_EOK : KNOT_ECONN;
+		}
+		conn->outbuf_pos += ret;
+	}
+
+	if (conn->outbuf_pos == conn->outbuf_len) {
+		free(conn->outbuf);
+		conn->outbuf = NULL;
+		conn->outbuf_len = 0;
+		conn->outbuf_pos = 0;
+	}
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Send one DNS message without blocking, keep the unsent rest.
+ *
+ * The previous reply remainder (e.g. from a multi-message zone transfer)
+ * must be flushed first, which may block up to the IO timeout.
+ */
+static int tcp_send(tcp_context_t *tcp, int fd, tcp_conn_t *conn,
+                    const uint8_t *wire, size_t size)
+{
+	int ret = tcp_flush(fd, conn, tcp->io_timeout);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	uint16_t pktsize = htons(size);
+	struct iovec iov[2] = {
+		{ .iov_base = &pktsize,      .iov_len = sizeof(pktsize) },
+		{ .iov_base = (void *)wire,  .iov_len = size }
+	};
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = 2
+	};
+
+	ssize_t sent = sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (sent < 0) {
+		if (!io_would_block()) {
+			return KNOT_ECONN;
+		}
+		sent = 0;
+	}
+
+	size_t done = sent;
+	size_t total = sizeof(pktsize) + size;
+	if (done == total) {
+		return KNOT_EOK;
+	}
+
+	/* Keep the rest for later, sent once the socket is writable. */
+	assert(conn->outbuf == NULL);
+	conn->outbuf = malloc(total - done);
+	if (conn->outbuf == NULL) {
+		return KNOT_ENOMEM;
+	}
+	for (int i = 0; i < 2; i++) {
+		size_t skip = MIN(done, iov[i].iov_len);
+		done -= skip;
+		memcpy(conn->outbuf + conn->outbuf_len,
+		       (uint8_t *)iov[i].iov_base + skip, iov[i].iov_len - skip);
+		conn->outbuf_len += iov[i].iov_len - skip;
+	}
+
+	return KNOT_EOK;
+}
+
+static int tcp_answer(tcp_context_t *tcp, knotd_qdata_params_t *params,
+                      tcp_conn_t *conn, struct iovec *query, struct iovec *tx)
+{
+	tx->iov_len = KNOT_WIRE_MAX_PKTSIZE;
+
+	handle_query(params, &tcp->layer, query, NULL);
+
+	/* Resolve until NOOP or finished. */
+	knot_pkt_t *ans = knot_pkt_new(tx->iov_base, tx->iov_len, tcp->layer.mm);
+	while (active_state(tcp->layer.state)) {
+		knot_layer_produce(&tcp->layer, ans);
+		/* Send, if response generation passed and wasn't ignored. */
+		if (ans->size > 0 && send_state(tcp->layer.state)) {
+			int ret = tcp_send(tcp, params->socket, conn, ans->wire, ans->size);
+			if (ret != KNOT_EOK) {
+				tcp_log_error(params->remote, "send", ret);
+				handle_finish(&tcp->layer);
+				return KNOT_EOF;
+			}
+		}
+	}
+
+	handle_finish(&tcp->layer);
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Receive available data and answer all complete queries in it.
+ *
+ * Neither partially received queries nor replies not fitting into the socket
+ * buffer block the worker. Further queries aren't processed until the pending
+ * reply is sent out.
+ *
+ * \param readable  Receive new data from the socket.
+ * \param active    Output flag set if some query was answered.
+ */
+static int tcp_handle(tcp_context_t *tcp, knotd_qdata_params_t *params,
+                      tcp_conn_t *conn, bool readable, bool *active,
+                      struct iovec *rx, struct iovec *tx)
+{
+	uint8_t *buf = rx->iov_base;
+	size_t len = 0;
+
+	/* Continue with previously received data. */
+	if (conn->inbuf_len > 0) {
+		assert(conn->inbuf_len <= TCP_RX_BUFSIZE);
+		memcpy(buf, conn->inbuf, conn->inbuf_len);
+		len = conn->inbuf_len;
+		free(conn->inbuf);
+		conn->inbuf = NULL;
+		conn->inbuf_len = 0;
+	}
+
+	if (readable) {
+		assert(len < TCP_RX_BUFSIZE);
+		ssize_t recv = recvfrom(params->socket, buf + len, TCP_RX_BUFSIZE - len,
+		                        MSG_DONTWAIT | MSG_NOSIGNAL, NULL, NULL);
+		if (recv == 0) {
+			return KNOT_EOF;
+		} else if (recv < 0) {
+			if (!io_would_block()) {
+				return KNOT_EOF;
+			}
+			recv = 0;
+		}
+		len += recv;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &params->recv_time);
+
+	size_t pos = 0;
+	while (len - pos >= sizeof(uint16_t) && conn->outbuf_len == 0) {
+		size_t size = knot_wire_read_u16(buf + pos);
+		if (len - pos - sizeof(uint16_t) < size) {
+			break;
+		}
+
+		struct iovec query = {
+			.iov_base = buf + pos + sizeof(uint16_t),
+			.iov_len = size
+		};
+		pos += sizeof(uint16_t) + size;
+		*active = true;
+
+		int ret = tcp_answer(tcp, params, conn, &query, tx);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	/* Store the unprocessed rest. */
+	if (pos < len) {
+		conn->inbuf = malloc(len - pos);
+		if (conn->inbuf == NULL) {
+			return KNOT_ENOMEM;
+		}
+		memcpy(conn->inbuf, buf + pos, len - pos);
+		conn->inbuf_len = len - pos;
+	}
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Serve a plain TCP connection which is readable or writable.
+ *
+ * A writable connection has a pending reply. Once it's sent out, the queries
+ * received in the meantime are answered.
+ */
+static int tcp_serve(tcp_context_t *tcp, knotd_qdata_params_t *params,
+                     tcp_conn_t *conn, bool writable, bool *active)
+{
+	if (!writable) {
+		return tcp_handle(tcp, params, conn, true, active,
+		                  &tcp->iov[0], &tcp->iov[1]);
+	}
+
+	*active = true;
+	int ret = tcp_flush(params->socket, conn, -1);
+	if (ret == KNOT_EOK && conn->outbuf_len == 0) {
+		ret = tcp_handle(tcp, params, conn, false, active,
+		                 &tcp->iov[0], &tcp->iov[1]);
+	}
+
+	return ret;
+}
+
 static void tcp_event_accept(tcp_context_t *tcp, unsigned i, const iface_t *iface)
 {
 	/* Accept client. */
@@ -230,7 +475,8 @@ static void tcp_event_accept(tcp_context_t *tcp, unsigned i, const iface_t *ifac
 	}
 }
 
-static int tcp_event_serve(tcp_context_t *tcp, unsigned i, const iface_t *iface)
+static int tcp_event_serve(tcp_context_t *tcp, unsigned i, const iface_t *iface,
+                           bool writable)
 {
 	int fd = fdset_get_fd(&tcp->set, i);
 
@@ -268,22 +514,40 @@ static int tcp_event_serve(tcp_context_t *tcp, unsigned i, const iface_t *iface)
 		return KNOT_EDENIED; // results in closing connection
 	}
 
-	/* Establish a TLS session. */
+	tcp_conn_t *conn = *fdset_ctx2(&tcp->set, i);
+	if (conn == NULL) {
+		conn = calloc(1, sizeof(*conn));
+		if (conn == NULL) {
+			return KNOT_ENOMEM;
+		}
+		*fdset_ctx2(&tcp->set, i) = conn;
+	}
+
+	int ret;
+	bool active = false;
 	if (iface->tls) {
+		/* Establish a TLS session. */
 		assert(tcp->tls_ctx != NULL);
-		knot_tls_conn_t *tls_conn = *fdset_ctx2(&tcp->set, i);
-		if (tls_conn == NULL) {
-			tls_conn = knot_tls_conn_new(tcp->tls_ctx, fd);
-			if (tls_conn == NULL) {
+		if (conn->tls_conn == NULL) {
+			conn->tls_conn = knot_tls_conn_new(tcp->tls_ctx, fd);
+			if (conn->tls_conn == NULL) {
 				return KNOT_ENOMEM;
 			}
-			*fdset_ctx2(&tcp->set, i) = tls_conn;
 		}
-		params_update_tls(&params, tls_conn);
+		params_update_tls(&params, conn->tls_conn);
+
+		ret = tcp_handle_tls(tcp, &params, &tcp->iov[0], &tcp->iov[1]);
+		active = true;
+	} else {
+		ret = tcp_serve(tcp, &params, conn, writable, &active);
 	}
 
-	int ret = tcp_handle(tcp, &params, &tcp->iov[0], &tcp->iov[1]);
 	if (ret == KNOT_EOK) {
+		/* Wait for writability if some reply is pending. */
+		ret = fdset_set_events(&tcp->set, i, (conn->outbuf_len > 0) ?
+		                       FDSET_POLLOUT : FDSET_POLLIN);
+	}
+	if (ret == KNOT_EOK && active) {
 		/* Update socket activity timer. */
 		(void)fdset_set_watchdog(&tcp->set, i, tcp->idle_timeout);
 	}
@@ -317,6 +581,12 @@ static void tcp_wait_for_events(tcp_context_t *tcp)
 		unsigned int idx = fdset_it_get_idx(&it);
 		if (fdset_it_is_error(&it)) {
 			should_close = (idx >= tcp->client_threshold);
+		} else if (fdset_it_is_pollout(&it)) {
+			const iface_t *iface = fdset_it_get_ctx(&it);
+			assert(iface && idx >= tcp->client_threshold);
+			if (tcp_event_serve(tcp, idx, iface, true) != KNOT_EOK) {
+				should_close = true;
+			}
 		} else if (fdset_it_is_pollin(&it)) {
 			const iface_t *iface = fdset_it_get_ctx(&it);
 			assert(iface);
@@ -328,14 +598,14 @@ static void tcp_wait_for_events(tcp_context_t *tcp)
 				}
 			/* Client sockets - already accepted connection or
 			   closed connection :-( */
-			} else if (tcp_event_serve(tcp, idx, iface) != KNOT_EOK) {
+			} else if (tcp_event_serve(tcp, idx, iface, false) != KNOT_EOK) {
 				should_close = true;
 			}
 		}
 
 		/* Evaluate. */
 		if (should_close) {
-			free_tls_ctx(set, idx);
+			free_conn_ctx(set, idx);
 			fdset_it_remove(&it);
 		}
 	}
@@ -378,7 +648,7 @@ int tcp_master(dthread_t *thread)
 
 	/* Create iovec abstraction. */
 	for (unsigned i = 0; i < 2; ++i) {
-		tcp.iov[i].iov_len = KNOT_WIRE_MAX_PKTSIZE;
+		tcp.iov[i].iov_len = TCP_RX_BUFSIZE;
 		tcp.iov[i].iov_base = malloc(tcp.iov[i].iov_len);
 		if (tcp.iov[i].iov_base == NULL) {
 			ret = KNOT_ENOMEM;
@@ -435,6 +705,9 @@ int tcp_master(dthread_t *thread)
 	}
 
 finish:
+	for (unsigned i = tcp.client_threshold; i < fdset_get_length(&tcp.set); i++) {
+		free_conn_ctx(&tcp.set, i);
+	}
 	knot_tls_ctx_free(tcp.tls_ctx);
 	free(tcp.iov[0].iov_base);
 	free(tcp.iov[1].iov_base);
@@ -25,13 +25,18 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/udp.h> // UDP_GRO
 #include <arpa/inet.h>
 #include <sys/param.h>
 #ifdef HAVE_SYS_UIO_H	// struct iovec (OpenBSD)
 #include <sys/uio.h>
 #endif /* HAVE_SYS_UIO_H */
 #include <unistd.h>
+#ifdef ENABLE_IO_URING
+#include <liburing.h>
+#endif // ENABLE_IO_URING
 
+#include "contrib/macros.h"
 #include "contrib/mempattern.h"
 #include "contrib/net.h"
 #include "contrib/sockaddr.h"
@@ -85,18 +90,19 @@ static void udp_handler(udp_context_t *udp, knotd_qdata_params_t *params,
 }
 
 typedef struct {
-	void* (*udp_init)(udp_context_t *, void *);
+	void* (*udp_init)(udp_context_t *, fdset_t *, void *);
 	void (*udp_deinit)(void *);
 	int (*udp_recv)(int, void *);
 	void (*udp_handle)(udp_context_t *, const iface_t *, void *);
 	void (*udp_send)(void *);
 	void (*udp_sweep)(udp_context_t *, void *);
+	int (*udp_wait)(void *, int); /*!< Completion based API waiting instead of polling. */
 } udp_api_t;
 
-/*! \brief Control message to fit IP_PKTINFO/IPv6_RECVPKTINFO and/or ECN. */
+/*! \brief Control message to fit IP_PKTINFO/IPv6_RECVPKTINFO, ECN, and/or UDP GRO. */
 typedef union {
 	struct cmsghdr cmsg;
-	uint8_t buf[CMSG_SPACE(sizeof(struct in6_pktinfo)) + CMSG_SPACE(sizeof(int))];
+	uint8_t buf[CMSG_SPACE(sizeof(struct in6_pktinfo)) + 2 * CMSG_SPACE(sizeof(int))];
 } cmsg_buf_t;
 
 static const sockaddr_t *local_addr(sockaddr_t *local_storage, const iface_t *iface)
@@ -145,10 +151,31 @@ static void cmsg_handle_pktinfo(sockaddr_t *local, const iface_t *iface,
 	}
 }
 
+#ifdef UDP_GRO
+/*! \brief Remove the control message, return the one taking its place or NULL. */
+static struct cmsghdr *cmsg_remove(struct msghdr *msg, struct cmsghdr *cmsg)
+{
+	uint8_t *begin = (uint8_t *)cmsg;
+	uint8_t *end = (uint8_t *)msg->msg_control + msg->msg_controllen;
+	size_t len = MIN(CMSG_ALIGN(cmsg->cmsg_len), end - begin);
+
+	memmove(begin, begin + len, end - begin - len);
+	msg->msg_controllen -= len;
+	if (msg->msg_controllen == 0) {
+		msg->msg_control = NULL;
+		return NULL;
+	}
+
+	return (begin + sizeof(*cmsg) <= end - len) ? cmsg : NULL;
+}
+#endif
+
 void cmsg_handle(const struct msghdr *rx, struct msghdr *tx,
-                 sockaddr_t *local, int **p_ecn, const iface_t *iface)
+                 sockaddr_t *local, int **p_ecn, size_t *gro_size,
+                 const iface_t *iface)
 {
 	local->un.sun_family = AF_UNSPEC;
+	*gro_size = 0;
 
 	tx->msg_controllen = rx->msg_controllen;
 	if (tx->msg_controllen > 0) {
@@ -162,6 +189,14 @@ void cmsg_handle(const struct msghdr *rx, struct msghdr *tx,
 	if (iface->tls) {
 		*p_ecn = NULL;
 		while (cmsg != NULL) {
+#ifdef UDP_GRO
+			// Coalesced datagrams, the cmsg isn't valid for sending.
+			if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+				*gro_size = *(int *)CMSG_DATA(cmsg);
+				cmsg = cmsg_remove(tx, cmsg);
+				continue;
+			}
+#endif
 			cmsg_handle_ecn(p_ecn, cmsg);
 			cmsg_handle_pktinfo(local, iface, cmsg);
 			cmsg = CMSG_NXTHDR(tx, cmsg);
@@ -176,7 +211,7 @@ void cmsg_handle(const struct msghdr *rx, struct msghdr *tx,
 static void udp_sweep(udp_context_t *ctx, void *d)
 {
 #ifdef ENABLE_QUIC
-	int fd = *(int *)d; // NOTE both udp_msg_ctx_t and udp_mmsg_ctx_t have 'fd' as first item
+	int fd = *(int *)d; // NOTE all udp_*_ctx_t have 'fd' as first item
 	quic_sweep_table(ctx->quic_table, &ctx->quic_closed, fd);
 	quic_reconfigure_table(ctx->quic_table);
 #endif // ENABLE_QUIC
@@ -191,7 +226,8 @@ typedef struct {
 	cmsg_buf_t cmsgs;
 } udp_msg_ctx_t;
 
-static void *udp_msg_init(_unused_ udp_context_t *ctx, _unused_ void *xdp_sock)
+static void *udp_msg_init(_unused_ udp_context_t *ctx, _unused_ fdset_t *fds,
+                          _unused_ void *xdp_sock)
 {
 	udp_msg_ctx_t *rq = calloc(1, sizeof(*rq));
 	if (rq == NULL) {
@@ -247,17 +283,20 @@ static void udp_msg_handle(udp_context_t *ctx, const iface_t *iface, void *d)
 	rq->iov[TX].iov_len = sizeof(rq->iobuf[TX]);
 
 	int *p_ecn;
-	cmsg_handle(&rq->msg[RX], &rq->msg[TX], &ctx->local, &p_ecn, iface);
+	size_t gro_size;
+	cmsg_handle(&rq->msg[RX], &rq->msg[TX], &ctx->local, &p_ecn, &gro_size, iface);
 	const sockaddr_t *local = local_addr(&ctx->local, iface);
 
 	/* Process received pkt. */
 	knotd_qdata_params_t params = params_init(
 		iface->tls ? KNOTD_QUERY_PROTO_QUIC : KNOTD_QUERY_PROTO_UDP,
 		&rq->addr, local, rq->fd, ctx->server, ctx->thread_id);
+	clock_gettime(CLOCK_MONOTONIC, &params.recv_time);
 	if (iface->tls) {
 #ifdef ENABLE_QUIC
 		quic_handler(&params, &ctx->layer, ctx->quic_idle_close,
-		             ctx->quic_table, &rq->iov[RX], &rq->msg[TX], p_ecn);
+		             ctx->quic_table, &rq->iov[RX], &rq->msg[TX], p_ecn,
+		             gro_size);
 #else
 		assert(0);
 #endif // ENABLE_QUIC
@@ -299,7 +338,8 @@ typedef struct {
 	cmsg_buf_t cmsgs[RECVMMSG_BATCHLEN];
 } udp_mmsg_ctx_t;
 
-static void *udp_mmsg_init(_unused_ udp_context_t *ctx, _unused_ void *xdp_sock)
+static void *udp_mmsg_init(_unused_ udp_context_t *ctx, _unused_ fdset_t *fds,
+                           _unused_ void *xdp_sock)
 {
 	udp_mmsg_ctx_t *rq = calloc(1, sizeof(*rq));
 	if (rq == NULL) {
@@ -345,6 +385,18 @@ static void udp_mmsg_handle(udp_context_t *ctx, const iface_t *iface, void *d)
 {
 	udp_mmsg_ctx_t *rq = d;
 
+	struct timespec recv_time;
+	clock_gettime(CLOCK_MONOTONIC, &recv_time);
+
+	/* Let the modules prepare for the whole batch. */
+	if (!iface->tls) {
+		const struct sockaddr_storage *remotes[RECVMMSG_BATCHLEN];
+		for (unsigned i = 0; i < rq->rcvd; ++i) {
+			remotes[i] = (const struct sockaddr_storage *)&rq->addrs[i];
+		}
+		process_query_batch(remotes, rq->rcvd, ctx->thread_id);
+	}
+
 	/* Handle each received message. */
 	unsigned j = 0;
 	for (unsigned i = 0; i < rq->rcvd; ++i) {
@@ -359,16 +411,18 @@ static void udp_mmsg_handle(udp_context_t *ctx, const iface_t *iface, void *d)
 
 		/* Update output message control buffer. */
 		int *p_ecn;
-		cmsg_handle(rx, tx, &ctx->local, &p_ecn, iface);
+		size_t gro_size;
+		cmsg_handle(rx, tx, &ctx->local, &p_ecn, &gro_size, iface);
 		const sockaddr_t *local = local_addr(&ctx->local, iface);
 
 		knotd_qdata_params_t params = params_init(
 			iface->tls ? KNOTD_QUERY_PROTO_QUIC : KNOTD_QUERY_PROTO_UDP,
 			&rq->addrs[i], local, rq->fd, ctx->server, ctx->thread_id);
+		params.recv_time = recv_time;
 		if (iface->tls) {
 #ifdef ENABLE_QUIC
 			quic_handler(&params, &ctx->layer, ctx->quic_idle_close,
-			             ctx->quic_table, rx->msg_iov, tx, p_ecn);
+			             ctx->quic_table, rx->msg_iov, tx, p_ecn, gro_size);
 #else
 		assert(0);
 #endif // ENABLE_QUIC
@@ -418,8 +472,392 @@ static udp_api_t udp_mmsg_api = {
 };
 #endif /* ENABLE_RECVMMSG */
 
+#ifdef ENABLE_IO_URING
+#define URING_BUFS		256	/*!< Provided receive buffers (power of two). */
+#define URING_BUF_PAYLOAD	4096	/*!< Maximum size of a received datagram. */
+#define URING_BATCHLEN		16	/*!< Maximum number of datagrams handled at once. */
+#define URING_BGID		0	/*!< Provided buffer group identifier. */
+
+/* Completion user data tags, the lower half is an index. */
+#define URING_RECV		(1ULL << 32)
+#define URING_SEND		(2ULL << 32)
+
+typedef struct {
+	int fd;
+	const iface_t *iface;
+	struct msghdr msg;	/*!< Multishot receive name and control sizes. */
+} uring_sock_t;
+
+typedef struct {
+	unsigned sock;		/*!< Receiving socket index. */
+	unsigned bid;		/*!< Provided buffer identifier. */
+	int len;		/*!< Received length including the recvmsg header. */
+} uring_rx_t;
+
+typedef struct {
+	struct msghdr msg;
+	struct iovec iov;
+	unsigned sock;
+	unsigned bid;		/*!< Buffer with the query, name, and control data. */
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+} uring_tx_t;
+
+typedef struct {
+	struct io_uring ring;
+	struct io_uring_buf_ring *buf_ring;
+	uint8_t *bufs;		/*!< Provided buffers storage. */
+	size_t buf_size;
+	unsigned recycled;	/*!< Buffers returned to the ring but not yet published. */
+	uring_sock_t *socks;
+	unsigned nsocks;
+	uring_rx_t rx[URING_BUFS]; /*!< Received datagrams not handled yet. */
+	unsigned rx_count;
+	uring_tx_t tx[URING_BATCHLEN];
+	unsigned tx_count;
+	unsigned tx_queued;	/*!< Responses already queued for sending. */
+	unsigned inflight;	/*!< Submitted sends not completed yet. */
+} udp_uring_ctx_t;
+
+static uint8_t *uring_buf(udp_uring_ctx_t *rq, unsigned bid)
+{
+	return rq->bufs + bid * rq->buf_size;
+}
+
+static void uring_recycle(udp_uring_ctx_t *rq, unsigned bid)
+{
+	io_uring_buf_ring_add(rq->buf_ring, uring_buf(rq, bid), rq->buf_size, bid,
+	                      io_uring_buf_ring_mask(URING_BUFS), rq->recycled++);
+}
+
+static struct io_uring_sqe *uring_get_sqe(udp_uring_ctx_t *rq)
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&rq->ring);
+	if (sqe == NULL) {
+		(void)io_uring_submit(&rq->ring);
+		sqe = io_uring_get_sqe(&rq->ring);
+	}
+	return sqe;
+}
+
+static int uring_arm_recv(udp_uring_ctx_t *rq, unsigned idx)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe(rq);
+	if (sqe == NULL) {
+		return KNOT_ESPACE;
+	}
+
+	io_uring_prep_recvmsg_multishot(sqe, rq->socks[idx].fd, &rq->socks[idx].msg, 0);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BGID;
+	io_uring_sqe_set_data64(sqe, URING_RECV | idx);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Process available completions, queue the received datagrams. */
+static void uring_reap(udp_uring_ctx_t *rq)
+{
+	struct io_uring_cqe *cqes[URING_BUFS];
+	unsigned count;
+	while ((count = io_uring_peek_batch_cqe(&rq->ring, cqes, URING_BUFS)) > 0) {
+		for (unsigned i = 0; i < count; i++) {
+			struct io_uring_cqe *cqe = cqes[i];
+			uint64_t data = io_uring_cqe_get_data64(cqe);
+			unsigned idx = data & UINT32_MAX;
+
+			if (data & URING_SEND) {
+				if (cqe->res < 0 && log_enabled_debug()) {
+					log_debug("UDP, failed to send a packet (%s)",
+					          strerror(-cqe->res));
+				}
+				uring_recycle(rq, rq->tx[idx].bid);
+				rq->inflight--;
+				continue;
+			}
+
+			/* Multishot receive terminates e.g. if out of buffers. */
+			if (!(cqe->flags & IORING_CQE_F_MORE)) {
+				if (cqe->res < 0 && cqe->res != -ENOBUFS && log_enabled_debug()) {
+					log_debug("UDP, failed to receive a packet (%s)",
+					          strerror(-cqe->res));
+				}
+				(void)uring_arm_recv(rq, idx);
+			}
+			if (cqe->res < 0 || !(cqe->flags & IORING_CQE_F_BUFFER)) {
+				continue;
+			}
+
+			assert(rq->rx_count < URING_BUFS);
+			rq->rx[rq->rx_count++] = (uring_rx_t) {
+				.sock = idx,
+				.bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT,
+				.len = cqe->res,
+			};
+		}
+		io_uring_cq_advance(&rq->ring, count);
+	}
+
+	if (rq->recycled > 0) {
+		io_uring_buf_ring_advance(rq->buf_ring, rq->recycled);
+		rq->recycled = 0;
+	}
+}
+
+/*!
+ * \brief Wait for completion of all queued sends.
+ *
+ * The response slots and their buffers mustn't be reused before.
+ */
+static bool uring_drain(udp_uring_ctx_t *rq)
+{
+	while (rq->inflight > 0) {
+		int ret = io_uring_submit_and_wait(&rq->ring, 1);
+		if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+			log_debug("UDP, failed to send packets (%s)", strerror(-ret));
+			return false;
+		}
+		uring_reap(rq);
+	}
+	rq->tx_count = 0;
+	rq->tx_queued = 0;
+
+	return true;
+}
+
+static void udp_uring_deinit(void *d);
+
+static void *udp_uring_init(_unused_ udp_context_t *ctx, fdset_t *fds,
+                            _unused_ void *xdp_sock)
+{
+	udp_uring_ctx_t *rq = calloc(1, sizeof(*rq));
+	if (rq == NULL) {
+		return NULL;
+	}
+	rq->nsocks = fdset_get_length(fds);
+
+	/* Deferred task running requires Linux 6.1, which also implies
+	 * multishot recvmsg and provided buffer rings. */
+	struct io_uring_params params = {
+		.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN |
+		         IORING_SETUP_CQSIZE,
+		.cq_entries = 2 * URING_BUFS,
+	};
+	int ret = io_uring_queue_init_params(URING_BATCHLEN + rq->nsocks, &rq->ring, &params);
+	if (ret < 0) {
+		free(rq);
+		return NULL;
+	}
+
+	rq->buf_ring = io_uring_setup_buf_ring(&rq->ring, URING_BUFS, URING_BGID, 0, &ret);
+	rq->buf_size = sizeof(struct io_uring_recvmsg_out) + sizeof(sockaddr_t) +
+	               sizeof(cmsg_buf_t) + URING_BUF_PAYLOAD;
+	rq->bufs = malloc(URING_BUFS * rq->buf_size);
+	rq->socks = calloc(rq->nsocks, sizeof(*rq->socks));
+	if (rq->buf_ring == NULL || rq->bufs == NULL || rq->socks == NULL) {
+		udp_uring_deinit(rq);
+		return NULL;
+	}
+
+	for (unsigned bid = 0; bid < URING_BUFS; bid++) {
+		uring_recycle(rq, bid);
+	}
+	io_uring_buf_ring_advance(rq->buf_ring, rq->recycled);
+	rq->recycled = 0;
+
+	for (unsigned i = 0; i < rq->nsocks; i++) {
+		rq->socks[i].fd = fdset_get_fd(fds, i);
+		rq->socks[i].iface = fds->ctx[i];
+		rq->socks[i].msg.msg_namelen = sizeof(sockaddr_t);
+		rq->socks[i].msg.msg_controllen = sizeof(cmsg_buf_t);
+		if (uring_arm_recv(rq, i) != KNOT_EOK) {
+			udp_uring_deinit(rq);
+			return NULL;
+		}
+	}
+
+	if (io_uring_submit(&rq->ring) < 0) {
+		udp_uring_deinit(rq);
+		return NULL;
+	}
+
+	return rq;
+}
+
+static void udp_uring_deinit(void *d)
+{
+	udp_uring_ctx_t *rq = d;
+	if (rq == NULL) {
+		return;
+	}
+
+	if (rq->buf_ring != NULL) {
+		io_uring_free_buf_ring(&rq->ring, rq->buf_ring, URING_BUFS, URING_BGID);
+	}
+	io_uring_queue_exit(&rq->ring);
+	free(rq->socks);
+	free(rq->bufs);
+	free(rq);
+}
+
+static int udp_uring_wait(void *d, int timeout_ms)
+{
+	udp_uring_ctx_t *rq = d;
+
+	/* Wait only if no datagram is left over from the previous batch. */
+	if (rq->rx_count == 0) {
+		struct __kernel_timespec ts = {
+			.tv_sec = timeout_ms / 1000,
+			.tv_nsec = (timeout_ms % 1000) * 1000000,
+		};
+		struct io_uring_cqe *cqe;
+		int ret = io_uring_submit_and_wait_timeout(&rq->ring, &cqe, 1, &ts, NULL);
+		if (ret < 0 && ret != -ETIME && ret != -EINTR && log_enabled_debug()) {
+			log_debug("UDP, failed to wait for packets (%s)", strerror(-ret));
+		}
+		uring_reap(rq);
+	}
+
+	return rq->rx_count;
+}
+
+static void udp_uring_handle(udp_context_t *ctx, _unused_ const iface_t *iface, void *d)
+{
+	udp_uring_ctx_t *rq = d;
+
+	/* Keep the datagrams queued until the previous responses are sent. */
+	if (!uring_drain(rq)) {
+		return;
+	}
+
+	unsigned count = MIN(rq->rx_count, URING_BATCHLEN);
+
+	struct timespec recv_time;
+	clock_gettime(CLOCK_MONOTONIC, &recv_time);
+
+	/* Let the modules prepare for the whole batch. */
+	const struct sockaddr_storage *remotes[URING_BATCHLEN];
+	unsigned remotes_count = 0;
+	for (unsigned i = 0; i < count; i++) {
+		const uring_rx_t *rx = &rq->rx[i];
+		uring_sock_t *sock = &rq->socks[rx->sock];
+
+		struct io_uring_recvmsg_out *out =
+			io_uring_recvmsg_validate(uring_buf(rq, rx->bid), rx->len, &sock->msg);
+		if (out != NULL && !sock->iface->tls) {
+			remotes[remotes_count++] = io_uring_recvmsg_name(out);
+		}
+	}
+	process_query_batch(remotes, remotes_count, ctx->thread_id);
+
+	for (unsigned i = 0; i < count; i++) {
+		const uring_rx_t *rx = &rq->rx[i];
+		uring_sock_t *sock = &rq->socks[rx->sock];
+
+		struct io_uring_recvmsg_out *out =
+			io_uring_recvmsg_validate(uring_buf(rq, rx->bid), rx->len, &sock->msg);
+		if (out == NULL || (out->flags & MSG_TRUNC)) {
+			uring_recycle(rq, rx->bid);
+			continue;
+		}
+
+		/* Reconstruct the received message from the provided buffer. */
+		uint8_t *name = io_uring_recvmsg_name(out);
+		struct iovec rx_iov = {
+			.iov_base = io_uring_recvmsg_payload(out, &sock->msg),
+			.iov_len = io_uring_recvmsg_payload_length(out, rx->len, &sock->msg),
+		};
+		struct msghdr rx_msg = {
+			.msg_name = name,
+			.msg_namelen = out->namelen,
+			.msg_iov = &rx_iov,
+			.msg_iovlen = 1,
+			.msg_control = name + sock->msg.msg_namelen,
+			.msg_controllen = out->controllen,
+		};
+
+		uring_tx_t *tx = &rq->tx[rq->tx_count];
+		tx->iov.iov_base = tx->buf;
+		tx->iov.iov_len = sizeof(tx->buf);
+		tx->msg = (struct msghdr) {
+			.msg_name = rx_msg.msg_name,
+			.msg_namelen = rx_msg.msg_namelen,
+			.msg_iov = &tx->iov,
+			.msg_iovlen = 1,
+		};
+
+		int *p_ecn;
+		size_t gro_size;
+		cmsg_handle(&rx_msg, &tx->msg, &ctx->local, &p_ecn, &gro_size, sock->iface);
+		const sockaddr_t *local = local_addr(&ctx->local, sock->iface);
+
+		knotd_qdata_params_t params = params_init(
+			sock->iface->tls ? KNOTD_QUERY_PROTO_QUIC : KNOTD_QUERY_PROTO_UDP,
+			name, local, sock->fd, ctx->server, ctx->thread_id);
+		params.recv_time = recv_time;
+		if (sock->iface->tls) {
+#ifdef ENABLE_QUIC
+			quic_handler(&params, &ctx->layer, ctx->quic_idle_close,
+			             ctx->quic_table, &rx_iov, &tx->msg, p_ecn, gro_size);
+#else
+			assert(0);
+#endif // ENABLE_QUIC
+		} else {
+			udp_handler(ctx, &params, &rx_iov, &tx->iov);
+		}
+
+		/* The buffer is returned once the response is sent. */
+		if (tx->iov.iov_len > 0) {
+			tx->sock = rx->sock;
+			tx->bid = rx->bid;
+			rq->tx_count++;
+		} else {
+			uring_recycle(rq, rx->bid);
+		}
+	}
+
+	rq->rx_count -= count;
+	memmove(rq->rx, rq->rx + count, rq->rx_count * sizeof(*rq->rx));
+}
+
+static void udp_uring_send(void *d)
+{
+	udp_uring_ctx_t *rq = d;
+
+	for (unsigned i = rq->tx_queued; i < rq->tx_count; i++) {
+		struct io_uring_sqe *sqe = uring_get_sqe(rq);
+		if (sqe == NULL) {
+			uring_recycle(rq, rq->tx[i].bid);
+			continue;
+		}
+		io_uring_prep_sendmsg(sqe, rq->socks[rq->tx[i].sock].fd, &rq->tx[i].msg, 0);
+		io_uring_sqe_set_data64(sqe, URING_SEND | i);
+		rq->inflight++;
+	}
+	rq->tx_queued = rq->tx_count;
+
+	/* Submit the whole batch at once, new datagrams are queued meanwhile.
+	 * If interrupted by an error, the next batch drains first. */
+	(void)uring_drain(rq);
+
+	if (rq->recycled > 0) {
+		io_uring_buf_ring_advance(rq->buf_ring, rq->recycled);
+		rq->recycled = 0;
+	}
+}
+
+static udp_api_t udp_uring_api = {
+	udp_uring_init,
+	udp_uring_deinit,
+	NULL,
+	udp_uring_handle,
+	udp_uring_send,
+	udp_sweep,
+	udp_uring_wait,
+};
+#endif /* ENABLE_IO_URING */
+
 #ifdef ENABLE_XDP
-static void *xdp_mmsg_init(udp_context_t *ctx, void *xdp_sock)
+static void *xdp_mmsg_init(udp_context_t *ctx, _unused_ fdset_t *fds, void *xdp_sock)
 {
 	return xdp_handle_init(ctx->server, xdp_sock);
 }
@@ -463,6 +901,15 @@ static udp_api_t xdp_mmsg_api = {
 };
 #endif /* ENABLE_XDP */
 
+static udp_api_t *udp_default_api(void)
+{
+#ifdef ENABLE_RECVMMSG
+	return &udp_mmsg_api;
+#else
+	return &udp_msg_api;
+#endif
+}
+
 static bool is_xdp_thread(const server_t *server, int thread_id)
 {
 	return server->handlers[IO_XDP].size > 0 &&
@@ -563,11 +1010,12 @@ int udp_master(dthread_t *thread)
 		assert(0);
 #endif
 	} else {
-#ifdef ENABLE_RECVMMSG
-		api = &udp_mmsg_api;
-#else
-		api = &udp_msg_api;
-#endif
+		api = udp_default_api();
+#ifdef ENABLE_IO_URING
+		if (conf()->cache.srv_udp_io_uring) {
+			api = &udp_uring_api;
+		}
+#endif // ENABLE_IO_URING
 	}
 	void *api_ctx = NULL;
 
@@ -607,7 +1055,17 @@ int udp_master(dthread_t *thread)
 #endif // ENABLE_QUIC
 
 	/* Initialize the networking API. */
-	api_ctx = api->udp_init(&udp, xdp_socket);
+	api_ctx = api->udp_init(&udp, &fds, xdp_socket);
+#ifdef ENABLE_IO_URING
+	if (api_ctx == NULL && api == &udp_uring_api) {
+		api = udp_default_api();
+		if (dt_get_id(thread) == 0) {
+			log_warning("UDP, io_uring not available, falling back to %s",
+			            (api == &udp_msg_api) ? "recvmsg" : "recvmmsg");
+		}
+		api_ctx = api->udp_init(&udp, &fds, xdp_socket);
+	}
+#endif // ENABLE_IO_URING
 	if (api_ctx == NULL) {
 		goto finish;
 	}
@@ -619,6 +1077,16 @@ int udp_master(dthread_t *thread)
 			break;
 		}
 
+		/* Completion based API receives from all the sockets at once. */
+		if (api->udp_wait != NULL) {
+			if (api->udp_wait(api_ctx, 1000) > 0) {
+				api->udp_handle(&udp, NULL, api_ctx);
+				api->udp_send(api_ctx);
+			}
+			api->udp_sweep(&udp, api_ctx);
+			continue;
+		}
+
 		/* Wait for events. */
 		fdset_it_t it;
 		(void)fdset_poll(&fds, &it, 0, 1000);
@@ -179,6 +179,14 @@ int xdp_handle_recv(xdp_handle_ctx_t *ctx)
 	return ret == KNOT_EOK ? ctx->msg_recv_count : ret;
 }
 
+// Skip TCP or QUIC or marked (zero length) message.
+static bool udp_msg(const xdp_handle_ctx_t *ctx, const knot_xdp_msg_t *msg)
+{
+	return !(msg->flags & KNOT_XDP_MSG_TCP) &&
+	       msg->ip_to.sin6_port != ctx->quic_port &&
+	       msg->payload.iov_len > 0;
+}
+
 static void handle_udp(xdp_handle_ctx_t *ctx, knot_layer_t *layer,
                        knotd_qdata_params_t *params)
 {
@@ -186,14 +194,22 @@ static void handle_udp(xdp_handle_ctx_t *ctx, knot_layer_t *layer,
 
 	ctx->msg_udp_count = 0;
 
+	// Let the modules prepare for the whole batch.
+	const struct sockaddr_storage *remotes[XDP_BATCHLEN];
+	unsigned remotes_count = 0;
+	for (uint32_t i = 0; i < ctx->msg_recv_count; i++) {
+		knot_xdp_msg_t *msg_recv = &ctx->msg_recv[i];
+		if (udp_msg(ctx, msg_recv)) {
+			remotes[remotes_count++] = (struct sockaddr_storage *)&msg_recv->ip_from;
+		}
+	}
+	process_query_batch(remotes, remotes_count, params->thread_id);
+
 	for (uint32_t i = 0; i < ctx->msg_recv_count; i++) {
 		knot_xdp_msg_t *msg_recv = &ctx->msg_recv[i];
 		knot_xdp_msg_t *msg_send = &ctx->msg_send_udp[ctx->msg_udp_count];
 
-		// Skip TCP or QUIC or marked (zero length) message.
-		if ((msg_recv->flags & KNOT_XDP_MSG_TCP) ||
-		    msg_recv->ip_to.sin6_port == ctx->quic_port ||
-		    msg_recv->payload.iov_len == 0) {
+		if (!udp_msg(ctx, msg_recv)) {
 			continue;
 		}
 
@@ -336,6 +352,7 @@ void xdp_handle_msgs(xdp_handle_ctx_t *ctx, knot_layer_t *layer,
 
 	knotd_qdata_params_t params = params_xdp_init(
 		knot_xdp_socket_fd(ctx->sock), server, thread_id);
+	clock_gettime(CLOCK_MONOTONIC, &params.recv_time);
 
 	knot_xdp_send_prepare(ctx->sock);
 
@@ -206,14 +206,32 @@ static bool update_match(conf_t *conf, conf_val_t *acl, knot_dname_t *key_name,
 	return true;
 }
 
-static bool check_addr_key(conf_t *conf, conf_val_t *addr_val, conf_val_t *key_val,
+/*! Get the compiled address ranges of the ACL (NULL if not available). */
+static const addr_set_t *acl_addr_set(conf_t *conf, conf_val_t *acl)
+{
+	if (conf->cache.acl_addr_sets == NULL) {
+		return NULL;
+	}
+
+	conf_val(acl);
+	trie_val_t *val = trie_get_try(conf->cache.acl_addr_sets, acl->data, acl->len);
+
+	return (val != NULL) ? *val : NULL;
+}
+
+static bool check_addr_key(conf_t *conf, conf_val_t *addr_val,
+                           const addr_set_t *addr_set, conf_val_t *key_val,
                            bool remote, const struct sockaddr_storage *addr,
                            const knot_tsig_key_t *tsig, conf_val_t *pin_val,
                            const uint8_t *session_pin, size_t session_pin_size,
                            bool deny, bool forward)
 {
 	/* Check if the address matches the acl address list or remote addresses. */
-	if (addr_val->code != KNOT_ENOENT) {
+	if (addr_set != NULL) {
+		if (!addr_set_match(addr_set, addr)) {
+			return false;
+		}
+	} else if (addr_val->code != KNOT_ENOENT) {
 		if (remote) {
 			if (!conf_addr_match(addr_val, addr)) {
 				return false;
@@ -315,7 +333,7 @@ bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
 			addr_val = conf_id_get(conf, C_RMT, C_ADDR, iter.id);
 			key_val = conf_id_get(conf, C_RMT, C_KEY, iter.id);
 			pin_val = conf_id_get(conf, C_RMT, C_CERT_KEY, iter.id);
-			if (check_addr_key(conf, &addr_val, &key_val, remote, addr,
+			if (check_addr_key(conf, &addr_val, NULL, &key_val, remote, addr,
 			                   tsig, &pin_val, session_pin, session_pin_size,
 			                   deny, forward)) {
 				break;
@@ -327,10 +345,13 @@ bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
 		}
 		/* Or check if acl address/key matches given address and key. */
 		if (!remote) {
-			addr_val = conf_id_get(conf, C_ACL, C_ADDR, acl);
+			const addr_set_t *addr_set = acl_addr_set(conf, acl);
+			if (addr_set == NULL) {
+				addr_val = conf_id_get(conf, C_ACL, C_ADDR, acl);
+			}
 			key_val = conf_id_get(conf, C_ACL, C_KEY, acl);
 			pin_val = conf_id_get(conf, C_ACL, C_CERT_KEY, acl);
-			if (!check_addr_key(conf, &addr_val, &key_val, remote, addr,
+			if (!check_addr_key(conf, &addr_val, addr_set, &key_val, remote, addr,
 			                    tsig, &pin_val, session_pin, session_pin_size,
 			                    deny, forward)) {
 				goto next_acl;
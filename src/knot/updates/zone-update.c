@@ -883,7 +883,8 @@ int zone_update_verify_digest(conf_t *conf, zone_update_t *update)
 		return KNOT_EOK;
 	}
 
-	int ret = zone_contents_digest_verify(update->new_cont);
+	conf_val_t thr = conf_zone_get(conf, C_ADJUST_THR, update->zone->name);
+	int ret = zone_contents_digest_verify(update->new_cont, conf_int(&thr));
 	if (ret != KNOT_EOK) {
 		log_zone_error(update->zone->name, "ZONEMD, verification failed (%s)",
 		               knot_strerror(ret));
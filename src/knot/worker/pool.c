@@ -31,11 +31,14 @@ struct worker_pool {
 	dt_unit_t *threads;
 
 	pthread_mutex_t lock;
-	pthread_cond_t wake;
+	pthread_cond_t wake;	/*!< Signals idle workers. */
+	pthread_cond_t done;	/*!< Signals threads waiting for the pool to drain. */
 
 	bool terminating;	/*!< Is the pool terminating? .*/
 	bool suspended;		/*!< Is execution temporarily suspended? .*/
 	int running;		/*!< Number of running threads. */
+	int idle;		/*!< Number of threads waiting for a task. */
+	int waiting;		/*!< Number of threads in worker_pool_wait(). */
 	worker_queue_t tasks;
 };
 
@@ -67,7 +70,9 @@ static int worker_main(dthread_t *thread)
 		}
 
 		if (task == NULL) {
+			pool->idle += 1;
 			pthread_cond_wait(&pool->wake, &pool->lock);
+			pool->idle -= 1;
 			continue;
 		}
 
@@ -79,7 +84,9 @@ static int worker_main(dthread_t *thread)
 		pthread_mutex_lock(&pool->lock);
 
 		pool->running -= 1;
-		pthread_cond_broadcast(&pool->wake);
+		if (pool->waiting > 0) {
+			pthread_cond_broadcast(&pool->done);
+		}
 	}
 
 	pthread_mutex_unlock(&pool->lock);
@@ -110,6 +117,10 @@ worker_pool_t *worker_pool_create(unsigned threads)
 		goto fail;
 	}
 
+	if (pthread_cond_init(&pool->done, NULL) != 0) {
+		goto fail;
+	}
+
 	worker_queue_init(&pool->tasks);
 
 	return pool;
@@ -130,6 +141,7 @@ void worker_pool_destroy(worker_pool_t *pool)
 
 	pthread_mutex_destroy(&pool->lock);
 	pthread_cond_destroy(&pool->wake);
+	pthread_cond_destroy(&pool->done);
 
 	worker_queue_deinit(&pool->tasks);
 
@@ -154,6 +166,7 @@ void worker_pool_stop(worker_pool_t *pool)
 	pthread_mutex_lock(&pool->lock);
 	pool->terminating = true;
 	pthread_cond_broadcast(&pool->wake);
+	pthread_cond_broadcast(&pool->done);
 	pthread_mutex_unlock(&pool->lock);
 
 	dt_stop(pool->threads);
@@ -198,12 +211,14 @@ void worker_pool_wait_cb(worker_pool_t *pool, wait_callback_t cb)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	while (!EMPTY_LIST(pool->tasks.list) || pool->running > 0) {
+	pool->waiting += 1;
+	while (worker_queue_length(&pool->tasks) > 0 || pool->running > 0) {
 		if (cb != NULL) {
 			cb(pool);
 		}
-		pthread_cond_wait(&pool->wake, &pool->lock);
+		pthread_cond_wait(&pool->done, &pool->lock);
 	}
+	pool->waiting -= 1;
 	pthread_mutex_unlock(&pool->lock);
 }
 
@@ -220,7 +235,9 @@ void worker_pool_assign(worker_pool_t *pool, struct task *task)
 
 	pthread_mutex_lock(&pool->lock);
 	worker_queue_enqueue(&pool->tasks, task);
-	pthread_cond_signal(&pool->wake);
+	if (pool->idle > 0) {
+		pthread_cond_signal(&pool->wake);
+	}
 	pthread_mutex_unlock(&pool->lock);
 }
 
@@ -232,7 +249,9 @@ void worker_pool_clear(worker_pool_t *pool)
 
 	pthread_mutex_lock(&pool->lock);
 	worker_queue_deinit(&pool->tasks);
-	worker_queue_init(&pool->tasks);
+	if (pool->waiting > 0) {
+		pthread_cond_broadcast(&pool->done);
+	}
 	pthread_mutex_unlock(&pool->lock);
 }
 
@@ -252,3 +271,18 @@ void worker_pool_status(worker_pool_t *pool, bool locked, int *running, int *que
 		pthread_mutex_unlock(&pool->lock);
 	}
 }
+
+void worker_pool_stats(worker_pool_t *pool, worker_pool_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	if (!pool) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	stats->running = pool->running;
+	memcpy(stats->queued, pool->tasks.length, sizeof(stats->queued));
+	stats->queued_max = pool->tasks.max_total;
+	memcpy(stats->wait_hist, pool->tasks.wait_hist, sizeof(stats->wait_hist));
+	pthread_mutex_unlock(&pool->lock);
+}
@@ -23,6 +23,16 @@
 struct worker_pool;
 typedef struct worker_pool worker_pool_t;
 
+/*!
+ * \brief Worker pool statistics.
+ */
+typedef struct {
+	int running;					/*!< Number of running tasks. */
+	size_t queued[WORKER_PRIO_COUNT];		/*!< Pending tasks per priority class. */
+	size_t queued_max;				/*!< Highest number of pending tasks. */
+	uint64_t wait_hist[WORKER_WAIT_BUCKETS];	/*!< Task wait time histogram. */
+} worker_pool_stats_t;
+
 typedef void(*wait_callback_t)(worker_pool_t *);
 
 /*!
@@ -77,6 +87,8 @@ void worker_pool_wait_cb(worker_pool_t *pool, wait_callback_t cb);
 
 /*!
  * \brief Assign a task to be performed by a worker in the pool.
+ *
+ * \note The task is queued in the priority class given by task->prio.
  */
 void worker_pool_assign(worker_pool_t *pool, struct task *task);
 
@@ -91,3 +103,8 @@ void worker_pool_clear(worker_pool_t *pool);
  * \note Locked means if the mutex `pool->lock` is locked.
  */
 void worker_pool_status(worker_pool_t *pool, bool locked, int *running, int *queued);
+
+/*!
+ * \brief Obtain detailed pool statistics including the task wait times.
+ */
+void worker_pool_stats(worker_pool_t *pool, worker_pool_stats_t *stats);
@@ -14,8 +14,29 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+
 #include "knot/worker/queue.h"
 #include "contrib/mempattern.h"
+#include "contrib/time.h"
+
+typedef struct {
+	node_t n;
+	worker_task_t *task;
+	struct timespec queued;
+} queue_node_t;
+
+static void wait_account(worker_queue_t *queue, double wait_ms)
+{
+	unsigned bucket = 0;
+	for (double limit = 1.0; wait_ms >= limit && bucket < WORKER_WAIT_BUCKETS - 1;
+	     limit *= 10.0) {
+		bucket++;
+	}
+	queue->wait_hist[bucket]++;
+}
 
 void worker_queue_init(worker_queue_t *queue)
 {
@@ -25,13 +46,23 @@ void worker_queue_init(worker_queue_t *queue)
 
 	memset(queue, 0, sizeof(worker_queue_t));
 
-	init_list(&queue->list);
+	for (int i = 0; i < WORKER_PRIO_COUNT; i++) {
+		init_list(&queue->list[i]);
+	}
 	mm_ctx_init(&queue->mm_ctx);
 }
 
 void worker_queue_deinit(worker_queue_t *queue)
 {
-	ptrlist_free(&queue->list, &queue->mm_ctx);
+	for (int i = 0; i < WORKER_PRIO_COUNT; i++) {
+		queue_node_t *node, *nxt;
+		WALK_LIST_DELSAFE(node, nxt, queue->list[i]) {
+			mm_free(&queue->mm_ctx, node);
+		}
+		init_list(&queue->list[i]);
+		queue->length[i] = 0;
+	}
+	queue->total = 0;
 }
 
 void worker_queue_enqueue(worker_queue_t *queue, worker_task_t *task)
@@ -40,28 +71,60 @@ void worker_queue_enqueue(worker_queue_t *queue, worker_task_t *task)
 		return;
 	}
 
-	ptrlist_add(&queue->list, task, &queue->mm_ctx);
+	queue_node_t *node = mm_alloc(&queue->mm_ctx, sizeof(*node));
+	if (node == NULL) {
+		return;
+	}
+	node->task = task;
+	node->queued = time_now();
+
+	worker_prio_t prio = task->prio < WORKER_PRIO_COUNT ? task->prio : WORKER_PRIO_IDLE;
+	add_tail(&queue->list[prio], &node->n);
+	queue->length[prio]++;
+	queue->total++;
+	if (queue->total > queue->max_total) {
+		queue->max_total = queue->total;
+	}
 }
 
 worker_task_t *worker_queue_dequeue(worker_queue_t *queue)
 {
-	if (!queue) {
+	if (!queue || queue->total == 0) {
 		return NULL;
 	}
 
-	worker_task_t *task = NULL;
+	struct timespec now = time_now();
 
-	if (!EMPTY_LIST(queue->list)) {
-		ptrnode_t *node = HEAD(queue->list);
-		task = (void *)node->d;
-		rem_node(&node->n);
-		queue->mm_ctx.free(&node->n);
+	queue_node_t *node = NULL;
+	int prio = -1;
+	for (int i = 0; i < WORKER_PRIO_COUNT; i++) {
+		if (EMPTY_LIST(queue->list[i])) {
+			continue;
+		}
+		queue_node_t *head = HEAD(queue->list[i]);
+		if (node == NULL) {
+			node = head;
+			prio = i;
+		} else if (time_diff_ms(&head->queued, &now) > WORKER_STARVE_MS) {
+			node = head;
+			prio = i;
+			break;
+		}
 	}
+	assert(node != NULL);
+
+	rem_node(&node->n);
+	queue->length[prio]--;
+	queue->total--;
+	wait_account(queue, time_diff_ms(&node->queued, &now));
+
+	worker_task_t *task = node->task;
+	mm_free(&queue->mm_ctx, node);
 
 	return task;
 }
 
 size_t worker_queue_length(worker_queue_t *queue)
 {
-	return queue ? list_size(&queue->list) : 0;
+	return queue ? queue->total : 0;
 }
@@ -16,8 +16,28 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include "contrib/ucw/lists.h"
 
+/*! \brief Queued tasks waiting longer than this are served regardless of priority. */
+#define WORKER_STARVE_MS	10000
+
+/*! \brief Number of wait time histogram buckets (<1ms, <10ms, ..., <100s, more). */
+#define WORKER_WAIT_BUCKETS	7
+
+/*!
+ * \brief Task priority classes, ordered from the most urgent one.
+ */
+typedef enum {
+	WORKER_PRIO_URGENT = 0,
+	WORKER_PRIO_HIGH,
+	WORKER_PRIO_NORMAL,
+	WORKER_PRIO_LOW,
+	WORKER_PRIO_IDLE,
+	WORKER_PRIO_COUNT
+} worker_prio_t;
+
 struct task;
 typedef void (*task_cb)(struct task *);
 
@@ -27,6 +47,7 @@ typedef void (*task_cb)(struct task *);
 typedef struct task {
 	void *ctx;
 	task_cb run;
+	worker_prio_t prio;	/*!< Priority class used when enqueued. */
 } worker_task_t;
 
 /*!
@@ -34,7 +55,11 @@ typedef struct task {
  */
 typedef struct worker_queue {
 	knot_mm_t mm_ctx;
-	list_t list;
+	list_t list[WORKER_PRIO_COUNT];		/*!< Task FIFO for each priority class. */
+	size_t length[WORKER_PRIO_COUNT];	/*!< Number of tasks in each FIFO. */
+	size_t total;				/*!< Total number of queued tasks. */
+	size_t max_total;			/*!< Highest total observed. */
+	uint64_t wait_hist[WORKER_WAIT_BUCKETS];/*!< Histogram of dequeued task wait times. */
 } worker_queue_t;
 
 /*!
@@ -55,6 +80,9 @@ void worker_queue_enqueue(worker_queue_t *queue, worker_task_t *task);
 /*!
  * \brief Remove item from the queue.
  *
+ * The oldest task of the most urgent non-empty class is returned, unless
+ * some lower class task has been waiting longer than WORKER_STARVE_MS.
+ *
  * \return Task or NULL if the queue is empty.
  */
 worker_task_t *worker_queue_dequeue(worker_queue_t *queue);
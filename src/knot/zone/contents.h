@@ -40,6 +40,7 @@ typedef struct zone_contents {
 	uint32_t max_ttl;
 	bool dnssec;
 	knot_time_t dnssec_expire;
+	uint64_t generation; /*!< Version number within the zone, assigned when published. */
 } zone_contents_t;
 
 /*!
@@ -14,24 +14,45 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
 #include <stdio.h>
 
 #include "knot/zone/digest.h"
 #include "knot/dnssec/rrset-sign.h"
 #include "knot/updates/zone-update.h"
+#include "contrib/macros.h"
 #include "contrib/wire_ctx.h"
 #include "libdnssec/digest.h"
 #include "libknot/libknot.h"
 
 #define DIGEST_BUF_MIN 4096
+#define DIGEST_CHUNK_NODES 2048
 
 typedef struct {
 	size_t buf_size;
+	size_t buf_len;
 	uint8_t *buf;
-	struct dnssec_digest_ctx *digest_ctx;
+	struct dnssec_digest_ctx *digest_ctx; // NULL if just serializing
 	const zone_node_t *apex;
 } contents_digest_ctx_t;
 
+/*! \brief Consecutive nodes serialized by one thread. */
+typedef struct {
+	contents_digest_ctx_t ctx;
+	zone_node_t **nodes;
+	size_t count;
+	pthread_t thread;
+	int thread_ret;
+	int ret;
+} digest_part_t;
+
+static int digest_flush(contents_digest_ctx_t *ctx)
+{
+	dnssec_binary_t bufbin = { ctx->buf_len, ctx->buf };
+	ctx->buf_len = 0;
+	return dnssec_digest(ctx->digest_ctx, &bufbin);
+}
+
 static int digest_rrset(knot_rrset_t *rrset, const zone_node_t *node, void *vctx)
 {
 	contents_digest_ctx_t *ctx = vctx;
@@ -60,8 +81,9 @@ static int digest_rrset(knot_rrset_t *rrset, const zone_node_t *node, void *vctx
 		}
 	}
 
-	size_t buf_req = knot_rrset_size_estimate(rrset);
+	size_t buf_req = ctx->buf_len + knot_rrset_size_estimate(rrset);
 	if (buf_req > ctx->buf_size) {
+		buf_req = MAX(buf_req, 2 * ctx->buf_size);
 		uint8_t *newbuf = realloc(ctx->buf, buf_req);
 		if (newbuf == NULL) {
 			return KNOT_ENOMEM;
@@ -70,7 +92,8 @@ static int digest_rrset(knot_rrset_t *rrset, const zone_node_t *node, void *vctx
 		ctx->buf_size = buf_req;
 	}
 
-	int ret = knot_rrset_to_wire_extra(rrset, ctx->buf, ctx->buf_size, 0,
+	int ret = knot_rrset_to_wire_extra(rrset, ctx->buf + ctx->buf_len,
+	                                   ctx->buf_size - ctx->buf_len, 0,
 	                                   NULL, KNOT_PF_ORIGTTL);
 
 	// cleanup apex RRSIGs mess
@@ -82,9 +105,12 @@ static int digest_rrset(knot_rrset_t *rrset, const zone_node_t *node, void *vctx
 		return ret;
 	}
 
-	// digest serialized RRSet
-	dnssec_binary_t bufbin = { ret, ctx->buf };
-	return dnssec_digest(ctx->digest_ctx, &bufbin);
+	// digest serialized RRSets, unless just serializing
+	ctx->buf_len += ret;
+	if (ctx->digest_ctx != NULL && ctx->buf_len >= DIGEST_BUF_MIN) {
+		return digest_flush(ctx);
+	}
+	return KNOT_EOK;
 }
 
 static int digest_node(zone_node_t *node, void *ctx)
@@ -97,8 +123,134 @@ static int digest_node(zone_node_t *node, void *ctx)
 	return ret;
 }
 
+static void *digest_part_thread(void *arg)
+{
+	digest_part_t *part = arg;
+
+	part->ctx.buf_len = 0;
+	part->ret = KNOT_EOK;
+	for (size_t i = 0; i < part->count && part->ret == KNOT_EOK; i++) {
+		part->ret = digest_node(part->nodes[i], &part->ctx);
+	}
+
+	return NULL;
+}
+
+static void digest_parts_start(digest_part_t *parts, unsigned threads)
+{
+	for (unsigned i = 0; i < threads; i++) {
+		parts[i].thread_ret = pthread_create(&parts[i].thread, NULL,
+		                                     digest_part_thread, &parts[i]);
+	}
+}
+
+static int digest_parts_join(digest_part_t *parts, unsigned threads)
+{
+	int ret = KNOT_EOK;
+	for (unsigned i = 0; i < threads; i++) {
+		if (parts[i].thread_ret == 0) {
+			(void)pthread_join(parts[i].thread, NULL);
+		} else {
+			// Not started in a separate thread.
+			digest_part_thread(&parts[i]);
+		}
+		if (ret == KNOT_EOK) {
+			ret = parts[i].ret;
+		}
+	}
+	return ret;
+}
+
+/*! \brief Assign next nodes to the parts, return false if there are no more nodes. */
+static bool digest_parts_fill(digest_part_t *parts, unsigned threads, zone_tree_it_t *it)
+{
+	bool filled = false;
+	for (unsigned i = 0; i < threads; i++) {
+		parts[i].count = 0;
+		while (parts[i].count < DIGEST_CHUNK_NODES && !zone_tree_it_finished(it)) {
+			parts[i].nodes[parts[i].count++] = zone_tree_it_val(it);
+			zone_tree_it_next(it);
+			filled = true;
+		}
+	}
+	return filled;
+}
+
+/*!
+ * \brief Serialize consecutive chunks of nodes in parallel and digest them in order.
+ *
+ * While the calling thread digests the parts of one round, the next round
+ * is already being serialized by the other set of parts.
+ */
+static int digest_parallel(zone_tree_t *tree, contents_digest_ctx_t *ctx, unsigned threads)
+{
+	digest_part_t *parts = calloc(2 * threads, sizeof(*parts));
+	zone_node_t **nodes = calloc(2 * threads * DIGEST_CHUNK_NODES, sizeof(*nodes));
+	if (parts == NULL || nodes == NULL) {
+		free(parts);
+		free(nodes);
+		return KNOT_ENOMEM;
+	}
+	for (unsigned i = 0; i < 2 * threads; i++) {
+		parts[i].ctx.apex = ctx->apex;
+		parts[i].nodes = nodes + i * DIGEST_CHUNK_NODES;
+	}
+
+	zone_tree_it_t it = { 0 };
+	int ret = zone_tree_it_begin(tree, &it);
+	if (ret != KNOT_EOK) {
+		free(parts);
+		free(nodes);
+		return ret;
+	}
+
+	digest_part_t *cur = parts, *next = parts + threads;
+	bool running = digest_parts_fill(cur, threads, &it);
+	if (running) {
+		digest_parts_start(cur, threads);
+	}
+	while (running) {
+		ret = digest_parts_join(cur, threads);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+
+		running = digest_parts_fill(next, threads, &it);
+		if (running) {
+			digest_parts_start(next, threads);
+		}
+
+		for (unsigned i = 0; i < threads && ret == KNOT_EOK; i++) {
+			ctx->buf = cur[i].ctx.buf;
+			ctx->buf_len = cur[i].ctx.buf_len;
+			ret = digest_flush(ctx);
+		}
+		ctx->buf = NULL;
+
+		if (ret != KNOT_EOK) {
+			if (running) {
+				(void)digest_parts_join(next, threads);
+			}
+			break;
+		}
+
+		digest_part_t *tmp = cur;
+		cur = next;
+		next = tmp;
+	}
+	zone_tree_it_free(&it);
+
+	for (unsigned i = 0; i < 2 * threads; i++) {
+		free(parts[i].ctx.buf);
+	}
+	free(parts);
+	free(nodes);
+
+	return ret;
+}
+
 int zone_contents_digest(const zone_contents_t *contents, int algorithm,
-                         uint8_t **out_digest, size_t *out_size)
+                         unsigned threads, uint8_t **out_digest, size_t *out_size)
 {
 	if (out_digest == NULL || out_size == NULL) {
 		return KNOT_EINVAL;
@@ -134,8 +286,15 @@ int zone_contents_digest(const zone_contents_t *contents, int algorithm,
 		}
 	}
 
-	if (ret == KNOT_EOK) {
+	if (ret == KNOT_EOK && threads > 1 && zone_tree_count(conts) > DIGEST_CHUNK_NODES) {
+		free(ctx.buf);
+		ctx.buf = NULL;
+		ret = digest_parallel(conts, &ctx, threads);
+	} else if (ret == KNOT_EOK) {
 		ret = zone_tree_apply(conts, digest_node, &ctx);
+		if (ret == KNOT_EOK) {
+			ret = digest_flush(&ctx);
+		}
 	}
 
 	if (conts != contents->nodes) {
@@ -152,11 +311,12 @@ int zone_contents_digest(const zone_contents_t *contents, int algorithm,
 	return ret;
 }
 
-static int verify_zonemd(const knot_rdata_t *zonemd, const zone_contents_t *contents)
+static int verify_zonemd(const knot_rdata_t *zonemd, const zone_contents_t *contents,
+                         unsigned threads)
 {
 	uint8_t *computed = NULL;
 	size_t comp_size = 0;
-	int ret = zone_contents_digest(contents, knot_zonemd_algorithm(zonemd),
+	int ret = zone_contents_digest(contents, knot_zonemd_algorithm(zonemd), threads,
 	                               &computed, &comp_size);
 	if (ret != KNOT_EOK) {
 		return ret;
@@ -172,7 +332,8 @@ static int verify_zonemd(const knot_rdata_t *zonemd, const zone_contents_t *cont
 	return ret;
 }
 
-bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool no_verify)
+bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool no_verify,
+                                 unsigned threads)
 {
 	if (alg == 0) {
 		return true;
@@ -192,7 +353,7 @@ bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool
 		return true;
 	}
 
-	return verify_zonemd(zonemd->rdata, contents) == KNOT_EOK;
+	return verify_zonemd(zonemd->rdata, contents, threads) == KNOT_EOK;
 }
 
 static bool check_duplicate_schalg(const knot_rdataset_t *zonemd, int check_upto,
@@ -210,7 +371,7 @@ static bool check_duplicate_schalg(const knot_rdataset_t *zonemd, int check_upto
 	return true;
 }
 
-int zone_contents_digest_verify(const zone_contents_t *contents)
+int zone_contents_digest_verify(const zone_contents_t *contents, unsigned threads)
 {
 	if (contents == NULL) {
 		return KNOT_EEMPTYZONE;
@@ -237,7 +398,7 @@ int zone_contents_digest_verify(const zone_contents_t *contents)
 		rr = knot_rdataset_next(rr);
 	}
 
-	return supported == NULL ? KNOT_ENOTSUP : verify_zonemd(supported, contents);
+	return supported == NULL ? KNOT_ENOTSUP : verify_zonemd(supported, contents, threads);
 }
 
 static ptrdiff_t zonemd_hash_offs(void)
@@ -266,7 +427,9 @@ int zone_update_add_digest(struct zone_update *update, int algorithm, bool place
 			return KNOT_EOK;
 		}
 	} else {
-		int ret = zone_contents_digest(update->new_cont, algorithm, &digest, &dsize);
+		conf_val_t thr = conf_zone_get(conf(), C_ADJUST_THR, update->zone->name);
+		int ret = zone_contents_digest(update->new_cont, algorithm, conf_int(&thr),
+		                               &digest, &dsize);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
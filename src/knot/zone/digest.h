@@ -1,4 +1,4 @@
-/*  Copyright (C) 2021 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
 
     This program is free software: you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -21,15 +21,19 @@
 /*!
  * \brief Compute hash over whole zone by concatenating RRSets in wire format.
  *
+ * With more threads, consecutive chunks of nodes are serialized in parallel
+ * and the calling thread hashes them in the canonical order.
+ *
  * \param contents     Zone contents to digest.
  * \param algorithm    Algorithm to use.
+ * \param threads      Number of serializing threads (1 for no parallelism).
  * \param out_digest   Output: buffer with computed hash (to be freed).
  * \param out_size     Output: size of the resulting hash.
  *
  * \return KNOT_E*
  */
 int zone_contents_digest(const zone_contents_t *contents, int algorithm,
-                         uint8_t **out_digest, size_t *out_size);
+                         unsigned threads, uint8_t **out_digest, size_t *out_size);
 
 /*!
  * \brief Check whether exactly one ZONEMD exists in the zone, is valid and matches given algorithm.
@@ -39,13 +43,16 @@ int zone_contents_digest(const zone_contents_t *contents, int algorithm,
  * \param contents   Zone contents to be verified.
  * \param alg        Required algorithm of the ZONEMD.
  * \param no_verify  Don't verify the validness of the digest in ZONEMD.
+ * \param threads    Number of threads for the digest computation.
  */
-bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool no_verify);
+bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool no_verify,
+                                 unsigned threads);
 
 /*!
  * \brief Verify zone dgest in ZONEMD record.
  *
  * \param contents   Zone contents ot be verified.
+ * \param threads    Number of threads for the digest computation.
  *
  * \retval KNOT_EEMPTYZONE  The zone is empty.
  * \retval KNOT_ENOENT      There is no ZONEMD in contents' apex.
@@ -55,7 +62,7 @@ bool zone_contents_digest_exists(const zone_contents_t *contents, int alg, bool
  * \retval KNOT_EMALF       The computed hash differs from ZONEMD.
  * \return KNOT_E*
  */
-int zone_contents_digest_verify(const zone_contents_t *contents);
+int zone_contents_digest_verify(const zone_contents_t *contents, unsigned threads);
 
 struct zone_update;
 /*!
@@ -26,6 +26,7 @@
 #include "knot/events/replan.h"
 #include "knot/journal/journal_read.h"
 #include "knot/journal/journal_write.h"
+#include "knot/nameserver/answer_cache.h"
 #include "knot/nameserver/process_query.h"
 #include "knot/query/requestor.h"
 #include "knot/updates/zone-update.h"
@@ -239,6 +240,8 @@ void zone_free(zone_t **zone_ptr)
 
 	conf_deactivate_modules(&zone->query_modules, &zone->query_plan);
 
+	answer_cache_free(zone->answer_cache);
+
 	ptrlist_free(&zone->internal_notify, NULL);
 
 	free(zone);
@@ -471,6 +474,10 @@ zone_contents_t *zone_switch_contents(zone_t *zone, zone_contents_t *new_content
 		return NULL;
 	}
 
+	if (new_contents != NULL) {
+		new_contents->generation = ++zone->contents_gen;
+	}
+
 	zone_contents_t *old_contents;
 	zone_contents_t **current_contents = &zone->contents;
 	old_contents = rcu_xchg_pointer(current_contents, new_contents);
@@ -141,6 +141,11 @@ typedef struct zone
 	/*! \brief Query modules. */
 	list_t query_modules;
 	struct query_plan *query_plan;
+
+	/*! \brief Cache of rendered responses (optional). */
+	struct answer_cache *answer_cache;
+	/*! \brief Generation of the last published contents. */
+	uint64_t contents_gen;
 } zone_t;
 
 /*!
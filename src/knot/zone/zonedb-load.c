@@ -1,4 +1,4 @@
-/*  Copyright (C) 2023 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
 
     This program is free software: you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -15,6 +15,7 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <urcu.h>
 
@@ -23,6 +24,7 @@
 #include "knot/conf/module.h"
 #include "knot/events/replan.h"
 #include "knot/journal/journal_metadata.h"
+#include "knot/nameserver/answer_cache.h"
 #include "knot/zone/digest.h"
 #include "knot/zone/timers.h"
 #include "knot/zone/zone-load.h"
@@ -31,6 +33,39 @@
 #include "knot/zone/zonedb.h"
 #include "knot/zone/zonefile.h"
 #include "libknot/libknot.h"
+#include "contrib/macros.h"
+
+/*! \brief Minimal number of zones created by one thread. */
+#define CREATE_MIN_ZONES	256
+
+/*! \brief Zone to be created (possibly in parallel with others). */
+typedef struct {
+	const knot_dname_t *name;
+	knot_dname_t *name_copy;  /*!< Owned copy of the name if not stable. */
+	zone_t *old_zone;         /*!< Zone being reloaded or NULL. */
+	bool cat_member;          /*!< Catalog member zone. */
+	bool cat_added;           /*!< Catalog member zone just added. */
+	zone_t *zone;             /*!< Out: created zone or NULL. */
+} create_job_t;
+
+typedef struct {
+	create_job_t *jobs;
+	size_t count;
+	size_t capacity;
+} create_jobs_t;
+
+typedef struct {
+	create_jobs_t *jobs;
+	conf_t *conf;
+	server_t *server;
+	unsigned threads;
+	unsigned thr_id;
+	pthread_t thread;
+	int ret;
+} create_arg_t;
+
+/*! \brief Serializes lazy opening of the catalog database by zone creating threads. */
+static pthread_mutex_t catalog_open_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static bool zone_file_updated(conf_t *conf, const zone_t *old_zone,
                               const knot_dname_t *zone_name)
@@ -87,7 +122,7 @@ static void replan_events(conf_t *conf, zone_t *zone, zone_t *old_zone)
 	bool conf_updated = (old_zone->change_type & CONF_IO_TRELOAD);
 
 	conf_val_t digest = conf_zone_get(conf, C_ZONEMD_GENERATE, zone->name);
-	if (zone->contents != NULL && !zone_contents_digest_exists(zone->contents, conf_opt(&digest), true)) {
+	if (zone->contents != NULL && !zone_contents_digest_exists(zone->contents, conf_opt(&digest), true, 1)) {
 		conf_updated = true;
 	}
 
@@ -111,6 +146,7 @@ static zone_t *create_zone_reload(conf_t *conf, const knot_dname_t *name,
 	}
 
 	zone->contents = old_zone->contents;
+	zone->contents_gen = old_zone->contents_gen;
 	zone_set_flag(zone, zone_get_flag(old_zone, ~0, false));
 
 	zone->timers = old_zone->timers;
@@ -173,7 +209,9 @@ static zone_t *create_zone_new(conf_t *conf, const knot_dname_t *name,
 		}
 		zone_set_flag(zone, ZONE_IS_CATALOG);
 	} else if (role == CATALOG_ROLE_INTERPRET) {
+		pthread_mutex_lock(&catalog_open_lock);
 		ret = catalog_open(&server->catalog);
+		pthread_mutex_unlock(&catalog_open_lock);
 		if (ret != KNOT_EOK) {
 			log_error("failed to open catalog database (%s)", knot_strerror(ret));
 		}
@@ -220,6 +258,18 @@ static zone_t *create_zone(conf_t *conf, const knot_dname_t *name, server_t *ser
 
 	if (z != NULL) {
 		zone_get_catalog_group(conf, z);
+
+		conf_val_t val = conf_zone_get(conf, C_ANS_CACHE, name);
+		size_t size = conf_int(&val);
+		if (size > 0) {
+			unsigned threads = conf->cache.srv_udp_threads +
+			                   conf->cache.srv_tcp_threads +
+			                   conf->cache.srv_xdp_threads;
+			z->answer_cache = answer_cache_new(size, threads);
+			if (z->answer_cache == NULL) {
+				log_zone_warning(name, "failed to create answer cache");
+			}
+		}
 	}
 
 	return z;
@@ -276,8 +326,115 @@ static bool check_open_catalog(catalog_t *cat)
 	return false;
 }
 
+static void create_job_run(create_job_t *job, conf_t *conf, server_t *server)
+{
+	job->zone = create_zone(conf, job->name, server, job->old_zone);
+	if (job->zone == NULL) {
+		log_zone_error(job->name, "zone cannot be created");
+		return;
+	}
+
+	if (job->cat_member) {
+		zone_set_flag(job->zone, ZONE_IS_CAT_MEMBER);
+	}
+	conf_activate_modules(conf, server, job->zone->name, &job->zone->query_modules,
+	                      &job->zone->query_plan);
+	if (job->cat_added) {
+		log_zone_info(job->name, "zone added from catalog");
+	}
+}
+
+static void create_jobs_add(create_jobs_t *jobs, const knot_dname_t *name,
+                            knot_dname_t *name_copy, zone_t *old_zone,
+                            bool cat_member, bool cat_added)
+{
+	if (jobs->count == jobs->capacity) {
+		size_t capacity = MAX(2 * jobs->capacity, CREATE_MIN_ZONES);
+		create_job_t *new_jobs = realloc(jobs->jobs, capacity * sizeof(*new_jobs));
+		if (new_jobs == NULL) {
+			log_zone_error(name, "zone cannot be created");
+			free(name_copy);
+			return;
+		}
+		jobs->jobs = new_jobs;
+		jobs->capacity = capacity;
+	}
+
+	jobs->jobs[jobs->count++] = (create_job_t) {
+		.name = name,
+		.name_copy = name_copy,
+		.old_zone = old_zone,
+		.cat_member = cat_member,
+		.cat_added = cat_added,
+	};
+}
+
+static void create_jobs_part(create_arg_t *arg)
+{
+	for (size_t i = arg->thr_id; i < arg->jobs->count; i += arg->threads) {
+		create_job_run(&arg->jobs->jobs[i], arg->conf, arg->server);
+	}
+}
+
+static void *create_jobs_thread(void *data)
+{
+	rcu_register_thread();
+	create_jobs_part(data);
+	rcu_unregister_thread();
+
+	return NULL;
+}
+
+/*!
+ * \brief Create the zones, the jobs are interleaved among the background
+ *        worker count of threads, and insert them into the zone database.
+ */
+static void create_jobs_finish(create_jobs_t *jobs, conf_t *conf, server_t *server,
+                               knot_zonedb_t *db_new)
+{
+	unsigned threads = MIN(conf->cache.srv_bg_threads, jobs->count / CREATE_MIN_ZONES);
+	threads = MAX(threads, 1);
+
+	create_arg_t args[threads];
+	for (unsigned i = 0; i < threads; i++) {
+		args[i] = (create_arg_t) {
+			.jobs = jobs,
+			.conf = conf,
+			.server = server,
+			.threads = threads,
+			.thr_id = i,
+			.ret = -1,
+		};
+	}
+
+	if (threads > 1) {
+		for (unsigned i = 0; i < threads; i++) {
+			args[i].ret = pthread_create(&args[i].thread, NULL,
+			                             create_jobs_thread, &args[i]);
+		}
+	}
+
+	for (unsigned i = 0; i < threads; i++) {
+		if (args[i].ret == 0) {
+			(void)pthread_join(args[i].thread, NULL);
+		} else {
+			// Not started in a separate thread.
+			create_jobs_part(&args[i]);
+		}
+	}
+
+	for (size_t i = 0; i < jobs->count; i++) {
+		if (jobs->jobs[i].zone != NULL) {
+			knot_zonedb_insert(db_new, jobs->jobs[i].zone);
+		}
+		free(jobs->jobs[i].name_copy);
+	}
+	jobs->count = 0;
+}
+
 static zone_t *reuse_member_zone(zone_t *zone, server_t *server, conf_t *conf,
-                                 reload_t mode, list_t *expired_contents)
+                                 reload_t mode, list_t *expired_contents,
+                                 create_jobs_t *jobs)
 {
 	if (!zone_get_flag(zone, ZONE_IS_CAT_MEMBER, false)) {
 		return NULL;
@@ -309,43 +466,18 @@ static zone_t *reuse_member_zone(zone_t *zone, server_t *server, conf_t *conf,
 		return zone; // reuse the member zone
 	}
 
-	zone_t *newzone = create_zone(conf, zone->name, server, zone);
-	if (newzone == NULL) {
-		log_zone_error(zone->name, "zone cannot be created");
-	} else {
-		assert(zone_get_flag(newzone, ZONE_IS_CAT_MEMBER, false));
-		conf_activate_modules(conf, server, newzone->name, &newzone->query_modules,
-		                      &newzone->query_plan);
-	}
-
-	return newzone;
-}
-
-// cold start of knot: add unchanged member zone to zonedb
-static zone_t *reuse_cold_zone(const knot_dname_t *zname, server_t *server, conf_t *conf)
-{
-	catalog_upd_val_t *upd = catalog_update_get(&server->catalog_upd, zname);
-	if (upd != NULL && upd->type == CAT_UPD_REM) {
-		return NULL; // zone will be removed immediately
-	}
-
-	zone_t *zone = create_zone(conf, zname, server, NULL);
-	if (zone == NULL) {
-		log_zone_error(zname, "zone cannot be created");
-	} else {
-		zone_set_flag(zone, ZONE_IS_CAT_MEMBER);
-		conf_activate_modules(conf, server, zone->name, &zone->query_modules,
-		                      &zone->query_plan);
-	}
-	return zone;
+	// reload the member zone
+	create_jobs_add(jobs, zone->name, NULL, zone, true, false);
+	return NULL;
 }
 
 typedef struct {
 	knot_zonedb_t *zonedb;
 	server_t *server;
-	conf_t *conf;
+	create_jobs_t *jobs;
 } reuse_cold_zone_ctx_t;
 
+// cold start of knot: add unchanged member zone to zonedb
 static int reuse_cold_zone_cb(const knot_dname_t *member, _unused_ const knot_dname_t *owner,
                               const knot_dname_t *catz, _unused_ const char *group,
                               void *ctx)
@@ -358,35 +490,34 @@ static int reuse_cold_zone_cb(const knot_dname_t *member, _unused_ const knot_dn
 		return KNOT_EOK;
 	}
 
-	zone_t *zone = reuse_cold_zone(member, rcz->server, rcz->conf);
-	if (zone == NULL) {
+	catalog_upd_val_t *upd = catalog_update_get(&rcz->server->catalog_upd, member);
+	if (upd != NULL && upd->type == CAT_UPD_REM) {
+		return KNOT_EOK; // zone will be removed immediately
+	}
+
+	// The member name is valid only within the callback.
+	knot_dname_t *copy = knot_dname_copy(member, NULL);
+	if (copy == NULL) {
 		return KNOT_ENOMEM;
 	}
-	return knot_zonedb_insert(rcz->zonedb, zone);
+	create_jobs_add(rcz->jobs, copy, copy, NULL, true, false);
+
+	return KNOT_EOK;
 }
 
-static zone_t *add_member_zone(catalog_upd_val_t *val, knot_zonedb_t *check,
-                               server_t *server, conf_t *conf)
+static void add_member_zone(catalog_upd_val_t *val, knot_zonedb_t *check,
+                            create_jobs_t *jobs)
 {
 	if (val->type != CAT_UPD_ADD) {
-		return NULL;
+		return;
 	}
 
 	if (knot_zonedb_find(check, val->member) != NULL) {
 		log_zone_error(val->member, "zone already configured, ignoring");
-		return NULL;
+		return;
 	}
 
-	zone_t *zone = create_zone(conf, val->member, server, NULL);
-	if (zone == NULL) {
-		log_zone_error(val->member, "zone cannot be created");
-	} else {
-		zone_set_flag(zone, ZONE_IS_CAT_MEMBER);
-		conf_activate_modules(conf, server, zone->name, &zone->query_modules,
-		                      &zone->query_plan);
-		log_zone_info(val->member, "zone added from catalog");
-	}
-	return zone;
+	create_jobs_add(jobs, val->member, NULL, NULL, true, true);
 }
 
 /*!
@@ -419,6 +550,9 @@ static knot_zonedb_t *create_zonedb(conf_t *conf, server_t *server, reload_t mod
 		mark_changed_zones(db_old, conf->io.zones);
 	}
 
+	/* Zones to be created, the catalog zones must exist before their members. */
+	create_jobs_t jobs = { 0 };
+
 	/* Process regular zones from the configuration. */
 	for (conf_iter_t iter = conf_iter(conf, C_ZONE); iter.code == KNOT_EOK;
 	     conf_iter_next(conf, &iter)) {
@@ -434,17 +568,9 @@ static knot_zonedb_t *create_zonedb(conf_t *conf, server_t *server, reload_t mod
 			}
 		}
 
-		zone_t *zone = create_zone(conf, name, server, old_zone);
-		if (zone == NULL) {
-			log_zone_error(name, "zone cannot be created");
-			continue;
-		}
-
-		conf_activate_modules(conf, server, zone->name, &zone->query_modules,
-		                      &zone->query_plan);
-
-		knot_zonedb_insert(db_new, zone);
+		create_jobs_add(&jobs, name, NULL, old_zone, false, false);
 	}
+	create_jobs_finish(&jobs, conf, server, db_new);
 
 	/* Purge decataloged zones before catalog removals are commited. */
 	catalog_it_t *cat_it = catalog_it_begin(&server->catalog_upd);
@@ -464,6 +590,7 @@ static knot_zonedb_t *create_zonedb(conf_t *conf, server_t *server, reload_t mod
 	int ret = catalog_update_commit(&server->catalog_upd, &server->catalog);
 	if (ret != KNOT_EOK) {
 		log_error("catalog, failed to apply changes (%s)", knot_strerror(ret));
+		free(jobs.jobs);
 		return db_new;
 	}
 
@@ -471,34 +598,33 @@ static knot_zonedb_t *create_zonedb(conf_t *conf, server_t *server, reload_t mod
 	if (db_old != NULL) {
 		knot_zonedb_iter_t *it = knot_zonedb_iter_begin(db_old);
 		while (!knot_zonedb_iter_finished(it)) {
-			zone_t *newzone = reuse_member_zone(knot_zonedb_iter_val(it),
-			                                    server, conf, mode,
-			                                    expired_contents);
-			if (newzone != NULL) {
-				knot_zonedb_insert(db_new, newzone);
+			zone_t *zone = reuse_member_zone(knot_zonedb_iter_val(it),
+			                                 server, conf, mode,
+			                                 expired_contents, &jobs);
+			if (zone != NULL) {
+				knot_zonedb_insert(db_new, zone);
 			}
 			knot_zonedb_iter_next(it);
 		}
 		knot_zonedb_iter_free(it);
 	} else if (check_open_catalog(&server->catalog)) {
-		reuse_cold_zone_ctx_t rcz = { db_new, server, conf };
+		reuse_cold_zone_ctx_t rcz = { db_new, server, &jobs };
 		ret = catalog_apply(&server->catalog, NULL, reuse_cold_zone_cb, &rcz, false);
 		if (ret != KNOT_EOK) {
 			log_error("catalog, failed to load member zones (%s)", knot_strerror(ret));
 		}
 	}
+	create_jobs_finish(&jobs, conf, server, db_new);
 
 	/* Process new catalog member zones. */
 	catalog_it_t *it = catalog_it_begin(&server->catalog_upd);
 	while (!catalog_it_finished(it)) {
-		catalog_upd_val_t *val = catalog_it_val(it);
-		zone_t *zone = add_member_zone(val, db_new, server, conf);
-		if (zone != NULL) {
-			knot_zonedb_insert(db_new, zone);
-		}
+		add_member_zone(catalog_it_val(it), db_new, &jobs);
 		catalog_it_next(it);
 	}
 	catalog_it_free(it);
+	create_jobs_finish(&jobs, conf, server, db_new);
+	free(jobs.jobs);
 
 	it = knot_zonedb_iter_begin(db_new);
 	while (!knot_zonedb_iter_finished(it)) {
@@ -135,26 +135,36 @@ zone_t **knot_zonedb_find_ptr(knot_zonedb_t *db, const knot_dname_t *zone_name)
 	return (zone_t **)val;
 }
 
+static bool label_boundary(uint32_t len, void *d)
+{
+	const uint8_t *bounds = d;
+	return bounds[len / 8] & (1 << (len % 8));
+}
+
 zone_t *knot_zonedb_find_suffix(knot_zonedb_t *db, const knot_dname_t *zone_name)
 {
 	if (db == NULL || zone_name == NULL) {
 		return NULL;
 	}
 
-	while (true) {
-		knot_dname_storage_t lf_storage;
-		uint8_t *lf = knot_dname_lf(zone_name, lf_storage);
-		assert(lf);
-
-		trie_val_t *val = trie_get_try(db->trie, lf + 1, *lf);
-		if (val != NULL) {
-			return *val;
-		} else if (zone_name[0] == 0) {
-			return NULL;
-		}
+	knot_dname_storage_t lf_storage;
+	uint8_t *lf = knot_dname_lf(zone_name, lf_storage);
+	assert(lf);
 
-		zone_name = knot_dname_next_label(zone_name);
+	/* Lookup format of each name suffix is a prefix of the name's one,
+	 * mark their lengths to ignore matches not ending at a label boundary. */
+	uint8_t bounds[KNOT_DNAME_MAXLEN / 8 + 1] = { 0 };
+	uint32_t pos = *lf;
+	bounds[pos / 8] |= 1 << (pos % 8);
+	for (; *zone_name != 0; zone_name = knot_dname_next_label(zone_name)) {
+		pos -= *zone_name + 1;
+		bounds[pos / 8] |= 1 << (pos % 8);
 	}
+	assert(pos == 0);
+
+	trie_val_t *val = trie_get_longest_prefix(db->trie, lf + 1, *lf,
+	                                          label_boundary, bounds);
+	return (val != NULL) ? *val : NULL;
 }
 
 size_t knot_zonedb_size(const knot_zonedb_t *db)
@@ -19,6 +19,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <strings.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <time.h>
@@ -27,6 +29,7 @@
 
 #include "libknot/libknot.h"
 #include "contrib/files.h"
+#include "contrib/macros.h"
 #include "knot/common/log.h"
 #include "knot/dnssec/zone-nsec.h"
 #include "knot/zone/semantic-check.h"
@@ -39,6 +42,24 @@
 #define WARNING(zone, fmt, ...) log_zone_warning(zone, "zone loader, " fmt, ##__VA_ARGS__)
 #define NOTICE(zone, fmt, ...) log_zone_notice(zone, "zone loader, " fmt, ##__VA_ARGS__)
 
+/*! \brief Minimal zone file size per parsing thread. */
+#define CHUNK_MIN_SIZE (4 * 1024 * 1024)
+
+/*! \brief Zone file part parsed by one thread. */
+typedef struct {
+	const char *start;    /*!< Chunk data. */
+	size_t size;          /*!< Chunk data length. */
+	uint64_t line;        /*!< Line number of the chunk start. */
+	char *origin;         /*!< Origin valid at the chunk start. */
+	uint32_t ttl;         /*!< Default TTL valid at the chunk start. */
+	const char *source;   /*!< Zone file name. */
+	zcreator_t zc;        /*!< Zone fragment creator. */
+	uint64_t errors;      /*!< Number of scanner errors. */
+	int scanner_ret;      /*!< Scanner error code if failed without errors. */
+	pthread_t thread;
+	int thread_ret;
+} zchunk_t;
+
 static void process_error(zs_scanner_t *s)
 {
 	zcreator_t *zc = s->process.data;
@@ -130,6 +151,404 @@ static void process_data(zs_scanner_t *scanner)
 	knot_rrset_clear(&rr, NULL);
 }
 
+/*! \brief Update the tracked origin or default TTL by a directive line. */
+static int chunk_track_directive(zs_scanner_t *state, const char *line, const char *end)
+{
+	const char *eol = memchr(line, '\n', end - line);
+	size_t len = (eol != NULL) ? eol - line : end - line;
+
+	char buf[1024];
+	if (len >= sizeof(buf) || memchr(line, '(', len) != NULL) {
+		return KNOT_ENOTSUP;
+	}
+	memcpy(buf, line, len);
+	buf[len] = '\n';
+
+	// Let the serial parsing report invalid directives.
+	if (zs_set_input_string(state, buf, len + 1) != 0 ||
+	    zs_parse_all(state) != 0) {
+		return KNOT_ENOTSUP;
+	}
+
+	return KNOT_EOK;
+}
+
+static int chunk_init(zchunk_t *chunk, const char *start, uint64_t line,
+                      const zs_scanner_t *state, const char *source)
+{
+	chunk->start = start;
+	chunk->line = line;
+	chunk->ttl = state->default_ttl;
+	chunk->source = source;
+	chunk->origin = knot_dname_to_str_alloc(state->zone_origin);
+
+	return (chunk->origin != NULL) ? KNOT_EOK : KNOT_ENOMEM;
+}
+
+static bool is_directive(const char *pos, const char *end, const char *name)
+{
+	size_t len = strlen(name);
+	return end - pos > len && strncasecmp(pos, name, len) == 0 &&
+	       (pos[len] == ' ' || pos[len] == '\t');
+}
+
+/*!
+ * \brief Split the zone file into chunks parsable independently.
+ *
+ * A chunk starts at a line with an explicit owner outside of parentheses
+ * and quotes, so the only carried state is the origin and the default TTL.
+ */
+static int chunks_split(zloader_t *loader, zchunk_t *chunks, unsigned *count)
+{
+	const char *pos = loader->scanner.input.start;
+	const char *end = loader->scanner.input.end;
+	const size_t step = (end - pos) / *count;
+
+	char *origin = knot_dname_to_str_alloc(loader->creator->z->apex->owner);
+	if (origin == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	zs_scanner_t state;
+	int ret = zs_init(&state, origin, KNOT_CLASS_IN, loader->scanner.default_ttl);
+	free(origin);
+	if (ret != 0) {
+		zs_deinit(&state);
+		return KNOT_ENOMEM;
+	}
+
+	ret = chunk_init(&chunks[0], pos, 1, &state, loader->source);
+	unsigned n = 1;
+	const char *next = pos + step;
+	uint64_t line = 1;
+	unsigned depth = 0;
+	bool quoted = false, line_start = true;
+
+	// Scan the whole file to detect directives preventing the splitting.
+	while (ret == KNOT_EOK && pos < end) {
+		if (line_start && depth == 0 && !quoted) {
+			line_start = false;
+			if (*pos == '$') {
+				if (is_directive(pos, end, "$INCLUDE")) {
+					ret = KNOT_ENOTSUP;
+				} else if (is_directive(pos, end, "$ORIGIN") ||
+				           is_directive(pos, end, "$TTL")) {
+					ret = chunk_track_directive(&state, pos, end);
+				}
+			} else if (n < *count && pos >= next &&
+			           strchr(" \t\r\n;()", *pos) == NULL) {
+				chunks[n - 1].size = pos - chunks[n - 1].start;
+				ret = chunk_init(&chunks[n++], pos, line, &state, loader->source);
+				next = pos + step;
+			}
+			continue;
+		}
+
+		char c = *pos++;
+		if (quoted) {
+			if (c == '\\' && pos < end) {
+				line += (*pos++ == '\n');
+			} else if (c == '"') {
+				quoted = false;
+			} else if (c == '\n') {
+				line++;
+			}
+			continue;
+		}
+
+		switch (c) {
+		case ';':
+			pos = memchr(pos, '\n', end - pos);
+			pos = (pos != NULL) ? pos : end;
+			break;
+		case '"':
+			quoted = true;
+			break;
+		case '(':
+			depth++;
+			break;
+		case ')':
+			depth -= (depth > 0);
+			break;
+		case '\\':
+			if (pos < end) {
+				line += (*pos++ == '\n');
+			}
+			break;
+		case '\n':
+			line++;
+			line_start = true;
+			break;
+		default:
+			break;
+		}
+	}
+	chunks[n - 1].size = end - chunks[n - 1].start;
+	*count = n;
+
+	zs_deinit(&state);
+
+	return ret;
+}
+
+static void *chunk_parse(void *arg)
+{
+	zchunk_t *chunk = arg;
+
+	zs_scanner_t s;
+	if (zs_init(&s, chunk->origin, KNOT_CLASS_IN, chunk->ttl) != 0 ||
+	    zs_set_input_string(&s, chunk->start, chunk->size) != 0 ||
+	    zs_set_processing(&s, process_data, process_error, &chunk->zc) != 0) {
+		chunk->scanner_ret = s.error.code;
+	} else {
+		s.line_counter = chunk->line;
+		s.file.name = strdup(chunk->source);
+		if (zs_parse_all(&s) != 0 && s.error.counter == 0) {
+			chunk->scanner_ret = s.error.code;
+		}
+		chunk->errors = s.error.counter;
+	}
+	zs_deinit(&s);
+
+	return NULL;
+}
+
+static int merge_rrsets(zcreator_t *zc, zone_node_t *into, const zone_node_t *node)
+{
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		knot_rrset_t rr = node_rrset_at(node, i);
+		int ret = node_add_rrset(into, &rr, NULL);
+		if (ret != KNOT_EOK && !handle_err(zc, &rr, ret, zc->master)) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+typedef struct {
+	zone_node_t **nodes;
+	size_t count;
+	size_t max;
+} merged_nodes_t;
+
+/*!
+ * \brief Move nodes of a zone fragment tree into the zone.
+ *
+ * Nodes not present in the zone are relinked as they are, including their
+ * parent pointers. Already present nodes get the records merged, and the
+ * fragment node, remembering its counterpart in 'prev', is freed later.
+ * Parents precede their children in the tree order.
+ */
+static int merge_tree(zcreator_t *zc, zone_tree_t *into, zone_tree_t *from,
+                      merged_nodes_t *merged)
+{
+	zone_tree_it_t it = { 0 };
+	int ret = zone_tree_it_begin(from, &it);
+	while (ret == KNOT_EOK && !zone_tree_it_finished(&it)) {
+		zone_node_t *node = zone_tree_it_val(&it);
+		zone_tree_it_next(&it);
+
+		knot_dname_storage_t lf_storage;
+		uint8_t *lf = knot_dname_lf(node->owner, lf_storage);
+		trie_val_t *val = trie_get_ins(into->trie, lf + 1, *lf);
+		if (val == NULL) {
+			ret = KNOT_ENOMEM;
+			break;
+		}
+
+		if (*val == NULL) {
+			*val = binode_first(node);
+			zone_node_t *parent = node->parent;
+			if (parent != NULL && parent->prev != NULL) {
+				node->parent = parent->prev;
+				node->parent->children++;
+				if (knot_dname_is_wildcard(node->owner)) {
+					node->parent->flags |= NODE_FLAGS_WILDCARD_CHILD;
+				}
+			}
+			continue;
+		}
+
+		if (merged->count == merged->max) {
+			size_t max = MAX(2 * merged->max, 64);
+			zone_node_t **nodes = realloc(merged->nodes, max * sizeof(*nodes));
+			if (nodes == NULL) {
+				ret = KNOT_ENOMEM;
+				break;
+			}
+			merged->nodes = nodes;
+			merged->max = max;
+		}
+		merged->nodes[merged->count++] = node;
+
+		node->prev = zone_tree_fix_get(*val, into);
+		ret = merge_rrsets(zc, node->prev, node);
+	}
+	zone_tree_it_free(&it);
+
+	return ret;
+}
+
+static int free_unmoved(zone_node_t *node, void *ctx)
+{
+	if (zone_tree_get(ctx, node->owner) != node) {
+		binode_unify(node, false, NULL);
+		node_free_rrsets(node, NULL);
+		node_free(node, NULL);
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Merge the zone fragment into the zone and free the fragment. */
+static int merge_fragment(zcreator_t *zc, zone_contents_t *fragment)
+{
+	merged_nodes_t merged = { 0 };
+
+	int ret = merge_tree(zc, zc->z->nodes, fragment->nodes, &merged);
+	if (ret == KNOT_EOK && fragment->nsec3_nodes != NULL) {
+		if (zc->z->nsec3_nodes == NULL) {
+			zc->z->nsec3_nodes = zone_tree_create(zc->z->nodes->flags & ZONE_TREE_USE_BINODES);
+			if (zc->z->nsec3_nodes == NULL) {
+				ret = KNOT_ENOMEM;
+			} else {
+				zc->z->nsec3_nodes->flags = zc->z->nodes->flags;
+			}
+		}
+		if (ret == KNOT_EOK) {
+			ret = merge_tree(zc, zc->z->nsec3_nodes, fragment->nsec3_nodes, &merged);
+		}
+	}
+
+	if (ret == KNOT_EOK) {
+		for (size_t i = 0; i < merged.count; i++) {
+			binode_unify(merged.nodes[i], false, NULL);
+			node_free_rrsets(merged.nodes[i], NULL);
+			node_free(merged.nodes[i], NULL);
+		}
+	} else {
+		(void)zone_tree_apply(fragment->nodes, free_unmoved, zc->z->nodes);
+		(void)zone_tree_apply(fragment->nsec3_nodes, free_unmoved, zc->z->nsec3_nodes);
+	}
+	free(merged.nodes);
+	zone_contents_free(fragment);
+
+	return ret;
+}
+
+static void chunks_free(zchunk_t *chunks, unsigned count)
+{
+	for (unsigned i = 0; i < count; i++) {
+		free(chunks[i].origin);
+		if (i > 0) {
+			zone_contents_deep_free(chunks[i].zc.z);
+		}
+	}
+}
+
+/*!
+ * \brief Parse the zone file in parallel into fragments merged into the zone.
+ *
+ * \retval KNOT_ENOTSUP if the zone file cannot be split.
+ */
+static int parse_parallel(zloader_t *loader, unsigned threads)
+{
+	zcreator_t *zc = loader->creator;
+	const knot_dname_t *zname = zc->z->apex->owner;
+
+	zchunk_t chunks[threads];
+	memset(chunks, 0, sizeof(chunks));
+
+	int ret = chunks_split(loader, chunks, &threads);
+	for (unsigned i = 0; ret == KNOT_EOK && i < threads; i++) {
+		chunks[i].zc.master = zc->master;
+		chunks[i].zc.z = (i == 0) ? zc->z : zone_contents_new(zname, true);
+		if (chunks[i].zc.z == NULL) {
+			ret = KNOT_ENOMEM;
+		}
+	}
+	if (ret != KNOT_EOK) {
+		chunks_free(chunks, threads);
+		return ret;
+	}
+
+	for (unsigned i = 0; i < threads; i++) {
+		chunks[i].thread_ret = pthread_create(&chunks[i].thread, NULL,
+		                                      chunk_parse, &chunks[i]);
+	}
+
+	uint64_t errors = 0;
+	for (unsigned i = 0; i < threads; i++) {
+		if (chunks[i].thread_ret == 0) {
+			chunks[i].thread_ret = pthread_join(chunks[i].thread, NULL);
+		}
+		if (chunks[i].thread_ret != 0 && ret == KNOT_EOK) {
+			ret = knot_map_errno_code(chunks[i].thread_ret);
+		}
+		errors += chunks[i].errors;
+	}
+
+	for (unsigned i = 0; i < threads; i++) {
+		if (ret == KNOT_EOK && chunks[i].scanner_ret != 0) {
+			ERROR(zname, "failed to load zone, file '%s' (%s)",
+			      loader->source, zs_strerror(chunks[i].scanner_ret));
+			ret = KNOT_EPARSEFAIL;
+		}
+		if (ret == KNOT_EOK && chunks[i].zc.ret != KNOT_EOK) {
+			ret = chunks[i].zc.ret;
+			ERROR(zname, "failed to load zone, file '%s' (%s)",
+			      loader->source, knot_strerror(ret));
+		}
+	}
+	if (ret == KNOT_EOK && errors > 0) {
+		ERROR(zname, "failed to load zone, file '%s', %"PRIu64" errors",
+		      loader->source, errors);
+		ret = KNOT_EPARSEFAIL;
+	}
+
+	// Merge in the file order, later TTLs take precedence.
+	for (unsigned i = 1; ret == KNOT_EOK && i < threads; i++) {
+		ret = merge_fragment(zc, chunks[i].zc.z);
+		chunks[i].zc.z = NULL;
+		if (ret != KNOT_EOK) {
+			ERROR(zname, "failed to load zone, file '%s' (%s)",
+			      loader->source, knot_strerror(ret));
+		}
+	}
+
+	chunks_free(chunks, threads);
+
+	return ret;
+}
+
+static int parse_serial(zloader_t *loader)
+{
+	zcreator_t *zc = loader->creator;
+	const knot_dname_t *zname = zc->z->apex->owner;
+
+	int ret = zs_parse_all(&loader->scanner);
+	if (ret != 0 && loader->scanner.error.counter == 0) {
+		ERROR(zname, "failed to load zone, file '%s' (%s)",
+		      loader->source, zs_strerror(loader->scanner.error.code));
+		return KNOT_EPARSEFAIL;
+	}
+
+	if (zc->ret != KNOT_EOK) {
+		ERROR(zname, "failed to load zone, file '%s' (%s)",
+		      loader->source, knot_strerror(zc->ret));
+		return zc->ret;
+	}
+
+	if (loader->scanner.error.counter > 0) {
+		ERROR(zname, "failed to load zone, file '%s', %"PRIu64" errors",
+		      loader->source, loader->scanner.error.counter);
+		return KNOT_EPARSEFAIL;
+	}
+
+	return KNOT_EOK;
+}
+
 int zonefile_open(zloader_t *loader, const char *source, const knot_dname_t *origin,
                   uint32_t dflt_ttl, semcheck_optional_t semantic_checks, time_t time)
 {
@@ -180,6 +599,7 @@ int zonefile_open(zloader_t *loader, const char *source, const knot_dname_t *ori
 	loader->creator = zc;
 	loader->semantic_checks = semantic_checks;
 	loader->time = time;
+	loader->threads = 1;
 
 	return KNOT_EOK;
 }
@@ -194,22 +614,16 @@ zone_contents_t *zonefile_load(zloader_t *loader)
 	const knot_dname_t *zname = zc->z->apex->owner;
 
 	assert(zc);
-	int ret = zs_parse_all(&loader->scanner);
-	if (ret != 0 && loader->scanner.error.counter == 0) {
-		ERROR(zname, "failed to load zone, file '%s' (%s)",
-		      loader->source, zs_strerror(loader->scanner.error.code));
-		goto fail;
+	size_t size = loader->scanner.input.end - loader->scanner.input.start;
+	unsigned threads = MIN(loader->threads, size / CHUNK_MIN_SIZE);
+	int ret = KNOT_ENOTSUP;
+	if (threads > 1) {
+		ret = parse_parallel(loader, threads);
 	}
-
-	if (zc->ret != KNOT_EOK) {
-		ERROR(zname, "failed to load zone, file '%s' (%s)",
-		      loader->source, knot_strerror(zc->ret));
-		goto fail;
+	if (ret == KNOT_ENOTSUP) {
+		ret = parse_serial(loader);
 	}
-
-	if (loader->scanner.error.counter > 0) {
-		ERROR(zname, "failed to load zone, file '%s', %"PRIu64" errors",
-		      loader->source, loader->scanner.error.counter);
+	if (ret != KNOT_EOK) {
 		goto fail;
 	}
 
@@ -25,8 +25,8 @@
 #include "libknot/errcode.h"
 #include "libknot/packet/wire.h"
 #include "contrib/ctype.h"
+#include "contrib/lower/lower.h"
 #include "contrib/mempattern.h"
-#include "contrib/tolower.h"
 
 static bool label_is_equal(const uint8_t *lb1, const uint8_t *lb2, bool no_case)
 {
@@ -35,14 +35,7 @@ static bool label_is_equal(const uint8_t *lb1, const uint8_t *lb2, bool no_case)
 	}
 
 	if (no_case) {
-		uint8_t len = *lb1;
-		for (uint8_t i = 1; i <= len; i++) {
-			if (knot_tolower(lb1[i]) != knot_tolower(lb2[i])) {
-				return false;
-			}
-		}
-
-		return true;
+		return LOWER.equal(lb1 + 1, lb2 + 1, *lb1);
 	} else {
 		return memcmp(lb1 + 1, lb2 + 1, *lb1) == 0;
 	}
@@ -478,13 +471,8 @@ void knot_dname_to_lower(knot_dname_t *name)
 		return;
 	}
 
-	while (*name != '\0') {
-		uint8_t len = *name;
-		for (uint8_t i = 1; i <= len; ++i) {
-			name[i] = knot_tolower(name[i]);
-		}
-		name += 1 + len;
-	}
+	// Label lengths are below 'A', the whole name can be converted at once.
+	LOWER.copy(name, name, knot_dname_size(name));
 }
 
 _public_
@@ -494,16 +482,7 @@ void knot_dname_copy_lower(knot_dname_t *dst, const knot_dname_t *name)
 		return;
 	}
 
-	while (*name != '\0') {
-		uint8_t len = *name;
-		*dst = len;
-		for (uint8_t i = 1; i <= len; ++i) {
-			dst[i] = knot_tolower(name[i]);
-		}
-		dst += 1 + len;
-		name += 1 + len;
-	}
-	*dst = '\0';
+	LOWER.copy(dst, name, knot_dname_size(name));
 }
 
 _public_
@@ -682,6 +661,12 @@ inline static bool dname_is_equal(const knot_dname_t *d1, const knot_dname_t *d2
 		return false;
 	}
 
+	/* Equal names in any letter case also have equal label lengths. */
+	if (no_case) {
+		size_t size = knot_dname_size(d1);
+		return size == knot_dname_size(d2) && LOWER.equal(d1, d2, size);
+	}
+
 	while (*d1 != '\0' || *d2 != '\0') {
 		if (label_is_equal(d1, d2, no_case)) {
 			d1 = knot_dname_next_label(d1);
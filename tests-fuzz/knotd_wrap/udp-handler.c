@@ -35,7 +35,8 @@ static inline void next(udp_stdin_t *rq)
 	}
 }
 
-static void *udp_stdin_init(_unused_ udp_context_t *ctx, _unused_ void *xdp_sock)
+static void *udp_stdin_init(_unused_ udp_context_t *ctx, _unused_ fdset_t *fds,
+                            _unused_ void *xdp_sock)
 {
 	udp_stdin_t *rq = calloc(1, sizeof(*rq));
 	if (rq == NULL) {
@@ -88,11 +89,11 @@ static void udp_stdin_send(void *d)
 }
 
 static udp_api_t stdin_api = {
-	udp_stdin_init,
-	udp_stdin_deinit,
-	udp_stdin_recv,
-	udp_stdin_handle,
-	udp_stdin_send
+	.udp_init = udp_stdin_init,
+	.udp_deinit = udp_stdin_deinit,
+	.udp_recv = udp_stdin_recv,
+	.udp_handle = udp_stdin_handle,
+	.udp_send = udp_stdin_send,
 };
 
 void udp_master_init_stdio(server_t *server) {
@@ -0,0 +1,162 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <tap/basic.h>
+
+#include <stdlib.h>
+
+#include "contrib/addr_set.h"
+#include "contrib/sockaddr.h"
+#include "libknot/errcode.h"
+
+#define RANDOM_ITEMS	200
+#define RANDOM_LOOKUPS	20000
+
+static struct sockaddr_storage addr(int family, const char *str)
+{
+	struct sockaddr_storage ss;
+	sockaddr_set(&ss, family, str, 0);
+	return ss;
+}
+
+static void test_match(addr_set_t *set, int family, const char *str, bool expected)
+{
+	struct sockaddr_storage ss = addr(family, str);
+	ok(addr_set_match(set, &ss) == expected, "%s %s", str,
+	   expected ? "matches" : "doesn't match");
+}
+
+static void test_basic(void)
+{
+	addr_set_t *set = addr_set_new();
+	ok(set != NULL, "create");
+
+	test_match(set, AF_INET, "192.0.2.1", false);
+
+	struct sockaddr_storage min, max;
+
+	min = addr(AF_INET, "192.0.2.0");
+	ok(addr_set_add_net(set, &min, 24) == KNOT_EOK, "add IPv4 prefix");
+	min = addr(AF_INET, "10.0.0.5");
+	max = addr(AF_INET, "10.0.1.2");
+	ok(addr_set_add_range(set, &min, &max) == KNOT_EOK, "add IPv4 range");
+	min = addr(AF_INET6, "2001:db8::");
+	ok(addr_set_add_net(set, &min, 32) == KNOT_EOK, "add IPv6 prefix");
+	min = addr(AF_INET6, "::1");
+	ok(addr_set_add_net(set, &min, 200) == KNOT_EOK, "add IPv6 host");
+	min = addr(AF_UNIX, "/run/knot.sock");
+	ok(addr_set_add_net(set, &min, 0) == KNOT_EOK, "add UNIX path");
+	min = addr(AF_INET, "10.0.0.9");
+	max = addr(AF_INET, "10.0.0.1");
+	ok(addr_set_add_range(set, &min, &max) == KNOT_EOK, "add empty range");
+	max = addr(AF_INET6, "::1");
+	ok(addr_set_add_range(set, &min, &max) == KNOT_EINVAL, "add mixed range");
+
+	test_match(set, AF_INET, "192.0.2.0", true);
+	test_match(set, AF_INET, "192.0.2.255", true);
+	test_match(set, AF_INET, "192.0.3.0", false);
+	test_match(set, AF_INET, "10.0.0.4", false);
+	test_match(set, AF_INET, "10.0.0.5", true);
+	test_match(set, AF_INET, "10.0.0.200", true);
+	test_match(set, AF_INET, "10.0.1.2", true);
+	test_match(set, AF_INET, "10.0.1.3", false);
+	test_match(set, AF_INET6, "2001:db8:ffff::1", true);
+	test_match(set, AF_INET6, "2001:db9::", false);
+	test_match(set, AF_INET6, "::1", true);
+	test_match(set, AF_INET6, "::2", false);
+	test_match(set, AF_INET6, "::ffff:192.0.2.1", false);
+	test_match(set, AF_UNIX, "/run/knot.sock", true);
+	test_match(set, AF_UNIX, "/run/other.sock", false);
+
+	min = addr(AF_INET, "0.0.0.0");
+	ok(addr_set_add_net(set, &min, 0) == KNOT_EOK, "add whole IPv4 space");
+	test_match(set, AF_INET, "198.51.100.1", true);
+	test_match(set, AF_INET6, "2001:db9::", false);
+
+	addr_set_free(set);
+}
+
+static void random_addr(struct sockaddr_storage *ss, int family)
+{
+	size_t len = 0;
+	sockaddr_set(ss, family, family == AF_INET ? "0.0.0.0" : "::", 0);
+	uint8_t *raw = sockaddr_raw(ss, &len);
+	for (size_t i = 0; i < len; i++) {
+		// Few distinct values to hit the ranges often.
+		raw[i] = (i < 2 || i == len - 1) ? rand() % 4 : 0;
+	}
+}
+
+static void test_random(int family)
+{
+	struct {
+		struct sockaddr_storage min, max;
+		unsigned prefix;
+	} items[RANDOM_ITEMS];
+
+	addr_set_t *set = addr_set_new();
+	unsigned bits = (family == AF_INET) ? 32 : 128;
+	bool added = true;
+	for (int i = 0; i < RANDOM_ITEMS; i++) {
+		random_addr(&items[i].min, family);
+		if (i % 2 == 0) {
+			items[i].max.ss_family = AF_UNSPEC;
+			items[i].prefix = 8 + rand() % (bits - 7);
+			added &= (addr_set_add_net(set, &items[i].min,
+			                           items[i].prefix) == KNOT_EOK);
+		} else {
+			random_addr(&items[i].max, family);
+			added &= (addr_set_add_range(set, &items[i].min,
+			                             &items[i].max) == KNOT_EOK);
+		}
+	}
+	ok(added, "IPv%u: add random items", family == AF_INET ? 4 : 6);
+
+	bool same = true;
+	for (int i = 0; i < RANDOM_LOOKUPS; i++) {
+		struct sockaddr_storage ss;
+		random_addr(&ss, family);
+
+		bool linear = false;
+		for (int j = 0; j < RANDOM_ITEMS && !linear; j++) {
+			if (items[j].max.ss_family == AF_UNSPEC) {
+				linear = sockaddr_net_match(&ss, &items[j].min,
+				                            items[j].prefix);
+			} else {
+				linear = sockaddr_range_match(&ss, &items[j].min,
+				                              &items[j].max);
+			}
+		}
+		same &= (addr_set_match(set, &ss) == linear);
+	}
+	ok(same, "IPv%u: lookups equal to linear matching",
+	   family == AF_INET ? 4 : 6);
+
+	addr_set_free(set);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	test_basic();
+
+	srand(1);
+	test_random(AF_INET);
+	test_random(AF_INET6);
+
+	return 0;
+}
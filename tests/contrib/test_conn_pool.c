@@ -0,0 +1,112 @@
+/*  Copyright (C) 2022 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <tap/basic.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "contrib/conn_pool.h"
+#include "contrib/sockaddr.h"
+
+#define CAPACITY 4
+
+static int closed;
+
+static void close_cb(conn_pool_fd_t fd)
+{
+	(void)fd;
+	closed++;
+}
+
+static bool invalid_cb(conn_pool_fd_t fd)
+{
+	return fd >= 1000;
+}
+
+static void test_get_put(void)
+{
+	conn_pool_t *pool = conn_pool_init(CAPACITY, 60, close_cb, invalid_cb);
+	ok(pool != NULL, "init");
+
+	struct sockaddr_storage src, src2, dst, dst2;
+	sockaddr_set(&src, AF_INET, "192.0.2.1", 1000);
+	sockaddr_set(&src2, AF_INET, "192.0.2.1", 2000);
+	sockaddr_set(&dst, AF_INET6, "2001:db8::1", 53);
+	sockaddr_set(&dst2, AF_INET6, "2001:db8::1", 853);
+
+	ok(conn_pool_get(pool, &src, &dst) == CONN_POOL_FD_INVALID, "get from empty");
+
+	ok(conn_pool_put(pool, &src, &dst, 1) == CONN_POOL_FD_INVALID, "put first");
+	ok(conn_pool_put(pool, &src, &dst, 2) == CONN_POOL_FD_INVALID, "put second");
+	ok(conn_pool_put(pool, &src, &dst2, 3) == CONN_POOL_FD_INVALID, "put other port");
+	ok(ATOMIC_GET(pool->usage) == 3, "usage");
+
+	ok(conn_pool_get(pool, &src2, &dst) == 2, "get newest, source port ignored");
+	ok(conn_pool_get(pool, &src, &dst) == 1, "get older");
+	ok(conn_pool_get(pool, &src, &dst) == CONN_POOL_FD_INVALID, "get exhausted");
+	ok(conn_pool_get(pool, &src, &dst2) == 3, "get destination port matched");
+
+	// displacement
+
+	for (int i = 0; i < CAPACITY; i++) {
+		conn_pool_put(pool, &src, &dst, 10 + i);
+	}
+	ok(conn_pool_put(pool, &src, &dst2, 20) == 10, "put displaces oldest");
+	ok(ATOMIC_GET(pool->usage) == CAPACITY, "usage at capacity");
+
+	// dead connections
+
+	ok(conn_pool_get(pool, &src, &dst) == 10 + CAPACITY - 1, "get after displacement");
+	conn_pool_put(pool, &src, &dst2, 1000);
+	closed = 0;
+	ok(conn_pool_get(pool, &src, &dst2) == 20 && closed == 1, "get skips dead connection");
+
+	conn_pool_deinit(pool);
+	ok(closed == 1 + CAPACITY - 2, "deinit closes pooled connections");
+}
+
+static void test_many(void)
+{
+	const int count = 1000;
+	conn_pool_t *pool = conn_pool_init(count, 60, close_cb, invalid_cb);
+
+	struct sockaddr_storage src, dst;
+	sockaddr_set(&src, AF_INET, "192.0.2.1", 0);
+
+	bool success = true;
+	for (int i = 0; i < count; i++) {
+		sockaddr_set(&dst, AF_INET, "198.51.100.1", i);
+		success &= (conn_pool_put(pool, &src, &dst, i) == CONN_POOL_FD_INVALID);
+	}
+	for (int i = count - 1; i >= 0; i--) {
+		sockaddr_set(&dst, AF_INET, "198.51.100.1", i);
+		success &= (conn_pool_get(pool, &src, &dst) == i);
+	}
+	ok(success && ATOMIC_GET(pool->usage) == 0, "many destinations");
+
+	conn_pool_deinit(pool);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	test_get_put();
+	test_many();
+
+	return 0;
+}
@@ -1,4 +1,4 @@
-/*  Copyright (C) 2019 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
 
     This program is free software: you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -178,6 +178,60 @@ static void test_wildcards(void)
 	ok(true, "trie: wildcard searches");
 }
 
+static bool even_len(uint32_t len, void *d)
+{
+	return len % 2 == 0;
+}
+
+static void test_longest_prefix(void)
+{
+	/* Short keys from a tiny alphabet to have many prefixes. */
+	const unsigned key_count = 2000, lookups = 20000;
+	uint8_t keys[key_count][8];
+	size_t lens[key_count];
+
+	trie_t *trie = trie_create(NULL);
+	for (unsigned i = 0; i < key_count; ++i) {
+		lens[i] = rand() % sizeof(keys[i]);
+		for (size_t j = 0; j < lens[i]; ++j) {
+			keys[i][j] = rand() % 3;
+		}
+		trie_val_t *val = trie_get_ins(trie, keys[i], lens[i]);
+		*val = keys[i];
+	}
+
+	bool passed = true;
+	for (unsigned i = 0; i < lookups && passed; ++i) {
+		uint8_t key[12];
+		uint32_t len = rand() % sizeof(key);
+		for (size_t j = 0; j < len; ++j) {
+			key[j] = rand() % 3;
+		}
+		bool even = (i % 2 == 1);
+
+		/* Reference: try all prefixes from the longest one. */
+		trie_val_t *expected = NULL;
+		for (int plen = len; plen >= 0 && expected == NULL; --plen) {
+			if (!even || plen % 2 == 0) {
+				expected = trie_get_try(trie, key, plen);
+			}
+		}
+
+		trie_val_t *found = trie_get_longest_prefix(trie, key, len,
+		                                            even ? even_len : NULL, NULL);
+		if (found != expected) {
+			diag("trie: longest prefix mismatch, key length %u", len);
+			passed = false;
+		}
+	}
+	ok(passed, "trie: longest prefix searches");
+
+	trie_clear(trie);
+	ok(trie_get_longest_prefix(trie, (uint8_t *)"", 0, NULL, NULL) == NULL,
+	   "trie: longest prefix in empty trie");
+	trie_free(trie);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -280,5 +334,8 @@ int main(int argc, char *argv[])
 	/* Test trie_get_try_wildcard(). */
 	test_wildcards();
 
+	/* Test trie_get_longest_prefix(). */
+	test_longest_prefix();
+
 	return 0;
 }
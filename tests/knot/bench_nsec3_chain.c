@@ -0,0 +1,145 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Micro-benchmark of the NSEC3 chain creation. A generated zone with the
+ * given number of names gets its NSEC3 chain created by
+ * knot_nsec3_create_chain() for various iteration counts and numbers
+ * of threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "knot/dnssec/nsec3-chain.h"
+#include "knot/updates/zone-update.h"
+#include "knot/zone/adjust.h"
+#include "knot/zone/zone.h"
+#include "libdnssec/crypto.h"
+#include "libknot/dname.h"
+
+#define DEFAULT_NAMES	200000
+#define TTL		3600
+
+static int add_rr(zone_update_t *up, const knot_dname_t *owner, uint16_t type,
+                  const uint8_t *rdata, uint16_t rdata_len)
+{
+	knot_rrset_t *rr = knot_rrset_new(owner, type, KNOT_CLASS_IN, TTL, NULL);
+	if (rr == NULL) {
+		return KNOT_ENOMEM;
+	}
+	int ret = knot_rrset_add_rdata(rr, rdata, rdata_len, NULL);
+	if (ret == KNOT_EOK) {
+		ret = zone_update_add(up, rr);
+	}
+	knot_rrset_free(rr, NULL);
+	return ret;
+}
+
+static int fill_zone(zone_update_t *up, const knot_dname_t *apex, unsigned names)
+{
+	// Root MNAME and RNAME followed by the serial and the timers.
+	uint8_t soa[2 + 5 * sizeof(uint32_t)] = { 0 };
+	int ret = add_rr(up, apex, KNOT_RRTYPE_SOA, soa, sizeof(soa));
+
+	const uint8_t addr[] = { 192, 0, 2, 1 };
+	for (unsigned i = 0; i < names && ret == KNOT_EOK; i++) {
+		char name_str[32];
+		(void)snprintf(name_str, sizeof(name_str), "host%u.example.", i);
+		knot_dname_t *owner = knot_dname_from_str_alloc(name_str);
+		ret = (owner != NULL) ? add_rr(up, owner, KNOT_RRTYPE_A, addr, sizeof(addr))
+		                      : KNOT_ENOMEM;
+		knot_dname_free(owner, NULL);
+	}
+
+	return ret;
+}
+
+static double elapsed_s(const struct timespec *begin, const struct timespec *end)
+{
+	return (end->tv_sec - begin->tv_sec) + (end->tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+static int bench(zone_t *zone, unsigned names, unsigned iterations, unsigned threads)
+{
+	const dnssec_nsec3_params_t params = {
+		.algorithm = DNSSEC_NSEC3_ALGORITHM_SHA1,
+		.iterations = iterations,
+		.salt = { .size = 8, .data = (uint8_t *)"\x01\x02\x03\x04\x05\x06\x07\x08" }
+	};
+
+	zone_update_t up;
+	int ret = zone_update_init(&up, zone, UPDATE_FULL);
+	if (ret != KNOT_EOK) {
+		return EXIT_FAILURE;
+	}
+	ret = fill_zone(&up, zone->name, names);
+	if (ret == KNOT_EOK) {
+		ret = zone_adjust_full(up.new_cont, 1);
+	}
+
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	if (ret == KNOT_EOK) {
+		ret = knot_nsec3_create_chain(up.new_cont, &params, TTL, &up, threads);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	zone_update_clear(&up);
+
+	printf("%8u names  %4u iterations  %2u threads  %8.3f s%s\n", names,
+	       iterations, threads, elapsed_s(&begin, &end),
+	       ret == KNOT_EOK ? "" : "  FAILED");
+
+	return ret == KNOT_EOK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned names = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_NAMES;
+	if (names == 0) {
+		printf("Usage: %s [names]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	dnssec_crypto_init();
+
+	knot_dname_t *apex = knot_dname_from_str_alloc("example.");
+	zone_t *zone = zone_new(apex);
+	knot_dname_free(apex, NULL);
+	if (zone == NULL) {
+		dnssec_crypto_cleanup();
+		return EXIT_FAILURE;
+	}
+
+	const unsigned iterations[] = { 0, 10 };
+	const unsigned threads[] = { 1, 2, 4, 8 };
+
+	int ret = EXIT_SUCCESS;
+	for (size_t i = 0; i < sizeof(iterations) / sizeof(*iterations); i++) {
+		for (size_t j = 0; j < sizeof(threads) / sizeof(*threads); j++) {
+			if (bench(zone, names, iterations[i], threads[j]) != EXIT_SUCCESS) {
+				ret = EXIT_FAILURE;
+			}
+		}
+	}
+
+	zone_free(&zone);
+	dnssec_crypto_cleanup();
+
+	return ret;
+}
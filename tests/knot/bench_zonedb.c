@@ -0,0 +1,163 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Micro-benchmark of the zone database suffix lookup. Stripping the QNAME
+ * label by label with knot_zonedb_find() is compared with the single-pass
+ * longest prefix search of knot_zonedb_find_suffix().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "knot/zone/zone.h"
+#include "knot/zone/zonedb.h"
+#include "libknot/dname.h"
+
+#define DEFAULT_QUERIES	1000000
+#define QUERY_SET	4096
+
+static const char *tlds[] = { "com", "net", "org", "cz", "example", "test" };
+
+static knot_dname_t *random_name(char *buf, size_t size, const char *base,
+                                 unsigned labels)
+{
+	size_t len = 0;
+	for (unsigned i = 0; i < labels; i++) {
+		len += snprintf(buf + len, size - len, "l%u-%x.", i, rand() % 256);
+	}
+	snprintf(buf + len, size - len, "%s", base);
+
+	return knot_dname_from_str_alloc(buf);
+}
+
+static zone_t *find_by_labels(knot_zonedb_t *db, const knot_dname_t *name)
+{
+	while (true) {
+		zone_t *zone = knot_zonedb_find(db, name);
+		if (zone != NULL || name[0] == 0) {
+			return zone;
+		}
+		name = knot_dname_next_label(name);
+	}
+}
+
+static void free_zones(knot_zonedb_t *db, zone_t **zone_list, unsigned count)
+{
+	knot_zonedb_free(&db);
+	for (unsigned i = 0; i < count; i++) {
+		zone_free(&zone_list[i]);
+	}
+	free(zone_list);
+}
+
+static double elapsed_ns(const struct timespec *begin, const struct timespec *end)
+{
+	return (end->tv_sec - begin->tv_sec) * 1e9 + (end->tv_nsec - begin->tv_nsec);
+}
+
+static int bench(unsigned zones, unsigned labels, unsigned queries)
+{
+	char buf[KNOT_DNAME_TXT_MAXLEN + 1];
+	zone_t **zone_list = calloc(zones, sizeof(*zone_list));
+	knot_zonedb_t *db = knot_zonedb_new();
+	if (zone_list == NULL || db == NULL) {
+		free(zone_list);
+		knot_zonedb_free(&db);
+		return EXIT_FAILURE;
+	}
+
+	/* Zones are second or third level names under a few TLDs. */
+	for (unsigned i = 0; i < zones; i++) {
+		const char *tld = tlds[i % (sizeof(tlds) / sizeof(*tlds))];
+		snprintf(buf, sizeof(buf), "%szone%u.%s", (i % 3 == 0) ? "sub." : "", i, tld);
+		knot_dname_t *name = knot_dname_from_str_alloc(buf);
+		zone_list[i] = zone_new(name);
+		knot_dname_free(name, NULL);
+		if (zone_list[i] == NULL || knot_zonedb_insert(db, zone_list[i]) != KNOT_EOK) {
+			free_zones(db, zone_list, i + 1);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* Names under random zones, some of them out of any zone. */
+	knot_dname_t *names[QUERY_SET];
+	for (unsigned i = 0; i < QUERY_SET; i++) {
+		char base[KNOT_DNAME_TXT_MAXLEN + 1];
+		if (i % 8 == 0) {
+			snprintf(base, sizeof(base), "nozone.invalid");
+		} else {
+			knot_dname_to_str(base, zone_list[rand() % zones]->name, sizeof(base));
+		}
+		names[i] = random_name(buf, sizeof(buf), base, labels);
+	}
+
+	struct timespec begin, end;
+	size_t found = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (unsigned i = 0; i < queries; i++) {
+		found += (find_by_labels(db, names[i % QUERY_SET]) != NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double by_labels = elapsed_ns(&begin, &end) / queries;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (unsigned i = 0; i < queries; i++) {
+		found -= (knot_zonedb_find_suffix(db, names[i % QUERY_SET]) != NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double longest_prefix = elapsed_ns(&begin, &end) / queries;
+
+	bool same = (found == 0);
+	for (unsigned i = 0; i < QUERY_SET; i++) {
+		same &= (find_by_labels(db, names[i]) == knot_zonedb_find_suffix(db, names[i]));
+		knot_dname_free(names[i], NULL);
+	}
+
+	printf("%8u zones  %3u labels  %8.1f ns by labels  %8.1f ns longest prefix%s\n",
+	       zones, labels, by_labels, longest_prefix, same ? "" : "  MISMATCH");
+
+	free_zones(db, zone_list, zones);
+
+	return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned queries = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_QUERIES;
+	if (queries == 0) {
+		printf("Usage: %s [queries]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	srand(1);
+
+	const unsigned zones[] = { 1000, 10000, 100000 };
+	const unsigned labels[] = { 1, 4, 16 };
+
+	int ret = EXIT_SUCCESS;
+	for (size_t i = 0; i < sizeof(zones) / sizeof(*zones); i++) {
+		for (size_t j = 0; j < sizeof(labels) / sizeof(*labels); j++) {
+			if (bench(zones[i], labels[j], queries) != EXIT_SUCCESS) {
+				ret = EXIT_FAILURE;
+			}
+		}
+	}
+
+	return ret;
+}
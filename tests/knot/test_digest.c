@@ -1,4 +1,4 @@
-/*  Copyright (C) 2022 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
 
     This program is free software: you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -16,6 +16,7 @@
 
 #include "knot/zone/digest.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <tap/basic.h>
 
@@ -91,7 +92,7 @@ static zone_contents_t *str2contents(const char *zone_str)
 static int check_contents(const char *zone_str)
 {
 	zone_contents_t *cont = str2contents(zone_str);
-	int ret = zone_contents_digest_verify(cont);
+	int ret = zone_contents_digest_verify(cont, 1);
 	zone_contents_deep_free(cont);
 	return ret;
 }
@@ -438,6 +439,41 @@ example.      86400  IN  SOA     ns1 admin 2018031900 (  \n\
 ns1           3600   IN  A       203.0.113.63            \n\
 ns2           3600   IN  AAAA    2001:db8::63";
 
+static void test_parallel(void)
+{
+	const size_t names = 5000;
+	const char *apex = "example. 86400 IN SOA ns1 admin 1 1800 900 604800 86400\n"
+	                   "example. 86400 IN NS ns1\n";
+	size_t size = strlen(apex) + names * 128;
+	char *zone_str = malloc(size);
+	assert(zone_str != NULL);
+
+	size_t len = snprintf(zone_str, size, "%s", apex);
+	for (size_t i = 0; i < names; i++) {
+		len += snprintf(zone_str + len, size - len,
+		                "n%zu.Example. 3600 IN A 192.0.2.%zu\n"
+		                "n%zu.example. 3600 IN TXT \"text %zu\"\n",
+		                i, i % 256, i, i);
+	}
+
+	zone_contents_t *cont = str2contents(zone_str);
+	free(zone_str);
+
+	uint8_t *serial_digest = NULL, *parallel_digest = NULL;
+	size_t serial_size = 0, parallel_size = 0;
+	int ret = zone_contents_digest(cont, 1, 1, &serial_digest, &serial_size);
+	is_int(KNOT_EOK, ret, "digest with one thread");
+	ret = zone_contents_digest(cont, 1, 4, &parallel_digest, &parallel_size);
+	is_int(KNOT_EOK, ret, "digest with more threads");
+	ok(serial_size == parallel_size && serial_size > 0 &&
+	   memcmp(serial_digest, parallel_digest, serial_size) == 0,
+	   "parallel digest equal to serial one");
+
+	free(serial_digest);
+	free(parallel_digest);
+	zone_contents_deep_free(cont);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -470,5 +506,7 @@ int main(int argc, char *argv[])
 	ret = check_contents(wrong_hash);
 	is_int(KNOT_EMALF, ret, "wrong hash");
 
+	test_parallel();
+
 	return 0;
 }
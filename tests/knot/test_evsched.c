@@ -0,0 +1,190 @@
+/*  Copyright (C) 2022 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <tap/basic.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libknot/errcode.h"
+#include "knot/common/evsched.h"
+#include "contrib/time.h"
+
+/*! Default number of timers in the throughput test, override with argv[1]. */
+#define BENCH_TIMERS 100000
+
+typedef struct {
+	pthread_mutex_t mx;
+	int order[4];
+	int fired;
+} fire_log_t;
+
+static fire_log_t fire_log = { .mx = PTHREAD_MUTEX_INITIALIZER };
+
+static void fire_cb(event_t *ev)
+{
+	pthread_mutex_lock(&fire_log.mx);
+	if (fire_log.fired < 4) {
+		fire_log.order[fire_log.fired] = (int)(intptr_t)ev->data;
+	}
+	fire_log.fired++;
+	pthread_mutex_unlock(&fire_log.mx);
+}
+
+static int fired_count(void)
+{
+	pthread_mutex_lock(&fire_log.mx);
+	int fired = fire_log.fired;
+	pthread_mutex_unlock(&fire_log.mx);
+
+	return fired;
+}
+
+static void wait_fired(int count, int timeout_ms)
+{
+	while (fired_count() < count && timeout_ms > 0) {
+		usleep(5000);
+		timeout_ms -= 5;
+	}
+}
+
+static void test_firing(void)
+{
+	evsched_t sched;
+	int ret = evsched_init(&sched, NULL);
+	ok(ret == KNOT_EOK, "evsched: init");
+
+	event_t *ev[4];
+	for (intptr_t i = 0; i < 4; i++) {
+		ev[i] = evsched_event_create(&sched, fire_cb, (void *)i);
+	}
+
+	evsched_start(&sched);
+
+	// schedule out of order, cancel one and move another
+
+	evsched_schedule(ev[0], 90);
+	evsched_schedule(ev[1], 30);
+	evsched_schedule(ev[2], 60);
+	evsched_schedule(ev[3], 10);
+	evsched_cancel(ev[3]);
+	evsched_schedule(ev[1], 5000);
+	evsched_schedule(ev[1], 0);
+
+	wait_fired(3, 2000);
+	usleep(50000);
+	ok(fired_count() == 3, "evsched: fired events count");
+	ok(fire_log.order[0] == 1 && fire_log.order[1] == 2 && fire_log.order[2] == 0,
+	   "evsched: fired events order");
+
+	// long timer not fired prematurely
+
+	evsched_schedule(ev[3], 100000);
+	usleep(20000);
+	ok(fired_count() == 3, "evsched: long timer pending");
+
+	evsched_stop(&sched);
+	evsched_join(&sched);
+
+	for (int i = 0; i < 3; i++) {
+		evsched_event_free(ev[i]);
+	}
+	evsched_deinit(&sched); // frees the pending ev[3]
+}
+
+static void noop_cb(event_t *ev)
+{
+}
+
+static void interrupt_handle(int s)
+{
+}
+
+static double rate(struct timespec *begin, size_t ops)
+{
+	struct timespec end = time_now();
+	double ms = time_diff_ms(begin, &end);
+	*begin = end;
+
+	return ms > 0 ? ops / ms * 1000 : 0;
+}
+
+static void test_throughput(size_t count)
+{
+	evsched_t sched;
+	int ret = evsched_init(&sched, NULL);
+	ok(ret == KNOT_EOK, "evsched: init for %zu timers", count);
+
+	event_t **ev = malloc(count * sizeof(*ev));
+	ok(ev != NULL, "evsched: allocate %zu timers", count);
+	if (ev == NULL) {
+		evsched_deinit(&sched);
+		return;
+	}
+
+	srand(1);
+	for (size_t i = 0; i < count; i++) {
+		ev[i] = evsched_event_create(&sched, noop_cb, NULL);
+	}
+
+	struct timespec begin = time_now();
+	for (size_t i = 0; i < count; i++) {
+		evsched_schedule(ev[i], 1000 + rand() % 86400000);
+	}
+	double insert = rate(&begin, count);
+	for (size_t i = 0; i < count; i++) {
+		evsched_schedule(ev[i], 1000 + rand() % 86400000);
+	}
+	double resched = rate(&begin, count);
+	for (size_t i = 0; i < count; i++) {
+		evsched_cancel(ev[i]);
+	}
+	double cancel = rate(&begin, count);
+
+	ok(sched.count == 0, "evsched: all %zu timers canceled", count);
+	diag("%zu timers: schedule %.0f/s, reschedule %.0f/s, cancel %.0f/s",
+	     count, insert, resched, cancel);
+
+	for (size_t i = 0; i < count; i++) {
+		evsched_event_free(ev[i]);
+	}
+	free(ev);
+	evsched_deinit(&sched);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	struct sigaction sa;
+	sa.sa_handler = interrupt_handle;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGALRM, &sa, NULL); // Interrupt
+
+	test_firing();
+
+	size_t count = BENCH_TIMERS;
+	if (argc > 1) {
+		count = strtoul(argv[1], NULL, 10);
+	}
+	test_throughput(count);
+
+	return 0;
+}
@@ -15,6 +15,7 @@
  */
 
 #include <pthread.h>
+#include <sys/socket.h>
 #include <tap/basic.h>
 #include <unistd.h>
 
@@ -139,6 +140,25 @@ int main(int argc, char *argv[])
 	ret = fdset_poll(&fdset, &it, 0, 100);
 	ok(ret == 0, "fdset_poll return 3");
 
+	int fds3[2];
+	ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds3);
+	ok(ret == 0, "create socket pair");
+	ret = fdset_add(&fdset, fds3[0], FDSET_POLLIN, NULL);
+	ok(ret == 0, "add socket to fdset");
+	ret = fdset_poll(&fdset, &it, 0, 0);
+	ok(ret == 0, "fdset_poll nothing to read");
+	ret = fdset_set_events(&fdset, 0, FDSET_POLLOUT);
+	ok(ret == KNOT_EOK, "fdset_set_events pollout");
+	ret = fdset_poll(&fdset, &it, 0, 0);
+	ok(ret == 1 && fdset_it_is_pollout(&it) && !fdset_it_is_pollin(&it),
+	   "fdset can write");
+	ret = fdset_set_events(&fdset, 0, FDSET_POLLIN);
+	ok(ret == KNOT_EOK, "fdset_set_events pollin");
+	ret = fdset_poll(&fdset, &it, 0, 0);
+	ok(ret == 0, "fdset_poll nothing to read again");
+	ret = fdset_remove(&fdset, 0);
+	ok(ret == KNOT_EOK, "fdset remove socket");
+	close(fds3[1]);
 
 	close(fds2[1]);
 	if (fd2_dup >= 0) {
@@ -15,10 +15,12 @@
  */
 
 #include <assert.h>
+#include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <tap/basic.h>
@@ -44,6 +46,8 @@ zone_journal_t jj;
 
 unsigned env_flag;
 
+const char *journal_compression = "none";
+
 static unsigned lmdb_page_size(knot_lmdb_db_t *db)
 {
 	knot_lmdb_txn_t txn = { 0 };
@@ -63,8 +67,9 @@ static void set_conf(int zonefile_sync, size_t journal_usage, const knot_dname_t
 	         " - id: default\n"
 	         "   zonefile-sync: %d\n"
 	         "   journal-max-usage: %zu\n"
-	         "   journal-max-depth: 1000\n",
-	         zonefile_sync, journal_usage);
+	         "   journal-max-depth: 1000\n"
+	         "   journal-compression: %s\n",
+	         zonefile_sync, journal_usage, journal_compression);
 	_unused_ int ret = test_conf(conf_str, NULL);
 	assert(ret == KNOT_EOK);
 	jj.conf = conf();
@@ -837,6 +842,158 @@ static void test_stress_base(const knot_dname_t *apex,
 	unset_conf();
 }
 
+#define GROUP_ZONES	8
+#define GROUP_INSERTS	10
+
+typedef struct {
+	zone_journal_t j;
+	changeset_t *chs[GROUP_INSERTS];
+	int ret;
+} group_arg_t;
+
+static void *group_insert(void *data)
+{
+	group_arg_t *arg = data;
+	for (int i = 0; i < GROUP_INSERTS && arg->ret == KNOT_EOK; i++) {
+		arg->ret = journal_insert(arg->j, arg->chs[i], NULL, NULL);
+	}
+	return NULL;
+}
+
+/*! \brief Test concurrent insertions into multiple zones committed together. */
+static void test_group_commit(void)
+{
+	set_conf(1000, 512 * 1024, NULL);
+
+	knot_lmdb_batch_stats_t before, after;
+	knot_lmdb_batch_stats(&jdb, &before);
+	jdb.batch_delay = 1;
+
+	group_arg_t args[GROUP_ZONES] = { 0 };
+	knot_dname_t apexes[GROUP_ZONES][4];
+	for (int z = 0; z < GROUP_ZONES; z++) {
+		memcpy(apexes[z], "\x02z", 3);
+		apexes[z][2] = '0' + z;
+		apexes[z][3] = '\0';
+		args[z].j = (zone_journal_t){ &jdb, apexes[z], jj.conf };
+		for (int i = 0; i < GROUP_INSERTS; i++) {
+			args[z].chs[i] = changeset_new(apexes[z]);
+			assert(args[z].chs[i] != NULL);
+			init_random_changeset(args[z].chs[i], i, i + 1, 20, apexes[z], false);
+		}
+	}
+
+	pthread_t threads[GROUP_ZONES];
+	for (int z = 0; z < GROUP_ZONES; z++) {
+		_unused_ int ret = pthread_create(&threads[z], NULL, group_insert, &args[z]);
+		assert(ret == 0);
+	}
+
+	bool success = true;
+	for (int z = 0; z < GROUP_ZONES; z++) {
+		pthread_join(threads[z], NULL);
+		success &= (args[z].ret == KNOT_EOK);
+
+		uint32_t serial_to = 0;
+		bool exists = false;
+		success &= (journal_sem_check(args[z].j) == KNOT_EOK);
+		success &= (journal_info(args[z].j, &exists, NULL, NULL, &serial_to,
+		                         NULL, NULL, NULL, NULL) == KNOT_EOK);
+		success &= (exists && serial_to == GROUP_INSERTS);
+
+		for (int i = 0; i < GROUP_INSERTS; i++) {
+			changeset_free(args[z].chs[i]);
+		}
+		(void)journal_scrape_with_md(args[z].j, false);
+	}
+	ok(success, "journal: concurrent inserts of %d zones", GROUP_ZONES);
+
+	knot_lmdb_batch_stats(&jdb, &after);
+	jdb.batch_delay = 0;
+	uint64_t inserts = after.operations - before.operations;
+	uint64_t commits = after.commits - before.commits;
+	ok(inserts == GROUP_ZONES * GROUP_INSERTS && commits > 0 && commits <= inserts &&
+	   after.max_batch >= 1, "journal: group commit statistics (%"PRIu64" inserts in "
+	   "%"PRIu64" commits, max batch %"PRIu64")", inserts, commits, after.max_batch);
+
+	unset_conf();
+}
+
+#ifdef ENABLE_ZSTD
+/*! \brief Test storing compressed changesets. */
+static void test_compression(const knot_dname_t *apex)
+{
+	journal_compression = "zstd";
+	set_conf(1000, 512 * 1024, apex);
+
+	int ret = journal_scrape_with_md(jj, false);
+	is_int(KNOT_EOK, ret, "journal: scrape before compression (%s)", knot_strerror(ret));
+
+	journal_read_t *read = NULL;
+	list_t l;
+
+	changeset_t e_ch, r_ch, s_ch;
+	changeset_init(&e_ch, apex);
+	init_random_changeset(&e_ch, 0, 1, 200, apex, true);
+	zone_node_t *n = NULL;
+	zone_contents_add_rr(e_ch.add, e_ch.soa_to, &n);
+	ret = journal_insert_zone(jj, e_ch.add);
+	zone_contents_remove_rr(e_ch.add, e_ch.soa_to, &n);
+	is_int(KNOT_EOK, ret, "journal: insert compressed zone-in-journal (%s)", knot_strerror(ret));
+
+	// Too big for a single chunk.
+	changeset_init(&r_ch, apex);
+	init_random_changeset(&r_ch, 1, 2, 2000, apex, false);
+	ret = journal_insert(jj, &r_ch, NULL, NULL);
+	is_int(KNOT_EOK, ret, "journal: insert compressed changeset (%s)", knot_strerror(ret));
+
+	// Mostly repeated content to be really compressed.
+	changeset_init(&s_ch, apex);
+	init_random_changeset(&s_ch, 2, 3, 1, apex, false);
+	for (int i = 0; i < 500; i++) {
+		knot_rrset_t rr;
+		knot_rrset_init(&rr, tm_owner_int(i, apex), KNOT_RRTYPE_TXT, KNOT_CLASS_IN, 3600);
+		uint8_t txt[RAND_RR_PAYLOAD + 1] = { RAND_RR_PAYLOAD };
+		memset(txt + 1, 'a', RAND_RR_PAYLOAD);
+		knot_rrset_add_rdata(&rr, txt, sizeof(txt), NULL);
+		changeset_add_addition(&s_ch, &rr, 0);
+		knot_rrset_clear(&rr, NULL);
+	}
+	bool exists;
+	uint64_t usage_before = 0, usage_after = 0;
+	journal_info(jj, &exists, NULL, NULL, NULL, NULL, NULL, &usage_before, NULL);
+	ret = journal_insert(jj, &s_ch, NULL, NULL);
+	is_int(KNOT_EOK, ret, "journal: insert compressible changeset (%s)", knot_strerror(ret));
+	journal_info(jj, &exists, NULL, NULL, NULL, NULL, NULL, &usage_after, NULL);
+	ok(usage_after - usage_before < changeset_serialized_size(&s_ch),
+	   "journal: changeset stored compressed");
+
+	ret = journal_sem_check(jj);
+	is_int(KNOT_EOK, ret, "journal: check after compressed store (%s)", knot_strerror(ret));
+
+	ret = load_j_list(&jj, true, 0, &read, &l);
+	is_int(KNOT_EOK, ret, "journal: load compressed changesets (%s)", knot_strerror(ret));
+	is_int(3, list_size(&l), "journal: read three compressed changesets");
+	changeset_t *it = HEAD(l);
+	ok(changesets_eq(&e_ch, it), "journal: compressed zone-in-journal not malformed");
+	it = (changeset_t *)it->n.next;
+	ok(changesets_eq(&r_ch, it), "journal: compressed changeset not malformed");
+	ok(changesets_eq(&s_ch, TAIL(l)), "journal: compressible changeset not malformed");
+	changesets_free(&l);
+	journal_read_end(read);
+
+	changeset_clear(&e_ch);
+	changeset_clear(&r_ch);
+	changeset_clear(&s_ch);
+
+	ret = journal_scrape_with_md(jj, true);
+	is_int(KNOT_EOK, ret, "journal: scrape compressed (%s)", knot_strerror(ret));
+
+	unset_conf();
+	journal_compression = "none";
+}
+#endif
+
 /*! \brief Test behavior when writing to the journal and flushing it. */
 static void test_stress(const knot_dname_t *apex)
 {
@@ -869,6 +1026,12 @@ int main(int argc, char *argv[])
 
 	test_merge(apex);
 
+	test_group_commit();
+
+#ifdef ENABLE_ZSTD
+	test_compression(apex);
+#endif
+
 	test_stress(apex);
 
 	knot_lmdb_deinit(&jdb);
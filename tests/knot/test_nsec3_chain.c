@@ -0,0 +1,145 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <tap/basic.h>
+
+#include "knot/dnssec/nsec3-chain.c"
+#include "libdnssec/crypto.h"
+
+// Enough names for each of the threads to get a part.
+#define THREADS	4
+#define NAMES	(THREADS * NSEC3_NODES_PER_THREAD + 10)
+#define TTL	3600
+
+static const dnssec_nsec3_params_t params = {
+	.algorithm = DNSSEC_NSEC3_ALGORITHM_SHA1,
+	.iterations = 1,
+	.salt = { .size = 4, .data = (uint8_t *)"\xde\xad\xbe\xef" }
+};
+
+static int add_rr(zone_update_t *up, const knot_dname_t *owner, uint16_t type,
+                  const uint8_t *rdata, uint16_t rdata_len)
+{
+	knot_rrset_t *rr = knot_rrset_new(owner, type, KNOT_CLASS_IN, TTL, NULL);
+	if (rr == NULL) {
+		return KNOT_ENOMEM;
+	}
+	int ret = knot_rrset_add_rdata(rr, rdata, rdata_len, NULL);
+	if (ret == KNOT_EOK) {
+		ret = zone_update_add(up, rr);
+	}
+	knot_rrset_free(rr, NULL);
+	return ret;
+}
+
+/*! Fill a full update with an apex SOA and an A record for each name. */
+static int fill_zone(zone_update_t *up, const knot_dname_t *apex, unsigned names)
+{
+	// Root MNAME and RNAME followed by the serial and the timers.
+	uint8_t soa[2 + 5 * sizeof(uint32_t)] = { 0 };
+	int ret = add_rr(up, apex, KNOT_RRTYPE_SOA, soa, sizeof(soa));
+
+	const uint8_t addr[] = { 192, 0, 2, 1 };
+	for (unsigned i = 0; i < names && ret == KNOT_EOK; i++) {
+		char name_str[32];
+		(void)snprintf(name_str, sizeof(name_str), "host%u.example.", i);
+		knot_dname_t *owner = knot_dname_from_str_alloc(name_str);
+		ret = (owner != NULL) ? add_rr(up, owner, KNOT_RRTYPE_A, addr, sizeof(addr))
+		                      : KNOT_ENOMEM;
+		knot_dname_free(owner, NULL);
+	}
+
+	return ret;
+}
+
+static int create_chain(zone_update_t *up, zone_t *zone, size_t threads)
+{
+	int ret = zone_update_init(up, zone, UPDATE_FULL);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	ret = fill_zone(up, zone->name, NAMES);
+	if (ret == KNOT_EOK) {
+		ret = zone_adjust_full(up->new_cont, 1);
+	}
+	if (ret == KNOT_EOK) {
+		ret = knot_nsec3_create_chain(up->new_cont, &params, TTL, up, threads);
+	}
+	return ret;
+}
+
+static bool chains_equal(const zone_contents_t *a, const zone_contents_t *b)
+{
+	if (a->nsec3_nodes == NULL || b->nsec3_nodes == NULL ||
+	    zone_tree_count(a->nsec3_nodes) != zone_tree_count(b->nsec3_nodes)) {
+		return false;
+	}
+
+	zone_tree_it_t it_a = { 0 }, it_b = { 0 };
+	bool equal = (zone_tree_it_begin(a->nsec3_nodes, &it_a) == KNOT_EOK &&
+	              zone_tree_it_begin(b->nsec3_nodes, &it_b) == KNOT_EOK);
+	while (equal && !zone_tree_it_finished(&it_a)) {
+		const zone_node_t *node_a = zone_tree_it_val(&it_a);
+		const zone_node_t *node_b = zone_tree_it_val(&it_b);
+		knot_rrset_t nsec3_a = node_rrset(node_a, KNOT_RRTYPE_NSEC3);
+		knot_rrset_t nsec3_b = node_rrset(node_b, KNOT_RRTYPE_NSEC3);
+		equal = knot_dname_is_equal(node_a->owner, node_b->owner) &&
+		        !knot_rrset_empty(&nsec3_a) &&
+		        knot_rrset_equal(&nsec3_a, &nsec3_b, true);
+		zone_tree_it_next(&it_a);
+		zone_tree_it_next(&it_b);
+	}
+	zone_tree_it_free(&it_a);
+	zone_tree_it_free(&it_b);
+
+	return equal;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	dnssec_crypto_init();
+
+	knot_dname_t *apex = knot_dname_from_str_alloc("example.");
+	assert(apex);
+	zone_t *serial_zone = zone_new(apex);
+	zone_t *parallel_zone = zone_new(apex);
+	assert(serial_zone && parallel_zone);
+
+	zone_update_t serial, parallel;
+	int ret = create_chain(&serial, serial_zone, 1);
+	is_int(KNOT_EOK, ret, "create chain in one thread");
+	ret = create_chain(&parallel, parallel_zone, THREADS);
+	is_int(KNOT_EOK, ret, "create chain in %u threads", THREADS);
+
+	size_t count = zone_tree_count(parallel.new_cont->nsec3_nodes);
+	is_int(NAMES + 1, count, "NSEC3 node for each name and the apex");
+	ok(chains_equal(serial.new_cont, parallel.new_cont),
+	   "parallel chain equals the serial one");
+
+	zone_update_clear(&serial);
+	zone_update_clear(&parallel);
+	zone_free(&serial_zone);
+	zone_free(&parallel_zone);
+	knot_dname_free(apex, NULL);
+
+	dnssec_crypto_cleanup();
+
+	return 0;
+}
@@ -1,4 +1,4 @@
-/*  Copyright (C) 2022 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
 
     This program is free software: you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -22,6 +22,7 @@
 
 #include "libknot/descriptor.h"
 #include "libknot/packet/wire.h"
+#include "knot/nameserver/answer_cache.h"
 #include "knot/nameserver/process_query.h"
 #include "test_server.h"
 #include "contrib/sockaddr.h"
@@ -72,6 +73,48 @@ static void exec_query(knot_layer_t *layer, const char *name,
 	knot_pkt_free(answer);
 }
 
+/* Resolve query and return the answer (to be freed by the caller). */
+static knot_pkt_t *produce_answer(knot_layer_t *layer, knot_pkt_t *query)
+{
+	knot_pkt_t *answer = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	assert(answer);
+
+	knot_layer_reset(layer);
+	knot_pkt_parse(query, 0);
+	knot_layer_consume(layer, query);
+	knot_layer_produce(layer, answer);
+
+	return answer;
+}
+
+/* Check that the cached answer equals the rendered one (1 TAP test). */
+static void test_answer_cache(knot_layer_t *layer, knot_pkt_t *query,
+                              const knot_dname_t *qname, const knot_dname_t *qname_case,
+                              const char *name)
+{
+	knot_pkt_clear(query);
+	knot_pkt_put_question(query, qname, KNOT_CLASS_IN, KNOT_RRTYPE_A);
+	knot_pkt_t *rendered = produce_answer(layer, query);
+
+	knot_pkt_clear(query);
+	knot_wire_set_id(query->wire, 0x1234);
+	knot_pkt_put_question(query, qname_case, KNOT_CLASS_IN, KNOT_RRTYPE_A);
+	knot_pkt_t *cached = produce_answer(layer, query);
+
+	/* Only the message ID and the question letter case differ. */
+	size_t qsize = KNOT_WIRE_HEADER_SIZE + knot_pkt_question_size(query);
+	bool same = rendered->size == cached->size &&
+	            knot_wire_get_id(cached->wire) == 0x1234 &&
+	            memcmp(rendered->wire + 2, cached->wire + 2, KNOT_WIRE_HEADER_SIZE - 2) == 0 &&
+	            memcmp(cached->wire + KNOT_WIRE_HEADER_SIZE, query->wire + KNOT_WIRE_HEADER_SIZE,
+	                   qsize - KNOT_WIRE_HEADER_SIZE) == 0 &&
+	            memcmp(rendered->wire + qsize, cached->wire + qsize, cached->size - qsize) == 0;
+	ok(same, "ns: answer cache, %s", name);
+
+	knot_pkt_free(rendered);
+	knot_pkt_free(cached);
+}
+
 /* \internal Helpers */
 #define WIRE_COPY(dst, dst_len, src, src_len) \
 	memcpy(dst, src, src_len); \
@@ -167,6 +210,16 @@ int main(int argc, char *argv[])
 	/* #189 Process AXFR client. */
 	/* #189 Process IXFR client. */
 
+	/* Answer cache (the contents must be published to be cacheable). */
+	zone->answer_cache = answer_cache_new(16, 1);
+	ok(zone->answer_cache != NULL, "ns: answer cache initialization");
+	(void)zone_switch_contents(zone, zone->contents);
+	test_answer_cache(&proc, query, (const knot_dname_t *)"\x03""www",
+	                  (const knot_dname_t *)"\x03""wWw", "NXDOMAIN");
+	test_answer_cache(&proc, query, ROOT_DNAME, ROOT_DNAME, "NODATA");
+	(void)zone_switch_contents(zone, zone->contents);
+	test_answer_cache(&proc, query, ROOT_DNAME, ROOT_DNAME, "new contents");
+
 	/* Query processor (smaller than DNS header, ignore). */
 	knot_layer_reset(&proc);
 	knot_pkt_clear(query);
@@ -0,0 +1,332 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <tap/basic.h>
+
+#include "knot/events/handlers/refresh.c"
+
+// More packets than the builder queue holds.
+#define PACKETS		(2 * AXFR_BUILDER_QUEUE + 3)
+#define PACKET_RRS	50
+#define SERIAL		2024
+
+static const uint8_t addr[] = { 192, 0, 2, 1 };
+
+static knot_rrset_t *soa_rrset(const knot_dname_t *apex)
+{
+	// Root MNAME and RNAME followed by the serial and the timers.
+	uint8_t rdata[2 + 5 * sizeof(uint32_t)] = { 0 };
+	knot_wire_write_u32(rdata + 2, SERIAL);
+
+	knot_rrset_t *soa = knot_rrset_new(apex, KNOT_RRTYPE_SOA, KNOT_CLASS_IN, 3600, NULL);
+	assert(soa);
+	int ret = knot_rrset_add_rdata(soa, rdata, sizeof(rdata), NULL);
+	assert(ret == KNOT_EOK);
+	return soa;
+}
+
+static knot_rrset_t *a_rrset(unsigned index, unsigned rdata_count)
+{
+	char name_str[32];
+	(void)snprintf(name_str, sizeof(name_str), "host%u.example.", index);
+	knot_dname_t *owner = knot_dname_from_str_alloc(name_str);
+	assert(owner);
+
+	knot_rrset_t *rr = knot_rrset_new(owner, KNOT_RRTYPE_A, KNOT_CLASS_IN, 3600, NULL);
+	assert(rr);
+	knot_dname_free(owner, NULL);
+	for (unsigned i = 0; i < rdata_count; i++) {
+		uint8_t rdata[sizeof(addr)];
+		memcpy(rdata, addr, sizeof(addr));
+		rdata[3] += i;
+		int ret = knot_rrset_add_rdata(rr, rdata, sizeof(rdata), NULL);
+		assert(ret == KNOT_EOK);
+	}
+	return rr;
+}
+
+/*!
+ * Create the answer packet number 'index' of the transfer. The first one
+ * starts with the SOA unless skipped, the last one ends with the SOA.
+ * Setting 'bad_index' puts an RRset with two records there, which the zone
+ * builder refuses (the parser always splits RRsets into single records).
+ */
+static knot_pkt_t *axfr_packet(const knot_dname_t *apex, unsigned index,
+                               bool skip_soa, int bad_index)
+{
+	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	assert(pkt);
+	knot_wire_set_qr(pkt->wire);
+	int ret = knot_pkt_begin(pkt, KNOT_ANSWER);
+	assert(ret == KNOT_EOK);
+
+	if (index == 0 && !skip_soa) {
+		ret = knot_pkt_put(pkt, 0, soa_rrset(apex), KNOT_PF_FREE);
+		assert(ret == KNOT_EOK);
+	}
+	for (unsigned i = 0; i < PACKET_RRS; i++) {
+		unsigned rr_index = index * PACKET_RRS + i;
+		unsigned count = (rr_index == bad_index) ? 2 : 1;
+		ret = knot_pkt_put(pkt, 0, a_rrset(rr_index, count), KNOT_PF_FREE);
+		assert(ret == KNOT_EOK);
+	}
+	if (index == PACKETS - 1) {
+		ret = knot_pkt_put(pkt, 0, soa_rrset(apex), KNOT_PF_FREE);
+		assert(ret == KNOT_EOK);
+	}
+
+	return pkt;
+}
+
+static void init_data(struct refresh_data *data, zone_t *zone, knot_layer_t *layer,
+                      const conf_remote_t *remote, zone_master_fallback_t *fallback)
+{
+	struct refresh_data init = {
+		.layer = layer,
+		.zone = zone,
+		.remote = remote,
+		.max_zone_size = SIZE_MAX,
+		.fallback = fallback,
+	};
+	memcpy(data, &init, sizeof(*data));
+}
+
+/*! Feed all the packets, returns the state after the last consumed one. */
+static int transfer(struct refresh_data *data, bool reuse_soa, int bad_index,
+                    unsigned *consumed)
+{
+	int next = KNOT_STATE_CONSUME;
+	for (*consumed = 0; *consumed < PACKETS && next == KNOT_STATE_CONSUME; (*consumed)++) {
+		knot_pkt_t *pkt = axfr_packet(data->zone->name, *consumed, reuse_soa, bad_index);
+		next = axfr_consume(pkt, data, reuse_soa && *consumed == 0);
+		knot_pkt_free(pkt);
+	}
+	return next;
+}
+
+static bool zone_complete(const zone_contents_t *contents)
+{
+	if (contents == NULL || zone_contents_serial(contents) != SERIAL) {
+		return false;
+	}
+	for (unsigned i = 0; i < PACKETS * PACKET_RRS; i++) {
+		knot_rrset_t *rr = a_rrset(i, 1);
+		const zone_node_t *node = zone_contents_find_node(contents, rr->owner);
+		bool found = knot_rdataset_member(node_rdataset(node, KNOT_RRTYPE_A),
+		                                  rr->rrs.rdata);
+		knot_rrset_free(rr, NULL);
+		if (!found) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_multi_packet(zone_t *zone, knot_layer_t *layer,
+                              const conf_remote_t *remote)
+{
+	zone_master_fallback_t fallback = { 0 };
+	struct refresh_data data;
+	init_data(&data, zone, layer, remote, &fallback);
+
+	unsigned consumed;
+	int next = transfer(&data, false, -1, &consumed);
+	ok(next == KNOT_STATE_DONE && data.ret == KNOT_EOK && consumed == PACKETS,
+	   "multi-packet: transfer done");
+	ok(data.axfr.builder == NULL, "multi-packet: builder finished");
+	ok(zone_complete(data.axfr.zone), "multi-packet: all records inserted");
+
+	axfr_cleanup(&data);
+}
+
+static void test_builder_error(zone_t *zone, knot_layer_t *layer,
+                               const conf_remote_t *remote)
+{
+	zone_master_fallback_t fallback = { 0 };
+	struct refresh_data data;
+	init_data(&data, zone, layer, remote, &fallback);
+
+	unsigned consumed;
+	int next = transfer(&data, false, PACKET_RRS + 1, &consumed);
+	ok(next == KNOT_STATE_FAIL && data.ret == KNOT_EINVAL,
+	   "builder error: transfer failed with the builder error");
+	// The failing packet is queued, the error comes with a later packet.
+	ok(consumed > 2, "builder error: reported after the batch was queued");
+
+	axfr_cleanup(&data);
+	ok(data.axfr.builder == NULL && data.axfr.zone == NULL,
+	   "builder error: cleaned up");
+}
+
+static void test_ixfr_fallback(zone_t *zone, knot_layer_t *layer,
+                               const conf_remote_t *remote)
+{
+	zone_master_fallback_t fallback = { 0 };
+	struct refresh_data data;
+	init_data(&data, zone, layer, remote, &fallback);
+
+	// The IXFR processing has already taken the initial SOA.
+	data.initial_soa_copy = soa_rrset(zone->name);
+
+	knot_pkt_t *pkt = axfr_packet(zone->name, 0, true, -1);
+	int next = axfr_consume(pkt, &data, true);
+	knot_pkt_free(pkt);
+	ok(next == KNOT_STATE_CONSUME && data.axfr.soa_seen,
+	   "IXFR fallback: saved SOA opens the transfer");
+	ok(data.initial_soa_copy == NULL, "IXFR fallback: saved SOA consumed");
+	ok(data.axfr.builder != NULL, "IXFR fallback: builder running");
+
+	unsigned consumed = 1;
+	for (; consumed < PACKETS && next == KNOT_STATE_CONSUME; consumed++) {
+		pkt = axfr_packet(zone->name, consumed, true, -1);
+		next = axfr_consume(pkt, &data, false);
+		knot_pkt_free(pkt);
+	}
+	ok(next == KNOT_STATE_DONE && data.ret == KNOT_EOK && consumed == PACKETS,
+	   "IXFR fallback: transfer done");
+	// The closing SOA isn't inserted, the zone SOA is the saved one.
+	ok(zone_complete(data.axfr.zone), "IXFR fallback: all records inserted");
+
+	axfr_cleanup(&data);
+}
+
+typedef struct {
+	struct axfr_builder *builder;
+	unsigned pushes;
+	unsigned pushed;  //!< Number of finished pushes, under the builder lock.
+	int ret;
+} pusher_t;
+
+static void *pusher_thread(void *arg)
+{
+	pusher_t *pusher = arg;
+
+	for (unsigned i = 0; i < pusher->pushes; i++) {
+		struct axfr_batch *batch = axfr_batch_new(1);
+		assert(batch);
+		int ret = axfr_builder_push(pusher->builder, batch);
+		pthread_mutex_lock(&pusher->builder->lock);
+		pusher->pushed++;
+		pusher->ret = ret;
+		pthread_mutex_unlock(&pusher->builder->lock);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static unsigned pushed(pusher_t *pusher)
+{
+	pthread_mutex_lock(&pusher->builder->lock);
+	unsigned count = pusher->pushed;
+	pthread_mutex_unlock(&pusher->builder->lock);
+	return count;
+}
+
+/*! Wait a while for the pusher to get to the expected number of pushes. */
+static bool wait_pushed(pusher_t *pusher, unsigned expected)
+{
+	for (int i = 0; i < 200 && pushed(pusher) < expected; i++) {
+		usleep(1000);
+	}
+	return pushed(pusher) == expected;
+}
+
+static struct axfr_batch *pop_batch(struct axfr_builder *builder)
+{
+	pthread_mutex_lock(&builder->lock);
+	struct axfr_batch *batch = builder->head;
+	builder->head = batch->next;
+	if (builder->head == NULL) {
+		builder->tail = NULL;
+	}
+	builder->queued--;
+	pthread_cond_broadcast(&builder->cond);
+	pthread_mutex_unlock(&builder->lock);
+	return batch;
+}
+
+static void test_push_blocking(zone_t *zone)
+{
+	// The builder is driven by hand, its thread is started later.
+	struct axfr_builder builder = { .zone = zone_contents_new(zone->name, true) };
+	pthread_mutex_init(&builder.lock, NULL);
+	pthread_cond_init(&builder.cond, NULL);
+
+	pusher_t pusher = { .builder = &builder, .pushes = AXFR_BUILDER_QUEUE + 2 };
+	pthread_t thread;
+	pthread_create(&thread, NULL, pusher_thread, &pusher);
+
+	ok(wait_pushed(&pusher, AXFR_BUILDER_QUEUE), "push: queue filled");
+	usleep(10000);
+	ok(pushed(&pusher) == AXFR_BUILDER_QUEUE && builder.queued == AXFR_BUILDER_QUEUE,
+	   "push: blocked while the queue is full");
+
+	axfr_batch_free(pop_batch(&builder));
+	ok(wait_pushed(&pusher, AXFR_BUILDER_QUEUE + 1) && pusher.ret == KNOT_EOK,
+	   "push: unblocked by a taken batch");
+
+	// A builder error wakes up the blocked push.
+	usleep(10000);
+	pthread_mutex_lock(&builder.lock);
+	builder.ret = KNOT_EINVAL;
+	pthread_cond_broadcast(&builder.cond);
+	pthread_mutex_unlock(&builder.lock);
+	pthread_join(thread, NULL);
+	ok(pusher.pushed == AXFR_BUILDER_QUEUE + 2 && pusher.ret == KNOT_EINVAL,
+	   "push: builder error returned to the blocked push");
+
+	// The builder thread drops the queued batches after the error.
+	pthread_create(&builder.thread, NULL, axfr_builder_thread, &builder);
+	pthread_mutex_lock(&builder.lock);
+	builder.closing = true;
+	pthread_cond_broadcast(&builder.cond);
+	pthread_mutex_unlock(&builder.lock);
+	pthread_join(builder.thread, NULL);
+	ok(builder.head == NULL && builder.queued == 0, "push: queue drained");
+
+	pthread_cond_destroy(&builder.cond);
+	pthread_mutex_destroy(&builder.lock);
+	zone_contents_deep_free(builder.zone);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	knot_dname_t *apex = knot_dname_from_str_alloc("example.");
+	assert(apex);
+	zone_t *zone = zone_new(apex);
+	assert(zone);
+	knot_dname_free(apex, NULL);
+
+	knot_layer_t layer = { 0 };
+	conf_remote_t remote = { 0 };
+	sockaddr_set(&remote.addr, AF_INET, "192.0.2.53", 53);
+
+	test_multi_packet(zone, &layer, &remote);
+	test_builder_error(zone, &layer, &remote);
+	test_ixfr_fallback(zone, &layer, &remote);
+	test_push_blocking(zone);
+
+	zone_free(&zone);
+
+	return 0;
+}
@@ -0,0 +1,303 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <tap/basic.h>
+
+#include "knot/query/soa-batch.c"
+#include "libknot/descriptor.h"
+
+#define ZONES	4
+#define SERIAL	1000
+
+static const int TIMEOUT = 2000;
+
+static const char *zone_names[ZONES] = {
+	"0.example.", "1.example.", "2.example.", "3.example."
+};
+
+/*! Close the next accepted connection without answering. */
+static volatile bool close_next = false;
+
+static void set_blocking_mode(int sock)
+{
+	int flags = fcntl(sock, F_GETFL);
+	flags &= ~O_NONBLOCK;
+	fcntl(sock, F_SETFL, flags);
+}
+
+/*! The serial of a zone is derived from the digit in its name. */
+static uint32_t zone_serial(const knot_dname_t *zone)
+{
+	return SERIAL + zone[1] - '0';
+}
+
+static void send_answer(int fd, uint16_t id, const knot_dname_t *qname, uint32_t serial)
+{
+	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	assert(pkt);
+	knot_wire_set_id(pkt->wire, id);
+	knot_wire_set_qr(pkt->wire);
+	knot_wire_set_aa(pkt->wire);
+	int ret = knot_pkt_put_question(pkt, qname, KNOT_CLASS_IN, KNOT_RRTYPE_SOA);
+	assert(ret == KNOT_EOK);
+	ret = knot_pkt_begin(pkt, KNOT_ANSWER);
+	assert(ret == KNOT_EOK);
+
+	// Root MNAME and RNAME followed by the serial and the timers.
+	uint8_t rdata[2 + 5 * sizeof(uint32_t)] = { 0 };
+	knot_wire_write_u32(rdata + 2, serial);
+	knot_rrset_t *soa = knot_rrset_new(qname, KNOT_RRTYPE_SOA, KNOT_CLASS_IN, 3600, NULL);
+	assert(soa);
+	ret = knot_rrset_add_rdata(soa, rdata, sizeof(rdata), NULL);
+	assert(ret == KNOT_EOK);
+	ret = knot_pkt_put(pkt, 0, soa, KNOT_PF_FREE);
+	assert(ret == KNOT_EOK);
+
+	(void)net_dns_tcp_send(fd, pkt->wire, pkt->size, TIMEOUT, NULL);
+	knot_pkt_free(pkt);
+}
+
+static uint16_t unused_id(const uint16_t *ids, size_t count)
+{
+	for (uint16_t id = 0; ; id++) {
+		size_t i = 0;
+		while (i < count && ids[i] != id) {
+			i++;
+		}
+		if (i == count) {
+			return id;
+		}
+	}
+}
+
+/*!
+ * Read all the pipelined queries first, then send an answer with an unknown
+ * ID, an answer with a mismatching question, and the answers in reverse order.
+ */
+static void answer_batch(int fd)
+{
+	uint16_t ids[ZONES];
+	knot_dname_t *qnames[ZONES] = { NULL };
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+
+	size_t count = 0;
+	for (; count < ZONES; count++) {
+		int len = net_dns_tcp_recv(fd, buf, sizeof(buf), TIMEOUT);
+		if (len < KNOT_WIRE_HEADER_SIZE) {
+			break;
+		}
+		knot_pkt_t *query = knot_pkt_new(buf, len, NULL);
+		assert(query);
+		if (knot_pkt_parse(query, 0) != KNOT_EOK) {
+			knot_pkt_free(query);
+			break;
+		}
+		ids[count] = knot_wire_get_id(query->wire);
+		qnames[count] = knot_dname_copy(knot_pkt_qname(query), NULL);
+		knot_pkt_free(query);
+	}
+
+	if (count > 0) {
+		send_answer(fd, unused_id(ids, count), qnames[0], 1);
+		send_answer(fd, ids[0], (const knot_dname_t *)"\x05wrong\x07""example", 1);
+	}
+	for (size_t i = count; i > 0; i--) {
+		send_answer(fd, ids[i - 1], qnames[i - 1], zone_serial(qnames[i - 1]));
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		knot_dname_free(qnames[i], NULL);
+	}
+}
+
+static void *responder_thread(void *arg)
+{
+	int fd = *(int *)arg;
+
+	set_blocking_mode(fd);
+	while (true) {
+		int client = accept(fd, NULL, NULL);
+		if (client < 0) {
+			break;
+		}
+		if (close_next) {
+			close_next = false;
+			close(client);
+			continue;
+		}
+		answer_batch(client);
+		close(client);
+	}
+
+	return NULL;
+}
+
+static void init_items(soa_batch_item_t *items)
+{
+	for (size_t i = 0; i < ZONES; i++) {
+		items[i] = (soa_batch_item_t){
+			.zone = knot_dname_from_str_alloc(zone_names[i])
+		};
+	}
+}
+
+static void free_items(soa_batch_item_t *items)
+{
+	for (size_t i = 0; i < ZONES; i++) {
+		knot_dname_free(items[i].zone, NULL);
+	}
+}
+
+static bool all_answered(soa_batch_item_t *items)
+{
+	for (size_t i = 0; i < ZONES; i++) {
+		if (!items[i].answered || items[i].serial != zone_serial(items[i].zone)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_query(const conf_remote_t *remote)
+{
+	query_edns_data_t edns = { .no_edns = true };
+	soa_batch_item_t items[ZONES];
+
+	init_items(items);
+	int ret = soa_batch_query(remote, &edns, items, ZONES, TIMEOUT);
+	is_int(KNOT_EOK, ret, "query: batch");
+	ok(all_answered(items), "query: answers matched by ID and question");
+	free_items(items);
+
+	// A pooled connection closed by the remote is replaced.
+	global_conn_pool = conn_pool_init(1, 60, conn_pool_close_cb_dflt,
+	                                  conn_pool_invalid_cb_allvalid);
+	assert(global_conn_pool);
+	close_next = true;
+	int fd = net_connected_socket(SOCK_STREAM, &remote->addr, NULL, false);
+	ok(fd >= 0, "query: stale connection");
+	fd = (int)conn_pool_put(global_conn_pool, &remote->via, &remote->addr, fd);
+	ok(fd == CONN_POOL_FD_INVALID, "query: stale connection pooled");
+	while (close_next) {
+		usleep(1000);
+	}
+
+	init_items(items);
+	ret = soa_batch_query(remote, &edns, items, ZONES, TIMEOUT);
+	is_int(KNOT_EOK, ret, "query: batch over stale pooled connection");
+	ok(all_answered(items), "query: answers after reconnection");
+	free_items(items);
+
+	conn_pool_deinit(global_conn_pool);
+	global_conn_pool = NULL;
+}
+
+static void test_take(const conf_remote_t *remote)
+{
+	knot_dname_t *zone = knot_dname_from_str_alloc(zone_names[1]);
+
+	knot_pkt_t *pkt = soa_batch_take(remote, zone);
+	ok(pkt != NULL && knot_dname_is_equal(knot_pkt_qname(pkt), zone),
+	   "take: cached answer");
+	knot_pkt_free(pkt);
+	ok(soa_batch_take(remote, zone) == NULL, "take: answer taken only once");
+
+	conf_remote_t other = *remote;
+	sockaddr_port_set(&other.addr, sockaddr_port(&remote->addr) + 1);
+	knot_dname_t *zone2 = knot_dname_from_str_alloc(zone_names[2]);
+	ok(soa_batch_take(&other, zone2) == NULL, "take: other remote");
+
+	// Answers older than the window are dropped.
+	uint8_t key[KEY_MAXLEN];
+	size_t key_len = answer_key(key, remote, zone2);
+	trie_val_t *val = trie_get_try(cache.answers[0], key, key_len);
+	ok(val != NULL, "take: answer in the current generation");
+	if (val != NULL) {
+		((cached_answer_t *)*val)->received -= SOA_BATCH_WINDOW;
+	}
+	ok(soa_batch_take(remote, zone2) == NULL, "take: expired answer");
+
+	// Answers not taken are dropped after two rotations.
+	for (int i = 0; i < 2; i++) {
+		cache.rotated -= SOA_BATCH_WINDOW;
+		(void)rotate(time(NULL));
+	}
+	knot_dname_t *zone3 = knot_dname_from_str_alloc(zone_names[3]);
+	ok(soa_batch_take(remote, zone3) == NULL, "take: rotated answer");
+
+	knot_dname_free(zone, NULL);
+	knot_dname_free(zone2, NULL);
+	knot_dname_free(zone3, NULL);
+}
+
+static void test_claim(const conf_remote_t *remote)
+{
+	ok(soa_batch_claim(remote), "claim: first");
+	ok(!soa_batch_claim(remote), "claim: rate limited");
+
+	conf_remote_t other = *remote;
+	sockaddr_set(&other.addr, AF_INET, "127.0.0.2", sockaddr_port(&remote->addr));
+	ok(soa_batch_claim(&other), "claim: other address");
+
+	uint8_t key[KEY_MAXLEN];
+	size_t key_len = remote_key(key, remote);
+	trie_val_t *val = trie_get_try(cache.claims, key, key_len);
+	ok(val != NULL, "claim: recorded");
+	if (val != NULL) {
+		*val = (void *)(intptr_t)(time(NULL) - SOA_BATCH_WINDOW);
+	}
+	ok(soa_batch_claim(remote), "claim: after the window");
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	signal(SIGPIPE, SIG_IGN);
+
+	conf_remote_t remote = { .soa_batch = ZONES };
+	sockaddr_set(&remote.addr, AF_INET, "127.0.0.1", 0);
+	ok(soa_batch_usable(&remote), "remote usable");
+
+	int responder_fd = net_bound_socket(SOCK_STREAM, &remote.addr, 0, 0);
+	assert(responder_fd >= 0);
+	socklen_t addr_len = sockaddr_len(&remote.addr);
+	int ret = getsockname(responder_fd, (struct sockaddr *)&remote.addr, &addr_len);
+	ok(ret == 0, "getsockname");
+	ret = listen(responder_fd, 10);
+	ok(ret == 0, "listen");
+
+	pthread_t thread;
+	pthread_create(&thread, 0, responder_thread, &responder_fd);
+
+	test_query(&remote);
+	test_take(&remote);
+	test_claim(&remote);
+
+	/* Terminate responder. */
+	shutdown(responder_fd, SHUT_RDWR);
+	pthread_join(thread, NULL);
+	close(responder_fd);
+
+	soa_batch_deinit();
+
+	return 0;
+}
@@ -0,0 +1,272 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <poll.h>
+#include <tap/basic.h>
+
+#include "knot/server/tcp-handler.c"
+
+#define QUERY_SIZE	(KNOT_WIRE_HEADER_SIZE + 16)
+#define BIG_REPLY	60000
+#define BIG_REPLIES	8
+
+/*! Size of the replies produced by the echo layer. */
+static size_t reply_size = QUERY_SIZE;
+
+static int echo_consume(knot_layer_t *ctx, knot_pkt_t *pkt)
+{
+	ctx->data = pkt;
+	return KNOT_STATE_PRODUCE;
+}
+
+/*! Reply with the query ID, padded to the reply size. */
+static int echo_produce(knot_layer_t *ctx, knot_pkt_t *pkt)
+{
+	const knot_pkt_t *query = ctx->data;
+	memset(pkt->wire, 0, reply_size);
+	memcpy(pkt->wire, query->wire, KNOT_WIRE_HEADER_SIZE);
+	knot_wire_set_qr(pkt->wire);
+	pkt->size = reply_size;
+	return KNOT_STATE_DONE;
+}
+
+static const knot_layer_api_t echo_layer = {
+	.consume = echo_consume,
+	.produce = echo_produce,
+};
+
+/*! Write a framed query with the given ID into the buffer. */
+static size_t put_query(uint8_t *buf, uint16_t id)
+{
+	knot_wire_write_u16(buf, QUERY_SIZE);
+	memset(buf + sizeof(uint16_t), 0, QUERY_SIZE);
+	knot_wire_set_id(buf + sizeof(uint16_t), id);
+	return sizeof(uint16_t) + QUERY_SIZE;
+}
+
+static void send_all(int fd, const uint8_t *data, size_t len)
+{
+	ssize_t ret = send(fd, data, len, MSG_NOSIGNAL);
+	assert(ret == len);
+	(void)ret;
+}
+
+/*! Client side reader of the framed replies. */
+typedef struct {
+	uint8_t buf[2 * (sizeof(uint16_t) + BIG_REPLY)];
+	size_t len;
+	unsigned replies;
+	uint16_t ids[BIG_REPLIES];
+	bool valid;
+} reader_t;
+
+/*! Read the available data without blocking, collect complete replies. */
+static void read_replies(int fd, reader_t *reader)
+{
+	while (true) {
+		ssize_t ret = recv(fd, reader->buf + reader->len,
+		                   sizeof(reader->buf) - reader->len, MSG_DONTWAIT);
+		if (ret > 0) {
+			reader->len += ret;
+		}
+
+		size_t pos = 0;
+		while (reader->len - pos >= sizeof(uint16_t)) {
+			size_t size = knot_wire_read_u16(reader->buf + pos);
+			if (reader->len - pos - sizeof(uint16_t) < size) {
+				break;
+			}
+			const uint8_t *wire = reader->buf + pos + sizeof(uint16_t);
+			reader->valid &= (size == reply_size && knot_wire_get_qr(wire));
+			if (reader->replies < BIG_REPLIES) {
+				reader->ids[reader->replies] = knot_wire_get_id(wire);
+			}
+			reader->replies++;
+			pos += sizeof(uint16_t) + size;
+		}
+		memmove(reader->buf, reader->buf + pos, reader->len - pos);
+		reader->len -= pos;
+
+		if (ret <= 0) {
+			break;
+		}
+	}
+}
+
+static bool ids_in_order(const reader_t *reader, unsigned count)
+{
+	for (unsigned i = 0; i < count; i++) {
+		if (reader->ids[i] != i + 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_split(tcp_context_t *tcp, knotd_qdata_params_t *params, int client)
+{
+	tcp_conn_t conn = { 0 };
+	reader_t reader = { .valid = true };
+	uint8_t buf[sizeof(uint16_t) + QUERY_SIZE];
+	size_t len = put_query(buf, 1);
+
+	// The length prefix only.
+	bool active = false;
+	send_all(client, buf, 1);
+	int ret = tcp_serve(tcp, params, &conn, false, &active);
+	ok(ret == KNOT_EOK && !active && conn.inbuf_len == 1,
+	   "split: partial length kept");
+
+	send_all(client, buf + 1, len / 2);
+	ret = tcp_serve(tcp, params, &conn, false, &active);
+	ok(ret == KNOT_EOK && !active && conn.inbuf_len == 1 + len / 2,
+	   "split: partial query kept");
+	read_replies(client, &reader);
+	ok(reader.replies == 0, "split: no reply yet");
+
+	send_all(client, buf + 1 + len / 2, len - 1 - len / 2);
+	ret = tcp_serve(tcp, params, &conn, false, &active);
+	ok(ret == KNOT_EOK && active && conn.inbuf_len == 0,
+	   "split: query completed");
+	read_replies(client, &reader);
+	ok(reader.replies == 1 && reader.valid && ids_in_order(&reader, 1),
+	   "split: answered");
+
+	free(conn.inbuf);
+}
+
+static void test_pipelined(tcp_context_t *tcp, knotd_qdata_params_t *params, int client)
+{
+	tcp_conn_t conn = { 0 };
+	reader_t reader = { .valid = true };
+	uint8_t buf[4 * (sizeof(uint16_t) + QUERY_SIZE)];
+
+	// Three complete queries and the beginning of the fourth one.
+	size_t len = 0;
+	for (uint16_t id = 1; id <= 4; id++) {
+		len += put_query(buf + len, id);
+	}
+	send_all(client, buf, len - 5);
+
+	bool active = false;
+	int ret = tcp_serve(tcp, params, &conn, false, &active);
+	ok(ret == KNOT_EOK && active && conn.inbuf_len == sizeof(uint16_t) + QUERY_SIZE - 5,
+	   "pipelined: incomplete query kept");
+	read_replies(client, &reader);
+	ok(reader.replies == 3 && reader.valid && ids_in_order(&reader, 3),
+	   "pipelined: answered in order");
+
+	send_all(client, buf + len - 5, 5);
+	ret = tcp_serve(tcp, params, &conn, false, &active);
+	read_replies(client, &reader);
+	ok(ret == KNOT_EOK && reader.replies == 4 && ids_in_order(&reader, 4),
+	   "pipelined: last query answered");
+
+	free(conn.inbuf);
+}
+
+static bool wait_writable(int fd)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+	return poll(&pfd, 1, 1000) == 1 && (pfd.revents & POLLOUT);
+}
+
+static void test_partial_reply(tcp_context_t *tcp, knotd_qdata_params_t *params,
+                               int client, int server)
+{
+	tcp_conn_t conn = { 0 };
+	reader_t reader = { .valid = true };
+	uint8_t buf[BIG_REPLIES * (sizeof(uint16_t) + QUERY_SIZE)];
+
+	size_t len = 0;
+	for (uint16_t id = 1; id <= BIG_REPLIES; id++) {
+		len += put_query(buf + len, id);
+	}
+	send_all(client, buf, len);
+
+	reply_size = BIG_REPLY;
+	bool active = false;
+	int ret = tcp_serve(tcp, params, &conn, false, &active);
+	ok(ret == KNOT_EOK && conn.outbuf_len > 0,
+	   "partial reply: reply remainder pending");
+	ok(conn.inbuf_len > 0, "partial reply: further queries postponed");
+
+	// Read on the client side, finish the replies once writable.
+	unsigned rounds = 0;
+	while (ret == KNOT_EOK && (conn.outbuf_len > 0 || conn.inbuf_len > 0) &&
+	       rounds++ < 1000) {
+		read_replies(client, &reader);
+		if (conn.outbuf_len > 0 && !wait_writable(server)) {
+			continue;
+		}
+		ret = tcp_serve(tcp, params, &conn, true, &active);
+	}
+	read_replies(client, &reader);
+	ok(ret == KNOT_EOK && conn.outbuf_len == 0 && conn.inbuf_len == 0,
+	   "partial reply: all sent on writability");
+	ok(reader.replies == BIG_REPLIES && reader.valid &&
+	   ids_in_order(&reader, BIG_REPLIES), "partial reply: all replies received");
+
+	reply_size = QUERY_SIZE;
+	free(conn.inbuf);
+	free(conn.outbuf);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	int fds[2];
+	int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	assert(ret == 0);
+	int client = fds[0], server = fds[1];
+
+	// Keep the socket buffers small to get partial sends.
+	int bufsize = 4096;
+	(void)setsockopt(server, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+	(void)setsockopt(client, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+
+	knot_mm_t mm;
+	mm_ctx_mempool(&mm, MM_DEFAULT_BLKSIZE);
+
+	tcp_context_t tcp = { .io_timeout = 1000 };
+	knot_layer_init(&tcp.layer, &mm, &echo_layer);
+	for (unsigned i = 0; i < 2; ++i) {
+		tcp.iov[i].iov_len = TCP_RX_BUFSIZE;
+		tcp.iov[i].iov_base = malloc(tcp.iov[i].iov_len);
+		assert(tcp.iov[i].iov_base);
+	}
+
+	struct sockaddr_storage remote = { 0 };
+	knotd_qdata_params_t params = {
+		.proto = KNOTD_QUERY_PROTO_TCP,
+		.remote = &remote,
+		.socket = server,
+	};
+
+	test_split(&tcp, &params, client);
+	test_pipelined(&tcp, &params, client);
+	test_partial_reply(&tcp, &params, client, server);
+
+	free(tcp.iov[0].iov_base);
+	free(tcp.iov[1].iov_base);
+	mp_delete(mm.ctx);
+	close(client);
+	close(server);
+
+	return 0;
+}
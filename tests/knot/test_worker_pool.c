@@ -127,6 +127,17 @@ int main(void)
 	worker_pool_wait(pool);
 	ok(executed_reset(&log) == TASKS_BATCH, "executed count after resume");
 
+	// statistics
+
+	worker_pool_stats_t stats;
+	worker_pool_stats(pool, &stats);
+	uint64_t waited = 0;
+	for (int i = 0; i < WORKER_WAIT_BUCKETS; i++) {
+		waited += stats.wait_hist[i];
+	}
+	ok(stats.running == 0 && waited == 3 * TASKS_BATCH &&
+	   stats.queued_max >= TASKS_BATCH, "pool statistics");
+
 	// try clean
 
 	pthread_mutex_lock(&log.mx);
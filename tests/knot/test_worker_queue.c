@@ -45,6 +45,28 @@ int main(void)
 	ok(worker_queue_dequeue(&queue) == &task_two, "dequeue second");
 	ok(worker_queue_dequeue(&queue) == NULL, "dequeue from empty");
 
+	// priorities
+
+	worker_task_t task_low = { .prio = WORKER_PRIO_LOW };
+	worker_task_t task_high = { .prio = WORKER_PRIO_HIGH };
+	worker_task_t task_urgent = { .prio = WORKER_PRIO_URGENT };
+
+	worker_queue_enqueue(&queue, &task_low);
+	worker_queue_enqueue(&queue, &task_high);
+	worker_queue_enqueue(&queue, &task_urgent);
+	ok(worker_queue_length(&queue) == 3, "queue length");
+	ok(queue.length[WORKER_PRIO_HIGH] == 1, "queue length of class");
+	ok(worker_queue_dequeue(&queue) == &task_urgent, "dequeue urgent");
+	ok(worker_queue_dequeue(&queue) == &task_high, "dequeue high");
+	ok(worker_queue_dequeue(&queue) == &task_low, "dequeue low");
+	ok(worker_queue_length(&queue) == 0, "queue empty");
+
+	uint64_t waited = 0;
+	for (int i = 0; i < WORKER_WAIT_BUCKETS; i++) {
+		waited += queue.wait_hist[i];
+	}
+	ok(waited == 5 && queue.max_total == 3, "queue statistics");
+
 	// deinit
 
 	worker_queue_enqueue(&queue, &task_three);
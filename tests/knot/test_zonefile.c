@@ -0,0 +1,159 @@
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tap/basic.h>
+#include <tap/files.h>
+
+#include "contrib/string.h"
+#include "knot/zone/zone-dump.h"
+#include "knot/zone/zonefile.h"
+#include "libknot/libknot.h"
+
+// Large enough to be split among several parsing threads.
+#define ZONE_SIZE	(13 * 1024 * 1024)
+#define THREADS		4
+
+static const char *txt_data =
+	"\"Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+	"eiusmod tempor incididunt ut labore et dolore magna aliqua.\" "
+	"\"Ut enim ad minim veniam, quis nostrud exercitation ullamco.\"";
+
+static bool write_zone(const char *path, bool nsec3, const char *include)
+{
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		return false;
+	}
+
+	fprintf(file, "$TTL 3600\n"
+	              "@ SOA ns1 admin 2024010100 1800 900 604800 86400\n"
+	              "@ NS ns1\n"
+	              "ns1 A 192.0.2.1\n");
+	if (nsec3) {
+		fprintf(file, "@ NSEC3PARAM 1 0 0 -\n");
+	}
+
+	for (unsigned i = 0; ftell(file) < ZONE_SIZE; i++) {
+		// Repeated owners and changing directives across the chunks.
+		if (i % 10000 == 0) {
+			fprintf(file, "$TTL %u\n", 300 + i / 10000);
+		}
+		fprintf(file, "rec%u.sub%u TXT %s\n", i, i % 100, txt_data);
+		fprintf(file, "sub%u 60 ( A\n 192.0.2.%u )\n", i % 100, i % 250);
+		if (nsec3) {
+			fprintf(file, "%032x NSEC3 1 0 0 - %032x A RRSIG\n", i, i + 1);
+		}
+		if (i % 5000 == 0) {
+			fprintf(file, "$ORIGIN o%u.example.\n"
+			              "host TXT \"origin %u\"\n"
+			              "$ORIGIN example.\n", i, i);
+		}
+	}
+
+	if (include != NULL) {
+		fprintf(file, "$INCLUDE %s\n", include);
+	}
+
+	return fclose(file) == 0;
+}
+
+static zone_contents_t *load_zonefile(const char *path, const knot_dname_t *origin,
+                                      unsigned threads)
+{
+	zloader_t zl;
+	int ret = zonefile_open(&zl, path, origin, 3600, SEMCHECK_MANDATORY_ONLY, time(NULL));
+	if (ret != KNOT_EOK) {
+		return NULL;
+	}
+	sem_handler_t handler = { .cb = err_handler_logger };
+	zl.err_handler = &handler;
+	zl.creator->master = true;
+	zl.threads = threads;
+
+	zone_contents_t *contents = zonefile_load(&zl);
+	zonefile_close(&zl);
+	return contents;
+}
+
+static char *dump(zone_contents_t *contents)
+{
+	char *buf = NULL;
+	size_t size = 0;
+	FILE *file = open_memstream(&buf, &size);
+	if (file == NULL) {
+		return NULL;
+	}
+	(void)zone_dump_text(contents, file, false, NULL);
+	fclose(file);
+	return buf;
+}
+
+static void test_parallel(const char *path, const knot_dname_t *origin,
+                          const char *name)
+{
+	zone_contents_t *serial = load_zonefile(path, origin, 1);
+	ok(serial != NULL, "%s: serial load", name);
+	zone_contents_t *parallel = load_zonefile(path, origin, THREADS);
+	ok(parallel != NULL, "%s: parallel load", name);
+
+	char *dump_serial = dump(serial), *dump_parallel = dump(parallel);
+	ok(dump_serial != NULL && dump_parallel != NULL &&
+	   strcmp(dump_serial, dump_parallel) == 0, "%s: contents equal", name);
+	ok(serial != NULL && parallel != NULL &&
+	   zone_tree_count(serial->nodes) == zone_tree_count(parallel->nodes) &&
+	   zone_tree_count(serial->nsec3_nodes) == zone_tree_count(parallel->nsec3_nodes),
+	   "%s: node counts equal", name);
+
+	free(dump_serial);
+	free(dump_parallel);
+	zone_contents_deep_free(serial);
+	zone_contents_deep_free(parallel);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	char *dir = test_mkdtemp();
+	ok(dir != NULL, "make temporary directory");
+	char *zonefile = sprintf_alloc("%s/example.zone", dir);
+	char *incfile = sprintf_alloc("%s/include.zone", dir);
+	knot_dname_t *origin = knot_dname_from_str_alloc("example.");
+
+	ok(write_zone(zonefile, false, NULL), "write unsigned zone");
+	test_parallel(zonefile, origin, "unsigned");
+
+	ok(write_zone(zonefile, true, NULL), "write NSEC3 zone");
+	test_parallel(zonefile, origin, "NSEC3");
+
+	// $INCLUDE after the last split point falls back to the serial parsing.
+	FILE *file = fopen(incfile, "w");
+	ok(file != NULL && fprintf(file, "included TXT \"included\"\n") > 0 &&
+	   fclose(file) == 0, "write included file");
+	ok(write_zone(zonefile, false, incfile), "write zone with $INCLUDE");
+	test_parallel(zonefile, origin, "include");
+
+	knot_dname_free(origin, NULL);
+	free(incfile);
+	free(zonefile);
+	test_rm_rf(dir);
+	free(dir);
+
+	return 0;
+}
@@ -1,4 +1,4 @@
-/*  Copyright (C) 2021 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+/*  Copyright (C) 2024 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
 
     This program is free software: you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -20,6 +20,7 @@
 #include <tap/basic.h>
 
 #include "libknot/dname.h"
+#include "contrib/lower/lower.h"
 
 /* Test dname_parse_from_wire */
 static int test_fw(size_t l, const char *w) {
@@ -158,6 +159,80 @@ static void test_dname_storage(void)
 	   "knot_dname_storage: valid name");
 }
 
+static void test_dname_lower(void)
+{
+	knot_dname_storage_t storage;
+
+	const knot_dname_t *in = (uint8_t *)
+		"\x3f""ABCDEFGHIJKLMNOPQRSTUVWXYZ@[`{abcdefghijklmnopqrstuvwxyz0123456"
+		"\x05""\xc1\xdaZ\x00""A"
+		"\x02""Cz"
+		"\x00";
+	const knot_dname_t *ref = (uint8_t *)
+		"\x3f""abcdefghijklmnopqrstuvwxyz@[`{abcdefghijklmnopqrstuvwxyz0123456"
+		"\x05""\xc1\xdaz\x00""a"
+		"\x02""cz"
+		"\x00";
+	size_t size = knot_dname_size(in);
+
+	knot_dname_copy_lower(storage, in);
+	ok(memcmp(storage, ref, size) == 0, "knot_dname_copy_lower: converted");
+
+	memcpy(storage, in, size);
+	knot_dname_to_lower(storage);
+	ok(memcmp(storage, ref, size) == 0, "knot_dname_to_lower: converted");
+
+	ok(knot_dname_is_case_equal(in, ref), "dname_is_case_equal: long name");
+	storage[size - 2] = 'y';
+	ok(!knot_dname_is_case_equal(storage, ref), "dname_is_case_equal: last byte differs");
+}
+
+static void random_case(uint8_t *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		// Mostly letters and the bytes around them.
+		buf[i] = (rand() % 4 == 0) ? rand() % 256 : '@' + rand() % 60;
+	}
+}
+
+static void test_lower_api(const struct lower_api *api, const char *name)
+{
+	uint8_t src[300], dst[300], ref[300];
+
+	bool copy_same = true, equal_same = true;
+	for (size_t len = 0; len <= sizeof(src); len++) {
+		random_case(src, len);
+		memset(dst, 0, sizeof(dst));
+
+		LOWER_SCALAR.copy(ref, src, len);
+		api->copy(dst, src, len);
+		copy_same &= (memcmp(dst, ref, len) == 0) && dst[len] == 0;
+		api->copy(src, src, len);
+		copy_same &= (memcmp(src, ref, len) == 0);
+
+		// Flip letter case of a few bytes.
+		memcpy(dst, ref, len);
+		for (size_t i = 0; len > 0 && i < 4; i++) {
+			size_t pos = rand() % len;
+			if (dst[pos] >= 'a' && dst[pos] <= 'z') {
+				dst[pos] ^= 0x20;
+			}
+		}
+		equal_same &= api->equal(dst, ref, len) && api->equal(ref, dst, len);
+
+		// Change one byte in a case-sensitive way.
+		for (size_t pos = 0; pos < len; pos++) {
+			uint8_t orig = dst[pos];
+			dst[pos] = (orig == 0xff) ? 0 : orig + 1;
+			equal_same &= (api->equal(dst, ref, len) ==
+			               LOWER_SCALAR.equal(dst, ref, len));
+			dst[pos] = orig;
+		}
+	}
+	ok(copy_same, "%s: lowercase copy equal to scalar", name);
+	ok(equal_same, "%s: case-insensitive comparison equal to scalar", name);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -614,5 +689,15 @@ int main(int argc, char *argv[])
 
 	test_dname_storage();
 
+	test_dname_lower();
+
+	srand(1);
+	test_lower_api(&LOWER_GENERIC, "generic");
+#if defined(__x86_64__)
+	if (LOWER_AVX2.copy != NULL && __builtin_cpu_supports("avx2")) {
+		test_lower_api(&LOWER_AVX2, "avx2");
+	}
+#endif
+
 	return 0;
 }
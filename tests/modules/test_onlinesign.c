@@ -18,6 +18,7 @@
 #include <assert.h>
 
 #include "knot/modules/onlinesign/nsec_next.h"
+#include "knot/modules/onlinesign/rrsig_cache.h"
 #include "libknot/consts.h"
 #include "libknot/dname.h"
 #include "libknot/errcode.h"
@@ -58,6 +59,49 @@ static void _test_nsec_next(const char *msg,
 	_test_nsec_next(msg, input, apex, expected); \
 }
 
+static void test_rrsig_cache(void)
+{
+	ok(rrsig_cache_new(0, 4) == NULL, "rrsig_cache, disabled");
+
+	rrsig_cache_t *cache = rrsig_cache_new(64 * 1024, 2);
+	ok(cache != NULL, "rrsig_cache, create");
+
+	knot_rrset_t *covered = knot_rrset_new((uint8_t *)"\x03""www""\x07""example""\x03""com",
+	                                       KNOT_RRTYPE_A, KNOT_CLASS_IN, 3600, NULL);
+	knot_rrset_t *rrsig = knot_rrset_new(covered->owner, KNOT_RRTYPE_RRSIG,
+	                                     KNOT_CLASS_IN, 3600, NULL);
+	assert(covered && rrsig);
+	assert(knot_rrset_add_rdata(covered, (uint8_t *)"\x01\x02\x03\x04", 4, NULL) == KNOT_EOK);
+	assert(knot_rrset_add_rdata(rrsig, (uint8_t *)"fake signature", 14, NULL) == KNOT_EOK);
+
+	ok(rrsig_cache_get(cache, 0, covered, 1, 100) == NULL, "rrsig_cache, empty");
+
+	rrsig_cache_put(cache, 0, covered, 1, &rrsig->rrs, 200);
+	const knot_rdataset_t *found = rrsig_cache_get(cache, 0, covered, 1, 100);
+	ok(found != NULL && knot_rdataset_eq(found, &rrsig->rrs), "rrsig_cache, hit");
+	ok(rrsig_cache_get(cache, 1, covered, 1, 100) == NULL, "rrsig_cache, other shard");
+	ok(rrsig_cache_get(cache, 2, covered, 1, 100) == NULL, "rrsig_cache, invalid shard");
+
+	covered->ttl = 60;
+	ok(rrsig_cache_get(cache, 0, covered, 1, 100) == NULL, "rrsig_cache, other TTL");
+	covered->ttl = 3600;
+
+	knot_rrset_t *other = knot_rrset_copy(covered, NULL);
+	assert(knot_rrset_add_rdata(other, (uint8_t *)"\x05\x06\x07\x08", 4, NULL) == KNOT_EOK);
+	ok(rrsig_cache_get(cache, 0, other, 1, 100) == NULL, "rrsig_cache, other rdata");
+	knot_rrset_free(other, NULL);
+
+	ok(rrsig_cache_get(cache, 0, covered, 2, 100) == NULL, "rrsig_cache, new keys");
+	rrsig_cache_put(cache, 0, covered, 2, &rrsig->rrs, 200);
+	ok(rrsig_cache_get(cache, 0, covered, 2, 100) != NULL, "rrsig_cache, hit again");
+	ok(rrsig_cache_get(cache, 0, covered, 2, 200) == NULL, "rrsig_cache, expired");
+	ok(rrsig_cache_get(cache, 0, covered, 2, 100) == NULL, "rrsig_cache, expired dropped");
+
+	knot_rrset_free(covered, NULL);
+	knot_rrset_free(rrsig, NULL);
+	rrsig_cache_free(cache);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -199,5 +243,7 @@ int main(int argc, char *argv[])
 		APEX
 	);
 
+	test_rrsig_cache();
+
 	return 0;
 }
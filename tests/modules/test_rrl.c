@@ -197,6 +197,9 @@ void count_test(char *desc, int expected_passing, double margin_fract,
 				i % (max_value - min_value + 1) + min_value,
 				i / (max_value - min_value + 1) % 256);
 		sockaddr_set(&addr, addr_family, addr_str, 0);
+		// Prefetching mustn't influence the result.
+		const struct sockaddr_storage *remotes[] = { &addr };
+		rrl_prefetch(rrl, remotes, 1);
 		if (rrl_query(rrl, &addr, NULL) != KNOT_EOK) {
 			cnt = i;
 			break;